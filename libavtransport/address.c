@@ -289,6 +289,9 @@ int avt_addr_from_info(void *log_ctx, AVTAddress *addr, AVTConnectionInfo *info)
         break;
     };
 
+    addr->zerocopy = info->output_opts.zerocopy;
+    addr->read_only = info->input_opts.read_only;
+
     return 0;
 }
 
@@ -46,6 +46,12 @@ typedef struct AVTAddress {
     char8_t *interface;
     char8_t *path;
     AVTMetadata *params;
+
+    /* Send without copying payloads, where supported */
+    bool zerocopy;
+
+    /* Only read from the address (files: do not create or truncate) */
+    bool read_only;
 } AVTAddress;
 
 int avt_addr_from_url(void *log_ctx, AVTAddress *addr, const char *path);
@@ -31,26 +31,43 @@
 #include <avtransport/avtransport.h>
 
 #include "common.h"
+#include "buffer.h"
 
 int avt_init(AVTContext **ctx, AVTContextOptions *opts)
 {
-    AVTContext *tmp = malloc(sizeof(*tmp));
+    AVTContext *tmp = calloc(1, sizeof(*tmp));
     if (!tmp)
         return AVT_ERROR(ENOMEM);
 
     if (opts)
         tmp->opts = *opts;
 
+    int err = avt_buffer_pool_init(&tmp->buffer_pool, tmp->opts.buffer_pool_max);
+    if (err < 0) {
+        free(tmp);
+        return err;
+    }
+
     atomic_init(&tmp->output.seq, 0);
     atomic_init(&tmp->input.seq, 0);
+    atomic_init(&tmp->input.fec_corrections, 0);
+    atomic_init(&tmp->input.corrupt_packets, 0);
 
     *ctx = tmp;
     return 0;
 }
 
+int avt_input_set_options(AVTContext *ctx, AVTInputOptions *opts)
+{
+    ctx->input.opts = *opts;
+    return 0;
+}
+
 void avt_close(AVTContext **ctx)
 {
     if (ctx) {
+        if (*ctx)
+            avt_buffer_pool_uninit(&(*ctx)->buffer_pool);
         free(*ctx);
         *ctx = NULL;
     }
@@ -26,24 +26,212 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdalign.h>
+#include <pthread.h>
 
 #include "buffer.h"
 #include "utils_internal.h"
 
+/* Number of buffer headers allocated at once */
+#define SLAB_NB_SLOTS 128
+
+/* Maximum number of free headers each thread keeps to itself, and
+ * the number of headers exchanged at once with the global pool */
+#define SLAB_CACHE_MAX   256
+#define SLAB_CACHE_BATCH  64
+
+/* A buffer header, with the reference count of the underlying data
+ * co-located in the same cache line. The reference count is only used
+ * if this header was the one which created the buffer. References
+ * point to the reference count of the originating header, and the
+ * originating header is only released once its count reaches zero. */
+typedef struct AVTBufferSlot {
+    alignas(64) union {
+        AVTBuffer buf;
+        struct AVTBufferSlot *next;
+    };
+    atomic_int refcnt;
+} AVTBufferSlot;
+
+static_assert(sizeof(AVTBufferSlot) == 64, "Buffer headers must fit in a cache line");
+
+typedef struct AVTBufferSlabCache {
+    AVTBufferSlot *head;
+    unsigned int nb;
+
+    /* Counters not yet published to the global pool */
+    uint64_t hits;
+    uint64_t misses;
+
+    bool registered;
+} AVTBufferSlabCache;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    pthread_key_t key;
+
+    AVTBufferSlot *free;
+    unsigned int nb_free;
+
+    void **slabs;
+    unsigned int nb_slabs;
+
+    atomic_uint_least64_t hits;
+    atomic_uint_least64_t misses;
+} slab_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local AVTBufferSlabCache slab_cache;
+
+/* Moves nb slots from the cache into the global pool. Must be locked. */
+static void slab_cache_flush(AVTBufferSlabCache *c, unsigned int nb)
+{
+    while (nb-- && c->head) {
+        AVTBufferSlot *s = c->head;
+        c->head = s->next;
+        c->nb--;
+
+        s->next = slab_pool.free;
+        slab_pool.free = s;
+        slab_pool.nb_free++;
+    }
+
+    atomic_fetch_add_explicit(&slab_pool.hits, c->hits, memory_order_relaxed);
+    atomic_fetch_add_explicit(&slab_pool.misses, c->misses, memory_order_relaxed);
+    c->hits = c->misses = 0;
+}
+
+/* Called on thread exit, gives back all cached slots */
+static void slab_cache_uninit(void *opaque)
+{
+    AVTBufferSlabCache *c = opaque;
+
+    pthread_mutex_lock(&slab_pool.lock);
+    slab_cache_flush(c, c->nb);
+    pthread_mutex_unlock(&slab_pool.lock);
+
+    c->registered = false;
+}
+
+static void slab_pool_init(void)
+{
+    pthread_key_create(&slab_pool.key, slab_cache_uninit);
+}
+
+/* Refill the thread cache from the global pool, allocating a new slab
+ * if needed. Must be locked. */
+static int slab_cache_refill(AVTBufferSlabCache *c)
+{
+    if (!slab_pool.free) {
+        void **slabs = realloc(slab_pool.slabs,
+                               (slab_pool.nb_slabs + 1)*sizeof(*slabs));
+        if (!slabs)
+            return AVT_ERROR(ENOMEM);
+        slab_pool.slabs = slabs;
+
+        AVTBufferSlot *slab = aligned_alloc(alignof(AVTBufferSlot),
+                                            SLAB_NB_SLOTS*sizeof(*slab));
+        if (!slab)
+            return AVT_ERROR(ENOMEM);
+        slab_pool.slabs[slab_pool.nb_slabs++] = slab;
+
+        for (int i = 0; i < SLAB_NB_SLOTS; i++) {
+            slab[i].next = slab_pool.free;
+            slab_pool.free = &slab[i];
+        }
+        slab_pool.nb_free += SLAB_NB_SLOTS;
+    }
+
+    for (int i = 0; i < SLAB_CACHE_BATCH && slab_pool.free; i++) {
+        AVTBufferSlot *s = slab_pool.free;
+        slab_pool.free = s->next;
+        slab_pool.nb_free--;
+
+        s->next = c->head;
+        c->head = s;
+        c->nb++;
+    }
+
+    return 0;
+}
+
+static AVTBufferSlot *slot_alloc(void)
+{
+    AVTBufferSlabCache *c = &slab_cache;
+
+    if (!c->head) {
+        if (!c->registered) {
+            pthread_once(&slab_pool.once, slab_pool_init);
+            pthread_setspecific(slab_pool.key, c);
+            c->registered = true;
+        }
+
+        c->misses++;
+
+        pthread_mutex_lock(&slab_pool.lock);
+        int err = slab_cache_refill(c);
+        pthread_mutex_unlock(&slab_pool.lock);
+        if (err < 0)
+            return NULL;
+    } else {
+        c->hits++;
+    }
+
+    AVTBufferSlot *s = c->head;
+    c->head = s->next;
+    c->nb--;
+
+    return s;
+}
+
+static void slot_release(AVTBufferSlot *s)
+{
+    AVTBufferSlabCache *c = &slab_cache;
+
+    s->next = c->head;
+    c->head = s;
+    c->nb++;
+
+    /* Slots may be freed on a different thread than the one they were
+     * allocated from, so keep the caches bounded. */
+    if (c->nb > SLAB_CACHE_MAX) {
+        pthread_mutex_lock(&slab_pool.lock);
+        slab_cache_flush(c, SLAB_CACHE_BATCH);
+        pthread_mutex_unlock(&slab_pool.lock);
+    }
+}
+
+static inline AVTBufferSlot *slot_from_refcnt(atomic_int *refcnt)
+{
+    return (AVTBufferSlot *)((uint8_t *)refcnt - offsetof(AVTBufferSlot, refcnt));
+}
+
+void avt_buffer_get_slab_stats(uint64_t *hits, uint64_t *misses,
+                               size_t *allocated)
+{
+    AVTBufferSlabCache *c = &slab_cache;
+
+    pthread_mutex_lock(&slab_pool.lock);
+    *hits = atomic_load_explicit(&slab_pool.hits, memory_order_relaxed) + c->hits;
+    *misses = atomic_load_explicit(&slab_pool.misses, memory_order_relaxed) + c->misses;
+    *allocated = slab_pool.nb_slabs*SLAB_NB_SLOTS*sizeof(AVTBufferSlot);
+    pthread_mutex_unlock(&slab_pool.lock);
+}
+
 AVTBuffer *avt_buffer_create(uint8_t *data, size_t len,
                              void *opaque, void (*free_fn)(void *opaque, void *base_data))
 {
-    AVTBuffer *buf = malloc(sizeof(*buf));
-    if (!buf)
+    AVTBufferSlot *s = slot_alloc();
+    if (!s)
         return NULL;
 
-    buf->refcnt = malloc(sizeof(*buf->refcnt));
-    if (!buf->refcnt) {
-        free(buf);
-        return NULL;
-    }
+    AVTBuffer *buf = &s->buf;
 
-    atomic_init(buf->refcnt, 1);
+    atomic_init(&s->refcnt, 1);
+    buf->refcnt = &s->refcnt;
 
     buf->base_data = data;
     buf->end_data = data + len;
@@ -58,15 +246,21 @@ AVTBuffer *avt_buffer_create(uint8_t *data, size_t len,
 int avt_buffer_realloc(AVTBuffer *buf, size_t len)
 {
     avt_assert2(avt_buffer_get_refcount(buf) == 1);
+
+    if (buf->free == avt_buffer_pool_release)
+        return avt_buffer_pool_realloc(buf, len);
+
     avt_assert2(buf->free == avt_buffer_default_free);
 
+    ptrdiff_t offset = buf->data - buf->base_data;
     uint8_t *newdata = realloc(buf->base_data, len);
     if (!newdata)
         return AVT_ERROR(ENOMEM);
 
     buf->base_data = newdata;
     buf->end_data = newdata + len;
-    buf->len = len;
+    buf->data = newdata + offset;
+    buf->len = len - offset;
 
     return 0;
 }
@@ -103,10 +297,12 @@ AVTBuffer *avt_buffer_reference(AVTBuffer *buffer, ptrdiff_t offset, int64_t len
     if (buffer->base_data + offset > buffer->end_data)
         return NULL;
 
-    AVTBuffer *ret = malloc(sizeof(*ret));
-    if (!ret)
+    AVTBufferSlot *s = slot_alloc();
+    if (!s)
         return NULL;
 
+    AVTBuffer *ret = &s->buf;
+
     atomic_fetch_add_explicit(buffer->refcnt, 1, memory_order_relaxed);
 
     memcpy(ret, buffer, sizeof(*ret));
@@ -130,33 +326,40 @@ int avt_buffer_offset(AVTBuffer *buf, ptrdiff_t offset)
 int avt_buffer_quick_ref(AVTBuffer *dst, AVTBuffer *buffer,
                          ptrdiff_t offset, size_t len)
 {
-    if (!buffer)
+    if (!buffer || !buffer->refcnt) {
+        memset(dst, 0, sizeof(*dst));
         return 0;
-    else if (buffer->base_data + offset > buffer->end_data)
+    } else if (offset < 0 || offset > buffer->len ||
+               len > (buffer->len - offset)) {
         return AVT_ERROR(EINVAL);
+    }
 
     atomic_fetch_add_explicit(buffer->refcnt, 1, memory_order_relaxed);
 
     memcpy(dst, buffer, sizeof(*dst));
 
     dst->data += offset;
-    dst->len = !len ? dst->end_data - dst->data : len;
+    dst->len = !len ? buffer->len - offset : len;
 
     return 0;
 }
 
 void avt_buffer_quick_unref(AVTBuffer *buf)
 {
-    if (!buf)
+    if (!buf || !buf->refcnt)
         return;
 
-    if (atomic_fetch_sub_explicit(buf->refcnt, 1, memory_order_acq_rel) == 1) {
-        buf->free(buf->opaque, buf->data);
-        free(buf->refcnt);
-    }
+    AVTBuffer tmp = *buf;
 
-    /* Zero out to avoid leaks */
+    /* Zero out to avoid leaks. Done first, as buf may be the header
+     * which owns the reference count. */
     memset(buf, 0, sizeof(*buf));
+
+    if (atomic_fetch_sub_explicit(tmp.refcnt, 1, memory_order_acq_rel) == 1) {
+        if (tmp.free)
+            tmp.free(tmp.opaque, tmp.base_data);
+        slot_release(slot_from_refcnt(tmp.refcnt));
+    }
 }
 
 int avt_buffer_get_refcount(AVTBuffer *buffer)
@@ -189,10 +392,18 @@ size_t avt_buffer_get_data_len(AVTBuffer *buffer)
 void avt_buffer_unref(AVTBuffer **buffer)
 {
     AVTBuffer *buf = *buffer;
-    if (!buffer)
+    if (!buf)
         return;
 
+    /* The header which created the buffer is released along with
+     * the last reference, all others can go immediately. */
+    AVTBufferSlot *s = (AVTBufferSlot *)buf;
+    bool owner = buf->refcnt == &s->refcnt;
+
     avt_buffer_quick_unref(buf);
 
-    free(buf);
+    if (!owner)
+        slot_release(s);
+
+    *buffer = NULL;
 }
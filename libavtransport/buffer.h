@@ -50,6 +50,46 @@ int avt_buffer_quick_ref(AVTBuffer *dst, AVTBuffer *buffer,
 
 void avt_buffer_quick_unref(AVTBuffer *buf);
 
+/* Statistics of the buffer header allocator. Hits are allocations served
+ * without taking a lock or calling malloc. Counters of other threads
+ * are published in batches, so the values are approximate. */
+void avt_buffer_get_slab_stats(uint64_t *hits, uint64_t *misses,
+                               size_t *allocated);
+
 int avt_buffer_offset(AVTBuffer *buf, ptrdiff_t offset);
 
+/* Size-class buffer pool. Buffers handed out return their memory to
+ * the pool once their last reference is gone. Thread-safe. */
+typedef struct AVTBufferPool AVTBufferPool;
+
+typedef struct AVTBufferPoolStats {
+    size_t used;      /* Bytes currently handed out */
+    size_t peak_used; /* High-water mark of used */
+    size_t cached;    /* Bytes kept for reuse */
+    uint64_t hits;    /* Allocations served from cached memory */
+    uint64_t misses;  /* Allocations which needed new memory */
+} AVTBufferPoolStats;
+
+/* Initialize a pool. max_size limits the memory retained by the pool
+ * (used and cached). Allocations are never refused, but memory returned
+ * while over the limit is freed rather than cached.
+ * If max_size is 0, a default is used. */
+int avt_buffer_pool_init(AVTBufferPool **pool, size_t max_size);
+
+/* Get a buffer of at least len bytes. If pool is NULL, or the length is
+ * above the largest size class, a regular buffer is allocated. */
+AVTBuffer *avt_buffer_pool_get(AVTBufferPool *pool, size_t len);
+
+/* Free callback for pooled buffers */
+void avt_buffer_pool_release(void *opaque, void *base_data);
+
+/* Reallocate a pooled buffer, used by avt_buffer_realloc().
+ * Grown past the largest size class, it leaves the pool. */
+int avt_buffer_pool_realloc(AVTBuffer *buf, size_t len);
+
+void avt_buffer_pool_get_stats(AVTBufferPool *pool, AVTBufferPoolStats *stats);
+
+/* Uninitialize a pool. Buffers still referenced remain valid. */
+void avt_buffer_pool_uninit(AVTBufferPool **pool);
+
 #endif
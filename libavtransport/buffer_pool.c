@@ -0,0 +1,265 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "buffer.h"
+#include "utils_internal.h"
+
+/* Smallest and largest pooled size classes, as powers of two.
+ * Anything larger is allocated directly. */
+#define POOL_MIN_CLASS_BITS  8
+#define POOL_MAX_CLASS_BITS 26
+#define POOL_NB_CLASSES (POOL_MAX_CLASS_BITS - POOL_MIN_CLASS_BITS + 1)
+
+/* Default amount of memory retained by a pool */
+#define POOL_DEFAULT_MAX_SIZE (128 << 20)
+
+typedef struct AVTBufferPoolClass {
+    AVTBufferPool *pool;
+    size_t size;
+
+    /* Free blocks, linked through their first bytes */
+    void *free;
+    unsigned int nb_free;
+} AVTBufferPoolClass;
+
+struct AVTBufferPool {
+    pthread_mutex_t lock;
+
+    /* One for the owner, plus one per block handed out */
+    atomic_int refcnt;
+    bool closed;
+
+    size_t max_size;
+    AVTBufferPoolStats stats;
+
+    AVTBufferPoolClass classes[POOL_NB_CLASSES];
+};
+
+static inline int pool_class_idx(size_t len)
+{
+    if (len <= (1 << POOL_MIN_CLASS_BITS))
+        return 0;
+
+    int bits = 64 - __builtin_clzll(len - 1);
+    if (bits > POOL_MAX_CLASS_BITS)
+        return -1;
+
+    return bits - POOL_MIN_CLASS_BITS;
+}
+
+int avt_buffer_pool_init(AVTBufferPool **_pool, size_t max_size)
+{
+    AVTBufferPool *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return AVT_ERROR(ENOMEM);
+
+    if (pthread_mutex_init(&pool->lock, NULL)) {
+        free(pool);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    atomic_init(&pool->refcnt, 1);
+    pool->max_size = max_size ? max_size : POOL_DEFAULT_MAX_SIZE;
+
+    for (int i = 0; i < POOL_NB_CLASSES; i++) {
+        pool->classes[i].pool = pool;
+        pool->classes[i].size = 1ULL << (POOL_MIN_CLASS_BITS + i);
+    }
+
+    *_pool = pool;
+
+    return 0;
+}
+
+/* Must be locked */
+static void pool_free_cached(AVTBufferPool *pool)
+{
+    for (int i = 0; i < POOL_NB_CLASSES; i++) {
+        AVTBufferPoolClass *c = &pool->classes[i];
+        while (c->free) {
+            void *next = *((void **)c->free);
+            free(c->free);
+            c->free = next;
+        }
+        pool->stats.cached -= c->nb_free*c->size;
+        c->nb_free = 0;
+    }
+}
+
+static void pool_unref(AVTBufferPool *pool)
+{
+    if (atomic_fetch_sub_explicit(&pool->refcnt, 1, memory_order_acq_rel) == 1) {
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+    }
+}
+
+void avt_buffer_pool_release(void *opaque, void *base_data)
+{
+    AVTBufferPoolClass *c = opaque;
+    AVTBufferPool *pool = c->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    pool->stats.used -= c->size;
+
+    /* Only keep the block if the memory retained stays under the limit */
+    if (!pool->closed &&
+        (pool->stats.used + pool->stats.cached + c->size) <= pool->max_size) {
+        *((void **)base_data) = c->free;
+        c->free = base_data;
+        c->nb_free++;
+        pool->stats.cached += c->size;
+        base_data = NULL;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    free(base_data);
+    pool_unref(pool);
+}
+
+/* Get a block from a size class, with the pool locked */
+static void *pool_get_block(AVTBufferPool *pool, AVTBufferPoolClass *c)
+{
+    void *block = c->free;
+    if (block) {
+        c->free = *((void **)block);
+        c->nb_free--;
+        pool->stats.cached -= c->size;
+        pool->stats.hits++;
+    } else {
+        pthread_mutex_unlock(&pool->lock);
+        block = malloc(c->size);
+        pthread_mutex_lock(&pool->lock);
+        if (!block)
+            return NULL;
+        pool->stats.misses++;
+    }
+
+    pool->stats.used += c->size;
+    pool->stats.peak_used = AVT_MAX(pool->stats.peak_used, pool->stats.used);
+
+    return block;
+}
+
+AVTBuffer *avt_buffer_pool_get(AVTBufferPool *pool, size_t len)
+{
+    int idx = pool_class_idx(len);
+    if (!pool || idx < 0)
+        return avt_buffer_alloc(len);
+
+    AVTBufferPoolClass *c = &pool->classes[idx];
+
+    pthread_mutex_lock(&pool->lock);
+    void *block = pool_get_block(pool, c);
+    pthread_mutex_unlock(&pool->lock);
+    if (!block)
+        return NULL;
+
+    atomic_fetch_add_explicit(&pool->refcnt, 1, memory_order_relaxed);
+
+    AVTBuffer *buf = avt_buffer_create(block, len, c, avt_buffer_pool_release);
+    if (!buf) {
+        avt_buffer_pool_release(c, block);
+        return NULL;
+    }
+
+    return buf;
+}
+
+int avt_buffer_pool_realloc(AVTBuffer *buf, size_t len)
+{
+    AVTBufferPoolClass *c = buf->opaque;
+    AVTBufferPool *pool = c->pool;
+
+    avt_assert1(buf->free == avt_buffer_pool_release);
+
+    /* Still fits in the same block */
+    if (len <= c->size) {
+        buf->end_data = buf->base_data + len;
+        buf->len = len - (buf->data - buf->base_data);
+        return 0;
+    }
+
+    /* Past the largest size class, the buffer leaves the pool */
+    int idx = pool_class_idx(len);
+    AVTBufferPoolClass *nc = idx < 0 ? NULL : &pool->classes[idx];
+
+    uint8_t *block;
+    if (nc) {
+        pthread_mutex_lock(&pool->lock);
+        block = pool_get_block(pool, nc);
+        pthread_mutex_unlock(&pool->lock);
+    } else {
+        block = malloc(len);
+    }
+    if (!block)
+        return AVT_ERROR(ENOMEM);
+
+    if (nc)
+        atomic_fetch_add_explicit(&pool->refcnt, 1, memory_order_relaxed);
+
+    ptrdiff_t offset = buf->data - buf->base_data;
+    memcpy(block, buf->base_data, buf->end_data - buf->base_data);
+    avt_buffer_pool_release(c, buf->base_data);
+
+    buf->opaque = nc;
+    buf->free = nc ? avt_buffer_pool_release : avt_buffer_default_free;
+    buf->base_data = block;
+    buf->end_data = block + len;
+    buf->data = block + offset;
+    buf->len = len - offset;
+
+    return 0;
+}
+
+void avt_buffer_pool_get_stats(AVTBufferPool *pool, AVTBufferPoolStats *stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void avt_buffer_pool_uninit(AVTBufferPool **_pool)
+{
+    AVTBufferPool *pool = *_pool;
+    if (!pool)
+        return;
+
+    /* Buffers still in use will free their memory once unreferenced */
+    pthread_mutex_lock(&pool->lock);
+    pool->closed = true;
+    pool_free_cached(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool_unref(pool);
+    *_pool = NULL;
+}
@@ -31,10 +31,19 @@
 
 #include <avtransport/avtransport.h>
 
+#include "fec.h"
+
 typedef struct AVTStreamPriv {
     enum AVTCodecID codec_id;
 
     struct AVTOutput *out;
+
+    /* Packets sent, segments included */
+    atomic_uint_least64_t nb_pkts;
+
+    /* Parity overhead, in percent, and its controller */
+    atomic_uint fec_overhead;
+    AVTFECControl fec_ctrl;
 } AVTStreamPriv;
 
 struct AVTContext {
@@ -53,13 +62,21 @@ struct AVTContext {
         struct AVTInputContext *ctx;
         AVTInputCallbacks proc;
         void *cb_opaque;
+        AVTInputOptions opts;
         atomic_uint seq;
         uint64_t epoch;
+
+        /* Headers corrected, and headers found corrupt, corrected or not */
+        atomic_uint_least64_t fec_corrections;
+        atomic_uint_least64_t corrupt_packets;
     } input;
 
     AVTStream **stream;
     int nb_stream;
 
+    /* Pool for payloads and input data */
+    struct AVTBufferPool *buffer_pool;
+
     AVTContextOptions opts;
 };
 
@@ -25,13 +25,30 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
 
 #include "connection_internal.h"
+#include "connection_mirror.h"
+#include "connection_resend.h"
 #include "protocol_common.h"
 #include "utils_internal.h"
 
 #include "../config.h"
 
+/* Number of packets which can be queued by producers before they have to wait
+ * for the queue to be drained. Large enough for keyframe bursts. */
+#define CONN_QUEUE_SIZE 1024
+
+/* Resends come in bursts of a few ranges at most */
+#define CONN_RESEND_QUEUE_SIZE 256
+
+/* Maximum number of resend requests made after each receive */
+#define CONN_NACK_BATCH 16
+
 struct AVTConnection {
     AVTAddress addr;
     AVTContext *ctx;
@@ -40,19 +57,342 @@ struct AVTConnection {
     const AVTProtocol *p;
     AVTProtocolCtx *p_ctx;
 
-    /* File mirror */
-    const AVTProtocol *mirror;
-    AVTProtocolCtx *mirror_ctx;
+    /* File mirror, also used to resend packets from */
+    _Atomic(AVTMirror *) mirror;
 
-    /* Output FIFO, pre-scheduler */
-    AVTPacketFifo out_fifo_pre;
+    /* Output queue, pre-scheduler. Producers push from any thread,
+     * a single drainer pops. */
+    AVTPacketQueue out_queue;
+
+    /* Packets to resend. Drained like the output queue, but sent
+     * before it, bypassing the scheduler and the mirror.
+     * Only allocated once there is something to resend from. */
+    _Atomic(AVTPacketQueue *) resend_queue;
+
+    /* Recently sent packets, resent from before going to the mirror */
+    AVTResendRing resend_ring;
     AVTScheduler out_scheduler;
     AVTPacketFifo out_fifo_post;
 
+    /* Synchronous mode: set while a producer is draining the queue */
+    atomic_flag draining;
+
+    /* Asynchronous mode: the sender thread drains the queue */
+    int async;
+    pthread_t sender;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t drained;
+    atomic_bool sender_idle;
+    atomic_int sender_err;
+    bool running;
+
+    /* Flush asked for, done by the sender thread once everything is out */
+    bool flush_req;
+    int flush_err;
+
     /* Input reorder buffer */
     AVTReorderBuffer in_buffer;
+    AVTPacketFifo in_fifo;
+
+    /* Callbacks for resend requests and feedback on the input */
+    AVTInputCallbacks in_cb;
+    void *in_cb_opaque;
+
+    /* Corrupt headers and lost packets last reported via the
+     * feedback callback */
+    uint64_t in_corrupt;
+    uint64_t in_lost;
 };
 
+static bool conn_pending(AVTConnection *conn)
+{
+    AVTPacketQueue *rq = atomic_load_explicit(&conn->resend_queue,
+                                              memory_order_acquire);
+    return avt_pkt_queue_pending(&conn->out_queue) ||
+           (rq && avt_pkt_queue_pending(rq));
+}
+
+/* Allocate the resend queue, before a resend ring or mirror is used */
+static int conn_resend_queue_init(AVTConnection *conn)
+{
+    AVTPacketQueue *rq = NULL;
+    if (atomic_load(&conn->resend_queue))
+        return 0;
+
+    AVTPacketQueue *q = aligned_alloc(alignof(AVTPacketQueue), sizeof(*q));
+    if (!q)
+        return AVT_ERROR(ENOMEM);
+
+    int err = avt_pkt_queue_init(q, CONN_RESEND_QUEUE_SIZE);
+    if (err < 0) {
+        free(q);
+        return err;
+    }
+
+    if (!atomic_compare_exchange_strong(&conn->resend_queue, &rq, q)) {
+        avt_pkt_queue_free(q);
+        free(q);
+    }
+
+    return 0;
+}
+
+static void conn_resend_queue_free(AVTConnection *conn)
+{
+    AVTPacketQueue *rq = atomic_exchange(&conn->resend_queue, NULL);
+    if (rq) {
+        avt_pkt_queue_free(rq);
+        free(rq);
+    }
+}
+
+/* Send all packets the scheduler allows to be sent right now */
+static int conn_send_scheduled(AVTConnection *conn)
+{
+    int err, ret = 0;
+    AVTPacketFifo *seq;
+    AVTMirror *mirror = atomic_load_explicit(&conn->mirror, memory_order_acquire);
+
+    while (!avt_scheduler_wait_time(&conn->out_scheduler)) {
+        err = avt_scheduler_pop(&conn->out_scheduler, &seq);
+        if (err < 0)
+            return err;
+
+        if (!seq->nb) {
+            avt_scheduler_done(&conn->out_scheduler, seq);
+            break;
+        }
+
+        /* Mirror first, so anything sent can be resent */
+        if (mirror) {
+            err = avt_mirror_write(mirror, seq);
+            if (err < 0)
+                ret = err;
+        }
+        avt_resend_ring_add(&conn->resend_ring, seq, avt_get_time_ns());
+
+        if (conn->p->send_packets) {
+            int64_t ret64 = conn->p->send_packets(conn->ctx, conn->p_ctx, seq);
+            if (ret64 < 0)
+                ret = (int)ret64;
+        } else {
+            union AVTPacketData pkt;
+            AVTBuffer pl;
+            while (!avt_pkt_fifo_pop(seq, &pkt, &pl)) {
+                int64_t ret64 = conn->p->send_packet(conn->ctx, conn->p_ctx, pkt, &pl);
+                if (ret64 < 0)
+                    ret = (int)ret64;
+                avt_buffer_quick_unref(&pl);
+            }
+        }
+
+        avt_scheduler_done(&conn->out_scheduler, seq);
+    }
+
+    return ret;
+}
+
+/* Move everything from the queue into the scheduler. Single consumer only. */
+static int conn_drain(AVTConnection *conn)
+{
+    int err, ret = 0;
+    union AVTPacketData pkt;
+    AVTBuffer pl;
+
+    /* Resends are late already, so they skip the scheduler */
+    AVTPacketQueue *rq = atomic_load_explicit(&conn->resend_queue,
+                                              memory_order_acquire);
+    while (rq && !avt_pkt_queue_pop(rq, &pkt, &pl)) {
+        int64_t ret64 = conn->p->send_packet(conn->ctx, conn->p_ctx, pkt, &pl);
+        avt_buffer_quick_unref(&pl);
+        if (ret64 < 0)
+            ret = (int)ret64;
+    }
+
+    while (!avt_pkt_queue_pop(&conn->out_queue, &pkt, &pl)) {
+        err = avt_scheduler_push(&conn->out_scheduler, pkt, &pl);
+        avt_buffer_quick_unref(&pl);
+        if (err < 0)
+            ret = err;
+    }
+
+    err = conn_send_scheduled(conn);
+    if (err < 0)
+        ret = err;
+
+    return ret;
+}
+
+/* Synchronous mode: whichever producer gets the flag drains the queue on
+ * behalf of everyone else. A producer which fails to get it does not wait,
+ * as the current drainer is guaranteed to see its packet. */
+static int conn_try_drain(AVTConnection *conn)
+{
+    int err, ret = 0;
+
+    do {
+        if (atomic_flag_test_and_set(&conn->draining))
+            return ret;
+
+        err = conn_drain(conn);
+        if (err < 0)
+            ret = err;
+
+        atomic_flag_clear(&conn->draining);
+    } while (conn_pending(conn));
+
+    return ret;
+}
+
+/* Synchronous mode: send everything, waiting for the rate limit if needed,
+ * then flush. The protocol is flushed while still holding the flag, so that
+ * nothing else sends through it meanwhile. */
+static int conn_flush_sync(AVTConnection *conn)
+{
+    int err;
+    int64_t wait;
+    bool done;
+
+    for (;;) {
+        if (atomic_flag_test_and_set(&conn->draining)) {
+            sched_yield();
+            continue;
+        }
+
+        err = conn_drain(conn);
+        wait = avt_scheduler_wait_time(&conn->out_scheduler);
+
+        done = err >= 0 && wait < 0 && !conn_pending(conn);
+        if (done)
+            err = conn->p->flush(conn->ctx, conn->p_ctx);
+
+        atomic_flag_clear(&conn->draining);
+
+        if (err < 0)
+            return err;
+        if (done)
+            return 0;
+        if (wait > 0)
+            nanosleep(&(struct timespec){ .tv_sec = wait / 1000000000,
+                                          .tv_nsec = wait % 1000000000 }, NULL);
+    }
+}
+
+static void conn_wake_sender(AVTConnection *conn)
+{
+    pthread_mutex_lock(&conn->lock);
+    pthread_cond_signal(&conn->wake);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+static void *conn_sender_thread(void *arg)
+{
+    AVTConnection *conn = arg;
+
+    pthread_mutex_lock(&conn->lock);
+    while (conn->running) {
+        pthread_mutex_unlock(&conn->lock);
+
+        int err = conn_drain(conn);
+        if (err < 0)
+            atomic_store(&conn->sender_err, err);
+
+        pthread_mutex_lock(&conn->lock);
+
+        /* Only this thread sends, so flushing from here cannot race it */
+        if (conn->flush_req && !conn_pending(conn) &&
+            avt_scheduler_wait_time(&conn->out_scheduler) < 0) {
+            pthread_mutex_unlock(&conn->lock);
+            err = conn->p->flush(conn->ctx, conn->p_ctx);
+            pthread_mutex_lock(&conn->lock);
+            conn->flush_err = err;
+            conn->flush_req = false;
+        }
+
+        /* Producers only signal when we're idle. Setting the flag before
+         * checking the queue means either we see their packet, or they see
+         * the flag and signal us once we're waiting (we hold the lock). */
+        atomic_store(&conn->sender_idle, true);
+        int64_t wait = avt_scheduler_wait_time(&conn->out_scheduler);
+        if (conn->running && !conn_pending(conn)) {
+            if (wait < 0) {
+                pthread_cond_broadcast(&conn->drained);
+                pthread_cond_wait(&conn->wake, &conn->lock);
+            } else if (wait > 0) {
+                /* Rate limited, sleep until more can be sent */
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                wait += ts.tv_nsec;
+                ts.tv_sec += wait / 1000000000;
+                ts.tv_nsec = wait % 1000000000;
+                pthread_cond_timedwait(&conn->wake, &conn->lock, &ts);
+            }
+        }
+        atomic_store(&conn->sender_idle, false);
+    }
+    pthread_cond_broadcast(&conn->drained);
+    pthread_mutex_unlock(&conn->lock);
+
+    return NULL;
+}
+
+static int conn_async_init(AVTConnection *conn)
+{
+    int err;
+
+    err = pthread_mutex_init(&conn->lock, NULL);
+    if (err)
+        return AVT_ERROR(err);
+
+    err = pthread_cond_init(&conn->wake, NULL);
+    if (err) {
+        pthread_mutex_destroy(&conn->lock);
+        return AVT_ERROR(err);
+    }
+
+    err = pthread_cond_init(&conn->drained, NULL);
+    if (err) {
+        pthread_cond_destroy(&conn->wake);
+        pthread_mutex_destroy(&conn->lock);
+        return AVT_ERROR(err);
+    }
+
+    atomic_init(&conn->sender_idle, false);
+    atomic_init(&conn->sender_err, 0);
+    conn->running = true;
+
+    err = pthread_create(&conn->sender, NULL, conn_sender_thread, conn);
+    if (err) {
+        pthread_cond_destroy(&conn->drained);
+        pthread_cond_destroy(&conn->wake);
+        pthread_mutex_destroy(&conn->lock);
+        return AVT_ERROR(err);
+    }
+
+    conn->async = 1;
+
+    return 0;
+}
+
+static void conn_async_uninit(AVTConnection *conn)
+{
+    if (!conn->async)
+        return;
+
+    pthread_mutex_lock(&conn->lock);
+    conn->running = false;
+    pthread_cond_signal(&conn->wake);
+    pthread_mutex_unlock(&conn->lock);
+
+    pthread_join(conn->sender, NULL);
+
+    pthread_cond_destroy(&conn->drained);
+    pthread_cond_destroy(&conn->wake);
+    pthread_mutex_destroy(&conn->lock);
+    conn->async = 0;
+}
+
 int avt_connection_create(AVTContext *ctx, AVTConnection **_conn,
                           AVTConnectionInfo *info)
 {
@@ -61,64 +401,278 @@ int avt_connection_create(AVTContext *ctx, AVTConnection **_conn,
     if (err < 0)
         return err;
 
-    AVTConnection *conn = calloc(1, sizeof(*conn));
+    /* The queue's cachelines must really be their own */
+    AVTConnection *conn = aligned_alloc(alignof(AVTConnection), sizeof(*conn));
+    if (!conn) {
+        avt_addr_free(&addr);
+        return AVT_ERROR(ENOMEM);
+    }
+    memset(conn, 0, sizeof(*conn));
 
     conn->addr = addr;
     conn->ctx = ctx;
+    atomic_flag_clear(&conn->draining);
+
+    err = avt_pkt_queue_init(&conn->out_queue, CONN_QUEUE_SIZE);
+    if (err < 0)
+        goto fail;
+
+    err = avt_resend_ring_init(&conn->resend_ring, info->output_opts.resend_buffer,
+                               info->output_opts.resend_max_age);
+    if (err < 0)
+        goto fail;
+
+    if (info->output_opts.resend_buffer) {
+        err = conn_resend_queue_init(conn);
+        if (err < 0)
+            goto fail;
+    }
 
     /* Output scheduler */
     err = avt_scheduler_init(&conn->out_scheduler);
     if (err < 0)
-        return err;
+        goto fail;
+
+#ifdef CONFIG_INPUT
+    err = avt_reorder_init(ctx, &conn->in_buffer, info->input_opts.buffer);
+    if (err < 0)
+        goto fail;
+#endif
 
     /* Protocol init */
     err = avt_protocol_init(ctx, &conn->p, &conn->p_ctx, &addr);
+    if (err < 0)
+        goto fail;
+
+    err = avt_scheduler_set_props(&conn->out_scheduler, 0,
+                                  info->output_opts.bandwidth,
+                                  conn->p->get_max_pkt_len(ctx, conn->p_ctx),
+                                  info->output_opts.buffer,
+                                  info->output_opts.interleave);
     if (err < 0) {
-        free(conn);
-        return err;
+        conn->p->close(ctx, &conn->p_ctx);
+        goto fail;
+    }
+
+    if (info->async > 0) {
+        err = conn_async_init(conn);
+        if (err < 0) {
+            conn->p->close(ctx, &conn->p_ctx);
+            goto fail;
+        }
     }
 
     *_conn = conn;
 
     return 0;
+
+fail:
+#ifdef CONFIG_INPUT
+    avt_reorder_free(ctx, &conn->in_buffer);
+#endif
+    avt_scheduler_free(&conn->out_scheduler);
+    avt_resend_ring_free(&conn->resend_ring);
+    conn_resend_queue_free(conn);
+    avt_pkt_queue_free(&conn->out_queue);
+    avt_addr_free(&conn->addr);
+    free(conn);
+    return err;
 }
 
-int avt_connection_send(AVTConnection *conn,
-                        union AVTPacketData pkt, AVTBuffer *pl)
+/* Push a packet onto one of the queues, and get it sent */
+static int conn_push(AVTConnection *conn, AVTPacketQueue *q,
+                     union AVTPacketData pkt, AVTBuffer *pl)
 {
     int err;
 
-    err = avt_pkt_fifo_push(&conn->out_fifo_pre, pkt, pl);
+    while ((err = avt_pkt_queue_push(q, pkt, pl)) == AVT_ERROR(EAGAIN)) {
+        /* Full, help drain it or wait for it to be drained */
+        if (conn->async) {
+            conn_wake_sender(conn);
+        } else {
+            err = conn_try_drain(conn);
+            if (err < 0)
+                return err;
+        }
+        sched_yield();
+    }
     if (err < 0)
         return err;
 
-    err = avt_scheduler_push(&conn->out_scheduler, pkt, pl);
+    if (conn->async) {
+        if (atomic_load(&conn->sender_idle))
+            conn_wake_sender(conn);
+        return atomic_exchange(&conn->sender_err, 0);
+    }
+
+    return conn_try_drain(conn);
+}
+
+int avt_connection_send(AVTConnection *conn,
+                        union AVTPacketData pkt, AVTBuffer *pl)
+{
+    return conn_push(conn, &conn->out_queue, pkt, pl);
+}
+
+int avt_connection_resend(AVTConnection *conn, uint64_t seq, uint32_t nb)
+{
+    int err = 0;
+    AVTMirror *mirror = atomic_load_explicit(&conn->mirror, memory_order_acquire);
+
+    /* Allocated before the mirror is set, if there is no resend ring */
+    AVTPacketQueue *rq = atomic_load_explicit(&conn->resend_queue,
+                                              memory_order_acquire);
+    if (!rq)
+        return AVT_ERROR(ENOENT);
+
+    for (uint64_t i = seq; i < (seq + nb); i++) {
+        union AVTPacketData pkt;
+        AVTBuffer pl, *mpl = NULL;
+
+        err = avt_resend_ring_get(&conn->resend_ring, i, &pkt, &pl);
+        if (err == AVT_ERROR(ENOENT) && mirror) {
+            err = avt_mirror_read(mirror, i, &pkt, &mpl);
+            if (err >= 0)
+                err = avt_buffer_quick_ref(&pl, mpl, 0, 0);
+            avt_buffer_unref(&mpl);
+        }
+        if (err < 0)
+            break;
+
+        err = conn_push(conn, rq, pkt, &pl);
+        avt_buffer_quick_unref(&pl);
+        if (err < 0)
+            break;
+    }
+
+    return err;
+}
+
+uint32_t avt_connection_get_max_pkt_len(AVTConnection *conn)
+{
+    return conn->p->get_max_pkt_len(conn->ctx, conn->p_ctx);
+}
+
+#ifdef CONFIG_INPUT
+int avt_connection_receive(AVTConnection *conn, int max_pkts)
+{
+    if (!conn->p->receive_packets)
+        return AVT_ERROR(ENOTSUP);
+
+    int nb_pkts = conn->p->receive_packets(conn->ctx, conn->p_ctx,
+                                           &conn->in_fifo, max_pkts);
+    if (nb_pkts < 0)
+        return nb_pkts;
+
+    int err = avt_reorder_push_fifo(conn->ctx, &conn->in_buffer, &conn->in_fifo);
     if (err < 0)
         return err;
 
+    AVTContext *ctx = conn->ctx;
+    if (conn->in_cb.resend_cb) {
+        AVTReorderNackRange ranges[CONN_NACK_BATCH];
+        int nb = avt_reorder_nack(ctx, &conn->in_buffer, avt_get_time_ns(),
+                                  ranges, CONN_NACK_BATCH);
+        for (int i = 0; i < nb; i++)
+            conn->in_cb.resend_cb(ctx, conn->in_cb_opaque,
+                                  ranges[i].seq, ranges[i].nb);
+    }
 
+    /* Every corrected header also counts as corrupt */
+    uint64_t corrupt = atomic_load_explicit(&ctx->input.corrupt_packets,
+                                            memory_order_relaxed);
+    uint64_t lost = conn->in_buffer.nack.lost;
+    if ((corrupt != conn->in_corrupt || lost != conn->in_lost) &&
+        conn->in_cb.feedback_cb) {
+        uint64_t corrected = atomic_load_explicit(&ctx->input.fec_corrections,
+                                                  memory_order_relaxed);
+        conn->in_corrupt = corrupt;
+        conn->in_lost = lost;
+        conn->in_cb.feedback_cb(ctx, conn->in_cb_opaque, NULL, 0, 0,
+                                corrected, corrupt, lost);
+    }
 
-    return 0;
+    return nb_pkts;
+}
+
+void avt_connection_set_input_cb(AVTConnection *conn,
+                                 const AVTInputCallbacks *cb, void *opaque)
+{
+    conn->in_cb = *cb;
+    conn->in_cb_opaque = opaque;
+}
+
+int avt_connection_pop(AVTConnection *conn, AVTReorderChain **chain)
+{
+    return avt_reorder_pop(conn->ctx, &conn->in_buffer, chain);
+}
+
+void avt_connection_done(AVTConnection *conn, AVTReorderChain *chain)
+{
+    avt_reorder_done(conn->ctx, &conn->in_buffer, chain);
+}
+
+int64_t avt_connection_seek(AVTConnection *conn, uint16_t stream_id, int64_t pts)
+{
+    if (!conn->p->seek)
+        return AVT_ERROR(ENOTSUP);
+
+    int64_t ret = conn->p->seek(conn->ctx, conn->p_ctx, 0, 0,
+                                stream_id, pts, false);
+    if (ret >= 0)
+        avt_pkt_fifo_clear(&conn->in_fifo);
+
+    return ret;
 }
+#endif
 
 int avt_connection_flush(AVTConnection *conn)
 {
-    return 0;
+    int err;
+
+    if (!conn->async)
+        return conn_flush_sync(conn);
+
+    pthread_mutex_lock(&conn->lock);
+    conn->flush_req = true;
+    while (conn->running && conn->flush_req) {
+        pthread_cond_signal(&conn->wake);
+        pthread_cond_wait(&conn->drained, &conn->lock);
+    }
+    int flush_err = conn->flush_req ? 0 : conn->flush_err;
+    conn->flush_req = false;
+    pthread_mutex_unlock(&conn->lock);
+
+    err = atomic_exchange(&conn->sender_err, 0);
+    return err < 0 ? err : flush_err;
 }
 
 int avt_connection_destroy(AVTConnection **_conn)
 {
     AVTConnection *conn = *_conn;
-    if (conn)
+    if (!conn)
         return 0;
 
+    conn_async_uninit(conn);
+
     int err = conn->p->close(conn->ctx, &conn->p_ctx);
 
     avt_pkt_fifo_free(&conn->out_fifo_post);
+    avt_pkt_fifo_free(&conn->in_fifo);
+#ifdef CONFIG_INPUT
+    avt_reorder_free(conn->ctx, &conn->in_buffer);
+#endif
     avt_scheduler_free(&conn->out_scheduler);
-    avt_pkt_fifo_free(&conn->out_fifo_pre);
+    avt_resend_ring_free(&conn->resend_ring);
+    conn_resend_queue_free(conn);
+    avt_pkt_queue_free(&conn->out_queue);
     avt_addr_free(&conn->addr);
 
+    AVTMirror *mirror = atomic_load(&conn->mirror);
+    int ret = avt_mirror_close(&mirror);
+    if (err >= 0)
+        err = ret;
+
     free(conn);
     *_conn = NULL;
     return err;
@@ -126,5 +680,24 @@ int avt_connection_destroy(AVTConnection **_conn)
 
 int avt_connection_mirror(AVTConnection *conn, const char *path)
 {
-    return  0;
+    AVTMirror *mirror, *cur = NULL;
+
+    /* Only one mirror per connection, as it holds what may need resending */
+    if (atomic_load(&conn->mirror))
+        return AVT_ERROR(EBUSY);
+
+    int err = conn_resend_queue_init(conn);
+    if (err < 0)
+        return err;
+
+    err = avt_mirror_open(conn->ctx, &mirror, path);
+    if (err < 0)
+        return err;
+
+    if (!atomic_compare_exchange_strong(&conn->mirror, &cur, mirror)) {
+        avt_mirror_close(&mirror);
+        return AVT_ERROR(EBUSY);
+    }
+
+    return 0;
 }
@@ -33,9 +33,44 @@
 
 #include <avtransport/packet_enums.h>
 
+#include "../config.h"
+
 int avt_connection_register_out(AVTConnection *conn, AVTOutput *out);
 
 int avt_connection_send(AVTConnection *conn,
                         union AVTPacketData pkt, AVTBuffer *pl);
 
+/* Resend nb packets starting at seq, from memory if still held,
+ * otherwise from the mirror.
+ * Returns AVT_ERROR(ENOENT) if one of them is in neither. */
+int avt_connection_resend(AVTConnection *conn, uint64_t seq, uint32_t nb);
+
+/* Maximum size of a packet, header included */
+uint32_t avt_connection_get_max_pkt_len(AVTConnection *conn);
+
+#ifdef CONFIG_INPUT
+/* Receive a batch of packets, up to max_pkts, and push them into the
+ * connection's reorder buffer. Waits for at least one.
+ * Returns the number of packets received, otherwise negative error. */
+int avt_connection_receive(AVTConnection *conn, int max_pkts);
+
+/* Set the callbacks avt_connection_receive() reports to.
+ * Of them, resend_cb and feedback_cb are used. */
+void avt_connection_set_input_cb(AVTConnection *conn,
+                                 const AVTInputCallbacks *cb, void *opaque);
+
+/* Pop the next finished chain of packets off the reorder buffer.
+ * Chains must be released with avt_connection_done() once processed,
+ * as the buffer does not evict finished chains.
+ * Returns AVT_ERROR(EAGAIN) if none are finished. */
+int avt_connection_pop(AVTConnection *conn, AVTReorderChain **chain);
+
+void avt_connection_done(AVTConnection *conn, AVTReorderChain *chain);
+
+/* Seek the input to the last keyframe of a stream at or before pts.
+ * Packets received but not yet processed are dropped.
+ * Returns the new offset, otherwise negative error. */
+int64_t avt_connection_seek(AVTConnection *conn, uint16_t stream_id, int64_t pts);
+#endif
+
 #endif /* AVTRANSPORT_CONNECTION_INTERNAL_H */
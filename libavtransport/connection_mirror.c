@@ -0,0 +1,275 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "connection_mirror.h"
+#include "io_common.h"
+#include "encode.h"
+#include "decode.h"
+
+/* Sequence numbers per index block */
+#define MIRROR_BLOCK_BITS 12
+#define MIRROR_BLOCK_SIZE (1 << MIRROR_BLOCK_BITS)
+
+/* Offsets of the packets of a block, relative to the first one written.
+ * 4 bytes per packet is all the memory a mirrored packet takes. */
+typedef struct AVTMirrorBlock {
+    int64_t base;
+    uint32_t off[MIRROR_BLOCK_SIZE]; /* UINT32_MAX if not written */
+} AVTMirrorBlock;
+
+struct AVTMirror {
+    AVTContext *ctx;
+    const AVTIO *io;
+    AVTIOCtx *io_ctx;
+
+    /* Vectors for writing */
+    AVTIOVector *vecs;
+    int nb_vecs_alloc;
+
+    /* Protects everything below, and reading */
+    pthread_mutex_t lock;
+    int64_t wpos;
+
+    AVTMirrorBlock **blocks;
+    size_t nb_blocks;
+    uint64_t first_blk;
+
+    /* Highest sequence number written, extended to 64 bits, 0 if none */
+    uint64_t last_seq;
+};
+
+int avt_mirror_open(AVTContext *ctx, AVTMirror **_m, const char *path)
+{
+    AVTMirror *m = calloc(1, sizeof(*m));
+    if (!m)
+        return AVT_ERROR(ENOMEM);
+
+    AVTAddress addr = {
+        .proto = AVT_PROTOCOL_FILE,
+        .path = (char8_t *)path,
+    };
+
+    int err = avt_io_init(ctx, &m->io, &m->io_ctx, &addr);
+    if (err < 0) {
+        free(m);
+        return err;
+    }
+
+    err = pthread_mutex_init(&m->lock, NULL);
+    if (err) {
+        m->io->close(ctx, &m->io_ctx);
+        free(m);
+        return AVT_ERROR(err);
+    }
+
+    m->ctx = ctx;
+    *_m = m;
+
+    return 0;
+}
+
+/* Record the offset of a packet. Must be called with the lock held. */
+static int mirror_index(AVTMirror *m, uint32_t wire_seq, int64_t off)
+{
+    if (!m->last_seq)
+        m->last_seq = AVT_SEQ_INIT(wire_seq);
+    uint64_t seq = avt_seq_unwrap(m->last_seq, wire_seq);
+    m->last_seq = AVT_MAX(m->last_seq, seq);
+
+    uint64_t blk = seq >> MIRROR_BLOCK_BITS;
+    if (!m->nb_blocks)
+        m->first_blk = blk;
+    else if (blk < m->first_blk)
+        return 0;
+
+    size_t idx = blk - m->first_blk;
+    if (idx >= m->nb_blocks) {
+        size_t nb = AVT_MAX(idx + 1, m->nb_blocks*2);
+        AVTMirrorBlock **blocks = realloc(m->blocks, nb*sizeof(*blocks));
+        if (!blocks)
+            return AVT_ERROR(ENOMEM);
+        memset(&blocks[m->nb_blocks], 0, (nb - m->nb_blocks)*sizeof(*blocks));
+        m->blocks = blocks;
+        m->nb_blocks = nb;
+    }
+
+    AVTMirrorBlock *b = m->blocks[idx];
+    if (!b) {
+        b = malloc(sizeof(*b));
+        if (!b)
+            return AVT_ERROR(ENOMEM);
+        b->base = off;
+        memset(b->off, 0xFF, sizeof(b->off));
+        m->blocks[idx] = b;
+    }
+
+    /* Packets are written in roughly sequence order, so this only
+     * happens with enormous packets, which are better off not resent */
+    if ((off - b->base) >= UINT32_MAX)
+        return 0;
+
+    b->off[seq & (MIRROR_BLOCK_SIZE - 1)] = off - b->base;
+
+    return 0;
+}
+
+int avt_mirror_write(AVTMirror *m, AVTPacketFifo *seq)
+{
+    int err;
+
+    int nb = AVT_MIN(seq->nb, IO_MAX_VECTORS);
+    if (nb > m->nb_vecs_alloc) {
+        AVTIOVector *vecs = realloc(m->vecs, nb*sizeof(*vecs));
+        if (!vecs)
+            return AVT_ERROR(ENOMEM);
+        m->vecs = vecs;
+        m->nb_vecs_alloc = nb;
+    }
+
+    for (unsigned int i = 0; i < seq->nb; i += nb) {
+        AVTIOVectors vec = {
+            .nb_vecs = AVT_MIN(seq->nb - i, nb),
+            .vecs = m->vecs,
+        };
+
+        for (int j = 0; j < vec.nb_vecs; j++) {
+            AVTOutputPacket *e = avt_pkt_fifo_get(seq, i + j);
+            AVTIOVector *v = &vec.vecs[j];
+            err = avt_encode_header(v->hdr, &v->hdr_len, e->pkt.desc, e->pkt, NULL);
+            if (err < 0)
+                return err;
+            v->payload = &e->pl;
+        }
+
+        int64_t ret = m->io->write_vec_output(m->ctx, m->io_ctx, &vec);
+        if (ret < 0)
+            return ret;
+
+        /* Only index packets once they can be read back */
+        pthread_mutex_lock(&m->lock);
+        int64_t off = m->wpos;
+        for (int j = 0; j < vec.nb_vecs; j++) {
+            AVTOutputPacket *e = avt_pkt_fifo_get(seq, i + j);
+            err = mirror_index(m, e->pkt.seq, off);
+            if (err < 0)
+                break;
+            off += vec.vecs[j].hdr_len + avt_buffer_get_data_len(&e->pl);
+        }
+        m->wpos = ret;
+        pthread_mutex_unlock(&m->lock);
+        if (err < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+int avt_mirror_read(AVTMirror *m, uint32_t wire_seq,
+                    union AVTPacketData *pkt, AVTBuffer **pl)
+{
+    int64_t ret;
+    AVTBuffer *buf = NULL;
+
+    pthread_mutex_lock(&m->lock);
+
+    uint64_t seq = avt_seq_unwrap(m->last_seq, wire_seq);
+    uint64_t blk = seq >> MIRROR_BLOCK_BITS;
+    AVTMirrorBlock *b = NULL;
+    if (m->nb_blocks && blk >= m->first_blk && (blk - m->first_blk) < m->nb_blocks)
+        b = m->blocks[blk - m->first_blk];
+
+    uint32_t rel = b ? b->off[seq & (MIRROR_BLOCK_SIZE - 1)] : UINT32_MAX;
+    if (rel == UINT32_MAX) {
+        pthread_mutex_unlock(&m->lock);
+        return AVT_ERROR(ENOENT);
+    }
+
+    /* Read the header first, to know how much more to read */
+    ret = m->io->seek(m->ctx, m->io_ctx, b->base + rel);
+    if (ret >= 0)
+        ret = m->io->read_input(m->ctx, m->io_ctx, &buf, AVT_MAX_HEADER_LEN);
+    if (ret >= 0)
+        ret = avt_decode_packet_size(buf, pkt);
+    if (ret > 0 && ret > avt_buffer_get_data_len(buf)) {
+        int64_t err = m->io->read_input(m->ctx, m->io_ctx, &buf, ret);
+        if (err < 0)
+            ret = err;
+    }
+
+    pthread_mutex_unlock(&m->lock);
+
+    /* Short reads mean the file was truncated behind our back */
+    if (ret == AVT_ERROR(EAGAIN) ||
+        (ret >= 0 && ret > avt_buffer_get_data_len(buf)))
+        ret = AVT_ERROR(EIO);
+    if (ret < 0)
+        goto end;
+
+    AVTBuffer tmp, tmp_pl;
+    ret = avt_buffer_quick_ref(&tmp, buf, 0, ret);
+    if (ret < 0)
+        goto end;
+
+    ret = avt_decode_packet(&tmp, pkt, &tmp_pl);
+    avt_buffer_quick_unref(&tmp);
+    if (ret < 0)
+        goto end;
+
+    *pl = NULL;
+    if (avt_buffer_get_data_len(&tmp_pl)) {
+        *pl = avt_buffer_reference(&tmp_pl, 0, avt_buffer_get_data_len(&tmp_pl));
+        if (!*pl)
+            ret = AVT_ERROR(ENOMEM);
+    }
+    avt_buffer_quick_unref(&tmp_pl);
+
+end:
+    avt_buffer_unref(&buf);
+    return ret < 0 ? ret : 0;
+}
+
+int avt_mirror_close(AVTMirror **_m)
+{
+    AVTMirror *m = *_m;
+    if (!m)
+        return 0;
+
+    int err = m->io->close(m->ctx, &m->io_ctx);
+
+    for (size_t i = 0; i < m->nb_blocks; i++)
+        free(m->blocks[i]);
+    free(m->blocks);
+    free(m->vecs);
+    pthread_mutex_destroy(&m->lock);
+
+    free(m);
+    *_m = NULL;
+    return err;
+}
@@ -24,16 +24,26 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef LIBAVTRANSPORT_RAPTOR
-#define LIBAVTRANSPORT_RAPTOR
+#ifndef AVTRANSPORT_CONNECTION_MIRROR_H
+#define AVTRANSPORT_CONNECTION_MIRROR_H
 
-#include <stdint.h>
-#include <stddef.h>
+#include "common.h"
+#include "utils_internal.h"
 
-uint64_t pq_calc_raptor_224(uint8_t *data);
-uint64_t pq_calc_raptor_160(uint8_t *data);
+/* Outgoing packets, written to a file, and indexed by sequence number.
+ * Writing is done by a single thread, reading may be done by any. */
+typedef struct AVTMirror AVTMirror;
 
-uint8_t *pq_calc_raptor_short(uint8_t *data, uint8_t *code,
-                              size_t data_len, size_t code_len);
+int avt_mirror_open(AVTContext *ctx, AVTMirror **m, const char *path);
 
-#endif
+/* Append all packets in seq to the file */
+int avt_mirror_write(AVTMirror *m, AVTPacketFifo *seq);
+
+/* Read back the packet with a given 32-bit sequence number.
+ * Returns AVT_ERROR(ENOENT) if it was never written. */
+int avt_mirror_read(AVTMirror *m, uint32_t seq,
+                    union AVTPacketData *pkt, AVTBuffer **pl);
+
+int avt_mirror_close(AVTMirror **m);
+
+#endif /* AVTRANSPORT_CONNECTION_MIRROR_H */
@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "connection_resend.h"
+
+/* Assumed average payload size, to size the ring with */
+#define RESEND_AVG_PKT_SIZE 256
+
+int avt_resend_ring_init(AVTResendRing *r, size_t max_size, uint64_t max_age)
+{
+    memset(r, 0, sizeof(*r));
+    if (!max_size)
+        return 0;
+
+    uint64_t nb = 64;
+    while (nb < (max_size / RESEND_AVG_PKT_SIZE))
+        nb <<= 1;
+
+    r->entries = malloc(nb*sizeof(*r->entries));
+    if (!r->entries)
+        return AVT_ERROR(ENOMEM);
+
+    int err = pthread_mutex_init(&r->lock, NULL);
+    if (err) {
+        free(r->entries);
+        r->entries = NULL;
+        return AVT_ERROR(err);
+    }
+
+    for (uint64_t i = 0; i < nb; i++) {
+        r->entries[i].seq = UINT64_MAX;
+        memset(&r->entries[i].pl, 0, sizeof(r->entries[i].pl));
+    }
+
+    r->mask = nb - 1;
+    r->max_size = max_size;
+    r->max_age = max_age;
+
+    return 0;
+}
+
+static void ring_evict(AVTResendRing *r, AVTResendEntry *e)
+{
+    r->size -= avt_buffer_get_data_len(&e->pl);
+    avt_buffer_quick_unref(&e->pl);
+    e->seq = UINT64_MAX;
+}
+
+/* Evict the lowest sequence numbers until within the limits */
+static void ring_trim(AVTResendRing *r, uint64_t now)
+{
+    while (r->first < r->end) {
+        AVTResendEntry *e = &r->entries[r->first & r->mask];
+        if (e->seq == r->first) {
+            bool expired = r->max_age && (now - e->time) > r->max_age;
+            if (r->size <= r->max_size && !expired &&
+                (r->end - r->first) <= (r->mask + 1))
+                break;
+            ring_evict(r, e);
+        }
+        r->first++;
+    }
+
+    if (r->first == r->end)
+        r->first = r->end = 0;
+}
+
+static void ring_add(AVTResendRing *r, union AVTPacketData pkt,
+                     AVTBuffer *pl, uint64_t time)
+{
+    if (!r->last)
+        r->last = AVT_SEQ_INIT(pkt.seq);
+    uint64_t seq = avt_seq_unwrap(r->last, pkt.seq);
+    r->last = AVT_MAX(r->last, seq);
+
+    if (r->first == r->end) {
+        r->first = seq;
+        r->end = seq + 1;
+    } else if (seq >= r->end) {
+        /* Jumped far ahead, nothing held is in range anymore */
+        if ((seq - r->first) > 2*(r->mask + 1)) {
+            for (uint64_t i = 0; i <= r->mask; i++)
+                if (r->entries[i].seq != UINT64_MAX)
+                    ring_evict(r, &r->entries[i]);
+            r->first = seq;
+        }
+        r->end = seq + 1;
+    } else if (seq < r->first) {
+        /* Sent late, and too far behind to be held */
+        if ((r->end - seq) > (r->mask + 1))
+            return;
+        r->first = seq;
+    }
+
+    AVTResendEntry *e = &r->entries[seq & r->mask];
+    if (e->seq != UINT64_MAX)
+        ring_evict(r, e);
+
+    e->seq = seq;
+    e->time = time;
+    e->pkt = pkt;
+    avt_buffer_quick_ref(&e->pl, pl, 0, 0);
+    r->size += avt_buffer_get_data_len(&e->pl);
+}
+
+void avt_resend_ring_add(AVTResendRing *r, AVTPacketFifo *seq, uint64_t time)
+{
+    if (!r->entries)
+        return;
+
+    pthread_mutex_lock(&r->lock);
+
+    for (unsigned int i = 0; i < seq->nb; i++) {
+        AVTOutputPacket *e = avt_pkt_fifo_get(seq, i);
+        ring_add(r, e->pkt, &e->pl, time);
+    }
+
+    ring_trim(r, time);
+
+    pthread_mutex_unlock(&r->lock);
+}
+
+int avt_resend_ring_get(AVTResendRing *r, uint32_t wire_seq,
+                        union AVTPacketData *pkt, AVTBuffer *pl)
+{
+    int err = AVT_ERROR(ENOENT);
+    if (!r->entries)
+        return err;
+
+    pthread_mutex_lock(&r->lock);
+
+    uint64_t seq = r->last ? avt_seq_unwrap(r->last, wire_seq) : UINT64_MAX;
+
+    AVTResendEntry *e = &r->entries[seq & r->mask];
+    if (e->seq == seq &&
+        (!r->max_age || (avt_get_time_ns() - e->time) <= r->max_age)) {
+        *pkt = e->pkt;
+        err = avt_buffer_quick_ref(pl, &e->pl, 0, 0);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+
+    return err;
+}
+
+void avt_resend_ring_free(AVTResendRing *r)
+{
+    if (!r->entries)
+        return;
+
+    for (uint64_t i = 0; i <= r->mask; i++)
+        avt_buffer_quick_unref(&r->entries[i].pl);
+
+    pthread_mutex_destroy(&r->lock);
+    free(r->entries);
+    memset(r, 0, sizeof(*r));
+}
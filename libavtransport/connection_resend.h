@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AVTRANSPORT_CONNECTION_RESEND_H
+#define AVTRANSPORT_CONNECTION_RESEND_H
+
+#include <pthread.h>
+
+#include "common.h"
+#include "utils_internal.h"
+
+typedef struct AVTResendEntry {
+    uint64_t seq; /* UINT64_MAX if empty */
+    uint64_t time;
+    union AVTPacketData pkt;
+    AVTBuffer pl;
+} AVTResendEntry;
+
+/* Packets recently sent, for resending, indexed by sequence number.
+ * Payloads are referenced, not copied. Thread-safe. */
+typedef struct AVTResendRing {
+    pthread_mutex_t lock;
+
+    AVTResendEntry *entries;
+    uint64_t mask;
+
+    uint64_t max_size; /* Payload bytes held */
+    uint64_t max_age;  /* In nanoseconds, 0 means unlimited */
+    uint64_t size;
+
+    /* Sequence numbers of the packets held are in [first, end).
+     * Sequence numbers are extended to 64 bits, last is the highest one
+     * added, or 0 if none was. */
+    uint64_t first;
+    uint64_t end;
+    uint64_t last;
+} AVTResendRing;
+
+/* Initialize a ring holding up to max_size bytes of payload.
+ * A max_size of 0 disables the ring. */
+int avt_resend_ring_init(AVTResendRing *r, size_t max_size, uint64_t max_age);
+
+/* Add all packets in seq, sent at time */
+void avt_resend_ring_add(AVTResendRing *r, AVTPacketFifo *seq, uint64_t time);
+
+/* Get a packet by its 32-bit sequence number. The payload is referenced
+ * into pl. Returns AVT_ERROR(ENOENT) if it is not held anymore. */
+int avt_resend_ring_get(AVTResendRing *r, uint32_t seq,
+                        union AVTPacketData *pkt, AVTBuffer *pl);
+
+void avt_resend_ring_free(AVTResendRing *r);
+
+#endif /* AVTRANSPORT_CONNECTION_RESEND_H */
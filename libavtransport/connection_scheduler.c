@@ -24,34 +24,210 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+
 #include "connection_scheduler.h"
 #include "utils_internal.h"
 
+/* Duration of data emitted per bucket when rate limited */
+#define SCHED_BUCKET_NS 1000000
+/* Limits for the per-stream DRR quantum */
+#define SCHED_MIN_QUANTUM 1024
+#define SCHED_MAX_QUANTUM (1 << 16)
+
 FN_CREATING(avt_scheduler, AVTScheduler, AVTPacketFifo,
             bucket, buckets, nb_buckets)
 
-int avt_scheduler_init(AVTScheduler *s, AVTOutput *out)
+FN_CREATING(avt_scheduler, AVTScheduler, AVTSchedulerStream,
+            stream, streams, nb_streams)
+
+static AVTSchedulerStream *sched_get_stream(AVTScheduler *s, uint16_t id)
 {
-    return 0;
+    AVTSchedulerStream *st = avt_id_map_get(&s->stream_map, id);
+    if (st)
+        return st;
+
+    /* The active round can hold every stream at once */
+    AVTSchedulerStream **active = realloc(s->active,
+                                          (s->nb_streams + 1)*sizeof(*active));
+    if (!active)
+        return NULL;
+    s->active = active;
+
+    st = avt_scheduler_create_stream(s);
+    if (!st)
+        return NULL;
+
+    st->id = id;
+    if (avt_id_map_set(&s->stream_map, id, st) < 0)
+        return NULL;
+
+    return st;
+}
+
+int avt_scheduler_init(AVTScheduler *s)
+{
+    return avt_scheduler_set_props(s, 0, 0, 0, 0, 0);
 }
 
 int avt_scheduler_set_props(AVTScheduler *s,
                             uint64_t rx_bandwidth, uint64_t tx_bandwidth,
-                            uint64_t max_pkt_size, uint64_t max_buffered)
+                            uint64_t max_pkt_size, uint64_t max_buffered,
+                            int interleave)
 {
+    bool was_limited = !!s->tx_bandwidth;
+
+    if (interleave < 0)
+        return AVT_ERROR(EINVAL);
+    s->interleave = interleave;
+
+    s->rx_bandwidth = rx_bandwidth;
+    s->tx_bandwidth = tx_bandwidth;
+    s->max_pkt_size = max_pkt_size;
+    s->max_buffered = max_buffered;
+
+    s->quantum = max_pkt_size ? max_pkt_size : SCHED_MAX_QUANTUM;
+    s->quantum = AVT_MAX(AVT_MIN(s->quantum, SCHED_MAX_QUANTUM), SCHED_MIN_QUANTUM);
+
+    if (tx_bandwidth) {
+        /* Enough for SCHED_BUCKET_NS worth of data, but no less than a packet */
+        s->bucket_size = (tx_bandwidth >> 3) / (1000000000 / SCHED_BUCKET_NS);
+        s->bucket_size = AVT_MAX(s->bucket_size, s->quantum);
+        s->burst = 2*s->bucket_size;
+        s->tokens = was_limited ? AVT_MIN(s->tokens, s->burst) : s->bucket_size;
+    } else {
+        s->bucket_size = INT64_MAX;
+        s->burst = INT64_MAX;
+        s->tokens = 0;
+    }
+    s->last_refill = avt_get_time_ns();
+
     return 0;
 }
 
+static inline bool sched_pkt_is_ctrl(union AVTPacketData pkt)
+{
+    switch (pkt.desc) {
+    case AVT_PKT_SESSION_START:
+    case AVT_PKT_TIME_SYNC:
+    case AVT_PKT_USER_DATA:
+        return true;
+    default:
+        return pkt.stream_id == UINT16_MAX;
+    }
+}
+
+/* Total size of the packet this packet or segment is part of */
+static inline int64_t sched_pkt_total(union AVTPacketData pkt, int64_t size)
+{
+    switch (pkt.desc) {
+    case AVT_PKT_STREAM_DATA_SEGMENT:
+    case AVT_PKT_METADATA_SEGMENT:
+    case AVT_PKT_FONT_DATA_SEGMENT:
+    case AVT_PKT_USER_DATA_SEGMENT:
+        return pkt.generic_segment.pkt_total_data;
+    default:
+        return size;
+    }
+}
+
+static inline int64_t sched_quantum(AVTScheduler *s)
+{
+    /* Automatic: one bucket per turn when rate limited, otherwise a
+     * single packet, for the finest interleaving possible */
+    if (!s->interleave)
+        return s->tx_bandwidth ? s->bucket_size : s->quantum;
+
+    return AVT_MAX(s->largest / s->interleave, s->quantum);
+}
+
 int avt_scheduler_push(AVTScheduler *s,
                        union AVTPacketData pkt, AVTBuffer *pl)
 {
+    int err;
+    size_t size = avt_pkt_hdr_size(pkt) + avt_buffer_get_data_len(pl);
+
+    if (s->max_buffered && (s->buffered + size) > s->max_buffered) {
+        avt_log(s, AVT_LOG_WARN, "Output buffer full (%lu bytes), dropping packet!\n",
+                (unsigned long)s->buffered);
+        return AVT_ERROR(ENOBUFS);
+    }
+
+    if (sched_pkt_is_ctrl(pkt)) {
+        err = avt_pkt_fifo_push(&s->ctrl, pkt, pl);
+    } else {
+        AVTSchedulerStream *st = sched_get_stream(s, pkt.stream_id);
+        if (!st)
+            return AVT_ERROR(ENOMEM);
+
+        AVTPacketFifo *f = &st->staging;
+        if (!f->nb)
+            s->active[s->nb_active++] = st;
+        err = avt_pkt_fifo_push(f, pkt, pl);
+        if (err < 0 && !f->nb)
+            s->nb_active--;
+    }
+    if (err < 0)
+        return err;
+
+    s->buffered += size;
+    s->largest = AVT_MAX(s->largest, sched_pkt_total(pkt, size));
+
+    return 0;
+}
+
+static void sched_refill(AVTScheduler *s)
+{
+    if (!s->tx_bandwidth)
+        return;
+
+    uint64_t now = avt_get_time_ns();
+    uint64_t delta = now - s->last_refill;
+
+    /* Nothing past a full bucket counts, which also keeps the
+     * multiplication below from overflowing after long idle periods */
+    if (s->tokens >= s->burst) {
+        s->last_refill = now;
+        return;
+    }
+    uint64_t fill = ((s->burst - s->tokens)*8*1000000000ULL) / s->tx_bandwidth + 1;
+    delta = AVT_MIN(delta, fill);
+
+    /* Only advance time by what was converted into whole bytes,
+     * to avoid losing precision at high refill rates */
+    int64_t bytes = (delta * (s->tx_bandwidth >> 3)) / 1000000000;
+    if (bytes <= 0)
+        return;
+
+    s->tokens = AVT_MIN(s->tokens + bytes, s->burst);
+    s->last_refill = now;
+}
+
+static int sched_move(AVTScheduler *s, AVTPacketFifo *bkt,
+                      AVTPacketFifo *src, int64_t size)
+{
+    union AVTPacketData pkt;
+    AVTBuffer pl;
+
+    int err = avt_pkt_fifo_pop(src, &pkt, &pl);
+    if (err < 0)
+        return err;
 
+    err = avt_pkt_fifo_push(bkt, pkt, &pl);
+    avt_buffer_quick_unref(&pl);
+    if (err < 0)
+        return err;
+
+    s->buffered -= size;
+    if (s->tx_bandwidth)
+        s->tokens -= size;
 
     return 0;
 }
 
 int avt_scheduler_pop(AVTScheduler *s, AVTPacketFifo **seq)
 {
+    int err;
     AVTPacketFifo *bkt = s->last_avail;
     if (!bkt) {
         bkt = avt_scheduler_create_bucket(s);
@@ -62,6 +238,65 @@ int avt_scheduler_pop(AVTScheduler *s, AVTPacketFifo **seq)
     s->last_avail = NULL;
     *seq = bkt;
 
+    sched_refill(s);
+
+    /* Packets may overshoot the budget, the token debt throttles
+     * the next buckets instead. */
+    int64_t budget = s->bucket_size;
+    if (s->tx_bandwidth)
+        budget = AVT_MIN(budget, s->tokens);
+
+    while (s->ctrl.nb && budget > 0) {
+        int64_t size = avt_pkt_fifo_front_size(&s->ctrl);
+        err = sched_move(s, bkt, &s->ctrl, size);
+        if (err < 0)
+            return err;
+        budget -= size;
+    }
+
+    /* Deficit round-robin between streams */
+    int64_t quantum = sched_quantum(s);
+    while (s->nb_active && budget > 0) {
+        AVTSchedulerStream *st = s->active[s->cur];
+        AVTPacketFifo *f = &st->staging;
+
+        if (!s->cur_credited) {
+            st->realtime += quantum;
+            s->cur_credited = true;
+        }
+
+        while (f->nb && budget > 0) {
+            int64_t size = avt_pkt_fifo_front_size(f);
+            if (size > st->realtime)
+                break;
+
+            err = sched_move(s, bkt, f, size);
+            if (err < 0)
+                return err;
+
+            st->realtime -= size;
+            budget -= size;
+        }
+
+        if (!f->nb) {
+            /* Nothing left, the stream gives up its deficit and its place */
+            st->realtime = 0;
+            s->active[s->cur] = s->active[--s->nb_active];
+            s->cur_credited = false;
+        } else if (budget > 0) {
+            /* Ran out of deficit, next stream */
+            s->cur++;
+            s->cur_credited = false;
+        }
+
+        if (s->cur >= s->nb_active)
+            s->cur = 0;
+    }
+
+    /* Only track the largest packet among those currently staged */
+    if (!s->nb_active)
+        s->largest = 0;
+
     return 0;
 }
 
@@ -70,9 +305,52 @@ void avt_scheduler_done(AVTScheduler *s, AVTPacketFifo *seq)
     if (!seq)
         return;
 
+    avt_pkt_fifo_clear(seq);
     s->last_avail = seq;
 }
 
+int64_t avt_scheduler_wait_time(AVTScheduler *s)
+{
+    if (!s->ctrl.nb && !s->nb_active)
+        return -1;
+
+    if (!s->tx_bandwidth)
+        return 0;
+
+    sched_refill(s);
+    if (s->tokens > 0)
+        return 0;
+
+    /* Time until the token count turns positive */
+    return ((1 - s->tokens)*8*1000000000LL) / s->tx_bandwidth + 1;
+}
+
 void avt_scheduler_free(AVTScheduler *s)
 {
+    for (int i = 0; i < s->nb_buckets; i++) {
+        avt_pkt_fifo_free(s->buckets[i]);
+        free(s->buckets[i]);
+    }
+    free(s->buckets);
+    s->buckets = NULL;
+    s->nb_buckets = 0;
+    s->last_avail = NULL;
+
+    for (int i = 0; i < s->nb_streams; i++) {
+        avt_pkt_fifo_free(&s->streams[i]->staging);
+        free(s->streams[i]);
+    }
+    free(s->streams);
+    s->streams = NULL;
+    s->nb_streams = 0;
+
+    free(s->active);
+    s->active = NULL;
+    s->nb_active = 0;
+    s->cur = 0;
+    s->cur_credited = false;
+
+    avt_id_map_free(&s->stream_map);
+
+    avt_pkt_fifo_free(&s->ctrl);
 }
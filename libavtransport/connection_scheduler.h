@@ -30,21 +30,57 @@
 #include "output_internal.h"
 #include "utils_internal.h"
 
+typedef struct AVTSchedulerStream {
+    uint16_t id;
+
+    /* Value in bytes. 0 means in perfect realtime sync,
+     * negative values mean the stream needs more data, positive values mean
+     * stream is good for now.
+     * Used as the deficit counter for round-robin between streams. */
+    int64_t realtime;
+
+    /* Staging buffer */
+    AVTPacketFifo staging;
+} AVTSchedulerStream;
+
 typedef struct AVTScheduler {
-    uint64_t max_buffered; /* In bytes */
-    uint64_t rx_bandwidth; /* Bits per second for transmission */
-    uint64_t tx_bandwidth; /* Bits per second for the receiver */
+    uint64_t max_buffered; /* In bytes, 0 means unlimited */
+    uint64_t rx_bandwidth; /* Bits per second for the receiver */
+    uint64_t tx_bandwidth; /* Bits per second for transmission, 0 means unlimited */
     uint64_t max_pkt_size;
 
-    /* One per stream. Value in bytes. 0 means in perfect realtime sync,
-     * negative values mean the stream needs more data, positive values mean
-     * stream is good for now. */
-    int64_t realtime[UINT16_MAX];
+    /* Token bucket. Tokens are in bytes, and may go negative, in which
+     * case nothing is emitted until the debt is paid off. */
+    int64_t tokens;
+    int64_t burst;
+    uint64_t last_refill; /* In nanoseconds */
+
+    /* Maximum amount of bytes emitted per bucket, and DRR quantum */
+    int64_t bucket_size;
+    int64_t quantum;
 
-    /* Per-stream staging buffers */
-    AVTPacketFifo staging[UINT16_MAX];
+    /* Interleaving, as in AVTConnectionInfo.output_opts.interleave.
+     * The DRR quantum is a fraction of the largest packet currently staged. */
+    int interleave;
+    int64_t largest;
+
+    /* Total amount of bytes staged */
+    uint64_t buffered;
+
+    /* Session-level packets with no stream ID. Emitted before anything else. */
+    AVTPacketFifo ctrl;
+
+    /* Per-stream state, allocated on first use */
+    AVTIdMap stream_map;
+    struct AVTSchedulerStream **streams;
     int nb_streams;
 
+    /* Round of streams with staged packets */
+    struct AVTSchedulerStream **active;
+    int nb_active;
+    int cur;
+    bool cur_credited;
+
     AVTPacketFifo *last_avail;
     AVTPacketFifo **buckets;
     int nb_buckets;
@@ -52,16 +88,26 @@ typedef struct AVTScheduler {
 
 int avt_scheduler_init(AVTScheduler *s);
 
+/* Zero values mean unlimited/unknown/automatic */
 int avt_scheduler_set_props(AVTScheduler *s,
                             uint64_t rx_bandwidth, uint64_t tx_bandwidth,
-                            uint64_t max_pkt_size, uint64_t max_buffered);
+                            uint64_t max_pkt_size, uint64_t max_buffered,
+                            int interleave);
 
+/* Stage a packet. Returns AVT_ERROR(ENOBUFS) if max_buffered is exceeded. */
 int avt_scheduler_push(AVTScheduler *s,
                        union AVTPacketData pkt, AVTBuffer *pl);
 
+/* Get a bucket of packets which may be sent right now.
+ * The bucket may be empty if the rate limit has been hit.
+ * Must be given back via avt_scheduler_done(). */
 int avt_scheduler_pop(AVTScheduler *s, AVTPacketFifo **seq);
 void avt_scheduler_done(AVTScheduler *s, AVTPacketFifo *seq);
 
+/* Nanoseconds until more packets may be popped, 0 if they may be popped now,
+ * or a negative value if nothing is staged. */
+int64_t avt_scheduler_wait_time(AVTScheduler *s);
+
 void avt_scheduler_free(AVTScheduler *s);
 
 #endif /* AVTRANSPORT_CONNECTION_SCHEDULER_H */
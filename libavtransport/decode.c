@@ -24,13 +24,229 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "decode.h"
+#include "bytestream.h"
+#include "ldpc_decode.h"
+
 #include "../packet_decode.h"
 
-static int avt_decode_pkt(AVTBuffer *buf)
+/* Decodes the header, and references the payload if buf covers all of it.
+ * Returns the number of bytes decoded. */
+static int64_t decode_header(AVTBuffer *buf, union AVTPacketData *pkt,
+                             AVTBuffer *pl)
+{
+    int64_t ret;
+    size_t len;
+    uint8_t *data = avt_buffer_get_data(buf, &len);
+
+    memset(pl, 0, sizeof(*pl));
+
+    /* Packets are never smaller than 36 bytes */
+    if (len < 36)
+        return AVT_ERROR(EINVAL);
+
+    uint16_t desc = AVT_RB16(data);
+
+    /* Descriptors with only their top byte fixed */
+    switch (desc >> 8) {
+    case (AVT_PKT_STREAM_DATA & 0xFFFF) >> 8:
+        ret = avt_decode_stream_data(buf, &pkt->stream_data, pl);
+        pkt->desc = AVT_PKT_STREAM_DATA;
+        goto end;
+    case (AVT_PKT_TIME_SYNC & 0xFFFF) >> 8:
+        ret = avt_decode_time_sync(buf, &pkt->time_sync);
+        pkt->desc = AVT_PKT_TIME_SYNC;
+        goto end;
+    }
+
+    switch (desc) {
+    case AVT_PKT_SESSION_START:
+        ret = avt_decode_session_start(buf, &pkt->session_start);
+        break;
+    case AVT_PKT_STREAM_REGISTRATION:
+        ret = avt_decode_stream_registration(buf, &pkt->stream_registration);
+        break;
+    case AVT_PKT_VIDEO_INFO:
+        ret = avt_decode_video_info(buf, &pkt->video_info);
+        break;
+    case AVT_PKT_LUT_ICC:
+        ret = avt_decode_lut_icc(buf, &pkt->lut_icc, pl);
+        break;
+    case AVT_PKT_FONT_DATA:
+        ret = avt_decode_font_data(buf, &pkt->font_data, pl);
+        break;
+    case AVT_PKT_FEC_GROUPING:
+        ret = avt_decode_fec_grouping(buf, &pkt->fec_grouping);
+        break;
+    case AVT_PKT_FEC_GROUP_DATA:
+        ret = avt_decode_fec_group_data(buf, &pkt->fec_group_data, pl);
+        break;
+    case AVT_PKT_VIDEO_ORIENTATION:
+        ret = avt_decode_video_orientation(buf, &pkt->video_orientation);
+        break;
+    case AVT_PKT_STREAM_DURATION:
+        ret = avt_decode_stream_duration(buf, &pkt->stream_duration);
+        break;
+    case AVT_PKT_STREAM_END:
+        ret = avt_decode_stream_end(buf, &pkt->stream_end);
+        break;
+    case AVT_PKT_USER_DATA:
+        ret = avt_decode_user_data(buf, &pkt->user_data, pl);
+        break;
+    case AVT_PKT_STREAM_INDEX: {
+        /* Entries are left as the payload, see avt_decode_index_entries() */
+        pkt->stream_index.index_entry_list = NULL;
+        ret = avt_decode_stream_index(buf, &pkt->stream_index);
+        size_t entries_len = avt_pkt_pl_size(*pkt);
+        if (ret >= 0 && entries_len && (36 + entries_len) <= len)
+            avt_buffer_quick_ref(pl, buf, 36, entries_len);
+        break;
+    }
+    case AVT_PKT_METADATA_SEGMENT:
+    case AVT_PKT_FONT_DATA_SEGMENT:
+    case AVT_PKT_STREAM_DATA_SEGMENT:
+    case AVT_PKT_USER_DATA_SEGMENT:
+        ret = avt_decode_generic_segment(buf, &pkt->generic_segment, pl);
+        break;
+    case AVT_PKT_METADATA_PARITY:
+    case AVT_PKT_FONT_DATA_PARITY:
+    case AVT_PKT_STREAM_DATA_PARITY:
+    case AVT_PKT_USER_DATA_PARITY:
+        ret = avt_decode_generic_parity(buf, &pkt->generic_parity, pl);
+        break;
+    default:
+        return AVT_ERROR(ENOTSUP);
+    }
+
+end:
+    return ret;
+}
+
+int64_t avt_decode_packet(AVTBuffer *buf, union AVTPacketData *pkt,
+                          AVTBuffer *pl)
+{
+    int64_t ret = decode_header(buf, pkt, pl);
+    if (ret < 0)
+        goto fail;
+
+    /* The payload must have fit entirely */
+    size_t hdr_len = avt_pkt_hdr_size(*pkt);
+    size_t pl_len = avt_pkt_pl_size(*pkt);
+    if (ret > avt_buffer_get_data_len(buf) || ret < hdr_len ||
+        (ret - hdr_len) != pl_len) {
+        ret = AVT_ERROR(EINVAL);
+        goto fail;
+    }
+
+    /* Zero-length references span the rest of the buffer */
+    if (avt_buffer_get_data_len(pl) != pl_len)
+        avt_buffer_quick_unref(pl);
+
+    return ret;
+
+fail:
+    avt_buffer_quick_unref(pl);
+    return ret;
+}
+
+int64_t avt_decode_packet_size(AVTBuffer *buf, union AVTPacketData *pkt)
+{
+    AVTBuffer pl;
+
+    /* A partial header, e.g. a truncated tail */
+    if (avt_buffer_get_data_len(buf) < 36)
+        return AVT_ERROR(EAGAIN);
+
+    int64_t ret = decode_header(buf, pkt, &pl);
+    avt_buffer_quick_unref(&pl);
+    if (ret < 0)
+        return ret;
+
+    size_t hdr_len = avt_pkt_hdr_size(*pkt);
+    if (avt_buffer_get_data_len(buf) < hdr_len)
+        return AVT_ERROR(EAGAIN);
+
+    return hdr_len + avt_pkt_pl_size(*pkt);
+}
+
+int avt_decode_index_entries(AVTBuffer *pl, AVTIndexEntry *entries,
+                             uint32_t nb_entries)
 {
+    size_t len;
+    uint8_t *data = avt_buffer_get_data(pl, &len);
+    if (len < ((size_t)nb_entries*18))
+        return AVT_ERROR(EINVAL);
 
-    AVTSessionStart session_start;
-    avt_decode_session_start(buf, &session_start);
+    AVTBytestream bs = avt_bs_init(data, len);
+    for (int i = 0; i < nb_entries; i++)
+        avt_decode_index_entry(&bs, &entries[i]);
 
     return 0;
 }
+
+/* Number of headers checked at once */
+#define CHECK_BATCH 64
+
+static void check_headers(AVTBuffer *bufs[], int ret[], int nb, int iterations)
+{
+    uint8_t *blk[CHECK_BATCH], *blk_short[CHECK_BATCH], *blk_long[CHECK_BATCH];
+    int idx[CHECK_BATCH], idx_short[CHECK_BATCH], idx_long[CHECK_BATCH];
+    int res[CHECK_BATCH];
+    int nb_blk = 0, nb_short = 0, nb_long = 0;
+
+    /* The first block covers the descriptor, so it goes first */
+    for (int i = 0; i < nb; i++) {
+        size_t len;
+        uint8_t *data = avt_buffer_get_data(bufs[i], &len);
+        ret[i] = AVT_ERROR(EINVAL);
+        if (len < 36)
+            continue;
+        blk[nb_blk] = data;
+        idx[nb_blk++] = i;
+    }
+
+    avt_ldpc_decode_288_224(blk, res, nb_blk, iterations);
+
+    for (int j = 0; j < nb_blk; j++) {
+        int i = idx[j];
+        ret[i] = res[j];
+        if (ret[i] < 0)
+            continue;
+
+        AVTBuffer pl;
+        union AVTPacketData pkt;
+        int64_t err = decode_header(bufs[i], &pkt, &pl);
+        avt_buffer_quick_unref(&pl);
+        if (err < 0)
+            continue;
+
+        /* Longer headers continue with either another short block,
+         * or a long block */
+        size_t hdr_len = avt_pkt_hdr_size(pkt);
+        if (hdr_len > avt_buffer_get_data_len(bufs[i])) {
+            continue;
+        } else if (hdr_len == 72) {
+            blk_short[nb_short] = blk[j] + 36;
+            idx_short[nb_short++] = i;
+        } else if (hdr_len == 384) {
+            blk_long[nb_long] = blk[j] + 36;
+            idx_long[nb_long++] = i;
+        }
+    }
+
+    avt_ldpc_decode_288_224(blk_short, res, nb_short, iterations);
+    for (int j = 0; j < nb_short; j++)
+        ret[idx_short[j]] = res[j] < 0 ? res[j] : ret[idx_short[j]] + res[j];
+
+    avt_ldpc_decode_2784_2016(blk_long, res, nb_long, iterations);
+    for (int j = 0; j < nb_long; j++)
+        ret[idx_long[j]] = res[j] < 0 ? res[j] : ret[idx_long[j]] + res[j];
+}
+
+void avt_decode_check_headers(AVTBuffer *bufs[], int ret[], int nb,
+                              int iterations)
+{
+    for (int i = 0; i < nb; i += CHECK_BATCH)
+        check_headers(&bufs[i], &ret[i], AVT_MIN(nb - i, CHECK_BATCH),
+                      iterations);
+}
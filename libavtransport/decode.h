@@ -24,51 +24,33 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <linux/io_uring.h>
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <errno.h>
-
-#include "output.h"
-
-struct PQOutputContext {
-    int fd;
-};
-
-static int sock_init(AVTContext *ctx, PQOutputContext **pc,
-                     AVTConnection *dst, AVTOutputOptions *opts)
-{
-    PQOutputContext *priv = malloc(sizeof(*priv));
-    if (!priv)
-        return AVT_ERROR(ENOMEM);
-
-
-    *pc = priv;
-
-    return 0;
-}
-
-static int sock_output(AVTContext *ctx, PQOutputContext *pc,
-                       uint8_t *hdr, size_t hdr_len, AVTBuffer *buf)
-{
-    size_t len;
-    void *data = avt_buffer_get_data(buf, &len);
-
-    return 0;
-}
-
-static int sock_close(AVTContext *ctx, PQOutputContext **pc)
-{
-
-    return 0;
-}
-
-const PQOutput pq_output_socket = {
-    .name = "file",
-    .type = AVT_CONNECTION_SOCKET,
-    .init = sock_init,
-    .output = sock_output,
-    .close = sock_close,
-};
+#ifndef AVTRANSPORT_DECODE
+#define AVTRANSPORT_DECODE
+
+#include <avtransport/connection.h>
+
+/* Decode a single packet from the start of buf.
+ * The payload, if any, is quick_ref'd into pl.
+ * Returns the number of bytes the packet spans, or a negative error. */
+int64_t avt_decode_packet(AVTBuffer *buf, union AVTPacketData *pkt,
+                          AVTBuffer *pl);
+
+/* Decode only the header of a packet at the start of buf, which needs
+ * to contain no more than the header.
+ * Returns the number of bytes the whole packet spans, AVT_ERROR(EAGAIN)
+ * if buf is too short for the header, or another negative error. */
+int64_t avt_decode_packet_size(AVTBuffer *buf, union AVTPacketData *pkt);
+
+/* Parse the entries of an index packet from its payload */
+int avt_decode_index_entries(AVTBuffer *pl, AVTIndexEntry *entries,
+                             uint32_t nb_entries);
+
+/* Check the LDPC parity of the headers at the start of each buffer, and
+ * correct them in place where needed. Buffers must be writable.
+ * Sets ret[i] to the number of bits corrected in bufs[i], which is 0 for
+ * clean headers, or to a negative error, AVT_ERROR(EBADMSG) if the
+ * header could not be corrected. */
+void avt_decode_check_headers(AVTBuffer *bufs[], int ret[], int nb,
+                              int iterations);
+
+#endif /* AVTRANSPORT_DECODE */
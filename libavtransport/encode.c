@@ -37,46 +37,88 @@ int avt_encode_header(uint8_t hdr[AVT_MAX_HEADER_LEN], size_t *hdr_len,
     switch (desc & 0xFFFF) {
     case AVT_PKT_SESSION_START: {
         avt_encode_session_start(&bs, pkt.session_start);
-        return 0;
+        break;
     }
     case AVT_PKT_STREAM_REGISTRATION: {
         avt_encode_stream_registration(&bs, pkt.stream_registration);
-        return 0;
+        break;
     }
     case AVT_PKT_VIDEO_INFO: {
         avt_encode_video_info(&bs, pkt.video_info);
-        return 0;
+        break;
     }
     case AVT_PKT_LUT_ICC: {
         avt_encode_lut_icc(&bs, pkt.lut_icc);
-        return 0;
+        break;
     }
     case AVT_PKT_FONT_DATA: {
         avt_encode_font_data(&bs, pkt.font_data);
-        return 0;
+        break;
     }
-    case AVT_PKT_STREAM_DATA: {
+    case AVT_PKT_STREAM_DATA & 0xFFFF: {
         avt_encode_stream_data(&bs, pkt.stream_data);
-        return 0;
+        break;
+    }
+    case AVT_PKT_TIME_SYNC & 0xFFFF: {
+        avt_encode_time_sync(&bs, pkt.time_sync);
+        break;
+    }
+    case AVT_PKT_FEC_GROUPING: {
+        avt_encode_fec_grouping(&bs, pkt.fec_grouping);
+        break;
+    }
+    case AVT_PKT_FEC_GROUP_DATA: {
+        avt_encode_fec_group_data(&bs, pkt.fec_group_data);
+        break;
+    }
+    case AVT_PKT_VIDEO_ORIENTATION: {
+        avt_encode_video_orientation(&bs, pkt.video_orientation);
+        break;
+    }
+    case AVT_PKT_STREAM_DURATION: {
+        avt_encode_stream_duration(&bs, pkt.stream_duration);
+        break;
+    }
+    case AVT_PKT_STREAM_END: {
+        avt_encode_stream_end(&bs, pkt.stream_end);
+        break;
     }
     case AVT_PKT_USER_DATA: {
         avt_encode_user_data(&bs, pkt.user_data);
-        return 0;
+        break;
     }
     case AVT_PKT_STREAM_INDEX: {
         avt_encode_stream_index(&bs, pkt.stream_index);
-        return 0;
+        break;
     }
     case AVT_PKT_METADATA_SEGMENT:
     case AVT_PKT_FONT_DATA_SEGMENT:
     case AVT_PKT_STREAM_DATA_SEGMENT:
     case AVT_PKT_USER_DATA_SEGMENT: {
         avt_encode_generic_segment(&bs, pkt.generic_segment);
-        return 0;
+        break;
+    }
+    case AVT_PKT_METADATA_PARITY:
+    case AVT_PKT_FONT_DATA_PARITY:
+    case AVT_PKT_STREAM_DATA_PARITY:
+    case AVT_PKT_USER_DATA_PARITY: {
+        avt_encode_generic_parity(&bs, pkt.generic_parity);
+        break;
     }
     default:
         avt_assert0(0);
+        return AVT_ERROR(EINVAL);
     }
 
+    *hdr_len = avt_bs_offs(&bs);
+
     return 0;
 }
+
+void avt_encode_index_entries(uint8_t *dst, const AVTIndexEntry *entries,
+                              uint32_t nb_entries)
+{
+    AVTBytestream bs = avt_bs_init(dst, (size_t)nb_entries*18);
+    for (int i = 0; i < nb_entries; i++)
+        avt_encode_index_entry(&bs, entries[i]);
+}
@@ -33,4 +33,9 @@ int avt_encode_header(uint8_t hdr[AVT_MAX_HEADER_LEN], size_t *hdr_len,
                       enum AVTPktDescriptors desc, union AVTPacketData pkt,
                       const uint8_t first[AVT_MAX_HEADER_LEN]);
 
+/* Write the entries of an index packet, which are sent as its payload.
+ * dst must fit 18 bytes per entry. */
+void avt_encode_index_entries(uint8_t *dst, const AVTIndexEntry *entries,
+                              uint32_t nb_entries);
+
 #endif /* AVTRANSPORT_ENCODE */
@@ -0,0 +1,1259 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avtransport/utils.h>
+
+#include "fec.h"
+#include "raptorq_tables.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+/* GF(256), with the polynomial x^8 + x^4 + x^3 + x^2 + 1 */
+static struct {
+    pthread_once_t once;
+    uint8_t exp[512];
+    uint8_t log[256];
+    uint8_t inv[256];
+
+    /* Products with every low and high nibble, for table-lookup kernels */
+    uint8_t mul_lo[256][16];
+    uint8_t mul_hi[256][16];
+
+    void (*muladd)(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+} gf = {
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    if (!a || !b)
+        return 0;
+    return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+static void muladd_c(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    const uint8_t *lo = gf.mul_lo[c], *hi = gf.mul_hi[c];
+    for (size_t i = 0; i < len; i++)
+        dst[i] ^= lo[src[i] & 0xF] ^ hi[src[i] >> 4];
+}
+
+#ifdef HAVE_X86
+__attribute__((target("ssse3")))
+static void muladd_ssse3(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    const __m128i lo = _mm_loadu_si128((const __m128i *)gf.mul_lo[c]);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)gf.mul_hi[c]);
+    const __m128i mask = _mm_set1_epi8(0xF);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(s, mask));
+        __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask));
+        d = _mm_xor_si128(d, _mm_xor_si128(l, h));
+        _mm_storeu_si128((__m128i *)&dst[i], d);
+    }
+
+    muladd_c(&dst[i], &src[i], c, len - i);
+}
+
+__attribute__((target("avx2")))
+static void muladd_avx2(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)gf.mul_lo[c]));
+    const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)gf.mul_hi[c]));
+    const __m256i mask = _mm256_set1_epi8(0xF);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask));
+        __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask));
+        d = _mm256_xor_si256(d, _mm256_xor_si256(l, h));
+        _mm256_storeu_si256((__m256i *)&dst[i], d);
+    }
+
+    muladd_c(&dst[i], &src[i], c, len - i);
+}
+#endif
+
+#ifdef HAVE_NEON
+static void muladd_neon(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    const uint8x16_t lo = vld1q_u8(gf.mul_lo[c]);
+    const uint8x16_t hi = vld1q_u8(gf.mul_hi[c]);
+    const uint8x16_t mask = vdupq_n_u8(0xF);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t s = vld1q_u8(&src[i]);
+        uint8x16_t d = vld1q_u8(&dst[i]);
+        uint8x16_t l = vqtbl1q_u8(lo, vandq_u8(s, mask));
+        uint8x16_t h = vqtbl1q_u8(hi, vshrq_n_u8(s, 4));
+        vst1q_u8(&dst[i], veorq_u8(d, veorq_u8(l, h)));
+    }
+
+    muladd_c(&dst[i], &src[i], c, len - i);
+}
+#endif
+
+static void gf_init(void)
+{
+    for (int i = 0, x = 1; i < 255; i++) {
+        gf.exp[i] = gf.exp[i + 255] = x;
+        gf.log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x11D;
+    }
+
+    for (int a = 1; a < 256; a++)
+        gf.inv[a] = gf.exp[255 - gf.log[a]];
+
+    for (int c = 0; c < 256; c++) {
+        for (int n = 0; n < 16; n++) {
+            gf.mul_lo[c][n] = gf_mul(c, n);
+            gf.mul_hi[c][n] = gf_mul(c, n << 4);
+        }
+    }
+
+    gf.muladd = muladd_c;
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        gf.muladd = muladd_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        gf.muladd = muladd_ssse3;
+#endif
+#ifdef HAVE_NEON
+    gf.muladd = muladd_neon;
+#endif
+}
+
+void avt_gf256_muladd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len)
+{
+    pthread_once(&gf.once, gf_init);
+
+    if (!c)
+        return;
+
+    gf.muladd(dst, src, c, len);
+}
+
+int avt_fec_blocks(AVTFECBlocks *b, size_t len)
+{
+    size_t kt = (len + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+    if (!kt || len > AVT_FEC_MAX_LEN)
+        return AVT_ERROR(EINVAL);
+
+    /* As few blocks as possible, as larger blocks withstand longer bursts */
+    int z = (kt + AVT_FEC_MAX_SOURCE - 1) / AVT_FEC_MAX_SOURCE;
+    *b = (AVTFECBlocks) {
+        .nb = z,
+        .nb_long = kt - (kt / z)*z,
+        .k_long = (kt + z - 1) / z,
+        .k_short = kt / z,
+    };
+
+    return z;
+}
+
+/* Encoding plans kept, for as many source block sizes */
+#define RQ_PLAN_CACHE 8
+
+/* Columns of an LT row, at most: the largest degree, and 3 PI symbols */
+#define RQ_MAX_LT (30 + 3)
+
+#define RQ_NIL UINT32_MAX
+#define RQ_INACT (UINT32_C(1) << 31)
+
+/* Parameters of a source block, RFC 6330 section 5.3.3.3 */
+typedef struct RQParams {
+    uint32_t k, j, s, h, w; /* K', J(K'), S(K'), H(K'), W(K') */
+    uint32_t l, p, p1, b;
+} RQParams;
+
+/* The constraint matrix of a source block, once its binary rows are peeled */
+typedef struct RQSystem {
+    RQParams par;
+
+    /* Binary rows: the LDPC rows, then the LT rows of the symbols used */
+    uint32_t nb_rows;
+    uint32_t *row_start;
+    uint32_t *cols;
+
+    /* Rows and the column they solve for, in the order they do.
+     * Each row only references columns solved for before, or inactive. */
+    uint32_t nb_piv;
+    uint32_t *piv_row;
+    uint32_t *piv_col;
+
+    /* Per column, its index in piv_col, or RQ_INACT | its inactive index */
+    uint32_t *col_idx;
+    uint32_t nb_inact;
+    uint32_t *inact_col;
+
+    /* Binary rows left for the dense system */
+    uint32_t nb_left;
+    uint32_t *left_row;
+} RQSystem;
+
+typedef struct RQPlan {
+    RQSystem sys;
+    int refs;
+
+    /* nb_dense x nb_inact: the inactive columns are the sum of the dense
+     * system's right-hand sides multiplied by their rows */
+    uint32_t nb_dense;
+    uint8_t *rt;
+} RQPlan;
+
+static struct {
+    pthread_mutex_t lock;
+    RQPlan *plans[RQ_PLAN_CACHE]; /* Most recently used first */
+} rq_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static inline bool rq_bit(const uint64_t *mask, size_t n)
+{
+    return (mask[n >> 6] >> (n & 63)) & 1;
+}
+
+static inline uint32_t rq_load(const uint8_t *src)
+{
+    uint32_t v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+}
+
+/* Multiply each byte of a symbol by alpha */
+static inline uint32_t rq_mul_alpha(uint32_t v)
+{
+    return ((v & 0x7F7F7F7F) << 1) ^ (((v >> 7) & 0x01010101)*0x1D);
+}
+
+static bool rq_is_prime(uint32_t n)
+{
+    if (n < 2)
+        return false;
+    for (uint32_t d = 2; d*d <= n; d++)
+        if (!(n % d))
+            return false;
+    return true;
+}
+
+/* Parameters of the smallest K' which fits k source symbols */
+static void rq_params(RQParams *par, uint32_t k)
+{
+    size_t lo = 0, hi = AVT_ARRAY_ELEMS(rq_sys) - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) >> 1;
+        if (rq_sys[mid][0] < k)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    par->k = rq_sys[lo][0];
+    par->j = rq_sys[lo][1];
+    par->s = rq_sys[lo][2];
+    par->h = rq_sys[lo][3];
+    par->w = rq_sys[lo][4];
+    par->l = par->k + par->s + par->h;
+    par->p = par->l - par->w;
+    par->b = par->w - par->s;
+    for (par->p1 = par->p; !rq_is_prime(par->p1); par->p1++);
+}
+
+/* Rand[y, i, m], section 5.3.5.1 */
+static inline uint32_t rq_rand(uint32_t y, uint32_t i, uint32_t m)
+{
+    return (rq_v[0][(y + i) & 0xFF] ^
+            rq_v[1][((y >> 8) + i) & 0xFF] ^
+            rq_v[2][((y >> 16) + i) & 0xFF] ^
+            rq_v[3][((y >> 24) + i) & 0xFF]) % m;
+}
+
+/* Deg[v], section 5.3.5.2 */
+static inline uint32_t rq_degree(const RQParams *par, uint32_t v)
+{
+    uint32_t d = 1;
+    while (v >= rq_deg[d])
+        d++;
+    return AVT_MIN(d, par->w - 2);
+}
+
+/* Columns of the LT row of an ISI, from Tuple[K', X] and Enc[], sections
+ * 5.3.5.3 and 5.3.5.4. Returns their number. */
+static uint32_t rq_lt_cols(const RQParams *par, uint32_t x, uint32_t *cols)
+{
+    uint32_t a = 53591 + par->j*997;
+    if (!(a & 1))
+        a++;
+    uint32_t y = 10267*(par->j + 1) + x*a;
+
+    uint32_t d = rq_degree(par, rq_rand(y, 0, 1 << 20));
+    a = 1 + rq_rand(y, 1, par->w - 1);
+    uint32_t b = rq_rand(y, 2, par->w);
+    uint32_t d1 = d < 4 ? 2 + rq_rand(x, 3, 2) : 2;
+    uint32_t a1 = 1 + rq_rand(x, 4, par->p1 - 1);
+    uint32_t b1 = rq_rand(x, 5, par->p1);
+
+    uint32_t n = 0;
+    cols[n++] = b;
+    for (uint32_t i = 1; i < d; i++) {
+        b = (b + a) % par->w;
+        cols[n++] = b;
+    }
+
+    while (b1 >= par->p)
+        b1 = (b1 + a1) % par->p1;
+    cols[n++] = par->w + b1;
+    for (uint32_t i = 1; i < d1; i++) {
+        b1 = (b1 + a1) % par->p1;
+        while (b1 >= par->p)
+            b1 = (b1 + a1) % par->p1;
+        cols[n++] = par->w + b1;
+    }
+
+    return n;
+}
+
+/* Encoding symbol of an ISI, from the intermediate symbols */
+static uint32_t rq_lt_sym(const RQParams *par, uint32_t x, const uint32_t *c)
+{
+    uint32_t cols[RQ_MAX_LT], v = 0;
+    uint32_t n = rq_lt_cols(par, x, cols);
+    for (uint32_t i = 0; i < n; i++)
+        v ^= c[cols[i]];
+    return v;
+}
+
+/* Sort the columns of a row, and cancel out those present an even number of
+ * times. Returns the number left. */
+static uint32_t rq_row_canon(uint32_t *cols, uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t v = cols[i], j = i;
+        for (; j && cols[j - 1] > v; j--)
+            cols[j] = cols[j - 1];
+        cols[j] = v;
+    }
+
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((i + 1) < n && cols[i] == cols[i + 1])
+            i++;
+        else
+            cols[out++] = cols[i];
+    }
+
+    return out;
+}
+
+static void rq_sys_free(RQSystem *sys)
+{
+    free(sys->row_start);
+    free(sys->cols);
+    free(sys->piv_row);
+    free(sys->piv_col);
+    free(sys->col_idx);
+    free(sys->inact_col);
+    free(sys->left_row);
+}
+
+/* Build the binary rows: the LDPC rows, section 5.3.3.3, then the LT rows
+ * of the nb symbols with the given ISIs */
+static int rq_build(RQSystem *sys, const uint32_t *isi, uint32_t nb)
+{
+    const RQParams *par = &sys->par;
+
+    sys->nb_rows = par->s + nb;
+    sys->row_start = malloc((sys->nb_rows + 1)*sizeof(*sys->row_start));
+    sys->cols = malloc((3*(par->b + par->s) + nb*RQ_MAX_LT)*sizeof(*sys->cols));
+    uint32_t *pos = malloc(par->s*sizeof(*pos));
+    if (!sys->row_start || !sys->cols || !pos) {
+        free(pos);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    /* The LDPC rows are given by column, so count each row's columns first */
+    uint32_t *start = sys->row_start;
+    memset(start, 0, (par->s + 1)*sizeof(*start));
+    for (uint32_t i = 0; i < par->b; i++) {
+        uint32_t a = 1 + i / par->s, b = i % par->s;
+        for (int n = 0; n < 3; n++, b = (b + a) % par->s)
+            start[b + 1]++;
+    }
+    for (uint32_t r = 0; r < par->s; r++) {
+        start[r + 1] += start[r] + 3;
+        pos[r] = start[r];
+    }
+
+    for (uint32_t i = 0; i < par->b; i++) {
+        uint32_t a = 1 + i / par->s, b = i % par->s;
+        for (int n = 0; n < 3; n++, b = (b + a) % par->s)
+            sys->cols[pos[b]++] = i;
+    }
+    for (uint32_t r = 0; r < par->s; r++) {
+        sys->cols[pos[r]++] = par->b + r;
+        sys->cols[pos[r]++] = par->w + (r % par->p);
+        sys->cols[pos[r]++] = par->w + ((r + 1) % par->p);
+    }
+    free(pos);
+
+    uint32_t out = 0;
+    for (uint32_t r = 0, beg = 0; r < par->s; r++) {
+        uint32_t end = start[r + 1];
+        uint32_t n = rq_row_canon(&sys->cols[beg], end - beg);
+        memmove(&sys->cols[out], &sys->cols[beg], n*sizeof(*sys->cols));
+        start[r] = out;
+        out += n;
+        beg = end;
+    }
+
+    for (uint32_t i = 0; i < nb; i++) {
+        start[par->s + i] = out;
+        out += rq_row_canon(&sys->cols[out],
+                            rq_lt_cols(par, isi[i], &sys->cols[out]));
+    }
+    start[sys->nb_rows] = out;
+
+    return 0;
+}
+
+typedef struct RQPeel {
+    uint32_t *adj_start; /* Rows of each column */
+    uint32_t *adj;
+    uint32_t *deg;       /* Active columns of each row */
+    uint8_t *used;
+
+    /* Rows by their degree, at the time they were added. Degrees only go
+     * down, and rows are added again when they do. */
+    uint32_t *head;
+    uint32_t *next;
+    uint32_t *row;
+    uint32_t nb;
+    uint32_t min;
+} RQPeel;
+
+static inline void rq_peel_push(RQPeel *pl, uint32_t r, uint32_t d)
+{
+    pl->row[pl->nb] = r;
+    pl->next[pl->nb] = pl->head[d];
+    pl->head[d] = pl->nb++;
+    pl->min = AVT_MIN(pl->min, d);
+}
+
+/* A column stops being active */
+static void rq_peel_col(RQPeel *pl, uint32_t c)
+{
+    for (uint32_t e = pl->adj_start[c]; e < pl->adj_start[c + 1]; e++) {
+        uint32_t r = pl->adj[e];
+        if (!pl->used[r] && --pl->deg[r])
+            rq_peel_push(pl, r, pl->deg[r]);
+    }
+}
+
+static void rq_inactivate(RQSystem *sys, uint32_t c)
+{
+    sys->col_idx[c] = RQ_INACT | sys->nb_inact;
+    sys->inact_col[sys->nb_inact++] = c;
+}
+
+/* Solve the binary rows for as many columns as possible, as in the first
+ * phase of section 5.4.2.2: repeatedly take the row with the fewest active
+ * columns, inactivate all of them but one, and solve for that one. The PI
+ * columns are inactive from the start. */
+static int rq_peel(RQSystem *sys)
+{
+    int err = 0;
+    const RQParams *par = &sys->par;
+    const uint32_t nr = sys->nb_rows, w = par->w;
+    const uint32_t *start = sys->row_start, *cols = sys->cols;
+    RQPeel pl = { 0 };
+
+    sys->piv_row = malloc(par->l*sizeof(*sys->piv_row));
+    sys->piv_col = malloc(par->l*sizeof(*sys->piv_col));
+    sys->col_idx = malloc(par->l*sizeof(*sys->col_idx));
+    sys->inact_col = malloc(par->l*sizeof(*sys->inact_col));
+    sys->left_row = malloc(nr*sizeof(*sys->left_row));
+    pl.adj_start = calloc(w + 1, sizeof(*pl.adj_start));
+    pl.deg = calloc(nr, sizeof(*pl.deg));
+    pl.used = calloc(nr, sizeof(*pl.used));
+    if (!sys->piv_row || !sys->piv_col || !sys->col_idx || !sys->inact_col ||
+        !sys->left_row || !pl.adj_start || !pl.deg || !pl.used) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    uint32_t max_deg = 0;
+    for (uint32_t r = 0; r < nr; r++) {
+        for (uint32_t e = start[r]; e < start[r + 1]; e++) {
+            if (cols[e] < w) {
+                pl.adj_start[cols[e] + 1]++;
+                pl.deg[r]++;
+            }
+        }
+        max_deg = AVT_MAX(max_deg, pl.deg[r]);
+    }
+    for (uint32_t c = 0; c < w; c++) {
+        pl.adj_start[c + 1] += pl.adj_start[c];
+        sys->col_idx[c] = pl.adj_start[c];
+    }
+
+    uint32_t nnz = pl.adj_start[w];
+    pl.adj = malloc(nnz*sizeof(*pl.adj));
+    pl.head = malloc((max_deg + 1)*sizeof(*pl.head));
+    pl.next = malloc((nr + nnz)*sizeof(*pl.next));
+    pl.row = malloc((nr + nnz)*sizeof(*pl.row));
+    if (!pl.adj || !pl.head || !pl.next || !pl.row) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    for (uint32_t r = 0; r < nr; r++)
+        for (uint32_t e = start[r]; e < start[r + 1]; e++)
+            if (cols[e] < w)
+                pl.adj[sys->col_idx[cols[e]]++] = r;
+
+    for (uint32_t c = 0; c < w; c++)
+        sys->col_idx[c] = RQ_NIL;
+    sys->nb_inact = 0;
+    for (uint32_t c = w; c < par->l; c++)
+        rq_inactivate(sys, c);
+
+    for (uint32_t d = 0; d <= max_deg; d++)
+        pl.head[d] = RQ_NIL;
+    pl.min = max_deg + 1;
+    for (uint32_t r = 0; r < nr; r++)
+        if (pl.deg[r])
+            rq_peel_push(&pl, r, pl.deg[r]);
+
+    sys->nb_piv = 0;
+    for (;;) {
+        uint32_t r = RQ_NIL;
+        while (pl.min <= max_deg) {
+            uint32_t e = pl.head[pl.min];
+            if (e == RQ_NIL) {
+                pl.min++;
+                continue;
+            }
+            pl.head[pl.min] = pl.next[e];
+            if (!pl.used[pl.row[e]] && pl.deg[pl.row[e]] == pl.min) {
+                r = pl.row[e];
+                break;
+            }
+        }
+        if (r == RQ_NIL)
+            break;
+
+        uint32_t c = RQ_NIL;
+        for (uint32_t e = start[r]; e < start[r + 1]; e++) {
+            if (cols[e] >= w || sys->col_idx[cols[e]] != RQ_NIL)
+                continue;
+            if (c == RQ_NIL) {
+                c = cols[e];
+            } else {
+                rq_inactivate(sys, cols[e]);
+                rq_peel_col(&pl, cols[e]);
+            }
+        }
+
+        pl.used[r] = 1;
+        sys->col_idx[c] = sys->nb_piv;
+        sys->piv_row[sys->nb_piv] = r;
+        sys->piv_col[sys->nb_piv++] = c;
+        rq_peel_col(&pl, c);
+    }
+
+    /* Columns no row could solve for */
+    for (uint32_t c = 0; c < w; c++)
+        if (sys->col_idx[c] == RQ_NIL)
+            rq_inactivate(sys, c);
+
+    sys->nb_left = 0;
+    for (uint32_t r = 0; r < nr; r++)
+        if (!pl.used[r])
+            sys->left_row[sys->nb_left++] = r;
+
+end:
+    free(pl.adj_start);
+    free(pl.adj);
+    free(pl.deg);
+    free(pl.used);
+    free(pl.head);
+    free(pl.next);
+    free(pl.row);
+    return err;
+}
+
+/* Add the inactive coefficients of the columns of a row, other than skip */
+static void rq_row_coef(const RQSystem *sys, uint32_t r, uint32_t skip,
+                        const uint64_t *coef, uint32_t nw, uint64_t *dst)
+{
+    for (uint32_t e = sys->row_start[r]; e < sys->row_start[r + 1]; e++) {
+        uint32_t c = sys->cols[e];
+        if (c == skip)
+            continue;
+
+        uint32_t idx = sys->col_idx[c];
+        if (idx & RQ_INACT) {
+            idx &= ~RQ_INACT;
+            dst[idx >> 6] ^= UINT64_C(1) << (idx & 63);
+        } else {
+            for (uint32_t i = 0; i < nw; i++)
+                dst[i] ^= coef[idx*nw + i];
+        }
+    }
+}
+
+/* Multiply a vector over GF(256), stored as 8 bit planes, by alpha */
+static void rq_planes_alpha(uint64_t *y, uint32_t nw)
+{
+    for (uint32_t i = 0; i < nw; i++) {
+        uint64_t top = y[7*nw + i];
+        for (int b = 7; b > 0; b--)
+            y[b*nw + i] = y[(b - 1)*nw + i];
+        y[i] = top;
+        y[2*nw + i] ^= top;
+        y[3*nw + i] ^= top;
+        y[4*nw + i] ^= top;
+    }
+}
+
+/* The rows of MT with a 1 in column m, for all columns but the last,
+ * section 5.3.3.3 */
+static inline void rq_mt_rows(const RQParams *par, uint32_t m,
+                              uint32_t *h1, uint32_t *h2)
+{
+    *h1 = rq_rand(m + 1, 6, par->h);
+    *h2 = (*h1 + rq_rand(m + 1, 7, par->h - 1) + 1) % par->h;
+}
+
+/* Build the system left for the inactive columns once the pivot columns are
+ * substituted in: the binary rows left over, then the HDPC rows, as rows of
+ * nb_inact GF(256) coefficients followed by aug zeroes */
+static uint8_t *rq_dense(const RQSystem *sys, uint32_t aug)
+{
+    const RQParams *par = &sys->par;
+    const uint32_t u = sys->nb_inact, nw = (u + 63) >> 6;
+    const uint32_t width = u + aug, nb_dense = sys->nb_left + par->h;
+
+    uint64_t *coef = calloc((size_t)(sys->nb_piv + 1 + 8 + 8*par->h)*nw,
+                            sizeof(*coef));
+    uint8_t *m = calloc((size_t)nb_dense*width, 1);
+    if (!coef || !m) {
+        free(coef);
+        free(m);
+        return NULL;
+    }
+    uint64_t *tmp = &coef[(size_t)sys->nb_piv*nw];
+    uint64_t *y = &tmp[nw];
+    uint64_t *acc = &y[8*nw];
+
+    /* Pivot columns, in terms of the inactive ones */
+    for (uint32_t k = 0; k < sys->nb_piv; k++)
+        rq_row_coef(sys, sys->piv_row[k], sys->piv_col[k], coef, nw,
+                    &coef[(size_t)k*nw]);
+
+    for (uint32_t j = 0; j < sys->nb_left; j++) {
+        memset(tmp, 0, nw*sizeof(*tmp));
+        rq_row_coef(sys, sys->left_row[j], RQ_NIL, coef, nw, tmp);
+        for (uint32_t i = 0; i < u; i++)
+            m[(size_t)j*width + i] = rq_bit(tmp, i);
+    }
+
+    /* HDPC rows: GAMMA is applied as y[m] = alpha*y[m - 1] + C[m] */
+    const uint32_t nb_cols = par->k + par->s;
+    for (uint32_t c = 0; c < nb_cols; c++) {
+        rq_planes_alpha(y, nw);
+
+        uint32_t idx = sys->col_idx[c];
+        if (idx & RQ_INACT) {
+            idx &= ~RQ_INACT;
+            y[idx >> 6] ^= UINT64_C(1) << (idx & 63);
+        } else {
+            for (uint32_t i = 0; i < nw; i++)
+                y[i] ^= coef[(size_t)idx*nw + i];
+        }
+
+        if (c < (nb_cols - 1)) {
+            uint32_t h1, h2;
+            rq_mt_rows(par, c, &h1, &h2);
+            for (uint32_t i = 0; i < 8*nw; i++) {
+                acc[h1*8*nw + i] ^= y[i];
+                acc[h2*8*nw + i] ^= y[i];
+            }
+        } else {
+            for (uint32_t h = 0; h < par->h; h++) {
+                for (uint32_t i = 0; i < 8*nw; i++)
+                    acc[h*8*nw + i] ^= y[i];
+                rq_planes_alpha(y, nw);
+            }
+        }
+    }
+
+    for (uint32_t h = 0; h < par->h; h++) {
+        uint8_t *row = &m[(size_t)(sys->nb_left + h)*width];
+        for (uint32_t i = 0; i < u; i++)
+            for (int b = 0; b < 8; b++)
+                row[i] |= rq_bit(&acc[(h*8 + b)*nw], i) << b;
+
+        /* The identity over the HDPC symbols */
+        memset(tmp, 0, nw*sizeof(*tmp));
+        uint32_t idx = sys->col_idx[nb_cols + h];
+        if (idx & RQ_INACT) {
+            idx &= ~RQ_INACT;
+            tmp[idx >> 6] ^= UINT64_C(1) << (idx & 63);
+        } else {
+            memcpy(tmp, &coef[(size_t)idx*nw], nw*sizeof(*tmp));
+        }
+        for (uint32_t i = 0; i < u; i++)
+            row[i] ^= rq_bit(tmp, i);
+    }
+
+    free(coef);
+    return m;
+}
+
+/* Gauss-Jordan elimination of the dense system over its first u columns.
+ * The first u rows end up as the identity, augmented with the solution. */
+static int rq_eliminate(uint8_t *m, uint32_t rows, uint32_t u, uint32_t width)
+{
+    for (uint32_t i = 0; i < u; i++) {
+        uint32_t p = i;
+        while (p < rows && !m[(size_t)p*width + i])
+            p++;
+        if (p == rows)
+            return AVT_ERROR(EAGAIN);
+
+        uint8_t *ri = &m[(size_t)i*width];
+        if (p != i) {
+            uint8_t *rp = &m[(size_t)p*width];
+            for (uint32_t j = i; j < width; j++) {
+                uint8_t t = ri[j];
+                ri[j] = rp[j];
+                rp[j] = t;
+            }
+        }
+
+        uint8_t f = gf.inv[ri[i]];
+        if (f != 1)
+            for (uint32_t j = i; j < width; j++)
+                ri[j] = gf_mul(ri[j], f);
+
+        for (uint32_t r = 0; r < rows; r++) {
+            uint8_t *rr = &m[(size_t)r*width];
+            if (r != i && rr[i])
+                gf.muladd(&rr[i], &ri[i], rr[i], width - i);
+        }
+    }
+
+    return 0;
+}
+
+/* Solve the pivot columns for what is known of them, with the inactive ones
+ * taken as zero, and get the right-hand side of the dense system */
+static void rq_forward(const RQSystem *sys, const uint32_t *rhs, uint32_t *c,
+                       uint32_t *dense_rhs)
+{
+    const RQParams *par = &sys->par;
+    const uint32_t *start = sys->row_start, *cols = sys->cols;
+
+    memset(c, 0, par->l*sizeof(*c));
+    for (uint32_t k = 0; k < sys->nb_piv; k++) {
+        uint32_t r = sys->piv_row[k], v = rhs[r];
+        for (uint32_t e = start[r]; e < start[r + 1]; e++)
+            v ^= c[cols[e]];
+        c[sys->piv_col[k]] = v;
+    }
+
+    for (uint32_t j = 0; j < sys->nb_left; j++) {
+        uint32_t r = sys->left_row[j], v = rhs[r];
+        for (uint32_t e = start[r]; e < start[r + 1]; e++)
+            v ^= c[cols[e]];
+        dense_rhs[j] = v;
+    }
+
+    uint32_t *acc = &dense_rhs[sys->nb_left], y = 0;
+    const uint32_t nb_cols = par->k + par->s;
+    memset(acc, 0, par->h*sizeof(*acc));
+    for (uint32_t m = 0; m < nb_cols; m++) {
+        y = rq_mul_alpha(y) ^ c[m];
+        if (m < (nb_cols - 1)) {
+            uint32_t h1, h2;
+            rq_mt_rows(par, m, &h1, &h2);
+            acc[h1] ^= y;
+            acc[h2] ^= y;
+        } else {
+            for (uint32_t h = 0; h < par->h; h++, y = rq_mul_alpha(y))
+                acc[h] ^= y;
+        }
+    }
+    for (uint32_t h = 0; h < par->h; h++)
+        acc[h] ^= c[nb_cols + h];
+}
+
+/* Solve the pivot columns, once the inactive ones are known */
+static void rq_backward(const RQSystem *sys, const uint32_t *rhs, uint32_t *c)
+{
+    const uint32_t *start = sys->row_start, *cols = sys->cols;
+
+    for (uint32_t k = 0; k < sys->nb_piv; k++) {
+        uint32_t r = sys->piv_row[k], col = sys->piv_col[k], v = rhs[r];
+        for (uint32_t e = start[r]; e < start[r + 1]; e++)
+            if (cols[e] != col)
+                v ^= c[cols[e]];
+        c[col] = v;
+    }
+}
+
+static void rq_plan_unref_locked(RQPlan *pl)
+{
+    if (--pl->refs)
+        return;
+
+    rq_sys_free(&pl->sys);
+    free(pl->rt);
+    free(pl);
+}
+
+static void rq_plan_unref(RQPlan *pl)
+{
+    pthread_mutex_lock(&rq_cache.lock);
+    rq_plan_unref_locked(pl);
+    pthread_mutex_unlock(&rq_cache.lock);
+}
+
+/* Everything about encoding a source block which does not depend on its data:
+ * the source symbols are its only right-hand sides */
+static int rq_plan_build(RQPlan *pl)
+{
+    int err;
+    RQSystem *sys = &pl->sys;
+    const RQParams *par = &sys->par;
+
+    uint32_t *isi = malloc(par->k*sizeof(*isi));
+    if (!isi)
+        return AVT_ERROR(ENOMEM);
+    for (uint32_t i = 0; i < par->k; i++)
+        isi[i] = i;
+
+    err = rq_build(sys, isi, par->k);
+    free(isi);
+    if (err < 0)
+        return err;
+
+    err = rq_peel(sys);
+    if (err < 0)
+        return err;
+
+    const uint32_t u = sys->nb_inact;
+    pl->nb_dense = sys->nb_left + par->h;
+    if (pl->nb_dense != u)
+        return AVT_ERROR(EINVAL);
+
+    const uint32_t width = u + pl->nb_dense;
+    uint8_t *m = rq_dense(sys, pl->nb_dense);
+    pl->rt = malloc((size_t)pl->nb_dense*u);
+    if (!m || !pl->rt) {
+        free(m);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    for (uint32_t j = 0; j < pl->nb_dense; j++)
+        m[(size_t)j*width + u + j] = 1;
+
+    /* Only possible with tables other than those of the RFC */
+    err = rq_eliminate(m, pl->nb_dense, u, width);
+    if (err < 0) {
+        free(m);
+        return AVT_ERROR(EINVAL);
+    }
+
+    for (uint32_t j = 0; j < pl->nb_dense; j++)
+        for (uint32_t i = 0; i < u; i++)
+            pl->rt[(size_t)j*u + i] = m[(size_t)i*width + u + j];
+
+    free(m);
+    return 0;
+}
+
+static int rq_plan_get(RQPlan **out, uint32_t k)
+{
+    int err;
+    RQParams par;
+    rq_params(&par, k);
+
+    pthread_mutex_lock(&rq_cache.lock);
+    for (int i = 0; i < RQ_PLAN_CACHE && rq_cache.plans[i]; i++) {
+        RQPlan *pl = rq_cache.plans[i];
+        if (pl->sys.par.k != par.k)
+            continue;
+
+        memmove(&rq_cache.plans[1], &rq_cache.plans[0], i*sizeof(pl));
+        rq_cache.plans[0] = pl;
+        pl->refs++;
+        pthread_mutex_unlock(&rq_cache.lock);
+        *out = pl;
+        return 0;
+    }
+    pthread_mutex_unlock(&rq_cache.lock);
+
+    /* Planned without the lock held, others may do the same meanwhile */
+    RQPlan *pl = calloc(1, sizeof(*pl));
+    if (!pl)
+        return AVT_ERROR(ENOMEM);
+    pl->sys.par = par;
+    pl->refs = 2;
+
+    err = rq_plan_build(pl);
+    if (err < 0) {
+        rq_sys_free(&pl->sys);
+        free(pl->rt);
+        free(pl);
+        return err;
+    }
+
+    pthread_mutex_lock(&rq_cache.lock);
+    if (rq_cache.plans[RQ_PLAN_CACHE - 1])
+        rq_plan_unref_locked(rq_cache.plans[RQ_PLAN_CACHE - 1]);
+    memmove(&rq_cache.plans[1], &rq_cache.plans[0],
+            (RQ_PLAN_CACHE - 1)*sizeof(pl));
+    rq_cache.plans[0] = pl;
+    pthread_mutex_unlock(&rq_cache.lock);
+
+    *out = pl;
+    return 0;
+}
+
+/* Compute the repair symbols first to first + nb - 1 of a source block of
+ * k symbols, which are ISIs K' + first onwards, spaced stride bytes apart */
+static int rq_encode_block(uint8_t *dst, size_t stride, const uint8_t *src,
+                           size_t len, uint32_t k, uint32_t first, uint32_t nb)
+{
+    RQPlan *pl;
+    int err = rq_plan_get(&pl, k);
+    if (err < 0)
+        return err;
+
+    const RQSystem *sys = &pl->sys;
+    const RQParams *par = &sys->par;
+    const uint32_t u = sys->nb_inact;
+
+    uint32_t *rhs = calloc(sys->nb_rows + par->l + pl->nb_dense, sizeof(*rhs));
+    uint8_t *lanes = calloc(4, u);
+    if (!rhs || !lanes) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+    uint32_t *c = &rhs[sys->nb_rows];
+    uint32_t *dense_rhs = &c[par->l];
+
+    /* Source symbols, zero-padded up to K' */
+    for (uint32_t i = 0; i < k && (i*AVT_FEC_SYMBOL_SIZE) < len; i++)
+        memcpy(&rhs[par->s + i], &src[i*AVT_FEC_SYMBOL_SIZE],
+               AVT_MIN(AVT_FEC_SYMBOL_SIZE, len - i*AVT_FEC_SYMBOL_SIZE));
+
+    rq_forward(sys, rhs, c, dense_rhs);
+
+    /* Each byte of the symbols separately */
+    for (uint32_t j = 0; j < pl->nb_dense; j++) {
+        uint8_t v[4];
+        memcpy(v, &dense_rhs[j], 4);
+        for (int b = 0; b < 4; b++)
+            if (v[b])
+                gf.muladd(&lanes[b*u], &pl->rt[(size_t)j*u], v[b], u);
+    }
+    for (uint32_t i = 0; i < u; i++) {
+        uint8_t v[4] = { lanes[i], lanes[u + i], lanes[2*u + i], lanes[3*u + i] };
+        memcpy(&c[sys->inact_col[i]], v, 4);
+    }
+
+    rq_backward(sys, rhs, c);
+
+    for (uint32_t r = 0; r < nb; r++) {
+        uint32_t v = rq_lt_sym(par, par->k + first + r, c);
+        memcpy(&dst[r*stride], &v, AVT_FEC_SYMBOL_SIZE);
+    }
+
+end:
+    free(rhs);
+    free(lanes);
+    rq_plan_unref(pl);
+    return err;
+}
+
+/* Solve for the intermediate symbols of a source block, given nb symbols
+ * and their ISIs */
+static int rq_decode_block(const RQParams *par, const uint32_t *isi,
+                           const uint32_t *val, uint32_t nb, uint32_t *c)
+{
+    int err;
+    RQSystem sys = { .par = *par };
+    uint32_t *rhs = NULL, *dense_rhs = NULL;
+    uint8_t *m = NULL;
+
+    err = rq_build(&sys, isi, nb);
+    if (err < 0)
+        goto end;
+
+    err = rq_peel(&sys);
+    if (err < 0)
+        goto end;
+
+    const uint32_t u = sys.nb_inact, width = u + 4;
+    const uint32_t nb_dense = sys.nb_left + par->h;
+    if (nb_dense < u) {
+        err = AVT_ERROR(EAGAIN);
+        goto end;
+    }
+
+    m = rq_dense(&sys, 4);
+    rhs = calloc(sys.nb_rows, sizeof(*rhs));
+    dense_rhs = malloc(nb_dense*sizeof(*dense_rhs));
+    if (!m || !rhs || !dense_rhs) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    memcpy(&rhs[par->s], val, nb*sizeof(*val));
+    rq_forward(&sys, rhs, c, dense_rhs);
+    for (uint32_t j = 0; j < nb_dense; j++)
+        memcpy(&m[(size_t)j*width + u], &dense_rhs[j], 4);
+
+    err = rq_eliminate(m, nb_dense, u, width);
+    if (err < 0)
+        goto end;
+
+    for (uint32_t i = 0; i < u; i++)
+        memcpy(&c[sys.inact_col[i]], &m[(size_t)i*width + u], 4);
+
+    rq_backward(&sys, rhs, c);
+
+end:
+    rq_sys_free(&sys);
+    free(m);
+    free(rhs);
+    free(dense_rhs);
+    return err;
+}
+
+static inline uint32_t fec_block_k(const AVTFECBlocks *b, int z)
+{
+    return z < b->nb_long ? b->k_long : b->k_short;
+}
+
+static inline size_t fec_block_start(const AVTFECBlocks *b, int z)
+{
+    if (z < b->nb_long)
+        return (size_t)z*b->k_long;
+    return (size_t)b->nb_long*b->k_long + (size_t)(z - b->nb_long)*b->k_short;
+}
+
+int avt_fec_encode(uint8_t *dst, const uint8_t *src, size_t len,
+                   int first, int nb)
+{
+    AVTFECBlocks b;
+    int err = avt_fec_blocks(&b, len);
+    if (err < 0)
+        return err;
+    else if (first < 0 || nb < 0)
+        return AVT_ERROR(EINVAL);
+
+    pthread_once(&gf.once, gf_init);
+
+    /* Repair symbol n is the (n / Z)-th one of block n % Z */
+    for (int z = 0; z < b.nb; z++) {
+        int r0 = first > z ? (first - z + b.nb - 1) / b.nb : 0;
+        int r1 = (first + nb) > z ? (first + nb - z + b.nb - 1) / b.nb : 0;
+        if (r1 <= r0)
+            continue;
+
+        size_t off = fec_block_start(&b, z)*AVT_FEC_SYMBOL_SIZE;
+        err = rq_encode_block(&dst[(r0*b.nb + z - first)*AVT_FEC_SYMBOL_SIZE],
+                              b.nb*AVT_FEC_SYMBOL_SIZE, &src[off], len - off,
+                              fec_block_k(&b, z), r0, r1 - r0);
+        if (err < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+int avt_fec_decode(uint8_t *data, size_t len, const uint64_t *lost,
+                   const uint8_t *repair, int nb_repair,
+                   const uint64_t *repair_lost)
+{
+    AVTFECBlocks b;
+    int err = avt_fec_blocks(&b, len);
+    if (err < 0)
+        return err;
+    else if (nb_repair < 0)
+        return AVT_ERROR(EINVAL);
+
+    pthread_once(&gf.once, gf_init);
+
+    uint32_t *isi = NULL, *val = NULL, *c = NULL;
+    for (int z = 0; z < b.nb; z++) {
+        RQParams par;
+        uint32_t k = fec_block_k(&b, z), nb = 0, nb_lost = 0;
+        size_t s0 = fec_block_start(&b, z);
+        for (uint32_t i = 0; i < k; i++)
+            nb_lost += rq_bit(lost, s0 + i);
+        if (!nb_lost)
+            continue;
+
+        rq_params(&par, k);
+        if (!isi) {
+            uint32_t max = par.k + (nb_repair + b.nb - 1) / b.nb;
+            isi = malloc(max*sizeof(*isi));
+            val = malloc(max*sizeof(*val));
+            c = malloc(par.l*sizeof(*c));
+            if (!isi || !val || !c) {
+                err = AVT_ERROR(ENOMEM);
+                break;
+            }
+        }
+
+        /* Source symbols received, the padding, then repair symbols */
+        for (uint32_t i = 0; i < par.k; i++) {
+            if (i < k && rq_bit(lost, s0 + i))
+                continue;
+            isi[nb] = i;
+            val[nb++] = i < k ? rq_load(&data[(s0 + i)*AVT_FEC_SYMBOL_SIZE]) : 0;
+        }
+        for (uint32_t n = z, r = 0; n < nb_repair; n += b.nb, r++) {
+            if (rq_bit(repair_lost, n))
+                continue;
+            isi[nb] = par.k + r;
+            val[nb++] = rq_load(&repair[n*AVT_FEC_SYMBOL_SIZE]);
+        }
+
+        if (nb < par.k) {
+            err = AVT_ERROR(EAGAIN);
+            break;
+        }
+
+        err = rq_decode_block(&par, isi, val, nb, c);
+        if (err < 0)
+            break;
+
+        for (uint32_t i = 0; i < k; i++) {
+            if (!rq_bit(lost, s0 + i))
+                continue;
+            uint32_t v = rq_lt_sym(&par, i, c);
+            memcpy(&data[(s0 + i)*AVT_FEC_SYMBOL_SIZE], &v, AVT_FEC_SYMBOL_SIZE);
+        }
+    }
+
+    free(isi);
+    free(val);
+    free(c);
+    return err < 0 ? err : 0;
+}
+
+void avt_fec_control_init(AVTFECControl *fc, unsigned int overhead,
+                          unsigned int min, unsigned int max)
+{
+    *fc = (AVTFECControl) {
+        .min = min,
+        .max = AVT_MAX(max, min),
+    };
+    fc->overhead = AVT_MIN(AVT_MAX(overhead, fc->min), fc->max);
+}
+
+bool avt_fec_control_delta(AVTFECControl *fc, uint64_t sent,
+                           uint32_t corrections, uint32_t corrupt,
+                           uint32_t missing, uint64_t *nb_sent, uint64_t *nb_lost)
+{
+    bool init = fc->init;
+    *nb_sent = sent - fc->sent;
+
+    /* Packets lost, or corrupt beyond repair.
+     * Counters are 32-bit and may wrap around. */
+    int64_t lost = (uint32_t)(missing - fc->missing);
+    lost += (int64_t)(uint32_t)(corrupt - fc->corrupt) -
+            (uint32_t)(corrections - fc->corrections);
+    *nb_lost = AVT_MAX(lost, 0);
+
+    fc->init = true;
+    fc->sent = sent;
+    fc->corrections = corrections;
+    fc->corrupt = corrupt;
+    fc->missing = missing;
+
+    return init && *nb_sent;
+}
+
+unsigned int avt_fec_control_adapt(AVTFECControl *fc, uint64_t nb_sent,
+                                   uint64_t nb_lost)
+{
+    if (!nb_sent)
+        return fc->overhead;
+
+    uint32_t rate = AVT_MIN((nb_lost*100*256) / nb_sent, 100*256);
+    fc->loss = fc->loss - (fc->loss >> 3) + (rate >> 3);
+
+    /* Enough repair data for twice the usual loss, or for the current burst */
+    uint32_t target = fc->min + (AVT_MAX(2*fc->loss, rate) + 255) / 256;
+    target = AVT_MIN(target, fc->max);
+
+    /* Go up immediately, come down slowly */
+    if (target >= fc->overhead)
+        fc->overhead = target;
+    else
+        fc->overhead -= (fc->overhead - target + 3) / 4;
+
+    return fc->overhead;
+}
+
+unsigned int avt_fec_control_update(AVTFECControl *fc, uint64_t sent,
+                                    uint32_t corrections, uint32_t corrupt,
+                                    uint32_t missing)
+{
+    uint64_t nb_sent, nb_lost;
+    if (!avt_fec_control_delta(fc, sent, corrections, corrupt, missing,
+                               &nb_sent, &nb_lost))
+        return fc->overhead;
+
+    return avt_fec_control_adapt(fc, nb_sent, nb_lost);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LIBAVTRANSPORT_FEC
+#define LIBAVTRANSPORT_FEC
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* RaptorQ, as per RFC 6330, with 32-bit symbols as the spec mandates */
+#define AVT_FEC_SYMBOL_SIZE 4
+
+/* Source symbols in a source block, at most */
+#define AVT_FEC_MAX_SOURCE 56403
+
+/* Source blocks a payload may be split into, at most */
+#define AVT_FEC_MAX_BLOCKS 255
+
+/* Largest payload FEC can be computed for */
+#define AVT_FEC_MAX_LEN \
+    ((size_t)AVT_FEC_MAX_BLOCKS*AVT_FEC_MAX_SOURCE*AVT_FEC_SYMBOL_SIZE)
+
+/* How a payload is split into source blocks, RFC 6330 section 4.4.1.2 */
+typedef struct AVTFECBlocks {
+    int nb;      /* Z */
+    int nb_long; /* ZL, the first blocks, with k_long source symbols */
+    int k_long;  /* KL */
+    int k_short; /* KS */
+} AVTFECBlocks;
+
+/* Split a payload of len bytes into source blocks.
+ * Returns the number of blocks, or a negative error. */
+int avt_fec_blocks(AVTFECBlocks *b, size_t len);
+
+/* dst[i] ^= c*src[i] over GF(256) */
+void avt_gf256_muladd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+
+/* Compute repair symbols first to first + nb - 1 for a payload of len
+ * bytes into dst, which must fit nb symbols.
+ * Repair symbols are interleaved between source blocks: repair symbol n
+ * belongs to block n % Z, of which it is the (n / Z)-th one.
+ * Returns 0, or a negative error. */
+int avt_fec_encode(uint8_t *dst, const uint8_t *src, size_t len,
+                   int first, int nb);
+
+/* Recover the missing source symbols of a payload of len bytes in place.
+ * data must fit all source symbols, with the padding of the last one zeroed,
+ * and have the received source symbols in place. Bit n of lost is set for
+ * each missing source symbol n.
+ * repair holds the nb_repair first repair symbols, as laid out by
+ * avt_fec_encode(), and bit n of repair_lost is set for each one missing.
+ * Returns 0, AVT_ERROR(EAGAIN) if more symbols are needed, or a negative
+ * error. */
+int avt_fec_decode(uint8_t *data, size_t len, const uint64_t *lost,
+                   const uint8_t *repair, int nb_repair,
+                   const uint64_t *repair_lost);
+
+/* Adapts the FEC overhead to the loss a receiver reports */
+typedef struct AVTFECControl {
+    unsigned int min;
+    unsigned int max;
+    unsigned int overhead; /* In percent */
+
+    /* Smoothed loss, in percent, in 8.8 fixed point */
+    uint32_t loss;
+
+    /* Totals at the last update */
+    bool init;
+    uint64_t sent;
+    uint32_t corrections;
+    uint32_t corrupt;
+    uint32_t missing;
+} AVTFECControl;
+
+void avt_fec_control_init(AVTFECControl *fc, unsigned int overhead,
+                          unsigned int min, unsigned int max);
+
+/* Update with the number of packets sent, and the totals the receiver
+ * reported. Returns the new overhead. */
+unsigned int avt_fec_control_update(AVTFECControl *fc, uint64_t sent,
+                                    uint32_t corrections, uint32_t corrupt,
+                                    uint32_t missing);
+
+/* Take in the totals like avt_fec_control_update(), without adapting,
+ * and get the packets sent and lost since the last totals.
+ * Returns false if there is nothing to adapt to yet. */
+bool avt_fec_control_delta(AVTFECControl *fc, uint64_t sent,
+                           uint32_t corrections, uint32_t corrupt,
+                           uint32_t missing, uint64_t *nb_sent, uint64_t *nb_lost);
+
+/* Adapt to nb_lost packets out of nb_sent. Returns the new overhead. */
+unsigned int avt_fec_control_adapt(AVTFECControl *fc, uint64_t nb_sent,
+                                   uint64_t nb_lost);
+
+#endif
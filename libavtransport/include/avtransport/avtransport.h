@@ -51,6 +51,10 @@ typedef struct AVTContextOptions {
 
     char producer_name[13];   /* Name of the project linking to libavtransport */
     uint16_t producer_ver[3]; /* Major, minor, micro version */
+
+    /* Upper limit of memory kept around for reuse by the payload buffer
+     * pool, in bytes. Zero means automatic. */
+    size_t buffer_pool_max;
 } AVTContextOptions;
 
 /* Allocate an AVTransport context with the given context options. */
@@ -162,12 +162,20 @@ typedef struct AVTConnectionInfo {
 
         /* Buffer size limit. Zero means automatic. Approximate/best effort. */
         size_t buffer;
+
+        /* Open the connection for reading only. Files are not created or
+         * truncated, and are memory-mapped rather than read, where possible. */
+        bool read_only;
     } input_opts;
 
     struct {
         /* Buffer size limit. Zero means automatic. Approximate/best effort. */
         size_t buffer;
 
+        /* Output bandwidth limit in bits per second. Output is paced
+         * to not exceed it. Zero means unlimited. */
+        uint64_t bandwidth;
+
         /* Interleave buffering:
          *  - 0 (the default): automatically select based on the bandwidth
          *  - 1:  buffer enough to interleave the largest current packet completely
@@ -175,6 +183,20 @@ typedef struct AVTConnectionInfo {
          *  - 3:  buffer enough to interleave a third of the largest packet
          *  - 4 and so on: fraction continues to INT_MAX */
         int interleave;
+
+        /* Keep this many bytes of the packets sent in memory, to resend
+         * them from without touching the mirror. Zero disables it. */
+        size_t resend_buffer;
+
+        /* Packets sent longer than this many nanoseconds ago are not
+         * resent from memory. Zero means no limit. */
+        uint64_t resend_max_age;
+
+        /* Let the kernel transmit directly from packet payloads, rather
+         * than copying them. Payloads are held onto until the kernel is done.
+         * Only worth it at high bitrates. Ignored if unsupported.
+         * The io_uring socket backend, which does not do this, is not used when set. */
+        bool zerocopy;
     } output_opts;
 
     /* When greater than 0, enables asynchronous mode.
@@ -39,15 +39,18 @@ typedef struct AVTInputOptions {
 
     struct {
         /**
-         * Whether to always check and correct using Raptor codes in the headers.
+         * Whether to always check and correct headers using their LDPC codes.
+         * Otherwise, correction is only attempted on headers which fail to
+         * parse. Checking a clean header is cheap.
          * Default: false
          */
         bool always_test_headers;
 
         /**
-         * Number of decoding steps. Higher values increase performance overhead,
-         * but allow for better correction of errors.
-         * Default: 1
+         * Maximum number of decoding iterations on corrupt headers.
+         * Higher values increase performance overhead, but allow for better
+         * correction of errors. Clean headers are never iterated on.
+         * Default: 0 (16)
          */
         uint8_t iterations;
     } ldpc;
@@ -104,10 +107,18 @@ typedef struct AVTInputCallbacks {
                       uint16_t redirect_port, int seek_requested,
                       int64_t seek_offset, uint32_t seek_seq);
 
+    /* Also called with a NULL stream when the number of corrected or
+     * corrupt headers received, or of packets lost, changes, with
+     * running totals. */
     int (*feedback_cb)(AVTContext *ctx, void *opaque, AVTStream *st,
                        uint64_t epoch_offset, uint64_t bandwidth,
                        uint32_t fec_corrections, uint32_t corrupt_packets,
                        uint32_t missing_packets);
+
+    /* Called to ask for nb packets, starting at seq, to be resent.
+     * Missing packets are asked for again, less often each time, until
+     * they arrive or are given up on. */
+    int (*resend_cb)(AVTContext *ctx, void *opaque, uint64_t seq, uint32_t nb);
 } AVTInputCallbacks;
 
 /* Open an AVTransport stream or a file for reading. */
@@ -121,6 +132,12 @@ AVT_API int avt_input_set_options(AVTContext *ctx, AVTInputOptions *opts);
 /* Seek into the stream, if possible. */
 AVT_API int avt_input_seek(AVTContext *ctx, AVTStream *st, int64_t offset, int absolute);
 
+/* Scan a file, and write a seek index for it to index_path, or to the
+ * file's path with ".idx" appended if NULL. Reading the file will use it
+ * to seek, which is useful for files written without index packets. */
+AVT_API int avt_index_file(AVTContext *ctx, const char *path,
+                           const char *index_path);
+
 /* Process a single packet and call its relevant callback. If no input is
  * available within the timeout duration (nanoseconds),
  * will return AVT_ERROR(EAGAIN).
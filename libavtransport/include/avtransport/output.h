@@ -55,6 +55,17 @@ typedef struct AVTOutputOptions {
 
     /* Compression mode */
     enum AVTOutputCompressionFlags compress;
+
+    /* Amount of parity data to send for each stream data packet,
+     * as a percentage of its payload. 0 disables parity packets. */
+    unsigned int fec_overhead;
+
+    /* Adapt the overhead of parity data and FEC groups to the loss
+     * reported via avt_output_feedback(), within these bounds, in percent.
+     * The overhead given is used as a starting point.
+     * If fec_max_overhead is 0, the overhead is fixed. */
+    unsigned int fec_min_overhead;
+    unsigned int fec_max_overhead;
 } AVTOutputOptions;
 
 /* All functions listed here are thread-safe. */
@@ -84,6 +95,32 @@ AVT_API int avt_output_stream_update(AVTOutput *out, AVTStream *st);
 AVT_API int avt_output_font_attachment(AVTStream *st, AVTBuffer *file,
                                        const char *filename, enum AVTFontType type);
 
+/* Protect a group of up to 16 streams with FEC as a whole, rather than
+ * each packet individually. After every block_size packets of the streams
+ * (0 means 64, at most 65535), repair data amounting to overhead percent of
+ * the block's payloads is sent, adapted to loss from there on if enabled.
+ * Grouped streams get no per-packet parity. Group IDs must not overlap with
+ * stream IDs. Grouping streams which are already grouped replaces their
+ * old group. */
+AVT_API int avt_output_fec_group(AVTOutput *out, uint16_t group_id,
+                                 AVTStream *streams[], int nb_streams,
+                                 unsigned int overhead, int block_size);
+
+/* Feedback from the receiver. Matches AVTInputCallbacks.feedback_cb, with
+ * the output as the opaque, so it may be hooked up to it directly.
+ * The counters are running totals. If st is NULL, the feedback is for
+ * all streams. */
+AVT_API int avt_output_feedback(AVTContext *ctx, void *opaque, AVTStream *st,
+                                uint64_t epoch_offset, uint64_t bandwidth,
+                                uint32_t fec_corrections, uint32_t corrupt_packets,
+                                uint32_t missing_packets);
+
+/* Resend nb packets starting at seq. Matches AVTInputCallbacks.resend_cb,
+ * with the output as the opaque, so it may be hooked up to it directly.
+ * Returns AVT_ERROR(ENOENT) if a packet is not held by any connection. */
+AVT_API int avt_output_resend(AVTContext *ctx, void *opaque,
+                              uint64_t seq, uint32_t nb);
+
 /* Write stream data to the output
  * If the size of pkt->buf is not equal to pkt->total_size, the
  * packet will be considered to be segmented, and further calls to
@@ -0,0 +1,654 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "encode.h"
+#include "decode.h"
+#include "bytestream.h"
+#include "address.h"
+
+/* Amount read at once when scanning a file */
+#define INDEX_SCAN_WINDOW (1 << 20)
+
+/* Sidecar index file layout, all big-endian:
+ *  - magic
+ *  - u64 size of the file indexed
+ *  - u64 number of entries
+ *  - entries sorted by stream ID, timestamp, then offset, each:
+ *    u64 offset, i64 pts, u16 stream ID, u16 flags */
+#define INDEX_SIDECAR_MAGIC "AVTIDX01"
+#define INDEX_SIDECAR_HDR   24
+#define INDEX_SIDECAR_ENTRY 20
+
+FN_CREATING(avt_index_writer, AVTIndexWriter, AVTIndexStream,
+            stream, streams, nb_streams)
+
+static AVTIndexStream *writer_get_stream(AVTIndexWriter *w, uint16_t id)
+{
+    AVTIndexStream *st = avt_id_map_get(&w->stream_map, id);
+    if (st)
+        return st;
+
+    st = avt_index_writer_create_stream(w);
+    if (!st)
+        return NULL;
+
+    st->id = id;
+    st->last_off = -1;
+
+    if (avt_id_map_set(&w->stream_map, id, st) < 0)
+        return NULL;
+
+    return st;
+}
+
+int avt_index_writer_add(AVTIndexWriter *w, union AVTPacketData pkt,
+                         int64_t off, int *due)
+{
+    AVTIndexStream *st;
+    int64_t pts;
+    bool keyframe = false;
+
+    w->last_seq = pkt.seq;
+    *due = -1;
+
+    switch (pkt.desc) {
+    case AVT_PKT_STREAM_DATA:
+        st = avt_id_map_get(&w->stream_map, pkt.stream_id);
+        if (st)
+            st->last_pts = pkt.stream_data.pts;
+        if (pkt.stream_data.frame_type != AVT_FRAME_TYPE_KEY)
+            return 0;
+        pts = pkt.stream_data.pts;
+        keyframe = true;
+        break;
+    case AVT_PKT_LUT_ICC:
+        pts = pkt.lut_icc.pts;
+        break;
+    case AVT_PKT_STREAM_REGISTRATION:
+    case AVT_PKT_VIDEO_INFO:
+    case AVT_PKT_VIDEO_ORIENTATION:
+        pts = INT64_MIN;
+        break;
+    default:
+        return 0;
+    }
+
+    st = writer_get_stream(w, pkt.stream_id);
+    if (!st)
+        return AVT_ERROR(ENOMEM);
+
+    /* Reconfigurations apply from the last timestamp onwards */
+    if (pts == INT64_MIN)
+        pts = st->last_pts;
+    else
+        st->last_pts = pts;
+
+    st->entries[st->nb_entries] = (AVTIndexEntry) {
+        .index_entry_descriptor = pkt.desc,
+        .pts = pts,
+        .target_seq = pkt.seq,
+    };
+    st->offsets[st->nb_entries++] = off;
+
+    if (st->nb_entries == AVT_INDEX_MAX_ENTRIES)
+        *due = st->id;
+    else if (!keyframe)
+        st->reconfig = true;
+    else if (st->reconfig || st->last_off < 0 ||
+             (off - st->last_off) >= AVT_INDEX_INTERVAL ||
+             (off - st->offsets[0]) >= (INT32_MAX/2))
+        *due = st->id;
+
+    return 0;
+}
+
+int avt_index_writer_pending(AVTIndexWriter *w)
+{
+    for (int i = 0; i < w->nb_streams; i++)
+        if (w->streams[i]->nb_entries)
+            return w->streams[i]->id;
+    return -1;
+}
+
+int avt_index_writer_build(AVTIndexWriter *w, uint16_t stream_id, int64_t off,
+                           union AVTPacketData *pkt, AVTBuffer **pl,
+                           union AVTPacketData *prev, int64_t *prev_off)
+{
+    AVTIndexStream *st = avt_id_map_get(&w->stream_map, stream_id);
+    if (!st || !st->nb_entries)
+        return AVT_ERROR(EINVAL);
+
+    AVTBuffer *buf = avt_buffer_alloc(st->nb_entries*18);
+    if (!buf)
+        return AVT_ERROR(ENOMEM);
+
+    /* Offsets which cannot be signalled are marked as unavailable */
+    for (int i = 0; i < st->nb_entries; i++) {
+        int64_t rel = st->offsets[i] - off;
+        st->entries[i].pkt_offset = (rel >= INT32_MIN && rel <= INT32_MAX) ? rel : 0;
+    }
+
+    size_t len;
+    avt_encode_index_entries(avt_buffer_get_data(buf, &len),
+                             st->entries, st->nb_entries);
+
+    uint32_t dist = 0;
+    if (st->last_off >= 0 && (off - st->last_off) <= UINT32_MAX)
+        dist = off - st->last_off;
+
+    *pkt = AVT_STREAM_INDEX_HDR(
+        .global_seq = w->last_seq,
+        .stream_id = stream_id,
+        .prev_idx = dist,
+        .nb_indices = st->nb_entries,
+    );
+    *pl = buf;
+
+    *prev_off = st->last_off;
+    if (st->last_off >= 0) {
+        *prev = st->last;
+        prev->stream_index.next_idx = dist;
+    }
+
+    st->last = *pkt;
+    st->last_off = off;
+    st->nb_entries = 0;
+    st->reconfig = false;
+
+    return 0;
+}
+
+void avt_index_writer_free(AVTIndexWriter *w)
+{
+    for (int i = 0; i < w->nb_streams; i++)
+        free(w->streams[i]);
+    free(w->streams);
+    avt_id_map_free(&w->stream_map);
+    memset(w, 0, sizeof(*w));
+}
+
+int avt_index_table_add(AVTIndexTable *t, AVTIndexTableEntry e)
+{
+    if (t->nb_entries == t->entries_alloc) {
+        size_t alloc = AVT_MAX(t->entries_alloc << 1, 64);
+        AVTIndexTableEntry *entries = realloc(t->entries, alloc*sizeof(*entries));
+        if (!entries)
+            return AVT_ERROR(ENOMEM);
+        t->entries = entries;
+        t->entries_alloc = alloc;
+    }
+
+    t->entries[t->nb_entries++] = e;
+    t->sorted = false;
+
+    return 0;
+}
+
+static int table_entry_cmp(const void *a, const void *b)
+{
+    const AVTIndexTableEntry *ea = a, *eb = b;
+    if (ea->stream_id != eb->stream_id)
+        return ea->stream_id < eb->stream_id ? -1 : 1;
+    if (ea->pts != eb->pts)
+        return ea->pts < eb->pts ? -1 : 1;
+    if (ea->offset != eb->offset)
+        return ea->offset < eb->offset ? -1 : 1;
+    return 0;
+}
+
+void avt_index_table_sort(AVTIndexTable *t)
+{
+    if (!t->sorted && t->nb_entries)
+        qsort(t->entries, t->nb_entries, sizeof(*t->entries), table_entry_cmp);
+    t->sorted = true;
+}
+
+const AVTIndexTableEntry *avt_index_table_find(AVTIndexTable *t,
+                                               uint16_t stream_id, int64_t pts)
+{
+    avt_index_table_sort(t);
+
+    /* First entry past the target */
+    size_t lo = 0, hi = t->nb_entries;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) >> 1);
+        const AVTIndexTableEntry *e = &t->entries[mid];
+        if (e->stream_id < stream_id ||
+            (e->stream_id == stream_id && e->pts <= pts))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    while (lo--) {
+        const AVTIndexTableEntry *e = &t->entries[lo];
+        if (e->stream_id != stream_id)
+            break;
+        if (e->flags & AVT_INDEX_KEYFRAME)
+            return e;
+    }
+
+    return NULL;
+}
+
+static int read_at(AVTContext *ctx, const AVTIO *io, AVTIOCtx *io_ctx,
+                   int64_t off, size_t len, AVTBuffer **buf)
+{
+    int64_t ret = io->seek(ctx, io_ctx, off);
+    if (ret < 0)
+        return ret;
+
+    *buf = NULL;
+    ret = io->read_input(ctx, io_ctx, buf, len);
+
+    return ret < 0 ? ret : 0;
+}
+
+/* Find the next index packet of a stream, at or after *off.
+ * Returns its size, 0 if there are no more, or a negative error. */
+static int64_t find_index_pkt(AVTContext *ctx, const AVTIO *io, AVTIOCtx *io_ctx,
+                              uint16_t stream_id, int64_t *off)
+{
+    int err;
+    AVTBuffer *buf;
+    union AVTPacketData pkt;
+
+    for (;;) {
+        err = read_at(ctx, io, io_ctx, *off, AVT_MAX_HEADER_LEN, &buf);
+        if (err < 0)
+            return err;
+
+        size_t len = avt_buffer_get_data_len(buf);
+        int64_t size = len ? avt_decode_packet_size(buf, &pkt) : 0;
+        avt_buffer_unref(&buf);
+
+        /* End of file, or truncated */
+        if (!size || size == AVT_ERROR(EAGAIN))
+            return 0;
+        else if (size < 0)
+            return size;
+
+        if (pkt.desc == AVT_PKT_STREAM_INDEX && pkt.stream_id == stream_id)
+            return size;
+
+        *off += size;
+    }
+}
+
+static int load_index_pkt(AVTContext *ctx, AVTIndexTable *t,
+                          const AVTIO *io, AVTIOCtx *io_ctx,
+                          int64_t off, int64_t size, uint32_t *next_idx)
+{
+    int err;
+    AVTBuffer *buf, pl;
+    union AVTPacketData pkt;
+
+    err = read_at(ctx, io, io_ctx, off, size, &buf);
+    if (err < 0)
+        return err;
+
+    int64_t ret = avt_decode_packet(buf, &pkt, &pl);
+    avt_buffer_unref(&buf);
+    if (ret < 0)
+        return ret;
+
+    AVTStreamIndex *idx = &pkt.stream_index;
+    AVTIndexEntry *entries = malloc(idx->nb_indices*sizeof(*entries));
+    if (!entries && idx->nb_indices) {
+        avt_buffer_quick_unref(&pl);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    err = avt_decode_index_entries(&pl, entries, idx->nb_indices);
+    avt_buffer_quick_unref(&pl);
+
+    for (int i = 0; err >= 0 && i < idx->nb_indices; i++) {
+        /* Unavailable */
+        if (!entries[i].pkt_offset)
+            continue;
+
+        /* Only the top byte of stream data descriptors is fixed */
+        bool keyframe = (entries[i].index_entry_descriptor >> 8) ==
+                        ((AVT_PKT_STREAM_DATA & 0xFFFF) >> 8);
+
+        err = avt_index_table_add(t, (AVTIndexTableEntry) {
+            .offset = off + entries[i].pkt_offset,
+            .pts = entries[i].pts,
+            .stream_id = idx->stream_id,
+            .flags = keyframe ? AVT_INDEX_KEYFRAME : AVT_INDEX_RECONFIG,
+        });
+    }
+
+    free(entries);
+    *next_idx = idx->next_idx;
+
+    return err;
+}
+
+int avt_index_table_load(AVTContext *ctx, AVTIndexTable *t,
+                         const AVTIO *io, AVTIOCtx *io_ctx,
+                         uint16_t stream_id)
+{
+    int err;
+    int64_t size, off = 0;
+    uint32_t next_idx;
+
+    if (t->complete || avt_id_map_get(&t->loaded, stream_id))
+        return 0;
+
+    /* next_idx may be inexact, so look from where it points to */
+    while ((size = find_index_pkt(ctx, io, io_ctx, stream_id, &off)) > 0) {
+        err = load_index_pkt(ctx, t, io, io_ctx, off, size, &next_idx);
+        if (err < 0)
+            return err;
+
+        off += next_idx ? next_idx : size;
+    }
+    if (size < 0)
+        return size;
+
+    return avt_id_map_set(&t->loaded, stream_id, t);
+}
+
+int avt_index_table_scan(AVTContext *ctx, AVTIndexTable *t,
+                         const AVTIO *io, AVTIOCtx *io_ctx)
+{
+    int err = 0;
+    int64_t size, off = 0, win_off = 0;
+    size_t win_len = 0;
+    bool eof = false;
+    AVTBuffer *win = NULL;
+    union AVTPacketData pkt;
+
+    /* Reconfigurations apply from the last timestamp of their stream */
+    int64_t *last_pts = calloc(1 << 16, sizeof(*last_pts));
+    if (!last_pts)
+        return AVT_ERROR(ENOMEM);
+
+    for (;;) {
+        /* Refill if the next header is not entirely within the window */
+        if (!win || off >= (win_off + win_len) ||
+            (!eof && (off + AVT_MAX_HEADER_LEN) > (win_off + win_len))) {
+            avt_buffer_unref(&win);
+            err = read_at(ctx, io, io_ctx, off, INDEX_SCAN_WINDOW, &win);
+            if (err < 0)
+                break;
+            win_off = off;
+            win_len = avt_buffer_get_data_len(win);
+            eof = win_len < INDEX_SCAN_WINDOW;
+            if (!win_len)
+                break;
+        }
+
+        AVTBuffer view;
+        size_t view_len = AVT_MIN(win_len - (off - win_off), AVT_MAX_HEADER_LEN);
+        err = avt_buffer_quick_ref(&view, win, off - win_off, view_len);
+        if (err < 0)
+            break;
+
+        size = avt_decode_packet_size(&view, &pkt);
+        avt_buffer_quick_unref(&view);
+
+        /* Truncated */
+        if (size == AVT_ERROR(EAGAIN)) {
+            err = 0;
+            break;
+        } else if (size < 0) {
+            avt_log(ctx, AVT_LOG_ERROR, "Unable to parse packet at offset %" PRIi64
+                    ", index stopped there\n", off);
+            err = 0;
+            break;
+        }
+
+        AVTIndexTableEntry e = {
+            .offset = off,
+            .stream_id = pkt.stream_id,
+        };
+
+        switch (pkt.desc) {
+        case AVT_PKT_STREAM_DATA:
+            last_pts[pkt.stream_id] = pkt.stream_data.pts;
+            if (pkt.stream_data.frame_type == AVT_FRAME_TYPE_KEY) {
+                e.pts = pkt.stream_data.pts;
+                e.flags = AVT_INDEX_KEYFRAME;
+            }
+            break;
+        case AVT_PKT_LUT_ICC:
+        case AVT_PKT_STREAM_REGISTRATION:
+        case AVT_PKT_VIDEO_INFO:
+        case AVT_PKT_VIDEO_ORIENTATION:
+            if (pkt.desc == AVT_PKT_LUT_ICC)
+                last_pts[pkt.stream_id] = pkt.lut_icc.pts;
+            e.pts = last_pts[pkt.stream_id];
+            e.flags = AVT_INDEX_RECONFIG;
+            break;
+        default:
+            break;
+        }
+
+        if (e.flags) {
+            err = avt_index_table_add(t, e);
+            if (err < 0)
+                break;
+        }
+
+        off += size;
+    }
+
+    avt_buffer_unref(&win);
+    free(last_pts);
+
+    if (err >= 0)
+        t->complete = true;
+
+    return err;
+}
+
+static char *sidecar_path(const char *index_path, const char *path)
+{
+    if (index_path)
+        return strdup(index_path);
+
+    size_t len = strlen(path);
+    char *ret = malloc(len + sizeof(".idx"));
+    if (ret) {
+        memcpy(ret, path, len);
+        memcpy(ret + len, ".idx", sizeof(".idx"));
+    }
+
+    return ret;
+}
+
+static int file_size(const char *path, uint64_t *size)
+{
+    struct stat st;
+    if (stat(path, &st) < 0)
+        return AVT_ERROR(errno);
+    *size = st.st_size;
+    return 0;
+}
+
+int avt_index_table_save(AVTIndexTable *t, const char *index_path,
+                         const char *path)
+{
+    int err;
+    uint64_t size = 0;
+    uint8_t hdr[INDEX_SIDECAR_HDR];
+
+    err = file_size(path, &size);
+    if (err < 0)
+        return err;
+
+    avt_index_table_sort(t);
+
+    char *out_path = sidecar_path(index_path, path);
+    if (!out_path)
+        return AVT_ERROR(ENOMEM);
+
+    uint8_t *data = malloc(AVT_MAX(t->nb_entries*INDEX_SIDECAR_ENTRY, 1));
+    if (!data) {
+        free(out_path);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    memcpy(hdr, INDEX_SIDECAR_MAGIC, 8);
+    AVT_WB64(&hdr[8], size);
+    AVT_WB64(&hdr[16], t->nb_entries);
+
+    for (size_t i = 0; i < t->nb_entries; i++) {
+        uint8_t *dst = &data[i*INDEX_SIDECAR_ENTRY];
+        AVT_WB64(&dst[0], t->entries[i].offset);
+        AVT_WB64(&dst[8], t->entries[i].pts);
+        AVT_WB16(&dst[16], t->entries[i].stream_id);
+        AVT_WB16(&dst[18], t->entries[i].flags);
+    }
+
+    FILE *f = fopen(out_path, "wb");
+    if (!f) {
+        err = AVT_ERROR(errno);
+    } else {
+        if (fwrite(hdr, sizeof(hdr), 1, f) != 1 ||
+            (t->nb_entries &&
+             fwrite(data, t->nb_entries*INDEX_SIDECAR_ENTRY, 1, f) != 1))
+            err = AVT_ERROR(EIO);
+        if (fclose(f) && err >= 0)
+            err = AVT_ERROR(errno);
+    }
+
+    free(data);
+    free(out_path);
+    return err;
+}
+
+int avt_index_table_open(AVTIndexTable *t, const char *index_path,
+                         const char *path)
+{
+    int err;
+    uint64_t size = 0;
+    uint8_t hdr[INDEX_SIDECAR_HDR];
+    uint8_t *data = NULL;
+
+    err = file_size(path, &size);
+    if (err < 0)
+        return err;
+
+    char *in_path = sidecar_path(index_path, path);
+    if (!in_path)
+        return AVT_ERROR(ENOMEM);
+
+    FILE *f = fopen(in_path, "rb");
+    free(in_path);
+    if (!f)
+        return AVT_ERROR(errno);
+
+    if (fread(hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr, INDEX_SIDECAR_MAGIC, 8)) {
+        err = AVT_ERROR(EINVAL);
+        goto end;
+    } else if (AVT_RB64(&hdr[8]) != size) {
+        err = AVT_ERROR(ESTALE);
+        goto end;
+    }
+
+    uint64_t nb_entries = AVT_RB64(&hdr[16]);
+    if (nb_entries > (SIZE_MAX / INDEX_SIDECAR_ENTRY)) {
+        err = AVT_ERROR(EINVAL);
+        goto end;
+    }
+
+    data = malloc(AVT_MAX(nb_entries*INDEX_SIDECAR_ENTRY, 1));
+    if (!data) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    if (nb_entries && fread(data, nb_entries*INDEX_SIDECAR_ENTRY, 1, f) != 1) {
+        err = AVT_ERROR(EINVAL);
+        goto end;
+    }
+
+    for (size_t i = 0; i < nb_entries; i++) {
+        uint8_t *src = &data[i*INDEX_SIDECAR_ENTRY];
+        err = avt_index_table_add(t, (AVTIndexTableEntry) {
+            .offset = AVT_RB64(&src[0]),
+            .pts = (int64_t)AVT_RB64(&src[8]),
+            .stream_id = AVT_RB16(&src[16]),
+            .flags = AVT_RB16(&src[18]),
+        });
+        if (err < 0)
+            goto end;
+    }
+
+    t->complete = true;
+
+end:
+    free(data);
+    fclose(f);
+    return err;
+}
+
+int avt_index_file(AVTContext *ctx, const char *path,
+                   const char *index_path)
+{
+    int err;
+    const AVTIO *io;
+    AVTIOCtx *io_ctx;
+    AVTIndexTable t = { 0 };
+
+    AVTAddress addr = {
+        .proto = AVT_PROTOCOL_FILE,
+        .path = (char8_t *)path,
+        .read_only = true,
+    };
+
+    err = avt_io_init(ctx, &io, &io_ctx, &addr);
+    if (err < 0)
+        return err;
+
+    err = avt_index_table_scan(ctx, &t, io, io_ctx);
+    io->close(ctx, &io_ctx);
+
+    if (err >= 0)
+        err = avt_index_table_save(&t, index_path, path);
+
+    avt_index_table_free(&t);
+
+    return err;
+}
+
+void avt_index_table_free(AVTIndexTable *t)
+{
+    free(t->entries);
+    avt_id_map_free(&t->loaded);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AVTRANSPORT_INDEX
+#define AVTRANSPORT_INDEX
+
+#include "common.h"
+#include "buffer.h"
+#include "io_common.h"
+#include "utils_internal.h"
+
+/* A stream gets a new index packet on its next keyframe after this many bytes */
+#define AVT_INDEX_INTERVAL (8 << 20)
+
+/* Maximum number of entries per index packet */
+#define AVT_INDEX_MAX_ENTRIES 64
+
+typedef struct AVTIndexStream {
+    uint16_t id;
+
+    /* Entries not yet written, and the absolute offsets they point to */
+    AVTIndexEntry entries[AVT_INDEX_MAX_ENTRIES];
+    int64_t offsets[AVT_INDEX_MAX_ENTRIES];
+    uint32_t nb_entries;
+
+    int64_t last_pts;
+    bool reconfig;
+
+    /* Last index packet written, for back-patching its next_idx */
+    union AVTPacketData last;
+    int64_t last_off;
+} AVTIndexStream;
+
+typedef struct AVTIndexWriter {
+    AVTIdMap stream_map;
+    AVTIndexStream **streams;
+    int nb_streams;
+
+    uint64_t last_seq;
+} AVTIndexWriter;
+
+/* Record a packet that is about to be written at off.
+ * *due is set to the ID of a stream whose index packet should be written
+ * right after it, or -1 if none is. */
+int avt_index_writer_add(AVTIndexWriter *w, union AVTPacketData pkt,
+                         int64_t off, int *due);
+
+/* Returns the ID of a stream with entries not yet written, or -1 if none */
+int avt_index_writer_pending(AVTIndexWriter *w);
+
+/* Build the index packet for a stream, to be written at off.
+ * The entries are returned as the payload.
+ * If the stream had an index packet before, *prev is set to it with its
+ * next_idx updated, to be rewritten at *prev_off. Otherwise, *prev_off is -1. */
+int avt_index_writer_build(AVTIndexWriter *w, uint16_t stream_id, int64_t off,
+                           union AVTPacketData *pkt, AVTBuffer **pl,
+                           union AVTPacketData *prev, int64_t *prev_off);
+
+void avt_index_writer_free(AVTIndexWriter *w);
+
+/* Seek table, built from index packets, or by scanning a file */
+enum AVTIndexTableFlags {
+    AVT_INDEX_KEYFRAME = 1 << 0,
+    AVT_INDEX_RECONFIG = 1 << 1,
+};
+
+typedef struct AVTIndexTableEntry {
+    uint64_t offset;
+    int64_t pts;
+    uint16_t stream_id;
+    uint16_t flags;
+} AVTIndexTableEntry;
+
+typedef struct AVTIndexTable {
+    AVTIndexTableEntry *entries;
+    size_t nb_entries;
+    size_t entries_alloc;
+    bool sorted;
+
+    /* Streams whose index packets have been loaded */
+    AVTIdMap loaded;
+
+    /* Covers every stream, nothing more to load */
+    bool complete;
+} AVTIndexTable;
+
+int avt_index_table_add(AVTIndexTable *t, AVTIndexTableEntry e);
+
+/* Sort by stream ID, then timestamp, then offset. Done on first lookup. */
+void avt_index_table_sort(AVTIndexTable *t);
+
+/* Find the last keyframe of a stream at or before pts. NULL if none. */
+const AVTIndexTableEntry *avt_index_table_find(AVTIndexTable *t,
+                                               uint16_t stream_id, int64_t pts);
+
+/* Load the entries of all index packets of a stream, starting from
+ * the beginning. Index packets are located by skipping over packets
+ * using their headers, then followed via their next_idx field.
+ * The IO read position is left undefined. */
+int avt_index_table_load(AVTContext *ctx, AVTIndexTable *t,
+                         const AVTIO *io, AVTIOCtx *io_ctx,
+                         uint16_t stream_id);
+
+/* Add the keyframes and reconfigurations of all streams to the table,
+ * by reading through a whole file, using only packet headers. */
+int avt_index_table_scan(AVTContext *ctx, AVTIndexTable *t,
+                         const AVTIO *io, AVTIOCtx *io_ctx);
+
+/* Sidecar index files. If index_path is NULL, the path of the
+ * file indexed with ".idx" appended is used.
+ * Loading fails with AVT_ERROR(ESTALE) if the file's size has changed. */
+int avt_index_table_save(AVTIndexTable *t, const char *index_path,
+                         const char *path);
+int avt_index_table_open(AVTIndexTable *t, const char *index_path,
+                         const char *path);
+
+void avt_index_table_free(AVTIndexTable *t);
+
+#endif /* AVTRANSPORT_INDEX */
@@ -27,19 +27,54 @@
 #include "io_common.h"
 
 extern const AVTIO avt_io_null;
+extern const AVTIO avt_io_mmap;
 extern const AVTIO avt_io_file;
+extern const AVTIO avt_io_file_uring;
+extern const AVTIO avt_io_udp;
+extern const AVTIO avt_io_udp_uring;
 
+/* In order of preference, per type */
 static const AVTIO *avt_io_list[] = {
-    [AVT_IO_NULL] = &avt_io_null,
-    [AVT_IO_FILE] = &avt_io_file,
+    &avt_io_null,
+    &avt_io_mmap,
+#ifdef CONFIG_HAVE_LIBURING
+    &avt_io_file_uring,
+#endif
+    &avt_io_file,
+#ifdef CONFIG_HAVE_LIBURING
+    &avt_io_udp_uring,
+#endif
+    &avt_io_udp,
 };
 
 /* For protocols to call */
 int avt_io_init(AVTContext *ctx, const AVTIO **_io, AVTIOCtx **io_ctx,
                 AVTAddress *addr)
 {
-    const AVTIO *io = avt_io_list[AVT_IO_FILE];
-    int err = io->init(ctx, io_ctx, addr);
-    *_io = io;
+    enum AVTIOType type;
+    switch (addr->proto) {
+    case AVT_PROTOCOL_UDP:
+    case AVT_PROTOCOL_UDP_LITE:
+        type = AVT_IO_SOCKET;
+        break;
+    default:
+        type = AVT_IO_FILE;
+        break;
+    }
+
+    /* Fall back to the next IO of the same type if one fails */
+    int err = AVT_ERROR(ENOTSUP);
+    for (int i = 0; i < AVT_ARRAY_ELEMS(avt_io_list); i++) {
+        const AVTIO *io = avt_io_list[i];
+        if (io->type != type)
+            continue;
+
+        err = io->init(ctx, io_ctx, addr);
+        if (err >= 0) {
+            *_io = io;
+            return err;
+        }
+    }
+
     return err;
 }
@@ -39,13 +39,16 @@ enum AVTIOType {
     AVT_IO_FD,
 };
 
+typedef struct AVTIOVector {
+    uint8_t hdr[AVT_MAX_HEADER_LEN];
+    size_t hdr_len;
+    AVTBuffer *payload;
+} AVTIOVector;
+
+/* Up to IO_MAX_VECTORS packets. The array is owned by the caller. */
 typedef struct AVTIOVectors {
     int nb_vecs;
-    struct {
-        uint8_t hdr[AVT_MAX_HEADER_LEN];
-        size_t hdr_len;
-        AVTBuffer *payload;
-    } vecs [IO_MAX_VECTORS];
+    AVTIOVector *vecs;
 } AVTIOVectors;
 
 /* Low level interface */
@@ -68,7 +71,7 @@ typedef struct AVTIO {
     /* Write multiple packets.
      * Returns positive offset after writing on success, otherwise negative error.
      * May be NULL if unsupported. */
-    int64_t (*write_vec_output)(AVTContext *ctx, AVTIOCtx *io, AVTIOVectors vec);
+    int64_t (*write_vec_output)(AVTContext *ctx, AVTIOCtx *io, AVTIOVectors *vec);
 
     /* Write a single packet to the output.
      * Returns positive offset after writing on success, otherwise negative error. */
@@ -76,9 +79,25 @@ typedef struct AVTIO {
                             uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
                             AVTBuffer *payload);
 
+    /* Overwrite data previously written at an offset, without moving
+     * the write position.
+     * Returns positive offset after writing on success, otherwise negative error.
+     * May be NULL if unsupported. */
+    int64_t (*rewrite_output)(AVTContext *ctx, AVTIOCtx *io, int64_t off,
+                              uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                              AVTBuffer *payload);
+
+    /* Read multiple datagrams at once, waiting for at least one.
+     * bufs[i] may contain several datagrams coalesced, each seg_len[i] long
+     * save for a shorter last one. seg_len[i] == 0 means bufs[i] is one datagram.
+     * Returns the number of buffers filled, otherwise negative error.
+     * May be NULL if unsupported. */
+    int (*read_vec_input)(AVTContext *ctx, AVTIOCtx *io,
+                          AVTBuffer **bufs, size_t *seg_len, int nb_bufs);
+
     /* Read input from IO. May be called with a non-zero buffer, in which
      * case the data in the buffer will be reallocated to 'len', with the
-     * start contents preserved.
+     * start contents preserved. For files, a len of 0 reads everything left.
      * Returns positive offset after reading on success, otherwise negative error. */
     int64_t (*read_input)(AVTContext *ctx, AVTIOCtx *io,
                           AVTBuffer **buf, size_t len);
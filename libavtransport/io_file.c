@@ -29,33 +29,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
 
 #include "io_common.h"
+#include "buffer.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 struct AVTIOCtx {
-    FILE *f;
+    int fd;
     off_t rpos;
     off_t wpos;
-    int is_write;
 };
 
 static int handle_error(AVTIOCtx *io, const char *msg)
 {
     char8_t err_info[256];
-    strerror_s(err_info, sizeof(err_info), errno);
+    int err = errno;
+    strerror_s(err_info, sizeof(err_info), err);
     avt_log(io, AVT_LOG_ERROR, msg, err_info);
-    return AVT_ERROR(errno);
+    return AVT_ERROR(err);
 }
 
 static int file_init(AVTContext *ctx, AVTIOCtx **_io, AVTAddress *addr)
 {
     int ret;
-    AVTIOCtx *io = malloc(sizeof(*io));
+    AVTIOCtx *io = calloc(1, sizeof(*io));
     if (!io)
         return AVT_ERROR(ENOMEM);
 
-    io->f = fopen(addr->path, "w+");
-    if (!io->f) {
+    if (addr->read_only)
+        io->fd = open(addr->path, O_RDONLY | O_CLOEXEC);
+    else
+        io->fd = open(addr->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (io->fd < 0) {
         ret = handle_error(io, "Error opening: %s\n");
         free(io);
         return ret;
@@ -79,17 +92,18 @@ static int64_t file_read_input(AVTContext *ctx, AVTIOCtx *io,
     size_t buf_len, off = 0;
     AVTBuffer *buf = *_buf;
 
-    if (io->is_write) {
-        ret = fseeko(io->f, io->rpos, SEEK_SET);
-        if (ret < 0) {
-            ret = handle_error(io, "Error seeking: %s\n");
-            return ret;
-        }
-        io->is_write = 0;
+    /* Zero means everything left */
+    if (!len) {
+        struct stat st;
+        if (fstat(io->fd, &st) < 0)
+            return handle_error(io, "Error getting file size: %s\n");
+        if (st.st_size <= io->rpos)
+            return AVT_ERROR(ENODATA);
+        len = (buf ? avt_buffer_get_data_len(buf) : 0) + (st.st_size - io->rpos);
     }
 
     if (!buf) {
-        buf = avt_buffer_alloc(len);
+        buf = avt_buffer_pool_get(ctx->buffer_pool, len);
         if (!buf)
             return AVT_ERROR(ENOMEM);
     } else {
@@ -101,69 +115,140 @@ static int64_t file_read_input(AVTContext *ctx, AVTIOCtx *io,
 
     data = avt_buffer_get_data(buf, &buf_len);
     len = AVT_MIN(len, buf_len - off);
-    fread(data + off, 1, len, io->f);
 
-    return (int64_t)(io->rpos = ftello(io->f));
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = pread(io->fd, data + off + got, len - got, io->rpos + got);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0) {
+            ret = handle_error(io, "Error reading: %s\n");
+            if (!*_buf)
+                avt_buffer_unref(&buf);
+            return ret;
+        } else if (!r) {
+            break;
+        }
+        got += r;
+    }
+
+    /* Only return what was actually read */
+    if (got < len)
+        avt_buffer_realloc(buf, off + got);
+
+    *_buf = buf;
+
+    return (int64_t)(io->rpos += got);
+}
+
+/* Write all vectors at *pos, handling partial writes */
+static int64_t file_pwritev_full(AVTIOCtx *io, struct iovec *iov, int nb_iov,
+                                 off_t *pos)
+{
+    while (nb_iov) {
+        ssize_t w = pwritev(io->fd, iov, nb_iov, *pos);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w < 0)
+            return handle_error(io, "Error writing: %s\n");
+
+        *pos += w;
+
+        while (nb_iov && w >= iov->iov_len) {
+            w -= iov->iov_len;
+            iov++;
+            nb_iov--;
+        }
+        if (nb_iov) {
+            iov->iov_base = (uint8_t *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+
+    return (int64_t)*pos;
 }
 
 static int64_t file_write_output(AVTContext *ctx, AVTIOCtx *io,
                                  uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
                                  AVTBuffer *payload)
 {
-    int ret;
     size_t len;
     uint8_t *data = avt_buffer_get_data(payload, &len);
 
-    if (!io->is_write) {
-        ret = fseeko(io->f, io->wpos, SEEK_SET);
-        if (ret < 0) {
-            ret = handle_error(io, "Error seeking: %s\n");
-            return ret;
-        }
-        io->is_write = 1;
-    }
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = hdr_len },
+        { .iov_base = data, .iov_len = len },
+    };
 
-    size_t out = fwrite(hdr, 1, hdr_len, io->f);
-    if (out != hdr_len) {
-        ret = handle_error(io, "Error writing: %s\n");
-        return ret;
-    }
+    return file_pwritev_full(io, iov, 1 + !!len, &io->wpos);
+}
 
-    if (payload) {
-        out = fwrite(data, 1, len, io->f);
-        if (out != len) {
-            ret = handle_error(io, "Error writing: %s\n");
-            return ret;
+static int64_t file_write_vec_output(AVTContext *ctx, AVTIOCtx *io,
+                                     AVTIOVectors *vec)
+{
+    int64_t ret = io->wpos;
+    struct iovec iov[IOV_MAX];
+    int nb_iov = 0;
+
+    for (int i = 0; i < vec->nb_vecs; i++) {
+        AVTIOVector *v = &vec->vecs[i];
+        size_t len;
+        uint8_t *data = avt_buffer_get_data(v->payload, &len);
+
+        if ((nb_iov + 2) > IOV_MAX) {
+            ret = file_pwritev_full(io, iov, nb_iov, &io->wpos);
+            if (ret < 0)
+                return ret;
+            nb_iov = 0;
         }
+
+        iov[nb_iov++] = (struct iovec){ .iov_base = v->hdr, .iov_len = v->hdr_len };
+        if (len)
+            iov[nb_iov++] = (struct iovec){ .iov_base = data, .iov_len = len };
     }
-    fflush(io->f);
 
-    return (int64_t)(io->wpos = ftello(io->f));
+    if (nb_iov)
+        ret = file_pwritev_full(io, iov, nb_iov, &io->wpos);
+
+    return ret;
+}
+
+static int64_t file_rewrite_output(AVTContext *ctx, AVTIOCtx *io, int64_t off,
+                                   uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                   AVTBuffer *payload)
+{
+    size_t len;
+    uint8_t *data = avt_buffer_get_data(payload, &len);
+    off_t pos = off;
+
+    if (off < 0 || (off + hdr_len + len) > io->wpos)
+        return AVT_ERROR(EINVAL);
+
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = hdr_len },
+        { .iov_base = data, .iov_len = len },
+    };
+
+    return file_pwritev_full(io, iov, 1 + !!len, &pos);
 }
 
 static int64_t file_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
 {
-    int ret = fseeko(io->f, (off_t)off, SEEK_SET);
-    if (ret < 0) {
-        ret = handle_error(io, "Error seeking: %s\n");
-        return ret;
-    }
-    io->is_write = 0;
-    return (int64_t)(io->rpos = ftello(io->f));
+    if (off < 0)
+        return AVT_ERROR(EINVAL);
+    return (int64_t)(io->rpos = (off_t)off);
 }
 
 static int file_flush(AVTContext *ctx, AVTIOCtx *io)
 {
-    int ret = fflush(io->f);
-    if (ret)
-        ret = handle_error(io, "Error flushing: %s\n");
-    return ret;
+    /* Writes go directly to the file descriptor */
+    return 0;
 }
 
 static int file_close(AVTContext *ctx, AVTIOCtx **_io)
 {
     AVTIOCtx *io = *_io;
-    int ret = fclose(io->f);
+    int ret = close(io->fd);
     if (ret)
         ret = handle_error(io, "Error closing: %s\n");
 
@@ -178,7 +263,9 @@ const AVTIO avt_io_file = {
     .init = file_init,
     .get_max_pkt_len = file_max_pkt_len,
     .read_input = file_read_input,
+    .write_vec_output = file_write_vec_output,
     .write_output = file_write_output,
+    .rewrite_output = file_rewrite_output,
     .seek = file_seek,
     .flush = file_flush,
     .close = file_close,
@@ -0,0 +1,411 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os_compat.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+
+#include <liburing.h>
+
+#include "io_common.h"
+#include "buffer.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Submission queue size. Each entry writes up to IOV_MAX vectors. */
+#define FURING_SQ_ENTRIES 32
+
+/* Index of the file in the registered file table */
+#define FURING_FD_IDX 0
+
+/* A vectored write in flight, advanced on short writes */
+typedef struct FURingReq {
+    struct iovec *iov;
+    int nb_iov;
+    off_t off;
+} FURingReq;
+
+struct AVTIOCtx {
+    int fd;
+    struct io_uring ring;
+
+    FURingReq req[FURING_SQ_ENTRIES];
+
+    /* Scratch space for write_vec_output, a header and payload per packet */
+    struct iovec iov[2*IO_MAX_VECTORS];
+
+    off_t rpos;
+    off_t wpos;
+};
+
+static int handle_error(AVTContext *ctx, int err, const char *msg)
+{
+    char8_t err_info[256];
+    strerror_s(err_info, sizeof(err_info), -err);
+    avt_log(ctx, AVT_LOG_ERROR, msg, err_info);
+    return err;
+}
+
+static int furing_init(AVTContext *ctx, AVTIOCtx **_io, AVTAddress *addr)
+{
+    int ret;
+    AVTIOCtx *io = calloc(1, sizeof(*io));
+    if (!io)
+        return AVT_ERROR(ENOMEM);
+
+    if (addr->read_only)
+        io->fd = open(addr->path, O_RDONLY | O_CLOEXEC);
+    else
+        io->fd = open(addr->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (io->fd < 0) {
+        ret = handle_error(ctx, AVT_ERROR(errno), "Error opening: %s\n");
+        free(io);
+        return ret;
+    }
+
+    /* On failure, the plain file IO is picked instead */
+    ret = io_uring_queue_init(FURING_SQ_ENTRIES, &io->ring, 0);
+    if (ret < 0) {
+        handle_error(ctx, ret, "io_uring unavailable: %s\n");
+        close(io->fd);
+        free(io);
+        return ret;
+    }
+
+    ret = io_uring_register_files(&io->ring, &io->fd, 1);
+    if (ret < 0) {
+        handle_error(ctx, ret, "io_uring setup failed: %s\n");
+        io_uring_queue_exit(&io->ring);
+        close(io->fd);
+        free(io);
+        return ret;
+    }
+
+    *_io = io;
+
+    return 0;
+}
+
+static uint32_t furing_max_pkt_len(AVTContext *ctx, AVTIOCtx *io)
+{
+    return UINT32_MAX;
+}
+
+static int furing_submit_wait(AVTContext *ctx, AVTIOCtx *io)
+{
+    int ret;
+    do {
+        ret = io_uring_submit_and_wait(&io->ring, 1);
+    } while (ret == -EINTR);
+    if (ret < 0)
+        return handle_error(ctx, ret, "Error submitting: %s\n");
+    return 0;
+}
+
+/* Read len bytes at off, less only at the end of the file */
+static int64_t furing_pread_full(AVTContext *ctx, AVTIOCtx *io,
+                                 uint8_t *data, size_t len, off_t off)
+{
+    size_t got = 0;
+    while (got < len) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+        io_uring_prep_read(sqe, FURING_FD_IDX, data + got,
+                           AVT_MIN(len - got, INT_MAX), off + got);
+        io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+
+        int ret = furing_submit_wait(ctx, io);
+        if (ret < 0)
+            return ret;
+
+        struct io_uring_cqe *cqe;
+        io_uring_peek_cqe(&io->ring, &cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&io->ring, cqe);
+
+        if (res == -EINTR || res == -EAGAIN)
+            continue;
+        else if (res < 0)
+            return handle_error(ctx, res, "Error reading: %s\n");
+        else if (!res)
+            break;
+        got += res;
+    }
+
+    return got;
+}
+
+static int64_t furing_read_input(AVTContext *ctx, AVTIOCtx *io,
+                                 AVTBuffer **_buf, size_t len)
+{
+    int ret;
+    uint8_t *data;
+    size_t buf_len, off = 0;
+    AVTBuffer *buf = *_buf;
+
+    /* Zero means everything left */
+    if (!len) {
+        struct stat st;
+        if (fstat(io->fd, &st) < 0)
+            return handle_error(ctx, AVT_ERROR(errno),
+                                "Error getting file size: %s\n");
+        if (st.st_size <= io->rpos)
+            return AVT_ERROR(ENODATA);
+        len = (buf ? avt_buffer_get_data_len(buf) : 0) + (st.st_size - io->rpos);
+    }
+
+    if (!buf) {
+        buf = avt_buffer_pool_get(ctx->buffer_pool, len);
+        if (!buf)
+            return AVT_ERROR(ENOMEM);
+    } else {
+        off = avt_buffer_get_data_len(buf);
+        ret = avt_buffer_realloc(buf, len);
+        if (ret < 0)
+            return ret;
+    }
+
+    data = avt_buffer_get_data(buf, &buf_len);
+    len = AVT_MIN(len, buf_len - off);
+
+    int64_t got = furing_pread_full(ctx, io, data + off, len, io->rpos);
+    if (got < 0) {
+        if (!*_buf)
+            avt_buffer_unref(&buf);
+        return got;
+    }
+
+    /* Only return what was actually read */
+    if ((size_t)got < len)
+        avt_buffer_realloc(buf, off + got);
+
+    *_buf = buf;
+
+    return (int64_t)(io->rpos += got);
+}
+
+static void furing_prep_write(AVTIOCtx *io, int idx)
+{
+    FURingReq *r = &io->req[idx];
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+    io_uring_prep_writev(sqe, FURING_FD_IDX, r->iov, r->nb_iov, r->off);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+    io_uring_sqe_set_data64(sqe, idx);
+}
+
+/* Submit all queued writes, and wait for them to complete.
+ * Short writes are resubmitted for the rest. */
+static int furing_run_writes(AVTContext *ctx, AVTIOCtx *io, int nb_req)
+{
+    int err = 0;
+    int pending = nb_req;
+
+    for (int i = 0; i < nb_req; i++)
+        furing_prep_write(io, i);
+
+    /* The vectors may live on the caller's stack, so everything in flight
+     * is waited for, even after an error */
+    while (pending) {
+        int ret = furing_submit_wait(ctx, io);
+        if (ret < 0)
+            return ret;
+
+        struct io_uring_cqe *cqe;
+        while (!io_uring_peek_cqe(&io->ring, &cqe)) {
+            int idx = io_uring_cqe_get_data64(cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(&io->ring, cqe);
+
+            FURingReq *r = &io->req[idx];
+            if ((res == -EINTR || res == -EAGAIN) && !err) {
+                furing_prep_write(io, idx);
+                continue;
+            } else if (res <= 0) {
+                if (!err)
+                    err = res < 0 ? res : AVT_ERROR(EIO);
+                pending--;
+                continue;
+            }
+
+            r->off += res;
+            while (r->nb_iov && res >= r->iov->iov_len) {
+                res -= r->iov->iov_len;
+                r->iov++;
+                r->nb_iov--;
+            }
+            if (r->nb_iov) {
+                r->iov->iov_base = (uint8_t *)r->iov->iov_base + res;
+                r->iov->iov_len -= res;
+            }
+
+            if (r->nb_iov && !err)
+                furing_prep_write(io, idx);
+            else
+                pending--;
+        }
+    }
+
+    if (err < 0)
+        return handle_error(ctx, err, "Error writing: %s\n");
+
+    return 0;
+}
+
+/* Write all vectors at *pos, up to IOV_MAX per request, all in flight
+ * at once */
+static int64_t furing_pwritev_full(AVTContext *ctx, AVTIOCtx *io,
+                                   struct iovec *iov, int nb_iov, off_t *pos)
+{
+    int ret;
+    int nb_req = 0;
+    off_t off = *pos;
+
+    while (nb_iov) {
+        if (nb_req == FURING_SQ_ENTRIES) {
+            ret = furing_run_writes(ctx, io, nb_req);
+            if (ret < 0)
+                return ret;
+            nb_req = 0;
+        }
+
+        int n = AVT_MIN(nb_iov, IOV_MAX);
+        io->req[nb_req++] = (FURingReq){ .iov = iov, .nb_iov = n, .off = off };
+        for (int i = 0; i < n; i++)
+            off += iov[i].iov_len;
+
+        iov += n;
+        nb_iov -= n;
+    }
+
+    if (nb_req) {
+        ret = furing_run_writes(ctx, io, nb_req);
+        if (ret < 0)
+            return ret;
+    }
+
+    return (int64_t)(*pos = off);
+}
+
+static int64_t furing_write_output(AVTContext *ctx, AVTIOCtx *io,
+                                   uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                   AVTBuffer *payload)
+{
+    size_t len;
+    uint8_t *data = avt_buffer_get_data(payload, &len);
+
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = hdr_len },
+        { .iov_base = data, .iov_len = len },
+    };
+
+    return furing_pwritev_full(ctx, io, iov, 1 + !!len, &io->wpos);
+}
+
+static int64_t furing_write_vec_output(AVTContext *ctx, AVTIOCtx *io,
+                                       AVTIOVectors *vec)
+{
+    int nb_iov = 0;
+
+    for (int i = 0; i < vec->nb_vecs; i++) {
+        AVTIOVector *v = &vec->vecs[i];
+        size_t len;
+        uint8_t *data = avt_buffer_get_data(v->payload, &len);
+
+        io->iov[nb_iov++] = (struct iovec){ .iov_base = v->hdr, .iov_len = v->hdr_len };
+        if (len)
+            io->iov[nb_iov++] = (struct iovec){ .iov_base = data, .iov_len = len };
+    }
+
+    return furing_pwritev_full(ctx, io, io->iov, nb_iov, &io->wpos);
+}
+
+static int64_t furing_rewrite_output(AVTContext *ctx, AVTIOCtx *io, int64_t off,
+                                     uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                     AVTBuffer *payload)
+{
+    size_t len;
+    uint8_t *data = avt_buffer_get_data(payload, &len);
+    off_t pos = off;
+
+    if (off < 0 || (off + hdr_len + len) > io->wpos)
+        return AVT_ERROR(EINVAL);
+
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = hdr_len },
+        { .iov_base = data, .iov_len = len },
+    };
+
+    return furing_pwritev_full(ctx, io, iov, 1 + !!len, &pos);
+}
+
+static int64_t furing_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
+{
+    if (off < 0)
+        return AVT_ERROR(EINVAL);
+    return (int64_t)(io->rpos = (off_t)off);
+}
+
+static int furing_flush(AVTContext *ctx, AVTIOCtx *io)
+{
+    /* Writes have all completed by the time they return */
+    return 0;
+}
+
+static int furing_close(AVTContext *ctx, AVTIOCtx **_io)
+{
+    AVTIOCtx *io = *_io;
+
+    io_uring_queue_exit(&io->ring);
+
+    int ret = close(io->fd);
+    if (ret)
+        ret = handle_error(ctx, AVT_ERROR(errno), "Error closing: %s\n");
+
+    free(io);
+    *_io = NULL;
+    return ret;
+}
+
+const AVTIO avt_io_file_uring = {
+    .name = "file_uring",
+    .type = AVT_IO_FILE,
+    .init = furing_init,
+    .get_max_pkt_len = furing_max_pkt_len,
+    .read_input = furing_read_input,
+    .write_vec_output = furing_write_vec_output,
+    .write_output = furing_write_output,
+    .rewrite_output = furing_rewrite_output,
+    .seek = furing_seek,
+    .flush = furing_flush,
+    .close = furing_close,
+};
@@ -0,0 +1,234 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os_compat.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "io_common.h"
+#include "buffer.h"
+
+/* How far ahead of the read position to ask the kernel to page in */
+#define MMAP_READAHEAD (8 << 20)
+
+struct AVTIOCtx {
+    int fd;
+
+    /* Covers the entire mapping. Every buffer returned references it,
+     * so the file is only unmapped once all of them are gone. */
+    AVTBuffer *map;
+    uint8_t *data;
+    size_t size;
+
+    size_t page_size;
+    off_t rpos;
+    off_t ra_end;
+};
+
+static int handle_error(AVTIOCtx *io, const char *msg)
+{
+    char8_t err_info[256];
+    int err = errno;
+    strerror_s(err_info, sizeof(err_info), err);
+    avt_log(io, AVT_LOG_ERROR, msg, err_info);
+    return AVT_ERROR(err);
+}
+
+static void mmap_unmap(void *opaque, void *base_data)
+{
+    munmap(base_data, (size_t)(uintptr_t)opaque);
+}
+
+static int mmap_init(AVTContext *ctx, AVTIOCtx **_io, AVTAddress *addr)
+{
+    int ret;
+    struct stat st;
+
+    /* Writers use the regular file IO */
+    if (!addr->read_only)
+        return AVT_ERROR(ENOTSUP);
+
+    AVTIOCtx *io = calloc(1, sizeof(*io));
+    if (!io)
+        return AVT_ERROR(ENOMEM);
+
+    io->fd = open(addr->path, O_RDONLY | O_CLOEXEC);
+    if (io->fd < 0) {
+        ret = handle_error(io, "Error opening: %s\n");
+        goto fail;
+    }
+
+    if (fstat(io->fd, &st) < 0) {
+        ret = handle_error(io, "Error getting file size: %s\n");
+        goto fail;
+    }
+
+    /* Empty files, pipes and devices cannot be mapped */
+    if (!S_ISREG(st.st_mode) || !st.st_size || st.st_size > SIZE_MAX) {
+        ret = AVT_ERROR(ENOTSUP);
+        goto fail;
+    }
+
+    io->size = st.st_size;
+    io->page_size = sysconf(_SC_PAGESIZE);
+
+    /* Writable, as headers get corrected in place. Being a private mapping,
+     * only the pages written to get copied, and the file is left alone. */
+    io->data = mmap(NULL, io->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    io->fd, 0);
+    if (io->data == MAP_FAILED) {
+        ret = handle_error(io, "Error mapping: %s\n");
+        goto fail;
+    }
+
+    io->map = avt_buffer_create(io->data, io->size,
+                                (void *)(uintptr_t)io->size, mmap_unmap);
+    if (!io->map) {
+        munmap(io->data, io->size);
+        ret = AVT_ERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* Demuxing mostly reads front to back. Hints are best-effort. */
+    madvise(io->data, io->size, MADV_SEQUENTIAL);
+
+    *_io = io;
+
+    return 0;
+
+fail:
+    if (io->fd >= 0)
+        close(io->fd);
+    free(io);
+    return ret;
+}
+
+static uint32_t mmap_max_pkt_len(AVTContext *ctx, AVTIOCtx *io)
+{
+    return UINT32_MAX;
+}
+
+/* Keep MMAP_READAHEAD bytes past 'end' paged in */
+static void mmap_readahead(AVTIOCtx *io, off_t end)
+{
+    if ((size_t)io->ra_end >= io->size || (end + MMAP_READAHEAD/2) < io->ra_end)
+        return;
+
+    off_t start = AVT_MAX(io->ra_end, end) & ~((off_t)io->page_size - 1);
+    off_t stop = AVT_MIN(end + MMAP_READAHEAD, (off_t)io->size);
+
+    madvise(io->data + start, stop - start, MADV_WILLNEED);
+    io->ra_end = stop;
+}
+
+static int64_t mmap_read_input(AVTContext *ctx, AVTIOCtx *io,
+                               AVTBuffer **_buf, size_t len)
+{
+    int ret;
+    size_t avail = (size_t)io->rpos < io->size ? io->size - io->rpos : 0;
+
+    /* Zero means everything left */
+    len = !len ? avail : AVT_MIN(len, avail);
+
+    mmap_readahead(io, io->rpos + len);
+
+    if (!*_buf) {
+        size_t off = AVT_MIN((size_t)io->rpos, io->size);
+        AVTBuffer *buf = avt_buffer_reference(io->map, off, len);
+        if (!buf)
+            return AVT_ERROR(ENOMEM);
+        *_buf = buf;
+    } else {
+        /* Appending to an existing buffer needs a copy */
+        size_t off = avt_buffer_get_data_len(*_buf);
+        ret = avt_buffer_realloc(*_buf, off + len);
+        if (ret < 0)
+            return ret;
+
+        size_t buf_len;
+        uint8_t *data = avt_buffer_get_data(*_buf, &buf_len);
+        memcpy(data + off, io->data + io->rpos, len);
+    }
+
+    return (int64_t)(io->rpos += len);
+}
+
+static int64_t mmap_write_output(AVTContext *ctx, AVTIOCtx *io,
+                                 uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                 AVTBuffer *payload)
+{
+    return AVT_ERROR(EBADF);
+}
+
+static int64_t mmap_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
+{
+    if (off < 0)
+        return AVT_ERROR(EINVAL);
+
+    /* Drop the hints after a jump */
+    if (off < io->rpos || off > io->ra_end)
+        io->ra_end = off;
+
+    return (int64_t)(io->rpos = (off_t)off);
+}
+
+static int mmap_flush(AVTContext *ctx, AVTIOCtx *io)
+{
+    return 0;
+}
+
+static int mmap_close(AVTContext *ctx, AVTIOCtx **_io)
+{
+    AVTIOCtx *io = *_io;
+
+    /* Buffers still referencing the mapping keep it alive */
+    avt_buffer_unref(&io->map);
+
+    int ret = close(io->fd);
+    if (ret)
+        ret = handle_error(io, "Error closing: %s\n");
+
+    free(io);
+    *_io = NULL;
+    return ret;
+}
+
+const AVTIO avt_io_mmap = {
+    .name = "mmap",
+    .type = AVT_IO_FILE,
+    .init = mmap_init,
+    .get_max_pkt_len = mmap_max_pkt_len,
+    .read_input = mmap_read_input,
+    .write_output = mmap_write_output,
+    .seek = mmap_seek,
+    .flush = mmap_flush,
+    .close = mmap_close,
+};
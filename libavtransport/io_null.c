@@ -30,6 +30,7 @@
 
 #include "io_common.h"
 #include "utils_internal.h"
+#include "buffer.h"
 #include "bytestream.h"
 #include "../config.h"
 #include "../packet_encode.h"
@@ -73,12 +74,13 @@ static int64_t null_input(AVTContext *ctx, AVTIOCtx *io,
                           AVTBuffer **buf, size_t len)
 {
     avt_assert0(!(*buf));
-    AVTBuffer *hdr_buf = avt_buffer_alloc(AVT_MAX_HEADER_LEN);
+    size_t hdr_len;
+    AVTBuffer *hdr_buf = avt_buffer_pool_get(ctx->buffer_pool, AVT_MAX_HEADER_LEN);
     if (!hdr_buf)
         return AVT_ERROR(ENOMEM);
 
-    uint8_t *hdr = avt_buffer_get_data(hdr_buf, NULL);
-    AVTBytestream bs = avt_bs_init(hdr, AVT_MAX_HEADER_LEN);
+    uint8_t *hdr = avt_buffer_get_data(hdr_buf, &hdr_len);
+    AVTBytestream bs = avt_bs_init(hdr, hdr_len);
 
     union AVTPacketData pkt = { .session_start = {
         .global_seq = atomic_fetch_add(&io->seq, 1ULL) & UINT32_MAX,
@@ -103,6 +105,16 @@ static int64_t null_output(AVTContext *ctx, AVTIOCtx *io,
     return atomic_fetch_add(&io->pos_w, hdr_len + avt_buffer_get_data_len(payload));
 }
 
+static int64_t null_vec_output(AVTContext *ctx, AVTIOCtx *io,
+                               AVTIOVectors *vec)
+{
+    size_t len = 0;
+    for (int i = 0; i < vec->nb_vecs; i++)
+        len += vec->vecs[i].hdr_len + avt_buffer_get_data_len(vec->vecs[i].payload);
+
+    return atomic_fetch_add(&io->pos_w, len) + len;
+}
+
 static int64_t null_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
 {
     return atomic_load(&io->pos_r);
@@ -129,6 +141,7 @@ const AVTIO avt_io_null = {
     .add_dst = null_add_dst,
     .del_dst = null_del_dst,
     .read_input = null_input,
+    .write_vec_output = null_vec_output,
     .write_output = null_output,
     .seek = null_seek,
     .flush = null_flush,
@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os_compat.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+
+#include "io_socket_common.h"
+#include "buffer.h"
+
+#ifndef IPPROTO_UDPLITE
+#define IPPROTO_UDPLITE 136
+#endif
+
+static int handle_error(AVTContext *ctx, const char *msg)
+{
+    char8_t err_info[256];
+    int err = errno;
+    strerror_s(err_info, sizeof(err_info), err);
+    avt_log(ctx, AVT_LOG_ERROR, msg, err_info);
+    return AVT_ERROR(err);
+}
+
+static void addr_to_sockaddr(struct sockaddr_in6 *sa, AVTAddress *addr)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->sin6_family = AF_INET6;
+    sa->sin6_port = htons(addr->port);
+    memcpy(&sa->sin6_addr, addr->ip, sizeof(addr->ip));
+    if (addr->interface)
+        sa->sin6_scope_id = if_nametoindex((const char *)addr->interface);
+}
+
+static uint32_t socket_get_mtu(AVTSocketCommon *sc)
+{
+    int mtu = 0;
+    socklen_t mtu_len = sizeof(mtu);
+
+    /* IPv6 header + UDP header */
+    int overhead = 40 + 8;
+    if (IN6_IS_ADDR_V4MAPPED(&sc->peer.sin6_addr))
+        overhead = 20 + 8;
+
+    /* Only known when connected. Otherwise, IPv6's minimum MTU is safe. */
+    if (sc->passive ||
+        getsockopt(sc->fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &mtu_len) < 0 ||
+        mtu <= overhead)
+        mtu = 1280;
+
+    return AVT_MIN(mtu - overhead, UDP_MAX_DATAGRAM);
+}
+
+int avt_socket_open(AVTContext *ctx, AVTSocketCommon *sc, AVTAddress *addr)
+{
+    int ret;
+
+    int proto = addr->proto == AVT_PROTOCOL_UDP_LITE ? IPPROTO_UDPLITE : IPPROTO_UDP;
+    sc->fd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, proto);
+    if (sc->fd < 0)
+        return handle_error(ctx, "Error opening socket: %s\n");
+
+    /* Allow IPv4-mapped addresses */
+    int v6only = 0;
+    setsockopt(sc->fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+
+    addr_to_sockaddr(&sc->peer, addr);
+
+    sc->passive = addr->mode == AVT_MODE_PASSIVE;
+    if (sc->passive) {
+        ret = bind(sc->fd, (struct sockaddr *)&sc->peer, sizeof(sc->peer));
+    } else {
+        ret = connect(sc->fd, (struct sockaddr *)&sc->peer, sizeof(sc->peer));
+        sc->have_peer = true;
+    }
+    if (ret < 0) {
+        ret = handle_error(ctx, "Error binding/connecting socket: %s\n");
+        close(sc->fd);
+        sc->fd = -1;
+        return ret;
+    }
+
+    if (sc->passive)
+        memset(&sc->peer, 0, sizeof(sc->peer));
+
+    sc->max_pkt_len = socket_get_mtu(sc);
+
+    return 0;
+}
+
+int avt_socket_close(AVTContext *ctx, AVTSocketCommon *sc)
+{
+    int ret = 0;
+    if (sc->fd >= 0 && close(sc->fd))
+        ret = handle_error(ctx, "Error closing socket: %s\n");
+    sc->fd = -1;
+    return ret;
+}
+
+bool avt_socket_gso(AVTSocketCommon *sc, AVTAddress *addr)
+{
+    /* UDP-Lite has no segmentation offload */
+    int gso_size = 0;
+    socklen_t gso_len = sizeof(gso_size);
+    return addr->proto == AVT_PROTOCOL_UDP &&
+           !getsockopt(sc->fd, IPPROTO_UDP, UDP_SEGMENT, &gso_size, &gso_len);
+}
+
+/* Pages touched by a packet, its header may straddle two */
+static int udp_zc_frags(AVTIOVector *v)
+{
+    size_t len;
+    uintptr_t data = (uintptr_t)avt_buffer_get_data(v->payload, &len);
+    if (!len)
+        return 2;
+    return 2 + (data + len - 1)/UDP_ZC_PAGE_SIZE - data/UDP_ZC_PAGE_SIZE + 1;
+}
+
+int avt_udp_gso_run(AVTIOVector *vecs, int nb, size_t *seg, bool zerocopy)
+{
+    size_t seg_len = vecs[0].hdr_len + avt_buffer_get_data_len(vecs[0].payload);
+    size_t total = seg_len;
+    int max = AVT_MIN(UDP_MAX_SEGMENTS, UDP_MAX_DATAGRAM / seg_len);
+    int frags = zerocopy ? udp_zc_frags(&vecs[0]) : 0;
+    int n = 1;
+
+    /* All segments are equally sized, save for a shorter last one */
+    while (n < AVT_MIN(nb, max)) {
+        size_t len = vecs[n].hdr_len + avt_buffer_get_data_len(vecs[n].payload);
+        if (len > seg_len || (total + len) > UDP_MAX_DATAGRAM)
+            break;
+        if (zerocopy) {
+            frags += udp_zc_frags(&vecs[n]);
+            if (frags > UDP_ZC_MAX_FRAGS)
+                break;
+        }
+        total += len;
+        n++;
+        if (len < seg_len)
+            break;
+    }
+
+    *seg = seg_len;
+    return n;
+}
+
+void avt_udp_gso_control(struct msghdr *m, UDPControl *ctrl, size_t seg_len)
+{
+    m->msg_control = ctrl->buf;
+    m->msg_controllen = sizeof(ctrl->buf);
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(m);
+    cm->cmsg_level = IPPROTO_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gso_size = seg_len;
+    memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AVTRANSPORT_IO_SOCKET_COMMON
+#define AVTRANSPORT_IO_SOCKET_COMMON
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "io_common.h"
+
+/* Largest possible UDP payload */
+#define UDP_MAX_DATAGRAM 65507
+
+/* Segments per GSO send, kernel limit */
+#define UDP_MAX_SEGMENTS 64
+
+/* Zerocopy sends are limited by the number of pages a single skb can
+ * reference (MAX_SKB_FRAGS). Pages are assumed to be 4KiB. */
+#define UDP_ZC_MAX_FRAGS 17
+#define UDP_ZC_PAGE_SIZE 4096
+
+/* Control message carrying the GSO segment size */
+typedef union UDPControl {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+} UDPControl;
+
+/* State shared between the socket IOs */
+typedef struct AVTSocketCommon {
+    int fd;
+    bool passive;
+
+    /* Destination when active, last sender when passive */
+    struct sockaddr_in6 peer;
+    bool have_peer;
+
+    uint32_t max_pkt_len;
+} AVTSocketCommon;
+
+/* Open, and bind or connect a UDP or UDP-Lite socket */
+int avt_socket_open(AVTContext *ctx, AVTSocketCommon *sc, AVTAddress *addr);
+
+/* Close the socket */
+int avt_socket_close(AVTContext *ctx, AVTSocketCommon *sc);
+
+/* Whether the socket can send with UDP segmentation offload */
+bool avt_socket_gso(AVTSocketCommon *sc, AVTAddress *addr);
+
+/* Number of packets, starting at vecs[0], that can go out as one GSO send.
+ * seg is set to the size of their segments. */
+int avt_udp_gso_run(AVTIOVector *vecs, int nb, size_t *seg, bool zerocopy);
+
+/* Attach the segment size of a GSO send to a message */
+void avt_udp_gso_control(struct msghdr *m, UDPControl *ctrl, size_t seg_len);
+
+#endif /* AVTRANSPORT_IO_SOCKET_COMMON */
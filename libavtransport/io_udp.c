@@ -0,0 +1,607 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os_compat.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/udp.h>
+#include <linux/errqueue.h>
+
+#include "io_socket_common.h"
+#include "buffer.h"
+
+/* Payload references held for zerocopy before waiting on the kernel */
+#define UDP_ZC_MAX_PENDING 4096
+
+/* Receive buffers, large enough for a whole coalesced (GRO) datagram */
+#define UDP_RX_BUF_SIZE 65535
+
+/* Received datagrams smaller than this are copied out, rather than
+ * holding onto a whole receive buffer */
+#define UDP_RX_COPY_THRESHOLD (UDP_RX_BUF_SIZE >> 2)
+
+typedef union UDPRxControl {
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+} UDPRxControl;
+
+/* A buffer the kernel may still be reading from */
+typedef struct UDPZCRef {
+    uint32_t id;
+    AVTBuffer *buf;
+} UDPZCRef;
+
+struct AVTIOCtx {
+    AVTSocketCommon sc;
+
+    int64_t rpos;
+    int64_t wpos;
+
+    /* Send runs of equally sized datagrams in a single UDP_SEGMENT call */
+    bool gso;
+
+    /* MSG_ZEROCOPY state. Every successful send gets an ID, which the
+     * kernel returns on the error queue once it no longer needs the data. */
+    bool zerocopy;
+    uint32_t zc_next_id;
+    UDPZCRef *zc_refs;
+    unsigned int zc_head;
+    unsigned int zc_nb;
+    unsigned int zc_alloc;
+
+    /* Scratch space for sendmmsg() */
+    struct mmsghdr *msg;
+    struct iovec *iov;
+    UDPControl *ctrl;
+    int nb_msg_alloc;
+
+    /* Receive datagrams coalesced by the kernel */
+    bool gro;
+
+    /* Scratch space for recvmmsg(). Buffers not filled are kept. */
+    struct mmsghdr *rx_msg;
+    struct iovec *rx_iov;
+    UDPRxControl *rx_ctrl;
+    struct sockaddr_in6 *rx_src;
+    AVTBuffer **rx_bufs;
+    int nb_rx_alloc;
+};
+
+static int handle_error(AVTIOCtx *io, const char *msg)
+{
+    char8_t err_info[256];
+    int err = errno;
+    strerror_s(err_info, sizeof(err_info), err);
+    avt_log(io, AVT_LOG_ERROR, msg, err_info);
+    return AVT_ERROR(err);
+}
+
+static int udp_init(AVTContext *ctx, AVTIOCtx **_io, AVTAddress *addr)
+{
+    AVTIOCtx *io = calloc(1, sizeof(*io));
+    if (!io)
+        return AVT_ERROR(ENOMEM);
+
+    int ret = avt_socket_open(ctx, &io->sc, addr);
+    if (ret < 0) {
+        free(io);
+        return ret;
+    }
+
+    io->gso = avt_socket_gso(&io->sc, addr);
+
+    int one = 1;
+    io->gro = addr->proto == AVT_PROTOCOL_UDP &&
+              !setsockopt(io->sc.fd, IPPROTO_UDP, UDP_GRO, &one, sizeof(one));
+
+    if (addr->zerocopy) {
+        io->zerocopy = !setsockopt(io->sc.fd, SOL_SOCKET, SO_ZEROCOPY,
+                                   &one, sizeof(one));
+        if (!io->zerocopy)
+            avt_log(ctx, AVT_LOG_WARN, "Zerocopy unsupported, copying\n");
+    }
+
+    *_io = io;
+
+    return 0;
+}
+
+static uint32_t udp_max_pkt_len(AVTContext *ctx, AVTIOCtx *io)
+{
+    return io->sc.max_pkt_len;
+}
+
+static int64_t udp_read_input(AVTContext *ctx, AVTIOCtx *io,
+                              AVTBuffer **_buf, size_t len)
+{
+    int ret;
+    uint8_t *data;
+    size_t buf_len, off = 0;
+    AVTBuffer *buf = *_buf;
+
+    /* Datagrams are read whole */
+    len = len ? AVT_MIN(len, UDP_MAX_DATAGRAM) : UDP_MAX_DATAGRAM;
+
+    if (!buf) {
+        buf = avt_buffer_pool_get(ctx->buffer_pool, len);
+        if (!buf)
+            return AVT_ERROR(ENOMEM);
+    } else {
+        off = avt_buffer_get_data_len(buf);
+        ret = avt_buffer_realloc(buf, off + len);
+        if (ret < 0)
+            return ret;
+    }
+
+    data = avt_buffer_get_data(buf, &buf_len);
+
+    struct sockaddr_in6 src;
+    socklen_t src_len = sizeof(src);
+    ssize_t r;
+    do {
+        r = recvfrom(io->sc.fd, data + off, len, 0, (struct sockaddr *)&src, &src_len);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+        ret = handle_error(io, "Error receiving: %s\n");
+        if (!*_buf)
+            avt_buffer_unref(&buf);
+        return ret;
+    }
+
+    if (io->sc.passive) {
+        io->sc.peer = src;
+        io->sc.have_peer = true;
+    }
+
+    avt_buffer_realloc(buf, off + r);
+    *_buf = buf;
+
+    return (io->rpos += r);
+}
+
+static int udp_alloc_rx(AVTIOCtx *io, int nb)
+{
+    if (nb <= io->nb_rx_alloc)
+        return 0;
+
+    struct mmsghdr *msg = realloc(io->rx_msg, nb*sizeof(*msg));
+    if (!msg)
+        return AVT_ERROR(ENOMEM);
+    io->rx_msg = msg;
+
+    struct iovec *iov = realloc(io->rx_iov, nb*sizeof(*iov));
+    if (!iov)
+        return AVT_ERROR(ENOMEM);
+    io->rx_iov = iov;
+
+    UDPRxControl *ctrl = realloc(io->rx_ctrl, nb*sizeof(*ctrl));
+    if (!ctrl)
+        return AVT_ERROR(ENOMEM);
+    io->rx_ctrl = ctrl;
+
+    struct sockaddr_in6 *src = realloc(io->rx_src, nb*sizeof(*src));
+    if (!src)
+        return AVT_ERROR(ENOMEM);
+    io->rx_src = src;
+
+    AVTBuffer **bufs = realloc(io->rx_bufs, nb*sizeof(*bufs));
+    if (!bufs)
+        return AVT_ERROR(ENOMEM);
+    for (int i = io->nb_rx_alloc; i < nb; i++)
+        bufs[i] = NULL;
+    io->rx_bufs = bufs;
+
+    io->nb_rx_alloc = nb;
+
+    return 0;
+}
+
+static int udp_read_vec_input(AVTContext *ctx, AVTIOCtx *io,
+                              AVTBuffer **bufs, size_t *seg_len, int nb_bufs)
+{
+    int ret = udp_alloc_rx(io, nb_bufs);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < nb_bufs; i++) {
+        size_t len;
+        if (!io->rx_bufs[i]) {
+            io->rx_bufs[i] = avt_buffer_pool_get(ctx->buffer_pool, UDP_RX_BUF_SIZE);
+            if (!io->rx_bufs[i])
+                return AVT_ERROR(ENOMEM);
+        }
+
+        io->rx_iov[i] = (struct iovec){
+            .iov_base = avt_buffer_get_data(io->rx_bufs[i], &len),
+            .iov_len = UDP_RX_BUF_SIZE,
+        };
+        io->rx_msg[i] = (struct mmsghdr){ .msg_hdr = {
+            .msg_name = &io->rx_src[i],
+            .msg_namelen = sizeof(io->rx_src[i]),
+            .msg_iov = &io->rx_iov[i],
+            .msg_iovlen = 1,
+            .msg_control = io->gro ? io->rx_ctrl[i].buf : NULL,
+            .msg_controllen = io->gro ? sizeof(io->rx_ctrl[i].buf) : 0,
+        }};
+    }
+
+    int n;
+    do {
+        n = recvmmsg(io->sc.fd, io->rx_msg, nb_bufs, MSG_WAITFORONE, NULL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return handle_error(io, "Error receiving: %s\n");
+
+    int nb_out = 0;
+    for (int i = 0; i < n; i++) {
+        struct msghdr *m = &io->rx_msg[i].msg_hdr;
+        size_t len = io->rx_msg[i].msg_len;
+
+        if (m->msg_flags & MSG_TRUNC)
+            continue;
+
+        size_t seg = 0;
+        if (io->gro) {
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm)) {
+                if (cm->cmsg_level == IPPROTO_UDP && cm->cmsg_type == UDP_GRO) {
+                    int gso_size;
+                    memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+                    seg = gso_size < len ? gso_size : 0;
+                }
+            }
+        }
+
+        AVTBuffer *buf;
+        if (!seg && len < UDP_RX_COPY_THRESHOLD) {
+            size_t buf_len;
+            buf = avt_buffer_pool_get(ctx->buffer_pool, len);
+            if (!buf) {
+                ret = AVT_ERROR(ENOMEM);
+                break;
+            }
+            memcpy(avt_buffer_get_data(buf, &buf_len), io->rx_iov[i].iov_base, len);
+        } else {
+            buf = io->rx_bufs[i];
+            io->rx_bufs[i] = NULL;
+            avt_buffer_realloc(buf, len);
+        }
+
+        bufs[nb_out] = buf;
+        seg_len[nb_out] = seg;
+        nb_out++;
+
+        io->rpos += len;
+    }
+
+    if (io->sc.passive && n) {
+        io->sc.peer = io->rx_src[n - 1];
+        io->sc.have_peer = true;
+    }
+
+    if (ret < 0) {
+        for (int i = 0; i < nb_out; i++)
+            avt_buffer_unref(&bufs[i]);
+        return ret;
+    }
+
+    return nb_out;
+}
+
+static int udp_alloc_msgs(AVTIOCtx *io, int nb)
+{
+    if (nb <= io->nb_msg_alloc)
+        return 0;
+
+    struct mmsghdr *msg = realloc(io->msg, nb*sizeof(*msg));
+    if (!msg)
+        return AVT_ERROR(ENOMEM);
+    io->msg = msg;
+
+    struct iovec *iov = realloc(io->iov, 2*nb*sizeof(*iov));
+    if (!iov)
+        return AVT_ERROR(ENOMEM);
+    io->iov = iov;
+
+    UDPControl *ctrl = realloc(io->ctrl, nb*sizeof(*ctrl));
+    if (!ctrl)
+        return AVT_ERROR(ENOMEM);
+    io->ctrl = ctrl;
+
+    io->nb_msg_alloc = nb;
+
+    return 0;
+}
+
+static int udp_zc_hold(AVTIOCtx *io, AVTBuffer *buf, uint32_t id)
+{
+    if (io->zc_nb == io->zc_alloc) {
+        unsigned int alloc = io->zc_alloc ? io->zc_alloc << 1 : 64;
+        UDPZCRef *refs = malloc(alloc*sizeof(*refs));
+        if (!refs)
+            return AVT_ERROR(ENOMEM);
+
+        /* Unwrap */
+        for (unsigned int i = 0; i < io->zc_nb; i++)
+            refs[i] = io->zc_refs[(io->zc_head + i) & (io->zc_alloc - 1)];
+
+        free(io->zc_refs);
+        io->zc_refs = refs;
+        io->zc_head = 0;
+        io->zc_alloc = alloc;
+    }
+
+    UDPZCRef *r = &io->zc_refs[(io->zc_head + io->zc_nb++) & (io->zc_alloc - 1)];
+    r->id = id;
+    r->buf = buf;
+
+    return 0;
+}
+
+/* Release everything the kernel is done with. Blocks until at least one
+ * completion arrives if wait is set. */
+static int udp_zc_reap(AVTContext *ctx, AVTIOCtx *io, bool wait)
+{
+    while (io->zc_nb) {
+        union {
+            char buf[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                     CMSG_SPACE(sizeof(struct sockaddr_in6))];
+            struct cmsghdr align;
+        } ctrl;
+        struct msghdr msg = {
+            .msg_control = ctrl.buf,
+            .msg_controllen = sizeof(ctrl.buf),
+        };
+
+        if (recvmsg(io->sc.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR)
+                continue;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return handle_error(io, "Error reading completions: %s\n");
+            else if (!wait)
+                break;
+
+            struct pollfd pfd = { .fd = io->sc.fd, .events = 0 };
+            if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                return handle_error(io, "Error waiting on completions: %s\n");
+            continue;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            struct sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cm), sizeof(serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno)
+                continue;
+
+            /* Completions cover the range [ee_info, ee_data] */
+            while (io->zc_nb) {
+                UDPZCRef *r = &io->zc_refs[io->zc_head];
+                if ((int32_t)(r->id - serr.ee_data) > 0)
+                    break;
+                avt_buffer_unref(&r->buf);
+                io->zc_head = (io->zc_head + 1) & (io->zc_alloc - 1);
+                io->zc_nb--;
+            }
+
+            /* The kernel copied the data anyway, e.g. over loopback */
+            if ((serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && io->zerocopy) {
+                avt_log(ctx, AVT_LOG_VERBOSE, "Zerocopy sends got copied, disabling\n");
+                io->zerocopy = false;
+            }
+        }
+
+        wait = false;
+    }
+
+    return 0;
+}
+
+static int64_t udp_write_vec_output(AVTContext *ctx, AVTIOCtx *io,
+                                    AVTIOVectors *vec)
+{
+    int ret;
+    AVTBuffer *hdrs = NULL;
+
+    if (!io->sc.have_peer)
+        return AVT_ERROR(ENOTCONN);
+
+    ret = udp_alloc_msgs(io, vec->nb_vecs);
+    if (ret < 0)
+        return ret;
+
+    /* The kernel reads headers after returning too, so they need to live
+     * in a buffer that can be held on to */
+    bool zerocopy = io->zerocopy;
+    uint8_t *hdr_dst = NULL;
+    if (zerocopy) {
+        size_t hdrs_len;
+        hdrs = avt_buffer_pool_get(ctx->buffer_pool,
+                                   vec->nb_vecs*AVT_MAX_HEADER_LEN);
+        if (!hdrs)
+            return AVT_ERROR(ENOMEM);
+        hdr_dst = avt_buffer_get_data(hdrs, &hdrs_len);
+    }
+
+    /* Build messages, one per datagram, or one per run with GSO */
+    int nb_msg = 0;
+    struct iovec *iov = io->iov;
+    for (int i = 0; i < vec->nb_vecs;) {
+        size_t seg_len = 0;
+        int n = io->gso ? avt_udp_gso_run(&vec->vecs[i], vec->nb_vecs - i, &seg_len, zerocopy) : 1;
+
+        struct msghdr *m = &io->msg[nb_msg].msg_hdr;
+        *m = (struct msghdr){
+            .msg_name = io->sc.passive ? &io->sc.peer : NULL,
+            .msg_namelen = io->sc.passive ? sizeof(io->sc.peer) : 0,
+            .msg_iov = iov,
+        };
+
+        for (int j = 0; j < n; j++) {
+            AVTIOVector *v = &vec->vecs[i + j];
+            size_t len;
+            uint8_t *data = avt_buffer_get_data(v->payload, &len);
+            uint8_t *hdr = v->hdr;
+
+            if (zerocopy) {
+                hdr = memcpy(hdr_dst, v->hdr, v->hdr_len);
+                hdr_dst += v->hdr_len;
+            }
+
+            *iov++ = (struct iovec){ .iov_base = hdr, .iov_len = v->hdr_len };
+            if (len)
+                *iov++ = (struct iovec){ .iov_base = data, .iov_len = len };
+        }
+        m->msg_iovlen = iov - m->msg_iov;
+
+        if (n > 1)
+            avt_udp_gso_control(m, &io->ctrl[nb_msg], seg_len);
+
+        nb_msg++;
+        i += n;
+    }
+
+    int sent = 0;
+    while (sent < nb_msg) {
+        int n = sendmmsg(io->sc.fd, &io->msg[sent], nb_msg - sent,
+                         zerocopy ? MSG_ZEROCOPY : 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            ret = handle_error(io, "Error sending: %s\n");
+            break;
+        }
+
+        for (int i = 0; i < n; i++)
+            io->wpos += io->msg[sent + i].msg_len;
+        sent += n;
+    }
+
+    if (!zerocopy)
+        return ret < 0 ? ret : io->wpos;
+
+    /* Each message sent got an ID. Hold everything until the last one
+     * completes. */
+    if (sent) {
+        uint32_t last_id = io->zc_next_id + sent - 1;
+        io->zc_next_id += sent;
+
+        int err = udp_zc_hold(io, hdrs, last_id);
+        if (err >= 0)
+            hdrs = NULL;
+        for (int i = 0; !err && i < vec->nb_vecs; i++) {
+            AVTBuffer *pl = vec->vecs[i].payload;
+            if (!avt_buffer_get_data_len(pl))
+                continue;
+            AVTBuffer *ref = avt_buffer_reference(pl, 0, 0);
+            err = ref ? udp_zc_hold(io, ref, last_id) : AVT_ERROR(ENOMEM);
+            if (err < 0)
+                avt_buffer_unref(&ref);
+        }
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
+    avt_buffer_unref(&hdrs);
+
+    int err = udp_zc_reap(ctx, io, io->zc_nb > UDP_ZC_MAX_PENDING);
+    if (err < 0 && ret >= 0)
+        ret = err;
+
+    return ret < 0 ? ret : io->wpos;
+}
+
+static int64_t udp_write_output(AVTContext *ctx, AVTIOCtx *io,
+                                uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                AVTBuffer *payload)
+{
+    AVTIOVector v = {
+        .hdr_len = hdr_len,
+        .payload = payload,
+    };
+    memcpy(v.hdr, hdr, hdr_len);
+
+    AVTIOVectors vec = { .nb_vecs = 1, .vecs = &v };
+    return udp_write_vec_output(ctx, io, &vec);
+}
+
+static int udp_flush(AVTContext *ctx, AVTIOCtx *io)
+{
+    return udp_zc_reap(ctx, io, false);
+}
+
+static int64_t udp_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
+{
+    return AVT_ERROR(ESPIPE);
+}
+
+static int udp_close(AVTContext *ctx, AVTIOCtx **_io)
+{
+    AVTIOCtx *io = *_io;
+    int ret = avt_socket_close(ctx, &io->sc);
+
+    /* Pages in flight stay pinned by the kernel, safe to let go */
+    while (io->zc_nb) {
+        avt_buffer_unref(&io->zc_refs[io->zc_head].buf);
+        io->zc_head = (io->zc_head + 1) & (io->zc_alloc - 1);
+        io->zc_nb--;
+    }
+    free(io->zc_refs);
+    free(io->ctrl);
+
+    for (int i = 0; i < io->nb_rx_alloc; i++)
+        avt_buffer_unref(&io->rx_bufs[i]);
+    free(io->rx_bufs);
+    free(io->rx_msg);
+    free(io->rx_iov);
+    free(io->rx_ctrl);
+    free(io->rx_src);
+
+    free(io->msg);
+    free(io->iov);
+    free(io);
+    *_io = NULL;
+    return ret;
+}
+
+const AVTIO avt_io_udp = {
+    .name = "udp",
+    .type = AVT_IO_SOCKET,
+    .init = udp_init,
+    .get_max_pkt_len = udp_max_pkt_len,
+    .read_input = udp_read_input,
+    .read_vec_input = udp_read_vec_input,
+    .write_vec_output = udp_write_vec_output,
+    .write_output = udp_write_output,
+    .seek = udp_seek,
+    .flush = udp_flush,
+    .close = udp_close,
+};
@@ -0,0 +1,546 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "os_compat.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <liburing.h>
+
+#include "io_socket_common.h"
+#include "buffer.h"
+
+/* Submission queue size. Buckets larger than this are sent in chunks. */
+#define URING_SQ_ENTRIES 256
+
+/* Provided receive buffers, must be a power of two */
+#define URING_RX_ENTRIES 64
+/* Rounded up, so that every buffer's io_uring_recvmsg_out is aligned */
+#define URING_RX_BUF_SIZE ((UDP_MAX_DATAGRAM + sizeof(struct io_uring_recvmsg_out) + \
+                            sizeof(struct sockaddr_in6) + 63) & ~((size_t)63))
+#define URING_RX_BGID 0
+
+/* Datagrams received while waiting on sends */
+#define URING_RX_QUEUE 64
+
+/* Index of the socket in the registered file table */
+#define URING_FD_IDX 0
+
+enum URingTag {
+    URING_TAG_SEND = 1,
+    URING_TAG_RECV,
+};
+
+typedef struct URingRxPacket {
+    AVTBuffer *buf;
+    struct sockaddr_in6 src;
+} URingRxPacket;
+
+struct AVTIOCtx {
+    AVTSocketCommon sc;
+    struct io_uring ring;
+
+    /* Receiving */
+    struct io_uring_buf_ring *br;
+    uint8_t *rx_bufs;
+    struct msghdr rx_msg;
+    bool rx_armed;
+
+    URingRxPacket rx_queue[URING_RX_QUEUE];
+    int rx_head;
+    int rx_nb;
+    uint64_t rx_dropped;
+
+    /* Sending, with runs of equally sized datagrams in one message
+     * when segmentation offload is available */
+    bool gso;
+    struct msghdr *msg;
+    struct iovec *iov;
+    UDPControl *ctrl;
+    int nb_msg_alloc;
+    int inflight;
+    int tx_err;
+
+    int64_t rpos;
+    int64_t wpos;
+};
+
+static int handle_error(AVTContext *ctx, int err, const char *msg)
+{
+    char8_t err_info[256];
+    strerror_s(err_info, sizeof(err_info), -err);
+    avt_log(ctx, AVT_LOG_ERROR, msg, err_info);
+    return err;
+}
+
+static int uring_init(AVTContext *ctx, AVTIOCtx **_io, AVTAddress *addr)
+{
+    int ret;
+
+    /* Zerocopy is only implemented in the socket IO, which is picked instead */
+    if (addr->zerocopy)
+        return AVT_ERROR(ENOTSUP);
+
+    AVTIOCtx *io = calloc(1, sizeof(*io));
+    if (!io)
+        return AVT_ERROR(ENOMEM);
+
+    ret = avt_socket_open(ctx, &io->sc, addr);
+    if (ret < 0) {
+        free(io);
+        return ret;
+    }
+
+    io->gso = avt_socket_gso(&io->sc, addr);
+
+    ret = io_uring_queue_init(URING_SQ_ENTRIES, &io->ring, 0);
+    if (ret < 0) {
+        handle_error(ctx, ret, "io_uring unavailable: %s\n");
+        avt_socket_close(ctx, &io->sc);
+        free(io);
+        return ret;
+    }
+
+    ret = io_uring_register_files(&io->ring, &io->sc.fd, 1);
+    if (ret < 0)
+        goto fail;
+
+    /* Registered ring of receive buffers, picked by the kernel */
+    io->rx_bufs = malloc(URING_RX_ENTRIES*URING_RX_BUF_SIZE);
+    if (!io->rx_bufs) {
+        ret = AVT_ERROR(ENOMEM);
+        goto fail;
+    }
+
+    io->br = io_uring_setup_buf_ring(&io->ring, URING_RX_ENTRIES, URING_RX_BGID,
+                                     0, &ret);
+    if (!io->br)
+        goto fail;
+
+    int mask = io_uring_buf_ring_mask(URING_RX_ENTRIES);
+    for (int i = 0; i < URING_RX_ENTRIES; i++)
+        io_uring_buf_ring_add(io->br, io->rx_bufs + i*URING_RX_BUF_SIZE,
+                              URING_RX_BUF_SIZE, i, mask, i);
+    io_uring_buf_ring_advance(io->br, URING_RX_ENTRIES);
+
+    /* Only the source address is of interest */
+    io->rx_msg.msg_namelen = sizeof(struct sockaddr_in6);
+
+    *_io = io;
+
+    return 0;
+
+fail:
+    handle_error(ctx, ret, "io_uring setup failed: %s\n");
+    io_uring_queue_exit(&io->ring);
+    avt_socket_close(ctx, &io->sc);
+    free(io->rx_bufs);
+    free(io);
+    return ret;
+}
+
+static uint32_t uring_max_pkt_len(AVTContext *ctx, AVTIOCtx *io)
+{
+    return io->sc.max_pkt_len;
+}
+
+static int uring_arm_recv(AVTIOCtx *io)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+    if (!sqe)
+        return AVT_ERROR(EBUSY);
+
+    io_uring_prep_recvmsg_multishot(sqe, URING_FD_IDX, &io->rx_msg, 0);
+    io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT);
+    io_uring_sqe_set_data64(sqe, URING_TAG_RECV);
+    sqe->buf_group = URING_RX_BGID;
+
+    io->rx_armed = true;
+
+    return 0;
+}
+
+static int uring_handle_recv(AVTContext *ctx, AVTIOCtx *io,
+                             struct io_uring_cqe *cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+        io->rx_armed = false;
+
+    /* Out of provided buffers, re-armed on the next read */
+    if (cqe->res == -ENOBUFS)
+        return 0;
+    else if (cqe->res < 0)
+        return cqe->res;
+
+    if (!(cqe->flags & IORING_CQE_F_BUFFER))
+        return 0;
+
+    int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    uint8_t *base = io->rx_bufs + bid*URING_RX_BUF_SIZE;
+
+    struct io_uring_recvmsg_out *o;
+    o = io_uring_recvmsg_validate(base, cqe->res, &io->rx_msg);
+    if (!o || (o->flags & MSG_TRUNC) || io->rx_nb == URING_RX_QUEUE) {
+        io->rx_dropped++;
+        goto end;
+    }
+
+    unsigned int len = io_uring_recvmsg_payload_length(o, cqe->res, &io->rx_msg);
+    AVTBuffer *buf = avt_buffer_pool_get(ctx->buffer_pool, len);
+    if (!buf) {
+        io->rx_dropped++;
+        goto end;
+    }
+    size_t buf_len;
+    memcpy(avt_buffer_get_data(buf, &buf_len),
+           io_uring_recvmsg_payload(o, &io->rx_msg), len);
+
+    URingRxPacket *rx = &io->rx_queue[(io->rx_head + io->rx_nb++) % URING_RX_QUEUE];
+    rx->buf = buf;
+    memset(&rx->src, 0, sizeof(rx->src));
+    memcpy(&rx->src, io_uring_recvmsg_name(o),
+           AVT_MIN(o->namelen, sizeof(rx->src)));
+
+end:
+    /* Hand the buffer back to the kernel */
+    io_uring_buf_ring_add(io->br, base, URING_RX_BUF_SIZE, bid,
+                          io_uring_buf_ring_mask(URING_RX_ENTRIES), 0);
+    io_uring_buf_ring_advance(io->br, 1);
+
+    return 0;
+}
+
+static int uring_handle_cqe(AVTContext *ctx, AVTIOCtx *io,
+                            struct io_uring_cqe *cqe)
+{
+    int ret = 0;
+
+    switch (io_uring_cqe_get_data64(cqe)) {
+    case URING_TAG_SEND:
+        io->inflight--;
+        if (cqe->res < 0 && !io->tx_err)
+            io->tx_err = cqe->res;
+        else if (cqe->res > 0)
+            io->wpos += cqe->res;
+        break;
+    case URING_TAG_RECV:
+        ret = uring_handle_recv(ctx, io, cqe);
+        break;
+    }
+
+    io_uring_cqe_seen(&io->ring, cqe);
+
+    return ret;
+}
+
+/* Handle all available completions */
+static int uring_reap(AVTContext *ctx, AVTIOCtx *io)
+{
+    int ret = 0;
+    struct io_uring_cqe *cqe;
+
+    while (!io_uring_peek_cqe(&io->ring, &cqe)) {
+        int err = uring_handle_cqe(ctx, io, cqe);
+        if (err < 0 && !ret)
+            ret = err;
+    }
+
+    return ret;
+}
+
+/* Wait until at least one datagram has been received */
+static int uring_wait_recv(AVTContext *ctx, AVTIOCtx *io)
+{
+    int ret;
+
+    while (!io->rx_nb) {
+        if (!io->rx_armed) {
+            ret = uring_arm_recv(io);
+            if (ret < 0)
+                return ret;
+        }
+
+        ret = io_uring_submit_and_wait(&io->ring, 1);
+        if (ret == -EINTR)
+            continue;
+        else if (ret < 0)
+            return ret;
+
+        ret = uring_reap(ctx, io);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static URingRxPacket *uring_pop_recv(AVTIOCtx *io)
+{
+    URingRxPacket *rx = &io->rx_queue[io->rx_head];
+    io->rx_head = (io->rx_head + 1) % URING_RX_QUEUE;
+    io->rx_nb--;
+
+    if (io->sc.passive) {
+        io->sc.peer = rx->src;
+        io->sc.have_peer = true;
+    }
+
+    return rx;
+}
+
+static int uring_read_vec_input(AVTContext *ctx, AVTIOCtx *io,
+                                AVTBuffer **bufs, size_t *seg_len, int nb_bufs)
+{
+    int ret = uring_wait_recv(ctx, io);
+    if (ret < 0)
+        return ret;
+
+    /* Pick up anything else that has arrived meanwhile */
+    ret = uring_reap(ctx, io);
+    if (ret < 0)
+        return ret;
+
+    int nb = AVT_MIN(io->rx_nb, nb_bufs);
+    for (int i = 0; i < nb; i++) {
+        URingRxPacket *rx = uring_pop_recv(io);
+        bufs[i] = rx->buf;
+        seg_len[i] = 0;
+        io->rpos += avt_buffer_get_data_len(rx->buf);
+    }
+
+    return nb;
+}
+
+static int64_t uring_read_input(AVTContext *ctx, AVTIOCtx *io,
+                                AVTBuffer **_buf, size_t len)
+{
+    int ret = uring_wait_recv(ctx, io);
+    if (ret < 0)
+        return ret;
+
+    URingRxPacket *rx = uring_pop_recv(io);
+
+    /* Datagrams are read whole */
+    size_t rx_len;
+    uint8_t *rx_data = avt_buffer_get_data(rx->buf, &rx_len);
+    if (!*_buf) {
+        *_buf = rx->buf;
+    } else {
+        AVTBuffer *buf = *_buf;
+        size_t off = avt_buffer_get_data_len(buf), buf_len;
+        ret = avt_buffer_realloc(buf, off + rx_len);
+        if (ret >= 0)
+            memcpy((uint8_t *)avt_buffer_get_data(buf, &buf_len) + off, rx_data, rx_len);
+        avt_buffer_unref(&rx->buf);
+        if (ret < 0)
+            return ret;
+    }
+
+    return (io->rpos += rx_len);
+}
+
+static int uring_alloc_msgs(AVTIOCtx *io, int nb)
+{
+    if (nb <= io->nb_msg_alloc)
+        return 0;
+
+    struct msghdr *msg = realloc(io->msg, nb*sizeof(*msg));
+    if (!msg)
+        return AVT_ERROR(ENOMEM);
+    io->msg = msg;
+
+    struct iovec *iov = realloc(io->iov, 2*nb*sizeof(*iov));
+    if (!iov)
+        return AVT_ERROR(ENOMEM);
+    io->iov = iov;
+
+    UDPControl *ctrl = realloc(io->ctrl, nb*sizeof(*ctrl));
+    if (!ctrl)
+        return AVT_ERROR(ENOMEM);
+    io->ctrl = ctrl;
+
+    io->nb_msg_alloc = nb;
+
+    return 0;
+}
+
+static int64_t uring_write_vec_output(AVTContext *ctx, AVTIOCtx *io,
+                                      AVTIOVectors *vec)
+{
+    int ret;
+
+    if (!io->sc.have_peer)
+        return AVT_ERROR(ENOTCONN);
+
+    ret = uring_alloc_msgs(io, vec->nb_vecs);
+    if (ret < 0)
+        return ret;
+
+    /* Build messages, one per datagram, or one per run with GSO */
+    int nb_msg = 0;
+    struct iovec *iov = io->iov;
+    for (int i = 0; i < vec->nb_vecs;) {
+        size_t seg_len = 0;
+        int n = io->gso ? avt_udp_gso_run(&vec->vecs[i], vec->nb_vecs - i, &seg_len, false) : 1;
+
+        struct msghdr *m = &io->msg[nb_msg];
+        *m = (struct msghdr){
+            .msg_name = io->sc.passive ? &io->sc.peer : NULL,
+            .msg_namelen = io->sc.passive ? sizeof(io->sc.peer) : 0,
+            .msg_iov = iov,
+        };
+
+        for (int j = 0; j < n; j++) {
+            AVTIOVector *v = &vec->vecs[i + j];
+            size_t len;
+            uint8_t *data = avt_buffer_get_data(v->payload, &len);
+
+            *iov++ = (struct iovec){ .iov_base = v->hdr, .iov_len = v->hdr_len };
+            if (len)
+                *iov++ = (struct iovec){ .iov_base = data, .iov_len = len };
+        }
+        m->msg_iovlen = iov - m->msg_iov;
+
+        if (n > 1)
+            avt_udp_gso_control(m, &io->ctrl[nb_msg], seg_len);
+
+        nb_msg++;
+        i += n;
+    }
+
+    /* One SQE per message, linked to keep them in order */
+    int off = 0;
+    while (off < nb_msg && !io->tx_err) {
+        int nb = AVT_MIN(nb_msg - off, URING_SQ_ENTRIES);
+        for (int i = 0; i < nb; i++) {
+            /* The queue is always drained before returning */
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+            io_uring_prep_sendmsg(sqe, URING_FD_IDX, &io->msg[off + i], 0);
+            io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE |
+                                        (i < (nb - 1) ? IOSQE_IO_LINK : 0));
+            io_uring_sqe_set_data64(sqe, URING_TAG_SEND);
+            io->inflight++;
+        }
+        off += nb;
+
+        do {
+            ret = io_uring_submit_and_wait(&io->ring, io->inflight);
+        } while (ret == -EINTR);
+        if (ret < 0)
+            return handle_error(ctx, ret, "Error submitting: %s\n");
+
+        /* Anything after a failed packet in the chain gets cancelled */
+        while (io->inflight) {
+            ret = uring_reap(ctx, io);
+            if (ret < 0 && !io->tx_err)
+                io->tx_err = ret;
+            if (!io->inflight)
+                break;
+
+            struct io_uring_cqe *cqe;
+            ret = io_uring_wait_cqe(&io->ring, &cqe);
+            if (ret < 0 && ret != -EINTR)
+                return handle_error(ctx, ret, "Error waiting: %s\n");
+        }
+    }
+
+    if (io->tx_err) {
+        ret = io->tx_err;
+        io->tx_err = 0;
+        return handle_error(ctx, ret, "Error sending: %s\n");
+    }
+
+    return io->wpos;
+}
+
+static int64_t uring_write_output(AVTContext *ctx, AVTIOCtx *io,
+                                  uint8_t hdr[AVT_MAX_HEADER_LEN], size_t hdr_len,
+                                  AVTBuffer *payload)
+{
+    AVTIOVector v = {
+        .hdr_len = hdr_len,
+        .payload = payload,
+    };
+    memcpy(v.hdr, hdr, hdr_len);
+
+    AVTIOVectors vec = { .nb_vecs = 1, .vecs = &v };
+    return uring_write_vec_output(ctx, io, &vec);
+}
+
+static int64_t uring_seek(AVTContext *ctx, AVTIOCtx *io, int64_t off)
+{
+    return AVT_ERROR(ESPIPE);
+}
+
+static int uring_flush(AVTContext *ctx, AVTIOCtx *io)
+{
+    return 0;
+}
+
+static int uring_close(AVTContext *ctx, AVTIOCtx **_io)
+{
+    AVTIOCtx *io = *_io;
+
+    while (io->rx_nb) {
+        avt_buffer_unref(&io->rx_queue[io->rx_head].buf);
+        io->rx_head = (io->rx_head + 1) % URING_RX_QUEUE;
+        io->rx_nb--;
+    }
+
+    if (io->rx_dropped)
+        avt_log(ctx, AVT_LOG_VERBOSE, "Dropped %" PRIu64 " datagrams\n",
+                io->rx_dropped);
+
+    io_uring_free_buf_ring(&io->ring, io->br, URING_RX_ENTRIES, URING_RX_BGID);
+    io_uring_queue_exit(&io->ring);
+    int ret = avt_socket_close(ctx, &io->sc);
+
+    free(io->rx_bufs);
+    free(io->msg);
+    free(io->iov);
+    free(io->ctrl);
+    free(io);
+    *_io = NULL;
+    return ret;
+}
+
+const AVTIO avt_io_udp_uring = {
+    .name = "udp_uring",
+    .type = AVT_IO_SOCKET,
+    .init = uring_init,
+    .get_max_pkt_len = uring_max_pkt_len,
+    .read_input = uring_read_input,
+    .read_vec_input = uring_read_vec_input,
+    .write_vec_output = uring_write_vec_output,
+    .write_output = uring_write_output,
+    .seek = uring_seek,
+    .flush = uring_flush,
+    .close = uring_close,
+};
@@ -25,3 +25,62 @@
  */
 
 #include "ldpc.h"
+
+/* Girth of both codes, including the dual-diagonal, is at least 6. */
+static const AVTLDPCCirculant ldpc_288_224[14][AVT_LDPC_COL_WEIGHT] = {
+    { {  1, 15 }, {  2,  1 }, {  3, 13 } }, { {  0,  5 }, {  1, 15 }, {  2,  5 } },
+    { {  0,  3 }, {  1, 11 }, {  3, 10 } }, { {  0,  3 }, {  2,  6 }, {  3, 11 } },
+    { {  0, 15 }, {  2,  8 }, {  3,  0 } }, { {  0,  6 }, {  1, 13 }, {  2, 11 } },
+    { {  1,  0 }, {  2,  3 }, {  3,  1 } }, { {  0,  2 }, {  1,  8 }, {  3, 14 } },
+    { {  0, 15 }, {  1,  4 }, {  3,  1 } }, { {  0,  8 }, {  2,  2 }, {  3, 12 } },
+    { {  0,  6 }, {  1,  2 }, {  2,  2 } }, { {  1,  9 }, {  2,  3 }, {  3,  9 } },
+    { {  1, 10 }, {  2, 15 }, {  3,  1 } }, { {  0,  9 }, {  1, 12 }, {  2,  4 } },
+};
+
+static const AVTLDPCCirculant ldpc_2784_2016[63][AVT_LDPC_COL_WEIGHT] = {
+    { {  1, 24 }, {  7,  9 }, { 21, 14 } }, { { 11,  9 }, { 12, 14 }, { 17, 24 } },
+    { {  2, 27 }, {  4, 14 }, { 10, 25 } }, { { 13, 23 }, { 16, 10 }, { 20, 23 } },
+    { {  6,  2 }, {  8, 31 }, {  9,  6 } }, { {  0, 22 }, {  5, 23 }, { 23, 19 } },
+    { {  3,  1 }, { 14,  2 }, { 15, 14 } }, { { 18, 12 }, { 19,  0 }, { 22,  0 } },
+    { {  1, 17 }, {  3,  9 }, { 23, 19 } }, { {  8, 23 }, { 17, 21 }, { 19, 31 } },
+    { { 11, 26 }, { 18, 11 }, { 22, 18 } }, { {  2,  4 }, { 12, 25 }, { 16, 31 } },
+    { {  7, 11 }, {  9,  6 }, { 14, 23 } }, { {  5, 15 }, { 10, 30 }, { 21, 24 } },
+    { {  0, 19 }, { 13, 28 }, { 20, 12 } }, { {  4,  5 }, {  6, 23 }, { 15, 24 } },
+    { {  2,  7 }, {  8,  2 }, { 15,  9 } }, { {  1,  1 }, { 19, 28 }, { 22, 29 } },
+    { {  9, 10 }, { 14, 23 }, { 18,  6 } }, { {  5, 15 }, {  6, 11 }, { 23, 10 } },
+    { {  3, 16 }, {  4,  0 }, { 10, 23 } }, { {  7, 28 }, { 11, 14 }, { 17, 26 } },
+    { { 12, 31 }, { 16, 30 }, { 20, 19 } }, { {  0, 30 }, { 13, 29 }, { 21,  6 } },
+    { {  1,  0 }, { 10,  0 }, { 21,  9 } }, { {  6, 10 }, { 19, 14 }, { 22,  5 } },
+    { {  0, 10 }, {  3,  1 }, { 11,  3 } }, { {  2, 25 }, { 13, 26 }, { 16,  7 } },
+    { { 12, 21 }, { 14, 14 }, { 20, 15 } }, { {  7,  7 }, {  9, 19 }, { 17, 11 } },
+    { {  5, 24 }, {  8, 17 }, { 15, 16 } }, { {  4, 29 }, { 18, 14 }, { 23, 27 } },
+    { {  6, 13 }, {  8, 21 }, { 22, 19 } }, { {  4, 19 }, { 11, 16 }, { 12, 26 } },
+    { {  1, 23 }, {  5, 26 }, { 17, 16 } }, { { 10, 10 }, { 16, 28 }, { 23, 24 } },
+    { {  9, 22 }, { 13, 24 }, { 20, 15 } }, { {  0,  9 }, { 15, 11 }, { 21,  6 } },
+    { {  2, 27 }, { 18,  1 }, { 19, 24 } }, { {  3, 15 }, {  7, 28 }, { 14,  5 } },
+    { { 12, 22 }, { 19, 19 }, { 21, 13 } }, { {  6, 29 }, {  9, 21 }, { 20,  2 } },
+    { {  7, 31 }, { 10, 17 }, { 17, 10 } }, { {  2,  6 }, {  4, 27 }, { 13, 13 } },
+    { {  1,  5 }, {  5,  1 }, { 23, 14 } }, { {  3,  1 }, { 16, 29 }, { 18, 27 } },
+    { {  8,  4 }, { 15, 12 }, { 22, 26 } }, { {  0, 11 }, { 11, 11 }, { 14, 23 } },
+    { {  3,  8 }, {  5, 11 }, {  9,  9 } }, { {  0, 29 }, { 13, 16 }, { 17, 20 } },
+    { {  1,  3 }, {  6, 16 }, { 22, 18 } }, { {  4, 20 }, { 12, 30 }, { 15, 25 } },
+    { { 11, 19 }, { 16, 26 }, { 18, 31 } }, { {  7,  2 }, { 20, 29 }, { 21,  0 } },
+    { {  8,  0 }, { 10, 20 }, { 14, 22 } }, { {  2, 20 }, { 19, 21 }, { 23, 25 } },
+    { {  2, 28 }, {  5, 24 }, { 18, 12 } }, { {  9,  9 }, { 16, 26 }, { 20,  1 } },
+    { {  3, 31 }, { 14,  6 }, { 17, 16 } }, { { 15, 25 }, { 22, 27 }, { 23,  4 } },
+    { {  0,  1 }, {  4,  5 }, {  6,  8 } }, { {  8, 18 }, { 11, 15 }, { 13, 19 } },
+    { {  7,  0 }, { 12, 18 }, { 21,  1 } },
+};
+const AVTLDPCCode avt_ldpc_288_224 = {
+    .n = 288,
+    .k = 224,
+    .z = 16,
+    .cols = ldpc_288_224,
+};
+
+const AVTLDPCCode avt_ldpc_2784_2016 = {
+    .n = 2784,
+    .k = 2016,
+    .z = 32,
+    .cols = ldpc_2784_2016,
+};
@@ -27,4 +27,29 @@
 #ifndef LIBAVTRANSPORT_LDPC
 #define LIBAVTRANSPORT_LDPC
 
+#include <stdint.h>
+
+/* Both header codes are quasi-cyclic: the message part of the parity check
+ * matrix H is made of ZxZ circulant permutation matrices, with a fixed number
+ * of them per block column. The parity part of H is a dual-diagonal, so
+ * parity bit i takes part in checks i and i + 1. */
+#define AVT_LDPC_COL_WEIGHT 3
+
+typedef struct AVTLDPCCirculant {
+    uint8_t row;   /* Block row */
+    uint8_t shift; /* Check i of the block row covers bit (i + shift) % z */
+} AVTLDPCCirculant;
+
+typedef struct AVTLDPCCode {
+    int n; /* Block length, in bits */
+    int k; /* Message length, in bits */
+    int z; /* Circulant size */
+
+    /* k/z block columns */
+    const AVTLDPCCirculant (*cols)[AVT_LDPC_COL_WEIGHT];
+} AVTLDPCCode;
+
+extern const AVTLDPCCode avt_ldpc_288_224;
+extern const AVTLDPCCode avt_ldpc_2784_2016;
+
 #endif
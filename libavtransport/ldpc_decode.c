@@ -24,4 +24,284 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avtransport/utils.h>
+
+#include "ldpc.h"
 #include "ldpc_decode.h"
+#include "ldpc_encode.h"
+
+/* Number of blocks decoded at once. The innermost loops of the decoder run
+ * across them, so they map onto vector lanes. */
+#define LDPC_LANES 16
+
+/* Blocks are hard decisions, so all bits start with the same confidence.
+ * Offset min-sum, with saturation. */
+#define LDPC_LLR_IN     8
+#define LDPC_LLR_OFFSET 2
+#define LDPC_LLR_MAX    1024
+
+/* Largest number of bits covered by a single check */
+#define LDPC_MAX_DEG 32
+
+typedef struct LDPCGraph {
+    const AVTLDPCCode *code;
+    int m;
+    int nb_edges;
+
+    /* Check i covers the bits var[ptr[i]] to var[ptr[i + 1] - 1] */
+    uint16_t *ptr;
+    uint16_t *var;
+} LDPCGraph;
+
+static uint16_t ptr_288_224[64 + 1];
+static uint16_t var_288_224[224*AVT_LDPC_COL_WEIGHT + 64*2 - 1];
+
+static uint16_t ptr_2784_2016[768 + 1];
+static uint16_t var_2784_2016[2016*AVT_LDPC_COL_WEIGHT + 768*2 - 1];
+
+static LDPCGraph graph_288_224 = {
+    .code = &avt_ldpc_288_224,
+    .m = 64,
+    .nb_edges = sizeof(var_288_224)/sizeof(*var_288_224),
+    .ptr = ptr_288_224,
+    .var = var_288_224,
+};
+
+static LDPCGraph graph_2784_2016 = {
+    .code = &avt_ldpc_2784_2016,
+    .m = 768,
+    .nb_edges = sizeof(var_2784_2016)/sizeof(*var_2784_2016),
+    .ptr = ptr_2784_2016,
+    .var = var_2784_2016,
+};
+
+static pthread_once_t graph_once = PTHREAD_ONCE_INIT;
+
+/* Expand the circulants and the dual-diagonal into a list of bits per check */
+static void graph_add(LDPCGraph *g, uint16_t *pos, int chk, int b)
+{
+    if (pos)
+        g->var[pos[chk]++] = b;
+    else
+        g->ptr[chk + 1]++;
+}
+
+static void graph_build(LDPCGraph *g)
+{
+    const AVTLDPCCode *c = g->code;
+    const int z = c->z;
+    uint16_t pos[768];
+
+    /* Count bits per check first, then fill in */
+    for (uint16_t *fill = NULL; ; fill = pos) {
+        for (int b = 0; b < c->k; b++) {
+            for (int i = 0; i < AVT_LDPC_COL_WEIGHT; i++) {
+                const AVTLDPCCirculant *e = &c->cols[b / z][i];
+                graph_add(g, fill, e->row*z + ((b % z) - e->shift + z) % z, b);
+            }
+        }
+
+        for (int j = 0; j < g->m; j++) {
+            graph_add(g, fill, j, c->k + j);
+            if (j + 1 < g->m)
+                graph_add(g, fill, j + 1, c->k + j);
+        }
+
+        if (fill)
+            break;
+
+        for (int j = 0; j < g->m; j++) {
+            g->ptr[j + 1] += g->ptr[j];
+            pos[j] = g->ptr[j];
+        }
+    }
+}
+
+static void graphs_init(void)
+{
+    graph_build(&graph_288_224);
+    graph_build(&graph_2784_2016);
+}
+
+static inline int get_bit(const uint8_t *blk, int b)
+{
+    return (blk[b >> 3] >> (7 - (b & 7))) & 1;
+}
+
+/* Layered offset min-sum over up to LDPC_LANES blocks */
+static void decode_lanes(const LDPCGraph *g, uint8_t *blocks[], int ret[],
+                         int nb, int iterations,
+                         int16_t (*p)[LDPC_LANES], int16_t (*r)[LDPC_LANES])
+{
+    const int n = g->code->n;
+    bool done[LDPC_LANES] = { 0 };
+    int nb_done = 0;
+
+    for (int b = 0; b < n; b++)
+        for (int l = 0; l < LDPC_LANES; l++)
+            p[b][l] = (l < nb && get_bit(blocks[l], b)) ? -LDPC_LLR_IN : LDPC_LLR_IN;
+    memset(r, 0, g->nb_edges*sizeof(*r));
+
+    for (int it = 0; it < iterations && nb_done < nb; it++) {
+        for (int chk = 0; chk < g->m; chk++) {
+            const int e0 = g->ptr[chk];
+            const int deg = g->ptr[chk + 1] - e0;
+            int16_t q[LDPC_MAX_DEG][LDPC_LANES];
+            int16_t min1[LDPC_LANES], min2[LDPC_LANES], idx[LDPC_LANES];
+            int16_t sign[LDPC_LANES] = { 0 };
+
+            for (int l = 0; l < LDPC_LANES; l++)
+                min1[l] = min2[l] = INT16_MAX;
+
+            /* Bit to check messages, and the two smallest of them */
+            for (int j = 0; j < deg; j++) {
+                const int16_t *pv = p[g->var[e0 + j]];
+                const int16_t *re = r[e0 + j];
+                for (int l = 0; l < LDPC_LANES; l++) {
+                    int16_t v = pv[l] - re[l];
+                    int16_t a = v < 0 ? -v : v;
+                    q[j][l] = v;
+                    sign[l] ^= v < 0;
+                    min2[l] = a < min1[l] ? min1[l] : (a < min2[l] ? a : min2[l]);
+                    idx[l]  = a < min1[l] ? j : idx[l];
+                    min1[l] = a < min1[l] ? a : min1[l];
+                }
+            }
+
+            for (int l = 0; l < LDPC_LANES; l++) {
+                min1[l] = AVT_MAX(min1[l] - LDPC_LLR_OFFSET, 0);
+                min2[l] = AVT_MAX(min2[l] - LDPC_LLR_OFFSET, 0);
+            }
+
+            /* Check to bit messages, excluding each bit's own */
+            for (int j = 0; j < deg; j++) {
+                int16_t *pv = p[g->var[e0 + j]];
+                int16_t *re = r[e0 + j];
+                for (int l = 0; l < LDPC_LANES; l++) {
+                    int16_t mag = idx[l] == j ? min2[l] : min1[l];
+                    int16_t m = (sign[l] ^ (q[j][l] < 0)) ? -mag : mag;
+                    int v = q[j][l] + m;
+                    re[l] = m;
+                    pv[l] = AVT_MAX(AVT_MIN(v, LDPC_LLR_MAX), -LDPC_LLR_MAX);
+                }
+            }
+        }
+
+        /* Early termination, per lane, once all checks are satisfied */
+        int16_t fail[LDPC_LANES] = { 0 };
+        for (int chk = 0; chk < g->m; chk++) {
+            int16_t par[LDPC_LANES] = { 0 };
+            for (int e = g->ptr[chk]; e < g->ptr[chk + 1]; e++) {
+                const int16_t *pv = p[g->var[e]];
+                for (int l = 0; l < LDPC_LANES; l++)
+                    par[l] ^= pv[l] < 0;
+            }
+            for (int l = 0; l < LDPC_LANES; l++)
+                fail[l] |= par[l];
+        }
+
+        for (int l = 0; l < nb; l++) {
+            if (done[l] || fail[l])
+                continue;
+
+            int flips = 0;
+            for (int b = 0; b < n; b++) {
+                int bit = p[b][l] < 0;
+                if (bit != get_bit(blocks[l], b)) {
+                    blocks[l][b >> 3] ^= 1 << (7 - (b & 7));
+                    flips++;
+                }
+            }
+
+            ret[l] = flips;
+            done[l] = true;
+            nb_done++;
+        }
+    }
+
+    for (int l = 0; l < nb; l++)
+        if (!done[l])
+            ret[l] = AVT_ERROR(EBADMSG);
+}
+
+/* Scratch space, only allocated once a block fails the check */
+typedef struct LDPCScratch {
+    int16_t (*p)[LDPC_LANES];
+    int16_t (*r)[LDPC_LANES];
+} LDPCScratch;
+
+static void decode_queued(const LDPCGraph *g, LDPCScratch *s,
+                          uint8_t *bad[], const int bad_idx[], int nb_bad,
+                          int ret[], int iterations)
+{
+    int res[LDPC_LANES];
+
+    if (!s->p) {
+        s->p = malloc(g->code->n*sizeof(*s->p));
+        s->r = malloc(g->nb_edges*sizeof(*s->r));
+    }
+
+    if (s->p && s->r)
+        decode_lanes(g, bad, res, nb_bad, iterations, s->p, s->r);
+
+    for (int j = 0; j < nb_bad; j++)
+        ret[bad_idx[j]] = (s->p && s->r) ? res[j] : AVT_ERROR(ENOMEM);
+}
+
+static void decode_blocks(const LDPCGraph *g, uint8_t *blocks[], int ret[],
+                          int nb, int iterations)
+{
+    const int k = g->code->k >> 3;
+    const int m = g->code->n - g->code->k;
+    LDPCScratch s = { 0 };
+    uint8_t *bad[LDPC_LANES];
+    int bad_idx[LDPC_LANES];
+    int nb_bad = 0;
+
+    if (iterations <= 0)
+        iterations = AVT_LDPC_DEFAULT_ITERATIONS;
+
+    pthread_once(&graph_once, graphs_init);
+
+    for (int i = 0; i < nb; i++) {
+        uint8_t par[96];
+        if (g == &graph_288_224)
+            avt_ldpc_encode_288_224(par, blocks[i]);
+        else
+            avt_ldpc_encode_2784_2016(par, blocks[i]);
+
+        /* Fast path, the parity matches */
+        ret[i] = 0;
+        if (!memcmp(par, &blocks[i][k], m >> 3))
+            continue;
+
+        bad[nb_bad] = blocks[i];
+        bad_idx[nb_bad++] = i;
+        if (nb_bad == LDPC_LANES) {
+            decode_queued(g, &s, bad, bad_idx, nb_bad, ret, iterations);
+            nb_bad = 0;
+        }
+    }
+
+    if (nb_bad)
+        decode_queued(g, &s, bad, bad_idx, nb_bad, ret, iterations);
+
+    free(s.p);
+    free(s.r);
+}
+
+void avt_ldpc_decode_288_224(uint8_t *blocks[], int ret[], int nb,
+                             int iterations)
+{
+    decode_blocks(&graph_288_224, blocks, ret, nb, iterations);
+}
+
+void avt_ldpc_decode_2784_2016(uint8_t *blocks[], int ret[], int nb,
+                               int iterations)
+{
+    decode_blocks(&graph_2784_2016, blocks, ret, nb, iterations);
+}
@@ -27,4 +27,20 @@
 #ifndef LIBAVTRANSPORT_LDPC_DECODE
 #define LIBAVTRANSPORT_LDPC_DECODE
 
+#include <stdint.h>
+
+/* Decoding iterations used when none are given */
+#define AVT_LDPC_DEFAULT_ITERATIONS 16
+
+/* Check a batch of blocks, and correct them in place where needed.
+ * Clean blocks are only re-encoded, blocks which fail the check are then
+ * decoded together, with up to iterations min-sum iterations.
+ * Sets ret[i] to 0 if blocks[i] was clean, to the number of bits corrected,
+ * or to AVT_ERROR(EBADMSG) if it could not be corrected. */
+void avt_ldpc_decode_288_224(uint8_t *blocks[], int ret[], int nb,
+                             int iterations);
+
+void avt_ldpc_decode_2784_2016(uint8_t *blocks[], int ret[], int nb,
+                               int iterations);
+
 #endif
@@ -24,14 +24,81 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "ldpc.h"
 #include "ldpc_encode.h"
 
+static inline uint32_t rotl16(uint32_t v, int s)
+{
+    return ((v << s) | (v >> ((16 - s) & 15))) & 0xFFFF;
+}
+
+static inline uint32_t rotl32(uint32_t v, int s)
+{
+    return (v << s) | (v >> ((32 - s) & 31));
+}
+
+/* The message bits of block column c, most significant first, land on
+ * check i of block row r as bit (i + shift) % z, hence the rotation.
+ * The dual-diagonal then makes parity bit i the XOR of checks 0 to i. */
+
+void avt_ldpc_encode_288_224(uint8_t parity[8], const uint8_t msg[28])
+{
+    const AVTLDPCCirculant (*cols)[AVT_LDPC_COL_WEIGHT] = avt_ldpc_288_224.cols;
+    uint32_t s[4] = { 0 };
+
+    for (int c = 0; c < 224/16; c++) {
+        uint32_t m = AVT_RB16(&msg[c*2]);
+        for (int i = 0; i < AVT_LDPC_COL_WEIGHT; i++)
+            s[cols[c][i].row] ^= rotl16(m, cols[c][i].shift);
+    }
+
+    uint64_t p = ((uint64_t)s[0] << 48) | ((uint64_t)s[1] << 32) |
+                 ((uint64_t)s[2] << 16) | ((uint64_t)s[3] <<  0);
+    p ^= p >>  1;
+    p ^= p >>  2;
+    p ^= p >>  4;
+    p ^= p >>  8;
+    p ^= p >> 16;
+    p ^= p >> 32;
+
+    AVT_WB64(parity, p);
+}
+
+void avt_ldpc_encode_2784_2016(uint8_t parity[96], const uint8_t msg[252])
+{
+    const AVTLDPCCirculant (*cols)[AVT_LDPC_COL_WEIGHT] = avt_ldpc_2784_2016.cols;
+    uint32_t s[24] = { 0 };
+
+    for (int c = 0; c < 2016/32; c++) {
+        uint32_t m = AVT_RB32(&msg[c*4]);
+        for (int i = 0; i < AVT_LDPC_COL_WEIGHT; i++)
+            s[cols[c][i].row] ^= rotl32(m, cols[c][i].shift);
+    }
+
+    uint32_t carry = 0;
+    for (int r = 0; r < 24; r++) {
+        uint32_t p = s[r];
+        p ^= p >>  1;
+        p ^= p >>  2;
+        p ^= p >>  4;
+        p ^= p >>  8;
+        p ^= p >> 16;
+        p ^= carry;
+        carry = -(p & 1);
+        AVT_WB32(&parity[r*4], p);
+    }
+}
+
 void avt_bsw_ldpc_288_224(AVTBytestream *bs)
 {
-    avt_bsw_zpad(bs, 64);
+    avt_assert1((bs->ptr - bs->start) >= 28 && (bs->ptr + 8) <= bs->end);
+    avt_ldpc_encode_288_224(bs->ptr, bs->ptr - 28);
+    bs->ptr += 8;
 }
 
 void avt_bsw_ldpc_2784_2016(AVTBytestream *bs)
 {
-    avt_bsw_zpad(bs, 768);
+    avt_assert1((bs->ptr - bs->start) >= 252 && (bs->ptr + 96) <= bs->end);
+    avt_ldpc_encode_2784_2016(bs->ptr, bs->ptr - 252);
+    bs->ptr += 96;
 }
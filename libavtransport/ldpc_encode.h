@@ -29,6 +29,13 @@
 
 #include "bytestream.h"
 
+/* Compute the parity of a message, both in network order.
+ * A block is valid when its parity matches what these return. */
+void avt_ldpc_encode_288_224(uint8_t parity[8], const uint8_t msg[28]);
+
+void avt_ldpc_encode_2784_2016(uint8_t parity[96], const uint8_t msg[252]);
+
+/* Write the parity for the message just written to the bytestream */
 void avt_bsw_ldpc_288_224(AVTBytestream *bs);
 
 void avt_bsw_ldpc_2784_2016(AVTBytestream *bs);
@@ -32,15 +32,28 @@
 #include "output_internal.h"
 #include "output_packet.h"
 #include "encode.h"
+#include "fec.h"
 
 #include "../config.h"
 
+/* Packets per FEC group source block, by default */
+#define FEC_GROUP_BLOCK_SIZE 64
+
 int avt_output_open(AVTContext *ctx, AVTOutput **_out,
                     AVTConnection *conn, AVTOutputOptions *opts)
 {
     AVTOutput *out = calloc(1, sizeof(*out));
+    if (!out)
+        return AVT_ERROR(ENOMEM);
 
+    out->ctx = ctx;
+    if (opts)
+        out->opts = *opts;
     atomic_store(&out->seq, 0);
+    atomic_store(&out->nb_fec_groups, 0);
+    pthread_mutex_init(&out->fec_lock, NULL);
+    avt_fec_control_init(&out->fec_ctrl, out->opts.fec_overhead,
+                         out->opts.fec_min_overhead, out->opts.fec_max_overhead);
     atomic_store(&out->epoch, avt_get_time_ns());
 
     out->conn = calloc(1, sizeof(*out->conn));
@@ -65,28 +78,179 @@ int avt_output_open(AVTContext *ctx, AVTOutput **_out,
     return 0;
 }
 
+FN_CREATING(avt_output, AVTOutput, AVTStream,
+            stream, streams, nb_streams)
+
 AVTStream *avt_output_stream_add(AVTOutput *out, uint16_t id)
 {
     if (id == UINT16_MAX) {
         avt_log(out, AVT_LOG_ERROR, "Invalid stream ID: 0x%X is reserved!\n", id);
-        return AVT_ERROR(EINVAL);
+        return NULL;
     }
 
-    AVTStream *st = &out->streams[id];
+    AVTStream *st = avt_id_map_get(&out->stream_map, id);
+    if (st)
+        return st;
+
+    st = avt_output_create_stream(out);
+    if (!st)
+        return NULL;
 
     st->id = id;
-    if (!st->priv) {
-        st->priv = calloc(1, sizeof(*st->priv));
-        if (!st->priv)
-            return NULL;
-    }
+    st->priv = calloc(1, sizeof(*st->priv));
+    if (!st->priv)
+        return NULL;
 
     st->priv->out = out;
-    out->active_stream_idx[out->nb_streams++] = id;
+    atomic_store(&st->priv->nb_pkts, 0);
+    atomic_store(&st->priv->fec_overhead, out->opts.fec_overhead);
+    avt_fec_control_init(&st->priv->fec_ctrl, out->opts.fec_overhead,
+                         out->opts.fec_min_overhead, out->opts.fec_max_overhead);
+
+    if (avt_id_map_set(&out->stream_map, id, st) < 0)
+        return NULL;
 
     return st;
 }
 
+FN_CREATING(avt_output, AVTOutput, AVTOutputFECGroup,
+            fec_group, fec_groups, nb_fec_groups)
+
+/* Send what is left of a group's block, and remove its streams.
+ * Must be called with the FEC lock held. */
+static int fec_group_ungroup(AVTOutput *out, AVTOutputFECGroup *grp)
+{
+    int err = avt_send_fec_block(out, grp);
+
+    for (int i = 0; i < grp->nb_streams; i++)
+        avt_id_map_set(&out->fec_group_map, grp->streams[i], NULL);
+    grp->nb_streams = 0;
+
+    return err;
+}
+
+int avt_output_fec_group(AVTOutput *out, uint16_t group_id,
+                         AVTStream *streams[], int nb_streams,
+                         unsigned int overhead, int block_size)
+{
+    int err = 0;
+
+    if (group_id == UINT16_MAX || avt_id_map_get(&out->stream_map, group_id)) {
+        avt_log(out, AVT_LOG_ERROR, "Invalid FEC group ID: 0x%X!\n", group_id);
+        return AVT_ERROR(EINVAL);
+    } else if (nb_streams < 1 || nb_streams > 16 ||
+               block_size < 0 || block_size > UINT16_MAX) {
+        return AVT_ERROR(EINVAL);
+    }
+
+    pthread_mutex_lock(&out->fec_lock);
+
+    AVTOutputFECGroup *grp = NULL;
+    for (int i = 0; i < out->nb_fec_groups; i++) {
+        if (out->fec_groups[i]->id == group_id) {
+            grp = out->fec_groups[i];
+            break;
+        }
+    }
+
+    if (grp) {
+        err = fec_group_ungroup(out, grp);
+    } else {
+        grp = avt_output_create_fec_group(out);
+        if (!grp) {
+            err = AVT_ERROR(ENOMEM);
+            goto end;
+        }
+        grp->id = group_id;
+    }
+
+    /* A stream may only be in a single group */
+    for (int i = 0; i < nb_streams; i++) {
+        AVTOutputFECGroup *old = avt_id_map_get(&out->fec_group_map, streams[i]->id);
+        if (old)
+            fec_group_ungroup(out, old);
+    }
+
+    grp->overhead = overhead;
+    avt_fec_control_init(&grp->fec_ctrl, overhead,
+                         out->opts.fec_min_overhead, out->opts.fec_max_overhead);
+    grp->block_size = block_size ? block_size : FEC_GROUP_BLOCK_SIZE;
+
+    for (int i = 0; i < nb_streams; i++) {
+        err = avt_id_map_set(&out->fec_group_map, streams[i]->id, grp);
+        if (err < 0)
+            break;
+        grp->streams[grp->nb_streams++] = streams[i]->id;
+    }
+
+end:
+    pthread_mutex_unlock(&out->fec_lock);
+    return err;
+}
+
+int avt_output_feedback(AVTContext *ctx, void *opaque, AVTStream *st,
+                        uint64_t epoch_offset, uint64_t bandwidth,
+                        uint32_t fec_corrections, uint32_t corrupt_packets,
+                        uint32_t missing_packets)
+{
+    AVTOutput *out = opaque;
+    if (!out->opts.fec_max_overhead)
+        return 0;
+
+    pthread_mutex_lock(&out->fec_lock);
+
+    uint64_t nb_sent, nb_lost;
+    if (st) {
+        if (!avt_fec_control_delta(&st->priv->fec_ctrl, atomic_load(&st->priv->nb_pkts),
+                                   fec_corrections, corrupt_packets, missing_packets,
+                                   &nb_sent, &nb_lost))
+            goto end;
+
+        atomic_store(&st->priv->fec_overhead,
+                     avt_fec_control_adapt(&st->priv->fec_ctrl, nb_sent, nb_lost));
+
+        /* Grouped streams are protected by their group, not per packet */
+        AVTOutputFECGroup *grp = avt_id_map_get(&out->fec_group_map, st->id);
+        if (grp)
+            grp->overhead = avt_fec_control_adapt(&grp->fec_ctrl, nb_sent, nb_lost);
+    } else {
+        if (!avt_fec_control_delta(&out->fec_ctrl, atomic_load(&out->seq),
+                                   fec_corrections, corrupt_packets, missing_packets,
+                                   &nb_sent, &nb_lost))
+            goto end;
+
+        unsigned int overhead = avt_fec_control_adapt(&out->fec_ctrl, nb_sent, nb_lost);
+        for (int i = 0; i < out->nb_streams; i++)
+            atomic_store(&out->streams[i]->priv->fec_overhead, overhead);
+
+        for (int i = 0; i < out->nb_fec_groups; i++) {
+            AVTOutputFECGroup *grp = out->fec_groups[i];
+            if (grp->nb_streams)
+                grp->overhead = avt_fec_control_adapt(&grp->fec_ctrl, nb_sent, nb_lost);
+        }
+    }
+
+end:
+    pthread_mutex_unlock(&out->fec_lock);
+
+    return 0;
+}
+
+int avt_output_resend(AVTContext *ctx, void *opaque, uint64_t seq, uint32_t nb)
+{
+    AVTOutput *out = opaque;
+    int err = AVT_ERROR(ENOENT);
+
+    /* Whichever connection the packets were sent on */
+    for (int i = 0; i < out->nb_conn; i++) {
+        err = avt_connection_resend(out->conn[i], seq, nb);
+        if (err != AVT_ERROR(ENOENT))
+            break;
+    }
+
+    return err;
+}
+
 int avt_output_stream_update(AVTOutput *out, AVTStream *st)
 {
     return avt_send_stream_register(out, st);
@@ -97,6 +261,17 @@ int avt_output_stream_data(AVTStream *st, AVTPacket *pkt)
     return avt_send_stream_data(st->priv->out, st, pkt);
 }
 
+size_t avt_packet_get_max_size(AVTOutput *out)
+{
+    uint32_t max = UINT32_MAX;
+
+    for (int i = 0; i < out->nb_conn; i++)
+        max = AVT_MIN(max, avt_connection_get_max_pkt_len(out->conn[i]));
+
+    /* Always leave room for at least some payload */
+    return AVT_MAX(max, AVT_MAX_HEADER_LEN + 1);
+}
+
 int avt_output_close(AVTOutput **_out)
 {
     AVTOutput *out = *_out;
@@ -104,6 +279,27 @@ int avt_output_close(AVTOutput **_out)
 #ifdef CONFIG_HAVE_LIBZSTD
     ZSTD_freeCCtx(out->zstd_ctx);
 #endif
+
+    /* Protect what was sent last too */
+    pthread_mutex_lock(&out->fec_lock);
+    for (int i = 0; i < out->nb_fec_groups; i++) {
+        avt_send_fec_block(out, out->fec_groups[i]);
+        avt_pkt_fifo_free(&out->fec_groups[i]->src);
+        free(out->fec_groups[i]);
+    }
+    free(out->fec_groups);
+    avt_id_map_free(&out->fec_group_map);
+    pthread_mutex_unlock(&out->fec_lock);
+    pthread_mutex_destroy(&out->fec_lock);
+
+    for (int i = 0; i < out->nb_streams; i++) {
+        free(out->streams[i]->priv);
+        free(out->streams[i]);
+    }
+    free(out->streams);
+    avt_id_map_free(&out->stream_map);
+
+    free(out->conn);
     free(out);
 
     *_out = NULL;
@@ -27,10 +27,13 @@
 #ifndef LIBAVTRANSPORT_OUTPUT
 #define LIBAVTRANSPORT_OUTPUT
 
+#include <pthread.h>
+
 #include <avtransport/output.h>
 
 #include "common.h"
 #include "connection_internal.h"
+#include "utils_internal.h"
 
 #include "../config.h"
 
@@ -38,24 +41,55 @@
 #include <zstd.h>
 #endif
 
+/* Streams protected by FEC as a whole */
+typedef struct AVTOutputFECGroup {
+    uint16_t id;
+    uint16_t streams[16];
+    int nb_streams;
+
+    unsigned int overhead;
+    int block_size;
+
+    /* Adapts the overhead to the loss of the streams in the group */
+    AVTFECControl fec_ctrl;
+
+    /* Number of the current source block */
+    uint16_t blk;
+
+    /* Packets of the current source block, in the order they were sent */
+    AVTPacketFifo src;
+} AVTOutputFECGroup;
+
 typedef struct AVTOutput {
     AVTContext *ctx;
+    AVTOutputOptions opts;
 
     AVTConnection **conn;
     uint32_t nb_conn;
 
-    AVTStream streams[UINT16_MAX];
-    uint16_t active_stream_idx[UINT16_MAX];
+    /* Streams, allocated on first use */
+    AVTIdMap stream_map;
+    AVTStream **streams;
     int nb_streams;
 
     atomic_uint_least64_t seq;
     atomic_uint_least64_t epoch;
 
+    /* Controller for feedback on all streams */
+    AVTFECControl fec_ctrl;
+
+    /* FEC groups, and the group of each stream, if any */
+    pthread_mutex_t fec_lock;
+    AVTOutputFECGroup **fec_groups;
+    atomic_int nb_fec_groups;
+    AVTIdMap fec_group_map;
+
 #ifdef CONFIG_HAVE_LIBZSTD
     ZSTD_CCtx *zstd_ctx;
 #endif
 } AVTOutput;
 
+/* Maximum size of a packet over all connections, header included */
 size_t avt_packet_get_max_size(AVTOutput *out);
 
 #endif
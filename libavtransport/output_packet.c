@@ -27,6 +27,8 @@
 #include <string.h>
 
 #include "output_packet.h"
+#include "encode.h"
+#include "fec.h"
 
 #include "../config.h"
 
@@ -52,6 +54,158 @@ static inline int avt_send_pkt(AVTOutput *out,
     return ret;
 }
 
+static inline uint64_t avt_fec_source(AVTOutputFECGroup *grp, int id)
+{
+    AVTOutputPacket *e = avt_pkt_fifo_get(&grp->src, id);
+    return ((e->pkt.seq & UINT32_MAX) << 32) | ((uint64_t)grp->blk << 16) | id;
+}
+
+int avt_send_fec_block(AVTOutput *out, AVTOutputFECGroup *grp)
+{
+    int err = 0;
+    AVTBuffer tmp;
+    AVTBuffer *src = NULL, *par = NULL;
+    int k = grp->src.nb;
+    if (!k)
+        return 0;
+
+    /* The payloads of the packets, concatenated, are the source block */
+    size_t len = 0;
+    for (int i = 0; i < k; i++)
+        len += avt_pkt_fifo_get(&grp->src, i)->pl.len;
+    if (!len)
+        goto end;
+
+    AVTFECBlocks blk;
+    if (avt_fec_blocks(&blk, len) < 0) {
+        avt_log(out, AVT_LOG_WARN, "Too much data for FEC group 0x%X, "
+                "not sending FEC data!\n", grp->id);
+        goto end;
+    }
+
+    size_t nb_source = (len + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+    size_t nb_repair = (nb_source*grp->overhead + 99) / 100;
+    nb_repair = AVT_MIN(nb_repair, UINT32_MAX / AVT_FEC_SYMBOL_SIZE);
+    if (!nb_repair)
+        goto end;
+
+    size_t total = nb_repair*AVT_FEC_SYMBOL_SIZE;
+    src = avt_buffer_pool_get(out->ctx->buffer_pool, len);
+    par = avt_buffer_pool_get(out->ctx->buffer_pool, total);
+    if (!src || !par) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    size_t src_len, par_len;
+    uint8_t *src_data = avt_buffer_get_data(src, &src_len);
+    uint8_t *par_data = avt_buffer_get_data(par, &par_len);
+
+    size_t pos = 0;
+    for (int i = 0; i < k; i++) {
+        AVTOutputPacket *e = avt_pkt_fifo_get(&grp->src, i);
+        memcpy(&src_data[pos], e->pl.data, e->pl.len);
+        pos += e->pl.len;
+    }
+
+    err = avt_fec_encode(par_data, src_data, len, 0, nb_repair);
+    if (err < 0)
+        goto end;
+
+    /* Registration, describing the source block */
+    union AVTPacketData reg = AVT_FEC_GROUPING_HDR(
+        .global_seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX,
+        .group_id = grp->id,
+        .fec_grouping_streams = grp->nb_streams,
+        .fec_common_oti = ((uint64_t)len << 24) | AVT_FEC_SYMBOL_SIZE,
+        .fec_scheme_oti = ((uint32_t)blk.nb << 24) | (1 << 8) | AVT_FEC_SYMBOL_SIZE,
+        .fec_start_global_seq = avt_pkt_fifo_get(&grp->src, 0)->pkt.seq,
+    );
+
+    for (int j = 0; j < grp->nb_streams; j++) {
+        for (int i = 0; i < k; i++) {
+            AVTOutputPacket *e = avt_pkt_fifo_get(&grp->src, i);
+            if (e->pkt.stream_id != grp->streams[j])
+                continue;
+            if (!reg.fec_grouping.fec_nb_packets[j]++)
+                reg.fec_grouping.fec_seq_number[j] = e->pkt.seq;
+        }
+    }
+
+    err = avt_send_pkt(out, reg, nullptr);
+    if (err < 0)
+        goto end;
+
+    size_t maxp = avt_packet_get_max_size(out);
+    union AVTPacketData fd = AVT_FEC_GROUP_DATA_HDR(
+        .group_id = grp->id,
+        .fec_total_data_length = total,
+    );
+    maxp -= avt_pkt_hdr_size(fd);
+
+    int id = 0;
+    for (size_t off = 0; off < total; off += fd.fec_group_data.fec_data_length) {
+        fd.fec_group_data.global_seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX;
+        fd.fec_group_data.fec_data_offset = off;
+        fd.fec_group_data.fec_data_length = AVT_MIN(total - off, maxp);
+
+        /* List the sources in order, repeating from the start once done */
+        fd.fec_group_data.fec_source_1 = avt_fec_source(grp, id++ % k);
+        for (int i = 0; i < 3; i++)
+            fd.fec_group_data.fec_source_234[i] = avt_fec_source(grp, id++ % k);
+
+        err = avt_buffer_quick_ref(&tmp, par, off, fd.fec_group_data.fec_data_length);
+        if (err < 0)
+            break;
+
+        err = avt_send_pkt(out, fd, &tmp);
+        avt_buffer_quick_unref(&tmp);
+        if (err < 0)
+            break;
+    }
+
+end:
+    avt_buffer_unref(&par);
+    avt_buffer_unref(&src);
+    avt_pkt_fifo_clear(&grp->src);
+    grp->blk++;
+    return err;
+}
+
+static bool avt_stream_fec_grouped(AVTOutput *out, AVTStream *st)
+{
+    if (!atomic_load_explicit(&out->nb_fec_groups, memory_order_relaxed))
+        return false;
+
+    pthread_mutex_lock(&out->fec_lock);
+    bool grouped = !!avt_id_map_get(&out->fec_group_map, st->id);
+    pthread_mutex_unlock(&out->fec_lock);
+
+    return grouped;
+}
+
+/* Send a packet carrying stream data, and add it to its stream's FEC group */
+static int avt_send_data_pkt(AVTOutput *out,
+                             union AVTPacketData pkt, AVTBuffer *pl)
+{
+    int err = avt_send_pkt(out, pkt, pl);
+    if (err < 0 || !atomic_load_explicit(&out->nb_fec_groups, memory_order_relaxed))
+        return err;
+
+    pthread_mutex_lock(&out->fec_lock);
+
+    AVTOutputFECGroup *grp = avt_id_map_get(&out->fec_group_map, pkt.stream_id);
+    if (grp) {
+        err = avt_pkt_fifo_push(&grp->src, pkt, pl);
+        if (err >= 0 && grp->src.nb >= grp->block_size)
+            err = avt_send_fec_block(out, grp);
+    }
+
+    pthread_mutex_unlock(&out->fec_lock);
+
+    return err;
+}
+
 static inline int avt_payload_compress(AVTOutput *out,
                                        AVTBuffer **data, enum AVTPktDescriptors desc,
                                        enum AVTDataCompression *data_compression)
@@ -69,27 +223,20 @@ static inline int avt_payload_compress(AVTOutput *out,
 
         size_t dst_size = ZSTD_compressBound(src_len);
 
-        /* TODO: use a buffer pool */
-        uint8_t *dst = malloc(dst_size);
-        if (!dst)
+        AVTBuffer *tmp = avt_buffer_pool_get(out->ctx->buffer_pool, dst_size);
+        if (!tmp)
             return AVT_ERROR(ENOMEM);
 
-        size_t dst_len = ZSTD_compressCCtx(out->zstd_ctx, dst, dst_size, src, src_len,
+        size_t dst_len = ZSTD_compressCCtx(out->zstd_ctx, tmp->data, dst_size, src, src_len,
                                            lvl < 0 ? ZSTD_CLEVEL_DEFAULT : lvl);
-        if (!dst_len) {
+        if (ZSTD_isError(dst_len)) {
             avt_log(out, AVT_LOG_ERROR, "Error while compressing with ZSTD!\n");
             err = AVT_ERROR(EINVAL);
-            free(dst);
-            break;
-        }
-
-        AVTBuffer *tmp = avt_buffer_create(dst, dst_len, NULL, avt_buffer_default_free);
-        if (!tmp) {
-            free(dst);
-            err = AVT_ERROR(ENOMEM);
+            avt_buffer_unref(&tmp);
             break;
         }
 
+        tmp->len = dst_len;
         *data = tmp;
 #else
         avt_log(out, AVT_LOG_ERROR, "ZSTD compression not enabled during build!\n");
@@ -104,9 +251,8 @@ static inline int avt_payload_compress(AVTOutput *out,
 
         size_t dst_size = BrotliEncoderMaxCompressedSize(src_len);
 
-        /* TODO: use a buffer pool */
-        uint8_t *dst = malloc(dst_size);
-        if (!dst)
+        AVTBuffer *tmp = avt_buffer_pool_get(out->ctx->buffer_pool, dst_size);
+        if (!tmp)
             return AVT_ERROR(ENOMEM);
 
         /* Brotli has a braindead advanced API that
@@ -114,20 +260,14 @@ static inline int avt_payload_compress(AVTOutput *out,
          * used by text, meh, good enough for now. */
         if (!BrotliEncoderCompress(lvl < 0 ? BROTLI_DEFAULT_QUALITY : lvl,
                                    BROTLI_DEFAULT_WINDOW, BROTLI_DEFAULT_MODE,
-                                   src_len, src, &dst_size, dst)) {
+                                   src_len, src, &dst_size, tmp->data)) {
             avt_log(out, AVT_LOG_ERROR, "Error while compressing with Brotli!\n");
             err = AVT_ERROR(EINVAL);
-            free(dst);
-            break;
-        }
-
-        AVTBuffer *tmp = avt_buffer_create(dst, dst_size, NULL, avt_buffer_default_free);
-        if (!tmp) {
-            free(dst);
-            err = AVT_ERROR(ENOMEM);
+            avt_buffer_unref(&tmp);
             break;
         }
 
+        tmp->len = dst_size;
         *data = tmp;
 #else
         avt_log(out, AVT_LOG_ERROR, "Brotli compression not enabled during build!\n");
@@ -200,48 +340,125 @@ int avt_send_stream_register(AVTOutput *out, AVTStream *st)
     return avt_send_pkt(out, pkt, nullptr);
 }
 
-#define INIT_SEGMENTED(buf, desc)                                                   \
-    int err;                                                                        \
-    void *series = NULL;                                                            \
-    size_t maxp = avt_packet_get_max_size(out);                                     \
-    size_t payload_size = avt_buffer_get_data_len(buf);                             \
-    size_t pbytes = payload_size;                                                   \
-    size_t seg_len = AVT_MIN(pbytes, maxp);                                         \
-                                                                                    \
-    enum AVTDataCompression data_compression;                                       \
-    err = avt_payload_compress(out, &buf, desc, &data_compression);                 \
-    if (err < 0)                                                                    \
-        return err;                                                                 \
-                                                                                    \
-    AVTBuffer tmp;                                                                  \
-    avt_buffer_quick_ref(&tmp, buf, 0, seg_len);
-
-#define SEGMENT(buf, seg_desc)                                                      \
-    avt_buffer_quick_unref(&tmp);                                                   \
-    if (err < 0)                                                                    \
-        return err;                                                                 \
-                                                                                    \
-    pbytes -= seg_len;                                                              \
-    while (pbytes) {                                                                \
-        const uint32_t seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX;        \
-        seg_len = AVT_MIN(pbytes, maxp);                                            \
-        avt_buffer_quick_ref(&tmp, buf, payload_size - pbytes, seg_len);            \
-        union AVTPacketData seg = { .generic_segment = {                            \
-            .generic_segment_descriptor = seg_desc,                                 \
-            .stream_id = st->id,                                                    \
-            .pkt_total_data = payload_size,                                         \
-            .seg_offset = payload_size - pbytes,                                    \
-            .seg_length = seg_len,                                                  \
-        }};                                                                         \
-                                                                                    \
-        avt_buffer_quick_unref(&tmp);                                               \
-        if (err < 0)                                                                \
-            break;                                                                  \
-                                                                                    \
-        pbytes -= seg_len;                                                          \
-    } while (pbytes);                                                               \
-                                                                                    \
-    return err;
+/* Send the rest of the payload after the first len bytes as segments.
+ * hdr is the first packet's header, with its sequence number set.
+ * Returns the number of segments sent. */
+static int avt_send_segments(AVTOutput *out, union AVTPacketData hdr,
+                             enum AVTPktDescriptors seg_desc,
+                             AVTBuffer *pl, size_t len)
+{
+    int err = 0, nb = 0;
+    uint8_t first[AVT_MAX_HEADER_LEN];
+    size_t first_len;
+    AVTBuffer tmp;
+
+    size_t payload_size = avt_buffer_get_data_len(pl);
+    if (len >= payload_size)
+        return 0;
+
+    avt_encode_header(first, &first_len, hdr.desc, hdr, NULL);
+
+    size_t maxp = avt_packet_get_max_size(out);
+    union AVTPacketData seg = AVT_GENERIC_SEGMENT_HDR(seg_desc,
+        .stream_id = hdr.stream_id,
+        .target_seq = hdr.seq,
+        .pkt_total_data = payload_size,
+    );
+    maxp -= avt_pkt_hdr_size(seg);
+
+    for (size_t off = len; off < payload_size; off += seg.generic_segment.seg_length) {
+        seg.generic_segment.global_seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX;
+        seg.generic_segment.seg_offset = off;
+        seg.generic_segment.seg_length = AVT_MIN(payload_size - off, maxp);
+
+        /* Each segment carries a seventh of the first packet's header */
+        memcpy(seg.generic_segment.header_7,
+               &first[(seg.generic_segment.global_seq % 7) * 4], 4);
+
+        err = avt_buffer_quick_ref(&tmp, pl, off, seg.generic_segment.seg_length);
+        if (err < 0)
+            break;
+
+        err = avt_send_data_pkt(out, seg, &tmp);
+        avt_buffer_quick_unref(&tmp);
+        if (err < 0)
+            break;
+        nb++;
+    }
+
+    return err < 0 ? err : nb;
+}
+
+/* Send parity data for the whole payload, split into packets.
+ * hdr is the first packet's header, with its sequence number set.
+ * Returns the number of parity packets sent. */
+static int avt_send_parity(AVTOutput *out, union AVTPacketData hdr,
+                           enum AVTPktDescriptors parity_desc, AVTBuffer *pl,
+                           unsigned int overhead)
+{
+    int err, nb = 0;
+    uint8_t first[AVT_MAX_HEADER_LEN];
+    size_t first_len;
+    AVTBuffer tmp;
+
+    size_t src_len;
+    uint8_t *src = avt_buffer_get_data(pl, &src_len);
+    if (!overhead || !src_len)
+        return 0;
+
+    /* Only senders going well past the packet size limits get here */
+    if (src_len > AVT_FEC_MAX_LEN)
+        return 0;
+
+    size_t nb_source = (src_len + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+    size_t nb_repair = (nb_source*overhead + 99) / 100;
+    nb_repair = AVT_MIN(nb_repair, UINT32_MAX / AVT_FEC_SYMBOL_SIZE);
+    size_t parity_total = nb_repair*AVT_FEC_SYMBOL_SIZE;
+
+    AVTBuffer *parity = avt_buffer_pool_get(out->ctx->buffer_pool, parity_total);
+    if (!parity)
+        return AVT_ERROR(ENOMEM);
+
+    size_t parity_len;
+    uint8_t *dst = avt_buffer_get_data(parity, &parity_len);
+    err = avt_fec_encode(dst, src, src_len, 0, nb_repair);
+    if (err < 0)
+        goto end;
+
+    avt_encode_header(first, &first_len, hdr.desc, hdr, NULL);
+
+    size_t maxp = avt_packet_get_max_size(out);
+    union AVTPacketData par = AVT_GENERIC_PARITY_HDR(parity_desc,
+        .stream_id = hdr.stream_id,
+        .target_seq = hdr.seq,
+        .parity_total = parity_total,
+    );
+    maxp -= avt_pkt_hdr_size(par);
+
+    for (size_t off = 0; off < parity_total; off += par.generic_parity.parity_data_length) {
+        par.generic_parity.global_seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX;
+        par.generic_parity.parity_data_offset = off;
+        par.generic_parity.parity_data_length = AVT_MIN(parity_total - off, maxp);
+
+        memcpy(par.generic_parity.header_7,
+               &first[(par.generic_parity.global_seq % 7) * 4], 4);
+
+        err = avt_buffer_quick_ref(&tmp, parity, off,
+                                   par.generic_parity.parity_data_length);
+        if (err < 0)
+            break;
+
+        err = avt_send_pkt(out, par, &tmp);
+        avt_buffer_quick_unref(&tmp);
+        if (err < 0)
+            break;
+        nb++;
+    }
+
+end:
+    avt_buffer_unref(&parity);
+    return err < 0 ? err : nb;
+}
 
 int avt_send_stream_data(AVTOutput *out, AVTStream *st, AVTPacket *pkt)
 {
@@ -253,17 +470,58 @@ int avt_send_stream_data(AVTOutput *out, AVTStream *st, AVTPacket *pkt)
     if (err < 0)
         return err;
 
+    /* Anything which doesn't fit goes into segments */
+    size_t pl_len = avt_buffer_get_data_len(pl);
+    size_t len = AVT_MIN(pl_len, avt_packet_get_max_size(out) -
+                                 avt_pkt_hdr_size(AVT_STREAM_DATA_HDR()));
+
     union AVTPacketData hdr = AVT_STREAM_DATA_HDR(
+        .global_seq = atomic_fetch_add(&out->seq, 1ULL) & UINT32_MAX,
         .frame_type = pkt->type,
-        .pkt_in_fec_group = 0,
+        .pkt_segmented = len < pl_len,
+        .pkt_in_fec_group = avt_stream_fec_grouped(out, st),
         .field_id = 0,
         .pkt_compression = data_compression,
         .stream_id = st->id,
         .pts = pkt->pts,
         .duration = pkt->duration,
+        .data_length = len,
     );
 
-    return avt_send_pkt(out, hdr, pl);
+    AVTBuffer tmp;
+    err = avt_buffer_quick_ref(&tmp, pl, 0, len);
+    if (err >= 0) {
+        err = avt_send_data_pkt(out, hdr, &tmp);
+        avt_buffer_quick_unref(&tmp);
+    }
+
+    int nb_pkts = 1;
+    if (err >= 0)
+        err = avt_send_segments(out, hdr, AVT_PKT_STREAM_DATA_SEGMENT, pl, len);
+
+    /* Grouped streams are protected by their group's FEC instead.
+     * Losing an unsegmented packet loses all of its source symbols,
+     * which its parity alone can never make up for. */
+    if (err >= 0) {
+        nb_pkts += err;
+        err = 0;
+        if (!hdr.stream_data.pkt_in_fec_group && hdr.stream_data.pkt_segmented)
+            err = avt_send_parity(out, hdr, AVT_PKT_STREAM_DATA_PARITY, pl,
+                                  atomic_load_explicit(&st->priv->fec_overhead,
+                                                       memory_order_relaxed));
+    }
+
+    if (err >= 0) {
+        nb_pkts += err;
+        err = 0;
+    }
+    atomic_fetch_add_explicit(&st->priv->nb_pkts, nb_pkts, memory_order_relaxed);
+
+    /* Connections hold their own references */
+    if (pl != pkt->data)
+        avt_buffer_unref(&pl);
+
+    return err;
 }
 
 #if 0
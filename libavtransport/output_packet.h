@@ -38,6 +38,10 @@ int avt_send_time_sync(AVTOutput *out);
 int avt_send_stream_register(AVTOutput *out, AVTStream *st);
 int avt_send_stream_data(AVTOutput *out, AVTStream *st, AVTPacket *pkt);
 
+/* Send the FEC data for the current source block of a group, and start
+ * a new block. Must be called with the FEC lock held. */
+int avt_send_fec_block(AVTOutput *out, AVTOutputFECGroup *grp);
+
 /* Generic data */
 int avt_send_generic_data(AVTOutput *out,
                           AVTStream *st, AVTBuffer *data, int64_t pts,
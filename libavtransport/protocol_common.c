@@ -29,6 +29,8 @@
 extern const AVTProtocol avt_protocol_noop;
 
 static const AVTProtocol *avt_protocol_list[] = {
+    [AVT_PROTOCOL_UDP] = &avt_protocol_noop,
+    [AVT_PROTOCOL_UDP_LITE] = &avt_protocol_noop,
     [AVT_PROTOCOL_FILE] = &avt_protocol_noop,
 };
 
@@ -36,6 +38,10 @@ static const AVTProtocol *avt_protocol_list[] = {
 int avt_protocol_init(AVTContext *ctx, const AVTProtocol **_p,
                       AVTProtocolCtx **p_ctx, AVTAddress *addr)
 {
+    if (addr->proto >= AVT_ARRAY_ELEMS(avt_protocol_list) ||
+        !avt_protocol_list[addr->proto])
+        return AVT_ERROR(ENOTSUP);
+
     const AVTProtocol *p = avt_protocol_list[addr->proto];
 
     int err = p->init(ctx, p_ctx, addr);
@@ -67,10 +67,16 @@ typedef struct AVTProtocol {
     int (*receive_packet)(AVTContext *ctx, AVTProtocolCtx *p,
                           union AVTPacketData *pkt, AVTBuffer **pl);
 
-    /* Seek to a place in the stream */
+    /* Receive up to max_pkts packets into a FIFO, waiting for at least one.
+     * Returns the number of packets received, otherwise negative error. */
+    int (*receive_packets)(AVTContext *ctx, AVTProtocolCtx *p,
+                           AVTPacketFifo *fifo, int max_pkts);
+
+    /* Seek to a place in the stream. If ts is not INT64_MIN, seeks to the
+     * last keyframe of the stream at or before ts, otherwise to off. */
     int64_t (*seek)(AVTContext *ctx, AVTProtocolCtx *p,
                     int64_t off, uint32_t seq,
-                    int64_t ts, bool ts_is_dts);
+                    uint16_t stream_id, int64_t ts, bool ts_is_dts);
 
     /* Flush buffered data */
     int (*flush)(AVTContext *ctx, AVTProtocolCtx *p);
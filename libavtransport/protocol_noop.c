@@ -26,27 +26,65 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#include "common.h"
 #include "protocol_common.h"
 #include "io_common.h"
+#include "encode.h"
+#include "decode.h"
+#include "index.h"
+
+/* Maximum number of reads batched in receive_packets */
+#define NOOP_RX_BATCH 64
 
 struct AVTProtocolCtx {
     const AVTIO *io;
     AVTIOCtx *io_ctx;
+
+    /* Vectors for send_packets */
+    AVTIOVector *vecs;
+    int nb_vecs_alloc;
+
+    /* Index packets, written to seekable outputs */
+    bool write_index;
+    AVTIndexWriter index;
+    int64_t wpos;
+
+    /* Seeking on input */
+    AVTIndexTable index_table;
+    int64_t rpos;
+
+    /* File path, to look for a sidecar index with */
+    char *path;
 };
 
 static int noop_init(AVTContext *ctx, AVTProtocolCtx **p, AVTAddress *addr)
 {
-    AVTProtocolCtx *priv = malloc(sizeof(*priv));
+    AVTProtocolCtx *priv = calloc(1, sizeof(*priv));
     if (!priv)
         return AVT_ERROR(ENOMEM);
 
     int err = avt_io_init(ctx, &priv->io, &priv->io_ctx, addr);
-    if (err < 0)
+    if (err < 0) {
         free(priv);
-    else
-        *p = priv;
+        return err;
+    }
+
+    priv->write_index = !addr->read_only && priv->io->type == AVT_IO_FILE &&
+                        priv->io->rewrite_output;
+
+    if (addr->read_only && priv->io->type == AVT_IO_FILE && addr->path) {
+        priv->path = strdup(addr->path);
+        if (!priv->path) {
+            priv->io->close(ctx, &priv->io_ctx);
+            free(priv);
+            return AVT_ERROR(ENOMEM);
+        }
+    }
+
+    *p = priv;
 
     return err;
 }
@@ -65,39 +103,364 @@ static int noop_rm_dst(AVTContext *ctx, AVTProtocolCtx *p, AVTAddress *addr)
     return p->io->del_dst(ctx, p->io_ctx, addr);
 }
 
+static int64_t noop_write_packet(AVTContext *ctx, AVTProtocolCtx *p,
+                                 union AVTPacketData pkt, AVTBuffer *pl)
+{
+    uint8_t hdr[AVT_MAX_HEADER_LEN];
+    size_t hdr_len;
+
+    int err = avt_encode_header(hdr, &hdr_len, pkt.desc, pkt, NULL);
+    if (err < 0)
+        return err;
+
+    int64_t ret = p->io->write_output(ctx, p->io_ctx, hdr, hdr_len, pl);
+    if (ret >= 0)
+        p->wpos = ret;
+
+    return ret;
+}
+
+static int noop_update_packet(AVTContext *ctx, AVTProtocolCtx *p,
+                              union AVTPacketData pkt, AVTBuffer *pl,
+                              void **series, int64_t pos)
+{
+    uint8_t hdr[AVT_MAX_HEADER_LEN];
+    size_t hdr_len;
+
+    if (!p->io->rewrite_output)
+        return AVT_ERROR(ENOTSUP);
+
+    int err = avt_encode_header(hdr, &hdr_len, pkt.desc, pkt, NULL);
+    if (err < 0)
+        return err;
+
+    int64_t ret = p->io->rewrite_output(ctx, p->io_ctx, pos, hdr, hdr_len, pl);
+
+    return ret < 0 ? ret : 0;
+}
+
+/* Write the index packet of a stream, and point the previous one to it */
+static int noop_write_index(AVTContext *ctx, AVTProtocolCtx *p, uint16_t stream_id)
+{
+    union AVTPacketData pkt, prev;
+    AVTBuffer *pl;
+    int64_t prev_off;
+
+    int err = avt_index_writer_build(&p->index, stream_id, p->wpos,
+                                     &pkt, &pl, &prev, &prev_off);
+    if (err < 0)
+        return err;
+
+    int64_t ret = noop_write_packet(ctx, p, pkt, pl);
+    avt_buffer_unref(&pl);
+    if (ret < 0)
+        return ret;
+
+    if (prev_off >= 0)
+        return noop_update_packet(ctx, p, prev, NULL, NULL, prev_off);
+
+    return 0;
+}
+
 static int64_t noop_send_packet(AVTContext *ctx, AVTProtocolCtx *p,
                                 union AVTPacketData pkt, AVTBuffer *pl)
 {
-    uint8_t hdr[AVT_MAX_HEADER_LEN];
-    size_t hdr_len = 0;
+    int err, due = -1;
 
-    // TODO
+    if (p->write_index) {
+        err = avt_index_writer_add(&p->index, pkt, p->wpos, &due);
+        if (err < 0)
+            return err;
+    }
 
-    return p->io->write_output(ctx, p->io_ctx, hdr, hdr_len, pl);
+    int64_t ret = noop_write_packet(ctx, p, pkt, pl);
+    if (ret < 0 || due < 0)
+        return ret;
+
+    err = noop_write_index(ctx, p, due);
+
+    return err < 0 ? err : p->wpos;
 }
 
 static int64_t noop_send_packets(AVTContext *ctx, AVTProtocolCtx *p,
                                  AVTPacketFifo *seq)
 {
-    uint8_t hdr[AVT_MAX_HEADER_LEN];
-    size_t hdr_len = 0;
+    int err;
+    int64_t ret = 0;
 
-    // TODO
+    /* No vectored output, one by one */
+    if (!p->io->write_vec_output) {
+        for (unsigned int i = 0; i < seq->nb; i++) {
+            AVTOutputPacket *e = avt_pkt_fifo_get(seq, i);
+            ret = noop_send_packet(ctx, p, e->pkt, &e->pl);
+            if (ret < 0)
+                return ret;
+        }
+        return ret;
+    }
 
-    return 0;
+    int nb = AVT_MIN(seq->nb, IO_MAX_VECTORS);
+    if (nb > p->nb_vecs_alloc) {
+        AVTIOVector *vecs = realloc(p->vecs, nb*sizeof(*vecs));
+        if (!vecs)
+            return AVT_ERROR(ENOMEM);
+        p->vecs = vecs;
+        p->nb_vecs_alloc = nb;
+    }
+
+    AVTIOVectors vec = { .nb_vecs = 0, .vecs = p->vecs };
+    int64_t off = p->wpos;
+    for (unsigned int i = 0; i < seq->nb; i++) {
+        AVTOutputPacket *e = avt_pkt_fifo_get(seq, i);
+        AVTIOVector *v = &vec.vecs[vec.nb_vecs++];
+        int due = -1;
+
+        err = avt_encode_header(v->hdr, &v->hdr_len, e->pkt.desc, e->pkt, NULL);
+        if (err < 0)
+            return err;
+        v->payload = &e->pl;
+
+        if (p->write_index) {
+            err = avt_index_writer_add(&p->index, e->pkt, off, &due);
+            if (err < 0)
+                return err;
+            off += v->hdr_len + avt_buffer_get_data_len(v->payload);
+        }
+
+        /* Index packets are rare, so just cut the batch short for them */
+        if (vec.nb_vecs == nb || due >= 0) {
+            ret = p->io->write_vec_output(ctx, p->io_ctx, &vec);
+            if (ret < 0)
+                return ret;
+            p->wpos = ret;
+            vec.nb_vecs = 0;
+        }
+
+        if (due >= 0) {
+            err = noop_write_index(ctx, p, due);
+            if (err < 0)
+                return err;
+            ret = off = p->wpos;
+        }
+    }
+
+    if (vec.nb_vecs) {
+        ret = p->io->write_vec_output(ctx, p->io_ctx, &vec);
+        if (ret >= 0)
+            p->wpos = ret;
+    }
+
+    return ret;
+}
+
+/* Check and correct the headers at the start of each buffer, and count
+ * them. Headers which cannot be corrected are left for decoding to reject.
+ * Returns the number of headers corrected. */
+static int noop_check_headers(AVTContext *ctx, AVTBuffer *bufs[], int nb)
+{
+    int ret[NOOP_RX_BATCH];
+    uint64_t corrected = 0, corrupt = 0;
+
+    avt_decode_check_headers(bufs, ret, nb, ctx->input.opts.ldpc.iterations);
+
+    for (int i = 0; i < nb; i++) {
+        corrected += ret[i] > 0;
+        corrupt += ret[i] > 0 || ret[i] == AVT_ERROR(EBADMSG);
+    }
+
+    if (corrupt) {
+        atomic_fetch_add_explicit(&ctx->input.fec_corrections, corrected,
+                                  memory_order_relaxed);
+        atomic_fetch_add_explicit(&ctx->input.corrupt_packets, corrupt,
+                                  memory_order_relaxed);
+    }
+
+    return corrected;
+}
+
+/* Decode a packet. Unless its header was already checked, headers which
+ * fail to decode get corrected, and decoded again. */
+static int64_t noop_decode_packet(AVTContext *ctx, AVTBuffer *buf,
+                                  union AVTPacketData *pkt, AVTBuffer *pl,
+                                  bool checked)
+{
+    bool always_test = ctx->input.opts.ldpc.always_test_headers;
+    if (!checked && always_test) {
+        noop_check_headers(ctx, &buf, 1);
+        checked = true;
+    }
+
+    int64_t ret = avt_decode_packet(buf, pkt, pl);
+    if (ret >= 0 || checked || always_test)
+        return ret;
+
+    if (noop_check_headers(ctx, &buf, 1))
+        ret = avt_decode_packet(buf, pkt, pl);
+
+    return ret;
 }
 
 static int noop_receive_packet(AVTContext *ctx, AVTProtocolCtx *p,
                                union AVTPacketData *pkt, AVTBuffer **pl)
 {
-    AVTBuffer *buf;
-    int err = p->io->read_input(ctx, p->io_ctx, &buf, 0);
-    if (err < 0)
-        return err;
+    AVTBuffer *buf = NULL;
+    AVTBuffer tmp;
 
-    // TODO
+    int64_t end = p->io->read_input(ctx, p->io_ctx, &buf, 0);
+    if (end < 0)
+        return end;
 
-    return 0;
+    size_t buf_len = avt_buffer_get_data_len(buf);
+    int64_t ret = noop_decode_packet(ctx, buf, pkt, &tmp, false);
+    avt_buffer_unref(&buf);
+    if (ret < 0)
+        return ret;
+
+    /* Files return everything left, so rewind to just past the packet */
+    p->rpos = end - buf_len + ret;
+    if (p->io->type == AVT_IO_FILE && ret < buf_len) {
+        int64_t err = p->io->seek(ctx, p->io_ctx, p->rpos);
+        if (err < 0) {
+            avt_buffer_quick_unref(&tmp);
+            return err;
+        }
+    }
+
+    *pl = NULL;
+    if (avt_buffer_get_data_len(&tmp)) {
+        *pl = avt_buffer_reference(&tmp, 0, avt_buffer_get_data_len(&tmp));
+        if (!*pl)
+            ret = AVT_ERROR(ENOMEM);
+    }
+    avt_buffer_quick_unref(&tmp);
+
+    return ret < 0 ? ret : 0;
+}
+
+/* Decode all packets in a single datagram into the FIFO.
+ * checked indicates the first header was already checked.
+ * Returns the number of packets decoded. */
+static int noop_decode_datagram(AVTContext *ctx, AVTBuffer *buf,
+                                AVTPacketFifo *fifo, bool checked)
+{
+    int err, nb_pkts = 0;
+    size_t off = 0, len = avt_buffer_get_data_len(buf);
+
+    while (off < len) {
+        AVTBuffer view, pl;
+        union AVTPacketData pkt;
+
+        err = avt_buffer_quick_ref(&view, buf, off, len - off);
+        if (err < 0)
+            return err;
+
+        int64_t ret = noop_decode_packet(ctx, &view, &pkt, &pl, checked && !off);
+        avt_buffer_quick_unref(&view);
+
+        /* Skip whatever is left of invalid datagrams */
+        if (ret < 0) {
+            avt_log(ctx, AVT_LOG_DEBUG, "Dropping undecodable data: %i\n", (int)ret);
+            break;
+        }
+
+        err = avt_pkt_fifo_push_move(fifo, pkt, &pl);
+        if (err < 0) {
+            avt_buffer_quick_unref(&pl);
+            return err;
+        }
+
+        off += ret;
+        nb_pkts++;
+    }
+
+    return nb_pkts;
+}
+
+/* Decode a batch of datagrams, checking their first headers all at once */
+static int noop_decode_datagrams(AVTContext *ctx, AVTBuffer *dgrams,
+                                 int nb_dgrams, AVTPacketFifo *fifo)
+{
+    int err = 0, nb_pkts = 0;
+    bool checked = ctx->input.opts.ldpc.always_test_headers;
+
+    if (checked) {
+        AVTBuffer *bufs[NOOP_RX_BATCH];
+        for (int i = 0; i < nb_dgrams; i++)
+            bufs[i] = &dgrams[i];
+        noop_check_headers(ctx, bufs, nb_dgrams);
+    }
+
+    for (int i = 0; i < nb_dgrams; i++) {
+        if (err >= 0) {
+            err = noop_decode_datagram(ctx, &dgrams[i], fifo, checked);
+            if (err > 0)
+                nb_pkts += err;
+        }
+        avt_buffer_quick_unref(&dgrams[i]);
+    }
+
+    return err < 0 ? err : nb_pkts;
+}
+
+static int noop_receive_packets(AVTContext *ctx, AVTProtocolCtx *p,
+                                AVTPacketFifo *fifo, int max_pkts)
+{
+    int err;
+
+    /* No vectored input, one by one */
+    if (!p->io->read_vec_input) {
+        union AVTPacketData pkt;
+        AVTBuffer *pl = NULL;
+        err = noop_receive_packet(ctx, p, &pkt, &pl);
+        if (err < 0)
+            return err;
+
+        err = avt_pkt_fifo_push(fifo, pkt, pl);
+        avt_buffer_unref(&pl);
+        return err < 0 ? err : 1;
+    }
+
+    AVTBuffer *bufs[NOOP_RX_BATCH];
+    size_t seg_len[NOOP_RX_BATCH];
+    int nb_bufs = p->io->read_vec_input(ctx, p->io_ctx, bufs, seg_len,
+                                        AVT_MIN(AVT_MAX(max_pkts, 1), NOOP_RX_BATCH));
+    if (nb_bufs < 0)
+        return nb_bufs;
+
+    /* Split up coalesced datagrams */
+    AVTBuffer dgrams[NOOP_RX_BATCH];
+    int nb_dgrams = 0, nb_pkts = 0;
+    err = 0;
+    for (int i = 0; i < nb_bufs; i++) {
+        size_t len = avt_buffer_get_data_len(bufs[i]);
+        size_t seg = seg_len[i] ? seg_len[i] : len;
+
+        for (size_t off = 0; err >= 0 && off < len; off += seg) {
+            err = avt_buffer_quick_ref(&dgrams[nb_dgrams], bufs[i], off,
+                                       AVT_MIN(seg, len - off));
+            if (err < 0)
+                break;
+
+            if (++nb_dgrams == NOOP_RX_BATCH) {
+                err = noop_decode_datagrams(ctx, dgrams, nb_dgrams, fifo);
+                if (err > 0)
+                    nb_pkts += err;
+                nb_dgrams = 0;
+            }
+        }
+
+        avt_buffer_unref(&bufs[i]);
+    }
+
+    if (nb_dgrams) {
+        int ret = noop_decode_datagrams(ctx, dgrams, nb_dgrams, fifo);
+        if (ret > 0)
+            nb_pkts += ret;
+        else if (err >= 0)
+            err = ret;
+    }
+
+    return err < 0 ? err : nb_pkts;
 }
 
 static uint32_t noop_max_pkt_len(AVTContext *ctx, AVTProtocolCtx *p)
@@ -107,9 +470,46 @@ static uint32_t noop_max_pkt_len(AVTContext *ctx, AVTProtocolCtx *p)
 
 static int64_t noop_seek(AVTContext *ctx, AVTProtocolCtx *p,
                          int64_t off, uint32_t seq,
-                         int64_t ts, bool ts_is_dts)
+                         uint16_t stream_id, int64_t ts, bool ts_is_dts)
 {
-    return p->io->seek(ctx, p->io_ctx, off);
+    int64_t ret;
+
+    if (ts != INT64_MIN) {
+        /* Needs the index packets of a file. Those only have a PTS. */
+        if (p->io->type != AVT_IO_FILE)
+            return AVT_ERROR(ENOTSUP);
+
+        /* A sidecar index, if any, covers everything. Only tried once. */
+        if (p->path) {
+            int err = avt_index_table_open(&p->index_table, NULL, p->path);
+            if (err < 0 && err != AVT_ERROR(ENOENT))
+                avt_log(ctx, AVT_LOG_WARN, "Unable to use sidecar index: %i\n", err);
+            if (err < 0)
+                avt_index_table_free(&p->index_table);
+            free(p->path);
+            p->path = NULL;
+        }
+
+        int err = avt_index_table_load(ctx, &p->index_table, p->io, p->io_ctx,
+                                       stream_id);
+        const AVTIndexTableEntry *e = NULL;
+        if (err >= 0)
+            e = avt_index_table_find(&p->index_table, stream_id, ts);
+
+        /* Loading moved the read position, go back or go to the keyframe */
+        ret = p->io->seek(ctx, p->io_ctx, e ? e->offset : p->rpos);
+        if (err < 0)
+            return err;
+        else if (!e)
+            return AVT_ERROR(ENOENT);
+    } else {
+        ret = p->io->seek(ctx, p->io_ctx, off);
+    }
+
+    if (ret >= 0)
+        p->rpos = ret;
+
+    return ret;
 }
 
 static int noop_flush(AVTContext *ctx, AVTProtocolCtx *p)
@@ -119,8 +519,24 @@ static int noop_flush(AVTContext *ctx, AVTProtocolCtx *p)
 
 static int noop_close(AVTContext *ctx, AVTProtocolCtx **p)
 {
+    int id, err = 0;
     AVTProtocolCtx *priv = *p;
-    int err = priv->io->close(ctx, &priv->io_ctx);
+
+    /* Index whatever was written since the last index packets */
+    while (priv->write_index && (id = avt_index_writer_pending(&priv->index)) >= 0) {
+        err = noop_write_index(ctx, priv, id);
+        if (err < 0)
+            break;
+    }
+
+    int ret = priv->io->close(ctx, &priv->io_ctx);
+    if (ret < 0)
+        err = ret;
+
+    avt_index_writer_free(&priv->index);
+    avt_index_table_free(&priv->index_table);
+    free(priv->path);
+    free(priv->vecs);
     free(priv);
     *p = NULL;
     return err;
@@ -134,7 +550,10 @@ const AVTProtocol avt_protocol_noop = {
     .rm_dst = noop_rm_dst,
     .get_max_pkt_len = noop_max_pkt_len,
     .receive_packet = noop_receive_packet,
+    .receive_packets = noop_receive_packets,
     .send_packet = noop_send_packet,
+    .send_packets = noop_send_packets,
+    .update_packet = noop_update_packet,
     .seek = noop_seek,
     .flush = noop_flush,
     .close = noop_close,
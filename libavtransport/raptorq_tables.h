@@ -0,0 +1,723 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* RaptorQ tables.
+ *
+ * rq_v and rq_deg are the tables V0 to V3 of RFC 6330 section 5.5 and the
+ * degree distribution of section 5.3.5.2.
+ *
+ * rq_sys is NOT the table of section 5.6 yet, but a stand-in with the same
+ * structure and growth, until it is extracted from the text of the RFC with
+ * tools/rfc6330_tables.py. Its values are:
+ *  - K', 477 sizes going up geometrically from 10 to 56403
+ *  - S(K'), the smallest prime at least ceil(0.01*K') + X, with X the
+ *    smallest integer such that X*(X - 1) >= 2*K', as in RFC 5053
+ *  - H(K'), the smallest integer, and at least 10, such that
+ *    choose(H, ceil(H/2)) >= K' + S
+ *  - W(K'), the smallest prime at least K' + S - ceil(sqrt(K'))
+ *  - J(K'), the first index for which the source symbols alone make up an
+ *    invertible constraint matrix
+ * Until then, FEC data will only be usable between implementations using
+ * these same tables.
+ */
+
+#ifndef LIBAVTRANSPORT_RAPTORQ_TABLES
+#define LIBAVTRANSPORT_RAPTORQ_TABLES
+
+#include <stdint.h>
+
+static const uint32_t rq_v[4][256] = {
+    {
+        251291136U, 3952231631U, 3370958628U, 4070167936U, 123631495U, 3351110283U,
+        3218676425U, 2011642291U, 774603218U, 2402805061U, 1004366930U, 1843948209U,
+        428891132U, 3746331984U, 1591258008U, 3067016507U, 1433388735U, 504005498U,
+        2032657933U, 3419319784U, 2805686246U, 3102436986U, 3808671154U, 2501582075U,
+        3978944421U, 246043949U, 4016898363U, 649743608U, 1974987508U, 2651273766U,
+        2357956801U, 689605112U, 715807172U, 2722736134U, 191939188U, 3535520147U,
+        3277019569U, 1470435941U, 3763101702U, 3232409631U, 122701163U, 3920852693U,
+        782246947U, 372121310U, 2995604341U, 2045698575U, 2332962102U, 4005368743U,
+        218596347U, 3415381967U, 4207612806U, 861117671U, 3676575285U, 2581671944U,
+        3312220480U, 681232419U, 307306866U, 4112503940U, 1158111502U, 709227802U,
+        2724140433U, 4201101115U, 4215970289U, 4048876515U, 3031661061U, 1909085522U,
+        510985033U, 1361682810U, 129243379U, 3142379587U, 2569842483U, 3033268270U,
+        1658118006U, 932109358U, 1982290045U, 2983082771U, 3007670818U, 3448104768U,
+        683749698U, 778296777U, 1399125101U, 1939403708U, 1692176003U, 3868299200U,
+        1422476658U, 593093658U, 1878973865U, 2526292949U, 1591602827U, 3986158854U,
+        3964389521U, 2695031039U, 1942050155U, 424618399U, 1347204291U, 2669179716U,
+        2434425874U, 2540801947U, 1384069776U, 4123580443U, 1523670218U, 2708475297U,
+        1046771089U, 2229796016U, 1255426612U, 4213663089U, 1521339547U, 3041843489U,
+        420130494U, 10677091U, 515623176U, 3457502702U, 2115821274U, 2720124766U,
+        3242576090U, 854310108U, 425973987U, 325832382U, 1796851292U, 2462744411U,
+        1976681690U, 1408671665U, 1228817808U, 3917210003U, 263976645U, 2593736473U,
+        2471651269U, 4291353919U, 650792940U, 1191583883U, 3046561335U, 2466530435U,
+        2545983082U, 969168436U, 2019348792U, 2268075521U, 1169345068U, 3250240009U,
+        3963499681U, 2560755113U, 911182396U, 760842409U, 3569308693U, 2687243553U,
+        381854665U, 2613828404U, 2761078866U, 1456668111U, 883760091U, 3294951678U,
+        1604598575U, 1985308198U, 1014570543U, 2724959607U, 3062518035U, 3115293053U,
+        138853680U, 4160398285U, 3322241130U, 2068983570U, 2247491078U, 3669524410U,
+        1575146607U, 828029864U, 3732001371U, 3422026452U, 3370954177U, 4006626915U,
+        543812220U, 1243116171U, 3928372514U, 2791443445U, 4081325272U, 2280435605U,
+        885616073U, 616452097U, 3188863436U, 2780382310U, 2340014831U, 1208439576U,
+        258356309U, 3837963200U, 2075009450U, 3214181212U, 3303882142U, 880813252U,
+        1355575717U, 207231484U, 2420803184U, 358923368U, 1617557768U, 3272161958U,
+        1771154147U, 2842106362U, 1751209208U, 1421030790U, 658316681U, 194065839U,
+        3241510581U, 38625260U, 301875395U, 4176141739U, 297312930U, 2137802113U,
+        1502984205U, 3669376622U, 3728477036U, 234652930U, 2213589897U, 2734638932U,
+        1129721478U, 3187422815U, 2859178611U, 3284308411U, 3819792700U, 3557526733U,
+        451874476U, 1740576081U, 3592838701U, 1709429513U, 3702918379U, 3533351328U,
+        1641660745U, 179350258U, 2380520112U, 3936163904U, 3685256204U, 3156252216U,
+        1854258901U, 2861641019U, 3176611298U, 834787554U, 331353807U, 517858103U,
+        3010168884U, 4012642001U, 2217188075U, 3756943137U, 3077882590U, 2054995199U,
+        3081443129U, 3895398812U, 1141097543U, 2376261053U, 2626898255U, 2554703076U,
+        401233789U, 1460049922U, 678083952U, 1064990737U, 940909784U, 1673396780U,
+        528881783U, 1712547446U, 3629685652U, 1358307511U,
+    },
+    {
+        807385413U, 2043073223U, 3336749796U, 1302105833U, 2278607931U, 541015020U,
+        1684564270U, 372709334U, 3508252125U, 1768346005U, 1270451292U, 2603029534U,
+        2049387273U, 3891424859U, 2152948345U, 4114760273U, 915180310U, 3754787998U,
+        700503826U, 2131559305U, 1308908630U, 224437350U, 4065424007U, 3638665944U,
+        1679385496U, 3431345226U, 1779595665U, 3068494238U, 1424062773U, 1033448464U,
+        4050396853U, 3302235057U, 420600373U, 2868446243U, 311689386U, 259047959U,
+        4057180909U, 1575367248U, 4151214153U, 110249784U, 3006865921U, 4293710613U,
+        3501256572U, 998007483U, 499288295U, 1205710710U, 2997199489U, 640417429U,
+        3044194711U, 486690751U, 2686640734U, 2394526209U, 2521660077U, 49993987U,
+        3843885867U, 4201106668U, 415906198U, 19296841U, 2402488407U, 2137119134U,
+        1744097284U, 579965637U, 2037662632U, 852173610U, 2681403713U, 1047144830U,
+        2982173936U, 910285038U, 4187576520U, 2589870048U, 989448887U, 3292758024U,
+        506322719U, 176010738U, 1865471968U, 2619324712U, 564829442U, 1996870325U,
+        339697593U, 4071072948U, 3618966336U, 2111320126U, 1093955153U, 957978696U,
+        892010560U, 1854601078U, 1873407527U, 2498544695U, 2694156259U, 1927339682U,
+        1650555729U, 183933047U, 3061444337U, 2067387204U, 228962564U, 3904109414U,
+        1595995433U, 1780701372U, 2463145963U, 307281463U, 3237929991U, 3852995239U,
+        2398693510U, 3754138664U, 522074127U, 146352474U, 4104915256U, 3029415884U,
+        3545667983U, 332038910U, 976628269U, 3123492423U, 3041418372U, 2258059298U,
+        2139377204U, 3243642973U, 3226247917U, 3674004636U, 2698992189U, 3453843574U,
+        1963216666U, 3509855005U, 2358481858U, 747331248U, 1957348676U, 1097574450U,
+        2435697214U, 3870972145U, 1888833893U, 2914085525U, 4161315584U, 1273113343U,
+        3269644828U, 3681293816U, 412536684U, 1156034077U, 3823026442U, 1066971017U,
+        3598330293U, 1979273937U, 2079029895U, 1195045909U, 1071986421U, 2712821515U,
+        3377754595U, 2184151095U, 750918864U, 2585729879U, 4249895712U, 1832579367U,
+        1192240192U, 946734366U, 31230688U, 3174399083U, 3549375728U, 1642430184U,
+        1904857554U, 861877404U, 3277825584U, 4267074718U, 3122860549U, 666423581U,
+        644189126U, 226475395U, 307789415U, 1196105631U, 3191691839U, 782852669U,
+        1608507813U, 1847685900U, 4069766876U, 3931548641U, 2526471011U, 766865139U,
+        2115084288U, 4259411376U, 3323683436U, 568512177U, 3736601419U, 1800276898U,
+        4012458395U, 1823982U, 27980198U, 2023839966U, 869505096U, 431161506U,
+        1024804023U, 1853869307U, 3393537983U, 1500703614U, 3019471560U, 1351086955U,
+        3096933631U, 3034634988U, 2544598006U, 1230942551U, 3362230798U, 159984793U,
+        491590373U, 3993872886U, 3681855622U, 903593547U, 3535062472U, 1799803217U,
+        772984149U, 895863112U, 1899036275U, 4187322100U, 101856048U, 234650315U,
+        3183125617U, 3190039692U, 525584357U, 1286834489U, 455810374U, 1869181575U,
+        922673938U, 3877430102U, 3422391938U, 1414347295U, 1971054608U, 3061798054U,
+        830555096U, 2822905141U, 167033190U, 1079139428U, 4210126723U, 3593797804U,
+        429192890U, 372093950U, 1779187770U, 3312189287U, 204349348U, 452421568U,
+        2800540462U, 3733109044U, 1235082423U, 1765319556U, 3174729780U, 3762994475U,
+        3171962488U, 442160826U, 198349622U, 45942637U, 1324086311U, 2901868599U,
+        678860040U, 3812229107U, 19936821U, 1119590141U, 3640121682U, 3545931032U,
+        2102949142U, 2828208598U, 3603378023U, 4135048896U,
+    },
+    {
+        1629829892U, 282540176U, 2794583710U, 496504798U, 2990494426U, 3070701851U,
+        2575963183U, 4094823972U, 2775723650U, 4079480416U, 176028725U, 2246241423U,
+        3732217647U, 2196843075U, 1306949278U, 4170992780U, 4039345809U, 3209664269U,
+        3387499533U, 293063229U, 3660290503U, 2648440860U, 2531406539U, 3537879412U,
+        773374739U, 4184691853U, 1804207821U, 3347126643U, 3479377103U, 3970515774U,
+        1891731298U, 2368003842U, 3537588307U, 2969158410U, 4230745262U, 831906319U,
+        2935838131U, 264029468U, 120852739U, 3200326460U, 355445271U, 2296305141U,
+        1566296040U, 1760127056U, 20073893U, 3427103620U, 2866979760U, 2359075957U,
+        2025314291U, 1725696734U, 3346087406U, 2690756527U, 99815156U, 4248519977U,
+        2253762642U, 3274144518U, 598024568U, 3299672435U, 556579346U, 4121041856U,
+        2896948975U, 3620123492U, 918453629U, 3249461198U, 2231414958U, 3803272287U,
+        3657597946U, 2588911389U, 242262274U, 1725007475U, 2026427718U, 46776484U,
+        2873281403U, 2919275846U, 3177933051U, 1918859160U, 2517854537U, 1857818511U,
+        3234262050U, 479353687U, 200201308U, 2801945841U, 1621715769U, 483977159U,
+        423502325U, 3689396064U, 1850168397U, 3359959416U, 3459831930U, 841488699U,
+        3570506095U, 930267420U, 1564520841U, 2505122797U, 593824107U, 1116572080U,
+        819179184U, 3139123629U, 1414339336U, 1076360795U, 512403845U, 177759256U,
+        1701060666U, 2239736419U, 515179302U, 2935012727U, 3821357612U, 1376520851U,
+        2700745271U, 966853647U, 1041862223U, 715860553U, 171592961U, 1607044257U,
+        1227236688U, 3647136358U, 1417559141U, 4087067551U, 2241705880U, 4194136288U,
+        1439041934U, 20464430U, 119668151U, 2021257232U, 2551262694U, 1381539058U,
+        4082839035U, 498179069U, 311508499U, 3580908637U, 2889149671U, 142719814U,
+        1232184754U, 3356662582U, 2973775623U, 1469897084U, 1728205304U, 1415793613U,
+        50111003U, 3133413359U, 4074115275U, 2710540611U, 2700083070U, 2457757663U,
+        2612845330U, 3775943755U, 2469309260U, 2560142753U, 3020996369U, 1691667711U,
+        4219602776U, 1687672168U, 1017921622U, 2307642321U, 368711460U, 3282925988U,
+        213208029U, 4150757489U, 3443211944U, 2846101972U, 4106826684U, 4272438675U,
+        2199416468U, 3710621281U, 497564971U, 285138276U, 765042313U, 916220877U,
+        3402623607U, 2768784621U, 1722849097U, 3386397442U, 487920061U, 3569027007U,
+        3424544196U, 217781973U, 2356938519U, 3252429414U, 145109750U, 2692588106U,
+        2454747135U, 1299493354U, 4120241887U, 2088917094U, 932304329U, 1442609203U,
+        952586974U, 3509186750U, 753369054U, 854421006U, 1954046388U, 2708927882U,
+        4047539230U, 3048925996U, 1667505809U, 805166441U, 1182069088U, 4265546268U,
+        4215029527U, 3374748959U, 373532666U, 2454243090U, 2371530493U, 3651087521U,
+        2619878153U, 1651809518U, 1553646893U, 1227452842U, 703887512U, 3696674163U,
+        2552507603U, 2635912901U, 895130484U, 3287782244U, 3098973502U, 990078774U,
+        3780326506U, 2290845203U, 41729428U, 1949580860U, 2283959805U, 1036946170U,
+        1694887523U, 4880696U, 466000198U, 2765355283U, 3318686998U, 1266458025U,
+        3919578154U, 3545413527U, 2627009988U, 3744680394U, 1696890173U, 3250684705U,
+        4142417708U, 915739411U, 3308488877U, 1289361460U, 2942552331U, 1169105979U,
+        3342228712U, 698560958U, 1356041230U, 2401944293U, 107705232U, 3701895363U,
+        903928723U, 3646581385U, 844950914U, 1944371367U, 3863894844U, 2946773319U,
+        1972431613U, 1706989237U, 29917467U, 3497665928U,
+    },
+    {
+        1191369816U, 744902811U, 2539772235U, 3213192037U, 3286061266U, 1200571165U,
+        2463281260U, 754888894U, 714651270U, 1968220972U, 3628497775U, 1277626456U,
+        1493398934U, 364289757U, 2055487592U, 3913468088U, 2930259465U, 902504567U,
+        3967050355U, 2056499403U, 692132390U, 186386657U, 832834706U, 859795816U,
+        1283120926U, 2253183716U, 3003475205U, 1755803552U, 2239315142U, 4271056352U,
+        2184848469U, 769228092U, 1249230754U, 1193269205U, 2660094102U, 642979613U,
+        1687087994U, 2726106182U, 446402913U, 4122186606U, 3771347282U, 37667136U,
+        192775425U, 3578702187U, 1952659096U, 3989584400U, 3069013882U, 2900516158U,
+        4045316336U, 3057163251U, 1702104819U, 4116613420U, 3575472384U, 2674023117U,
+        1409126723U, 3215095429U, 1430726429U, 2544497368U, 1029565676U, 1855801827U,
+        4262184627U, 1854326881U, 2906728593U, 3277836557U, 2787697002U, 2787333385U,
+        3105430738U, 2477073192U, 748038573U, 1088396515U, 1611204853U, 201964005U,
+        3745818380U, 3654683549U, 3816120877U, 3915783622U, 2563198722U, 1181149055U,
+        33158084U, 3723047845U, 3790270906U, 3832415204U, 2959617497U, 372900708U,
+        1286738499U, 1932439099U, 3677748309U, 2454711182U, 2757856469U, 2134027055U,
+        2780052465U, 3190347618U, 3758510138U, 3626329451U, 1120743107U, 1623585693U,
+        1389834102U, 2719230375U, 3038609003U, 462617590U, 260254189U, 3706349764U,
+        2556762744U, 2874272296U, 2502399286U, 4216263978U, 2683431180U, 2168560535U,
+        3561507175U, 668095726U, 680412330U, 3726693946U, 4180630637U, 3335170953U,
+        942140968U, 2711851085U, 2059233412U, 4265696278U, 3204373534U, 232855056U,
+        881788313U, 2258252172U, 2043595984U, 3758795150U, 3615341325U, 2138837681U,
+        1351208537U, 2923692473U, 3402482785U, 2105383425U, 2346772751U, 499245323U,
+        3417846006U, 2366116814U, 2543090583U, 1828551634U, 3148696244U, 3853884867U,
+        1364737681U, 2200687771U, 2689775688U, 232720625U, 4071657318U, 2671968983U,
+        3531415031U, 1212852141U, 867923311U, 3740109711U, 1923146533U, 3237071777U,
+        3100729255U, 3247856816U, 906742566U, 4047640575U, 4007211572U, 3495700105U,
+        1171285262U, 2835682655U, 1634301229U, 3115169925U, 2289874706U, 2252450179U,
+        944880097U, 371933491U, 1649074501U, 2208617414U, 2524305981U, 2496569844U,
+        2667037160U, 1257550794U, 3399219045U, 3194894295U, 1643249887U, 342911473U,
+        891025733U, 3146861835U, 3789181526U, 938847812U, 1854580183U, 2112653794U,
+        2960702988U, 1238603378U, 2205280635U, 1666784014U, 2520274614U, 3355493726U,
+        2310872278U, 3153920489U, 2745882591U, 1200203158U, 3033612415U, 2311650167U,
+        1048129133U, 4206710184U, 4209176741U, 2640950279U, 2096382177U, 4116899089U,
+        3631017851U, 4104488173U, 1857650503U, 3801102932U, 445806934U, 3055654640U,
+        897898279U, 3234007399U, 1325494930U, 2982247189U, 1619020475U, 2720040856U,
+        885096170U, 3485255499U, 2983202469U, 3891011124U, 546522756U, 1524439205U,
+        2644317889U, 2170076800U, 2969618716U, 961183518U, 1081831074U, 1037015347U,
+        3289016286U, 2331748669U, 620887395U, 303042654U, 3990027945U, 1562756376U,
+        3413341792U, 2059647769U, 2823844432U, 674595301U, 2457639984U, 4076754716U,
+        2447737904U, 1583323324U, 625627134U, 3076006391U, 345777990U, 1684954145U,
+        879227329U, 3436182180U, 1522273219U, 3802543817U, 1456017040U, 1897819847U,
+        2970081129U, 1382576028U, 3820044861U, 1044428167U, 612252599U, 3340478395U,
+        2150613904U, 3397625662U, 3573635640U, 3432275192U,
+    },
+};
+
+static const uint32_t rq_deg[31] = {
+    0, 5243, 529531, 704294, 791675, 844104, 879057, 904023,
+    922747, 937311, 948962, 958494, 966438, 973160, 978921, 983914,
+    988283, 992138, 995565, 998631, 1001391, 1003887, 1006157, 1008229,
+    1010129, 1011876, 1013490, 1014983, 1016370, 1017662, 1048576,
+};
+
+/* K', J(K'), S(K'), H(K'), W(K') */
+static const uint16_t rq_sys[477][5] = {
+    { 10, 0, 7, 10, 13 },
+    { 12, 0, 7, 10, 17 },
+    { 14, 0, 7, 10, 17 },
+    { 16, 0, 11, 10, 23 },
+    { 18, 0, 11, 10, 29 },
+    { 20, 0, 11, 10, 29 },
+    { 22, 0, 11, 10, 29 },
+    { 24, 0, 11, 10, 31 },
+    { 26, 0, 11, 10, 31 },
+    { 28, 0, 11, 10, 37 },
+    { 30, 0, 11, 10, 37 },
+    { 32, 0, 11, 10, 37 },
+    { 34, 0, 11, 10, 41 },
+    { 36, 0, 11, 10, 41 },
+    { 38, 0, 11, 10, 43 },
+    { 40, 0, 11, 10, 47 },
+    { 42, 0, 11, 10, 47 },
+    { 44, 0, 11, 10, 53 },
+    { 46, 0, 13, 10, 53 },
+    { 48, 0, 13, 10, 59 },
+    { 50, 0, 13, 10, 59 },
+    { 52, 0, 13, 10, 59 },
+    { 54, 0, 13, 10, 59 },
+    { 56, 0, 13, 10, 61 },
+    { 58, 0, 13, 10, 67 },
+    { 60, 0, 13, 10, 67 },
+    { 62, 1, 13, 10, 67 },
+    { 64, 0, 13, 10, 71 },
+    { 66, 0, 13, 10, 71 },
+    { 68, 0, 17, 10, 79 },
+    { 70, 0, 17, 10, 79 },
+    { 72, 0, 17, 10, 83 },
+    { 74, 0, 17, 10, 83 },
+    { 76, 0, 17, 10, 89 },
+    { 78, 0, 17, 10, 89 },
+    { 80, 0, 17, 10, 89 },
+    { 82, 0, 17, 10, 89 },
+    { 84, 0, 17, 10, 97 },
+    { 86, 0, 17, 10, 97 },
+    { 88, 0, 17, 10, 97 },
+    { 90, 0, 17, 10, 97 },
+    { 92, 0, 17, 10, 101 },
+    { 94, 0, 17, 10, 101 },
+    { 96, 0, 17, 10, 103 },
+    { 98, 0, 17, 10, 107 },
+    { 100, 0, 17, 10, 107 },
+    { 102, 0, 17, 10, 109 },
+    { 104, 0, 17, 10, 113 },
+    { 106, 0, 19, 10, 127 },
+    { 108, 0, 19, 10, 127 },
+    { 110, 0, 19, 10, 127 },
+    { 112, 0, 19, 10, 127 },
+    { 114, 0, 19, 10, 127 },
+    { 116, 0, 19, 10, 127 },
+    { 118, 0, 19, 10, 127 },
+    { 120, 0, 19, 10, 131 },
+    { 122, 0, 19, 10, 131 },
+    { 124, 0, 19, 10, 131 },
+    { 126, 0, 19, 10, 137 },
+    { 128, 0, 19, 10, 137 },
+    { 130, 0, 19, 10, 137 },
+    { 132, 0, 19, 10, 139 },
+    { 134, 0, 19, 10, 149 },
+    { 136, 0, 19, 10, 149 },
+    { 138, 1, 23, 10, 149 },
+    { 140, 0, 23, 10, 151 },
+    { 142, 0, 23, 10, 157 },
+    { 144, 0, 23, 10, 157 },
+    { 146, 0, 23, 10, 157 },
+    { 148, 0, 23, 10, 163 },
+    { 150, 0, 23, 10, 163 },
+    { 152, 0, 23, 10, 163 },
+    { 154, 0, 23, 10, 167 },
+    { 156, 0, 23, 10, 167 },
+    { 158, 0, 23, 10, 173 },
+    { 160, 0, 23, 10, 173 },
+    { 162, 0, 23, 10, 173 },
+    { 164, 0, 23, 10, 179 },
+    { 166, 0, 23, 10, 179 },
+    { 168, 0, 23, 10, 179 },
+    { 170, 0, 23, 10, 179 },
+    { 172, 0, 23, 10, 181 },
+    { 174, 0, 23, 10, 191 },
+    { 176, 0, 23, 10, 191 },
+    { 178, 0, 23, 10, 191 },
+    { 180, 0, 23, 10, 191 },
+    { 182, 0, 23, 10, 191 },
+    { 184, 0, 23, 10, 193 },
+    { 186, 0, 23, 10, 197 },
+    { 188, 0, 23, 10, 197 },
+    { 190, 0, 23, 10, 199 },
+    { 192, 0, 23, 10, 211 },
+    { 194, 0, 23, 10, 211 },
+    { 196, 0, 23, 10, 211 },
+    { 198, 0, 23, 10, 211 },
+    { 200, 0, 23, 10, 211 },
+    { 202, 0, 29, 10, 223 },
+    { 204, 0, 29, 10, 223 },
+    { 206, 0, 29, 10, 223 },
+    { 208, 0, 29, 10, 223 },
+    { 210, 0, 29, 10, 227 },
+    { 212, 0, 29, 10, 227 },
+    { 214, 0, 29, 10, 229 },
+    { 216, 0, 29, 10, 233 },
+    { 218, 0, 29, 10, 233 },
+    { 220, 0, 29, 10, 239 },
+    { 222, 0, 29, 10, 239 },
+    { 224, 0, 29, 11, 239 },
+    { 226, 0, 29, 11, 239 },
+    { 228, 0, 29, 11, 241 },
+    { 230, 0, 29, 11, 251 },
+    { 232, 0, 29, 11, 251 },
+    { 234, 0, 29, 11, 251 },
+    { 236, 0, 29, 11, 251 },
+    { 238, 0, 29, 11, 251 },
+    { 240, 0, 29, 11, 257 },
+    { 242, 0, 29, 11, 257 },
+    { 244, 0, 29, 11, 257 },
+    { 246, 0, 29, 11, 263 },
+    { 248, 0, 29, 11, 263 },
+    { 250, 0, 29, 11, 263 },
+    { 252, 0, 29, 11, 269 },
+    { 254, 0, 29, 11, 269 },
+    { 256, 0, 29, 11, 269 },
+    { 258, 0, 29, 11, 271 },
+    { 260, 0, 29, 11, 277 },
+    { 262, 0, 29, 11, 277 },
+    { 264, 0, 29, 11, 277 },
+    { 266, 0, 29, 11, 281 },
+    { 268, 0, 29, 11, 281 },
+    { 270, 0, 29, 11, 283 },
+    { 272, 0, 29, 11, 293 },
+    { 274, 0, 29, 11, 293 },
+    { 276, 0, 29, 11, 293 },
+    { 278, 0, 29, 11, 293 },
+    { 280, 0, 29, 11, 293 },
+    { 282, 0, 29, 11, 307 },
+    { 284, 0, 29, 11, 307 },
+    { 286, 0, 29, 11, 307 },
+    { 288, 0, 29, 11, 307 },
+    { 290, 0, 29, 11, 307 },
+    { 292, 0, 29, 11, 307 },
+    { 294, 0, 29, 11, 307 },
+    { 296, 0, 29, 11, 307 },
+    { 298, 0, 29, 11, 311 },
+    { 300, 0, 29, 11, 311 },
+    { 302, 0, 31, 11, 317 },
+    { 304, 0, 31, 11, 317 },
+    { 306, 0, 31, 11, 331 },
+    { 308, 0, 31, 11, 331 },
+    { 310, 0, 31, 11, 331 },
+    { 312, 0, 31, 11, 331 },
+    { 314, 0, 31, 11, 331 },
+    { 316, 0, 31, 11, 331 },
+    { 318, 0, 31, 11, 331 },
+    { 320, 0, 31, 11, 337 },
+    { 322, 0, 31, 11, 337 },
+    { 324, 0, 31, 11, 337 },
+    { 326, 0, 31, 11, 347 },
+    { 328, 0, 31, 11, 347 },
+    { 330, 0, 31, 11, 347 },
+    { 332, 0, 31, 11, 347 },
+    { 334, 0, 31, 11, 347 },
+    { 336, 0, 31, 11, 349 },
+    { 338, 0, 31, 11, 353 },
+    { 340, 0, 31, 11, 353 },
+    { 342, 0, 31, 11, 359 },
+    { 344, 1, 31, 11, 359 },
+    { 346, 0, 31, 11, 359 },
+    { 348, 1, 31, 11, 367 },
+    { 350, 0, 31, 11, 367 },
+    { 352, 0, 37, 11, 373 },
+    { 354, 0, 37, 11, 373 },
+    { 356, 0, 37, 11, 379 },
+    { 358, 0, 37, 11, 379 },
+    { 360, 0, 37, 11, 379 },
+    { 362, 0, 37, 11, 379 },
+    { 364, 0, 37, 11, 383 },
+    { 366, 0, 37, 11, 383 },
+    { 368, 0, 37, 11, 389 },
+    { 370, 0, 37, 11, 389 },
+    { 372, 0, 37, 11, 389 },
+    { 374, 0, 37, 11, 397 },
+    { 376, 0, 37, 11, 397 },
+    { 378, 0, 37, 11, 397 },
+    { 380, 0, 37, 11, 397 },
+    { 382, 0, 37, 11, 401 },
+    { 384, 0, 37, 11, 401 },
+    { 386, 0, 37, 11, 409 },
+    { 388, 0, 37, 11, 409 },
+    { 390, 0, 37, 11, 409 },
+    { 392, 0, 37, 11, 409 },
+    { 394, 0, 37, 11, 419 },
+    { 396, 0, 37, 11, 419 },
+    { 398, 0, 37, 11, 419 },
+    { 400, 0, 37, 11, 419 },
+    { 402, 0, 37, 11, 419 },
+    { 404, 0, 37, 11, 421 },
+    { 406, 0, 37, 11, 431 },
+    { 408, 0, 37, 11, 431 },
+    { 410, 0, 37, 11, 431 },
+    { 412, 0, 37, 11, 431 },
+    { 414, 0, 37, 11, 431 },
+    { 416, 0, 37, 11, 433 },
+    { 418, 0, 37, 11, 439 },
+    { 420, 0, 37, 11, 439 },
+    { 422, 0, 37, 11, 439 },
+    { 428, 0, 37, 12, 449 },
+    { 436, 0, 37, 12, 457 },
+    { 444, 0, 37, 12, 461 },
+    { 452, 0, 37, 12, 467 },
+    { 460, 0, 37, 12, 479 },
+    { 469, 0, 37, 12, 487 },
+    { 477, 0, 37, 12, 499 },
+    { 486, 0, 37, 12, 503 },
+    { 495, 0, 37, 12, 509 },
+    { 504, 0, 41, 12, 523 },
+    { 513, 0, 41, 12, 541 },
+    { 522, 0, 41, 12, 541 },
+    { 532, 0, 41, 12, 557 },
+    { 542, 0, 41, 12, 563 },
+    { 552, 0, 41, 12, 569 },
+    { 562, 0, 41, 12, 587 },
+    { 572, 0, 41, 12, 593 },
+    { 583, 0, 41, 12, 599 },
+    { 593, 0, 41, 12, 613 },
+    { 604, 0, 43, 12, 631 },
+    { 615, 0, 43, 12, 641 },
+    { 626, 0, 43, 12, 643 },
+    { 638, 0, 47, 12, 659 },
+    { 650, 0, 47, 12, 673 },
+    { 661, 0, 47, 12, 683 },
+    { 674, 0, 47, 12, 701 },
+    { 686, 0, 47, 12, 709 },
+    { 698, 0, 47, 12, 719 },
+    { 711, 0, 47, 12, 733 },
+    { 724, 0, 47, 12, 751 },
+    { 738, 0, 47, 12, 757 },
+    { 751, 0, 53, 12, 787 },
+    { 765, 0, 53, 12, 797 },
+    { 779, 0, 53, 12, 809 },
+    { 793, 0, 53, 12, 821 },
+    { 808, 0, 53, 12, 839 },
+    { 822, 0, 53, 12, 853 },
+    { 837, 0, 53, 12, 863 },
+    { 853, 0, 53, 12, 877 },
+    { 868, 0, 53, 12, 907 },
+    { 884, 0, 53, 13, 907 },
+    { 900, 0, 53, 13, 929 },
+    { 917, 0, 59, 13, 947 },
+    { 934, 0, 59, 13, 967 },
+    { 951, 0, 59, 13, 983 },
+    { 968, 0, 59, 13, 997 },
+    { 986, 0, 59, 13, 1013 },
+    { 1004, 0, 59, 13, 1031 },
+    { 1022, 0, 59, 13, 1049 },
+    { 1041, 0, 59, 13, 1069 },
+    { 1060, 0, 59, 13, 1087 },
+    { 1080, 0, 59, 13, 1109 },
+    { 1099, 0, 59, 13, 1129 },
+    { 1120, 0, 61, 13, 1151 },
+    { 1140, 0, 61, 13, 1171 },
+    { 1161, 0, 61, 13, 1187 },
+    { 1182, 0, 67, 13, 1217 },
+    { 1204, 0, 67, 13, 1237 },
+    { 1226, 0, 67, 13, 1259 },
+    { 1248, 0, 67, 13, 1279 },
+    { 1271, 0, 67, 13, 1303 },
+    { 1294, 0, 67, 13, 1327 },
+    { 1318, 0, 67, 13, 1361 },
+    { 1342, 0, 67, 13, 1373 },
+    { 1367, 0, 67, 13, 1399 },
+    { 1392, 0, 71, 13, 1427 },
+    { 1417, 0, 71, 13, 1451 },
+    { 1443, 0, 71, 13, 1481 },
+    { 1470, 0, 71, 13, 1511 },
+    { 1497, 0, 71, 13, 1531 },
+    { 1524, 0, 73, 13, 1559 },
+    { 1552, 0, 73, 13, 1597 },
+    { 1580, 0, 73, 13, 1613 },
+    { 1609, 0, 79, 13, 1657 },
+    { 1639, 0, 79, 14, 1693 },
+    { 1669, 0, 79, 14, 1709 },
+    { 1699, 0, 79, 14, 1741 },
+    { 1731, 0, 79, 14, 1777 },
+    { 1762, 0, 79, 14, 1801 },
+    { 1794, 0, 79, 14, 1831 },
+    { 1827, 0, 83, 14, 1867 },
+    { 1861, 0, 83, 14, 1901 },
+    { 1895, 0, 83, 14, 1949 },
+    { 1930, 0, 83, 14, 1973 },
+    { 1965, 0, 89, 14, 2011 },
+    { 2001, 0, 89, 14, 2053 },
+    { 2038, 0, 89, 14, 2081 },
+    { 2075, 0, 89, 14, 2129 },
+    { 2113, 0, 89, 14, 2161 },
+    { 2152, 0, 89, 14, 2203 },
+    { 2191, 0, 89, 14, 2237 },
+    { 2231, 0, 97, 14, 2281 },
+    { 2272, 0, 97, 14, 2333 },
+    { 2313, 0, 97, 14, 2371 },
+    { 2356, 0, 97, 14, 2411 },
+    { 2399, 0, 97, 14, 2447 },
+    { 2443, 0, 97, 14, 2503 },
+    { 2488, 0, 97, 14, 2539 },
+    { 2533, 0, 101, 14, 2591 },
+    { 2580, 0, 101, 14, 2633 },
+    { 2627, 0, 101, 14, 2677 },
+    { 2675, 0, 101, 14, 2729 },
+    { 2724, 0, 103, 14, 2777 },
+    { 2774, 0, 103, 14, 2833 },
+    { 2825, 0, 107, 14, 2879 },
+    { 2876, 0, 107, 14, 2939 },
+    { 2929, 0, 109, 14, 2999 },
+    { 2983, 0, 109, 14, 3037 },
+    { 3037, 0, 113, 14, 3109 },
+    { 3093, 0, 113, 14, 3163 },
+    { 3149, 0, 113, 14, 3209 },
+    { 3207, 0, 127, 14, 3299 },
+    { 3266, 0, 127, 14, 3343 },
+    { 3326, 0, 127, 15, 3407 },
+    { 3387, 0, 127, 15, 3457 },
+    { 3449, 0, 127, 15, 3517 },
+    { 3512, 0, 127, 15, 3581 },
+    { 3576, 0, 127, 15, 3643 },
+    { 3642, 0, 127, 15, 3709 },
+    { 3708, 0, 127, 15, 3779 },
+    { 3776, 0, 127, 15, 3847 },
+    { 3845, 0, 131, 15, 3917 },
+    { 3916, 0, 131, 15, 3989 },
+    { 3987, 0, 131, 15, 4057 },
+    { 4060, 0, 137, 15, 4133 },
+    { 4135, 0, 137, 15, 4211 },
+    { 4211, 0, 137, 15, 4283 },
+    { 4288, 0, 137, 15, 4363 },
+    { 4366, 0, 139, 15, 4441 },
+    { 4446, 0, 149, 15, 4547 },
+    { 4528, 0, 149, 15, 4621 },
+    { 4610, 0, 149, 15, 4691 },
+    { 4695, 0, 149, 15, 4783 },
+    { 4781, 0, 149, 15, 4861 },
+    { 4868, 0, 149, 15, 4951 },
+    { 4958, 0, 151, 15, 5039 },
+    { 5048, 0, 157, 15, 5147 },
+    { 5141, 0, 157, 15, 5227 },
+    { 5235, 0, 157, 15, 5323 },
+    { 5331, 0, 163, 15, 5431 },
+    { 5428, 0, 163, 15, 5519 },
+    { 5528, 0, 163, 15, 5623 },
+    { 5629, 0, 167, 15, 5737 },
+    { 5732, 0, 167, 15, 5827 },
+    { 5837, 0, 173, 15, 5939 },
+    { 5944, 0, 173, 15, 6043 },
+    { 6053, 0, 173, 15, 6151 },
+    { 6164, 0, 179, 15, 6269 },
+    { 6276, 0, 179, 16, 6379 },
+    { 6391, 0, 179, 16, 6491 },
+    { 6508, 0, 181, 16, 6619 },
+    { 6628, 0, 191, 16, 6737 },
+    { 6749, 0, 191, 16, 6857 },
+    { 6873, 0, 191, 16, 6983 },
+    { 6998, 0, 191, 16, 7109 },
+    { 7127, 0, 193, 16, 7237 },
+    { 7257, 0, 197, 16, 7369 },
+    { 7390, 0, 197, 16, 7507 },
+    { 7525, 0, 211, 16, 7649 },
+    { 7663, 0, 211, 16, 7789 },
+    { 7803, 0, 211, 16, 7927 },
+    { 7946, 0, 211, 16, 8069 },
+    { 8092, 0, 211, 16, 8219 },
+    { 8240, 0, 223, 16, 8377 },
+    { 8391, 0, 223, 16, 8527 },
+    { 8545, 0, 223, 16, 8677 },
+    { 8701, 0, 223, 16, 8831 },
+    { 8860, 0, 223, 16, 8999 },
+    { 9023, 0, 227, 16, 9157 },
+    { 9188, 0, 229, 16, 9323 },
+    { 9356, 0, 233, 16, 9497 },
+    { 9527, 0, 239, 16, 9677 },
+    { 9702, 0, 239, 16, 9851 },
+    { 9880, 0, 241, 16, 10037 },
+    { 10060, 0, 251, 16, 10211 },
+    { 10245, 0, 251, 16, 10399 },
+    { 10432, 0, 251, 16, 10589 },
+    { 10623, 0, 257, 16, 10781 },
+    { 10818, 0, 257, 16, 10973 },
+    { 11016, 0, 263, 16, 11177 },
+    { 11218, 0, 269, 16, 11383 },
+    { 11423, 0, 269, 16, 11587 },
+    { 11632, 0, 271, 16, 11801 },
+    { 11845, 0, 277, 16, 12037 },
+    { 12062, 0, 277, 16, 12239 },
+    { 12283, 0, 281, 16, 12457 },
+    { 12508, 0, 293, 16, 12689 },
+    { 12737, 0, 293, 17, 12917 },
+    { 12970, 0, 293, 17, 13151 },
+    { 13208, 0, 307, 17, 13411 },
+    { 13450, 0, 307, 17, 13649 },
+    { 13696, 0, 307, 17, 13901 },
+    { 13947, 0, 311, 17, 14143 },
+    { 14202, 0, 313, 17, 14401 },
+    { 14462, 0, 317, 17, 14669 },
+    { 14727, 0, 331, 17, 14939 },
+    { 14997, 0, 331, 17, 15217 },
+    { 15271, 0, 331, 17, 15493 },
+    { 15551, 0, 337, 17, 15767 },
+    { 15836, 0, 347, 17, 16057 },
+    { 16126, 0, 347, 17, 16349 },
+    { 16421, 0, 347, 17, 16649 },
+    { 16722, 0, 353, 17, 16963 },
+    { 17028, 0, 359, 17, 17257 },
+    { 17340, 0, 367, 17, 17579 },
+    { 17657, 0, 367, 17, 17891 },
+    { 17981, 0, 373, 17, 18223 },
+    { 18310, 0, 379, 17, 18553 },
+    { 18645, 0, 383, 17, 18899 },
+    { 18987, 0, 389, 17, 19249 },
+    { 19334, 0, 397, 17, 19597 },
+    { 19688, 0, 397, 17, 19949 },
+    { 20049, 0, 409, 17, 20323 },
+    { 20416, 0, 409, 17, 20693 },
+    { 20790, 0, 419, 17, 21067 },
+    { 21171, 0, 419, 17, 21467 },
+    { 21558, 0, 431, 17, 21851 },
+    { 21953, 0, 431, 17, 22247 },
+    { 22355, 0, 439, 17, 22651 },
+    { 22764, 0, 443, 17, 23057 },
+    { 23181, 0, 449, 17, 23497 },
+    { 23606, 0, 457, 17, 23909 },
+    { 24038, 0, 461, 18, 24359 },
+    { 24478, 0, 467, 18, 24793 },
+    { 24927, 0, 479, 18, 25253 },
+    { 25383, 0, 487, 18, 25717 },
+    { 25848, 0, 487, 18, 26177 },
+    { 26321, 0, 499, 18, 26669 },
+    { 26803, 0, 503, 18, 27143 },
+    { 27294, 0, 509, 18, 27647 },
+    { 27794, 0, 521, 18, 28151 },
+    { 28303, 0, 523, 18, 28657 },
+    { 28821, 0, 541, 18, 29201 },
+    { 29349, 0, 541, 18, 29723 },
+    { 29886, 0, 547, 18, 30269 },
+    { 30434, 0, 557, 18, 30817 },
+    { 30991, 0, 563, 18, 31379 },
+    { 31558, 0, 569, 18, 31957 },
+    { 32136, 0, 577, 18, 32533 },
+    { 32725, 0, 587, 18, 33149 },
+    { 33324, 0, 593, 18, 33739 },
+    { 33934, 0, 607, 18, 34361 },
+    { 34556, 0, 613, 18, 35023 },
+    { 35188, 0, 619, 18, 35671 },
+    { 35833, 0, 631, 18, 36277 },
+    { 36489, 0, 641, 18, 36943 },
+    { 37157, 0, 647, 18, 37619 },
+    { 37838, 0, 659, 18, 38303 },
+    { 38530, 0, 673, 18, 39019 },
+    { 39236, 0, 677, 18, 39719 },
+    { 39954, 0, 691, 18, 40459 },
+    { 40686, 0, 701, 18, 41189 },
+    { 41431, 0, 709, 18, 41941 },
+    { 42190, 0, 719, 18, 42703 },
+    { 42962, 0, 727, 18, 43481 },
+    { 43749, 0, 739, 18, 44279 },
+    { 44550, 0, 751, 18, 45119 },
+    { 45366, 0, 757, 18, 45943 },
+    { 46197, 0, 769, 18, 46751 },
+    { 47043, 0, 787, 18, 47623 },
+    { 47904, 0, 797, 19, 48487 },
+    { 48781, 0, 809, 19, 49369 },
+    { 49675, 0, 821, 19, 50273 },
+    { 50584, 0, 827, 19, 51193 },
+    { 51511, 0, 839, 19, 52127 },
+    { 52454, 0, 853, 19, 53077 },
+    { 53415, 0, 863, 19, 54049 },
+    { 54393, 0, 877, 19, 55049 },
+    { 55389, 0, 907, 19, 56081 },
+    { 56403, 0, 907, 19, 57073 },
+};
+
+#endif /* LIBAVTRANSPORT_RAPTORQ_TABLES */
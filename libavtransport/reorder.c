@@ -25,27 +25,1022 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "reorder.h"
+#include "decode.h"
+#include "fec.h"
+#include "ldpc_encode.h"
+
+/* Packets are assumed to be at least this large on average,
+ * when sizing the packet and chain buffers */
+#define REORDER_AVG_PKT_SIZE 1024
+
+/* Used when no buffer size limit is given */
+#define REORDER_DEFAULT_SIZE (8*1024*1024)
+
+/* Arrays in the arena each start on a cacheline */
+#define REORDER_ALIGN(x) (((x) + 63) & ~((size_t)63))
+
+/* Loss detection. Times are in nanoseconds. */
+#define NACK_WINDOW AVT_REORDER_NACK_WINDOW
+#define NACK_MAX_TRIES 4
+#define NACK_INITIAL_RTT (50*1000000)
+#define NACK_MIN_RTO (2*1000000)
+
+/* Parity whose data has not shown up after this many packets
+ * is dropped */
+#define PARITY_MAX_AGE NACK_WINDOW
+
+#define NIL AVT_REORDER_NIL
+
+/* The global chain, listing all packets */
+#define GLOBAL 0
+
+static inline size_t hdr_offset(union AVTPacketData pkt)
+{
+    switch (pkt.desc) {
+    case AVT_PKT_STREAM_DATA_SEGMENT:
+        return pkt.generic_segment.seg_offset;
+    case AVT_PKT_STREAM_DATA_PARITY:
+        return pkt.generic_parity.parity_data_offset;
+    default:
+        return 0;
+    }
+}
+
+static inline uint32_t chain_idx(AVTReorderBuffer *rb, const AVTReorderChain *c)
+{
+    return c - rb->chain;
+}
+
+static inline bool chain_has_header(AVTReorderBuffer *rb, const AVTReorderChain *c)
+{
+    return c->start != NIL && rb->link[c->start].desc == AVT_PKT_STREAM_DATA;
+}
+
+static uint32_t pkt_new(AVTReorderBuffer *rb, AVTReorderChain *c,
+                        union AVTPacketData pkt, AVTBuffer *pl,
+                        size_t offset, size_t len)
+{
+    uint32_t i = rb->free_pkt;
+    AVTReorderPkt *p = &rb->pkt[i];
+    AVTReorderLink *l = &rb->link[i];
+    rb->free_pkt = l->global_next;
+
+    p->pkt = pkt;
+    p->recv_order = rb->recv_order++;
+    memset(&p->pl, 0, sizeof(p->pl));
+    if (len)
+        avt_buffer_quick_ref(&p->pl, pl, offset, len);
+
+    AVTReorderChain *g = &rb->chain[GLOBAL];
+    *l = (AVTReorderLink) {
+        .chain = chain_idx(rb, c),
+        .prev = NIL,
+        .next = NIL,
+        .global_prev = g->top,
+        .global_next = NIL,
+        .offset = hdr_offset(pkt),
+        .len = len,
+        .desc = pkt.desc,
+    };
+
+    if (g->top != NIL)
+        rb->link[g->top].global_next = i;
+    else
+        g->start = i;
+    g->top = i;
+    g->nb_packets++;
+
+    /* Payloads placed in the chain's buffer are accounted for with it */
+    size_t size = avt_pkt_hdr_size(pkt) + (c->data ? 0 : len);
+    g->payload_size += size;
+    rb->global_size += size;
+    rb->nb_pkt++;
+
+    c->nb_packets++;
+    c->payload_size += len;
+
+    return i;
+}
+
+static void pkt_free(AVTReorderBuffer *rb, uint32_t i)
+{
+    AVTReorderChain *g = &rb->chain[GLOBAL];
+    AVTReorderLink *l = &rb->link[i];
+
+    if (l->global_prev != NIL)
+        rb->link[l->global_prev].global_next = l->global_next;
+    else
+        g->start = l->global_next;
+    if (l->global_next != NIL)
+        rb->link[l->global_next].global_prev = l->global_prev;
+    else
+        g->top = l->global_prev;
+    g->nb_packets--;
+
+    size_t size = avt_pkt_hdr_size(rb->pkt[i].pkt) +
+                  (rb->chain[l->chain].data ? 0 : l->len);
+    g->payload_size -= size;
+    rb->global_size -= size;
+    rb->nb_pkt--;
+
+    avt_buffer_quick_unref(&rb->pkt[i].pl);
+
+    l->global_next = rb->free_pkt;
+    rb->free_pkt = i;
+}
+
+static inline uint32_t lookup_hash(AVTReorderBuffer *rb,
+                                   enum AVTReorderChainType type, uint64_t seq)
+{
+    uint64_t key = (seq << 1) | (type == AVT_REORDER_CHAIN_PARITY);
+    return (key * UINT64_C(0x9E3779B97F4A7C15)) >> 32 & rb->lookup_mask;
+}
+
+/* Find an unfinished chain being reassembled */
+static AVTReorderChain *chain_find(AVTReorderBuffer *rb,
+                                   enum AVTReorderChainType type, uint64_t seq)
+{
+    for (uint32_t h = lookup_hash(rb, type, seq); rb->lookup[h] != NIL;
+         h = (h + 1) & rb->lookup_mask) {
+        AVTReorderChain *c = &rb->chain[rb->lookup[h]];
+        if (c->type == type && c->seq == seq)
+            return c;
+    }
+    return NULL;
+}
+
+static void chain_activate(AVTReorderBuffer *rb, AVTReorderChain *c)
+{
+    uint32_t h = lookup_hash(rb, c->type, c->seq);
+    while (rb->lookup[h] != NIL)
+        h = (h + 1) & rb->lookup_mask;
+    rb->lookup[h] = chain_idx(rb, c);
+    c->active = true;
+}
+
+static void chain_deactivate(AVTReorderBuffer *rb, AVTReorderChain *c)
+{
+    if (!c->active)
+        return;
+    c->active = false;
+
+    uint32_t idx = chain_idx(rb, c);
+    uint32_t h = lookup_hash(rb, c->type, c->seq);
+    while (rb->lookup[h] != idx)
+        h = (h + 1) & rb->lookup_mask;
+
+    /* Shift back entries which would become unreachable */
+    for (uint32_t j = h;;) {
+        j = (j + 1) & rb->lookup_mask;
+        if (rb->lookup[j] == NIL)
+            break;
+
+        AVTReorderChain *o = &rb->chain[rb->lookup[j]];
+        uint32_t home = lookup_hash(rb, o->type, o->seq);
+        if (((j - home) & rb->lookup_mask) >= ((j - h) & rb->lookup_mask)) {
+            rb->lookup[h] = rb->lookup[j];
+            h = j;
+        }
+    }
+
+    rb->lookup[h] = NIL;
+}
+
+static void chain_free(AVTReorderBuffer *rb, AVTReorderChain *c);
+
+/* Drop the oldest parity chain if its data never arrived, and
+ * it has waited long enough, or if forced to. Returns false if
+ * it has to be kept. */
+static bool parity_age_pop(AVTReorderBuffer *rb, bool force)
+{
+    AVTReorderChain *c = &rb->chain[rb->parity_age[rb->parity_age_first]];
+
+    /* Entries of chains which have since been freed are skipped */
+    if (c->type == AVT_REORDER_CHAIN_PARITY && c->active && c->parity == NIL) {
+        if (!force && (rb->recv_order - c->created) < PARITY_MAX_AGE)
+            return false;
+        chain_free(rb, c);
+    }
+
+    rb->parity_age_first = (rb->parity_age_first + 1) % rb->nb_chains_allocated;
+    rb->parity_age_nb--;
+    return true;
+}
+
+static AVTReorderChain *chain_new(AVTReorderBuffer *rb,
+                                  enum AVTReorderChainType type,
+                                  uint64_t seq, uint16_t stream_id)
+{
+    AVTReorderChain *c = &rb->chain[rb->free_chain];
+    rb->free_chain = c->next;
+    rb->nb_chains++;
+
+    memset(c, 0, sizeof(*c));
+    c->type = type;
+    c->seq = seq;
+    c->stream_id = stream_id;
+    c->start = c->top = NIL;
+    c->next = NIL;
+    c->parity = NIL;
+    c->fec_group = NIL;
+    c->created = rb->recv_order;
+
+    if (type == AVT_REORDER_CHAIN_PARITY) {
+        if (rb->parity_age_nb == rb->nb_chains_allocated)
+            parity_age_pop(rb, true);
+        uint32_t pos = (rb->parity_age_first + rb->parity_age_nb++) %
+                       rb->nb_chains_allocated;
+        rb->parity_age[pos] = chain_idx(rb, c);
+    }
+
+    if (type == AVT_REORDER_CHAIN_STREAM_DATA ||
+        type == AVT_REORDER_CHAIN_PARITY) {
+        /* Parity may arrive before the data it protects */
+        enum AVTReorderChainType other = type == AVT_REORDER_CHAIN_PARITY ?
+                                         AVT_REORDER_CHAIN_STREAM_DATA :
+                                         AVT_REORDER_CHAIN_PARITY;
+        AVTReorderChain *o = chain_find(rb, other, seq);
+        if (o) {
+            c->parity = chain_idx(rb, o);
+            o->parity = chain_idx(rb, c);
+        }
+
+        chain_activate(rb, c);
+    }
+
+    return c;
+}
+
+static void chain_free(AVTReorderBuffer *rb, AVTReorderChain *c)
+{
+    uint32_t idx = chain_idx(rb, c);
+
+    chain_deactivate(rb, c);
+    if (c->parity != NIL) {
+        AVTReorderChain *o = &rb->chain[c->parity];
+        o->parity = NIL;
+        c->parity = NIL;
+        /* Parity is of no use without the data it protects */
+        if (c->type == AVT_REORDER_CHAIN_STREAM_DATA)
+            chain_free(rb, o);
+    }
+    if (rb->top_stream_data == idx)
+        rb->top_stream_data = NIL;
+
+    uint32_t i = c->start;
+    while (i != NIL) {
+        uint32_t next = rb->link[i].next;
+        pkt_free(rb, i);
+        i = next;
+    }
+
+    if (c->data) {
+        size_t size = avt_buffer_get_data_len(c->data);
+        rb->chain[GLOBAL].payload_size -= size;
+        rb->global_size -= size;
+        avt_buffer_unref(&c->data);
+        free(c->sym_bytes);
+        c->sym_bytes = c->sym_done = NULL;
+    }
+
+    c->next = rb->free_chain;
+    rb->free_chain = idx;
+    rb->nb_chains--;
+}
+
+static void chain_link_before(AVTReorderBuffer *rb, AVTReorderChain *c,
+                              uint32_t next, uint32_t i)
+{
+    AVTReorderLink *l = &rb->link[i];
+    l->next = next;
+    l->prev = next != NIL ? rb->link[next].prev : c->top;
+    if (l->prev != NIL)
+        rb->link[l->prev].next = i;
+    else
+        c->start = i;
+    if (next != NIL)
+        rb->link[next].prev = i;
+    else
+        c->top = i;
+}
+
+static void chain_unlink(AVTReorderBuffer *rb, AVTReorderChain *c, uint32_t i)
+{
+    AVTReorderLink *l = &rb->link[i];
+    if (l->prev != NIL)
+        rb->link[l->prev].next = l->next;
+    else
+        c->start = l->next;
+    if (l->next != NIL)
+        rb->link[l->next].prev = l->prev;
+    else
+        c->top = l->prev;
+
+    c->nb_packets--;
+    c->payload_size -= l->len;
+    pkt_free(rb, i);
+}
+
+static inline size_t chain_nb_sym(const AVTReorderChain *c)
+{
+    return (c->tot_payload_size + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+}
+
+/* Mark [off, off + len) of a chain's payload as received, and the source
+ * symbols this completes as done */
+static void chain_cover(AVTReorderChain *c, size_t off, size_t len)
+{
+    const size_t t = AVT_FEC_SYMBOL_SIZE;
+    const size_t end = off + len;
+    if (!len)
+        return;
+
+    for (size_t b = off; b < end;) {
+        size_t n = AVT_MIN(64 - (b & 63), end - b);
+        uint64_t m = n == 64 ? UINT64_MAX : (UINT64_C(1) << n) - 1;
+        c->sym_bytes[b >> 6] |= m << (b & 63);
+        b += n;
+    }
+
+    /* Symbols never straddle words of sym_bytes */
+    for (size_t s = off / t; s <= (end - 1) / t; s++) {
+        uint64_t bit = UINT64_C(1) << (s & 63);
+        if (c->sym_done[s >> 6] & bit)
+            continue;
+        size_t b = s*t;
+        if (((c->sym_bytes[b >> 6] >> (b & 63)) & ((UINT64_C(1) << t) - 1)) ==
+            ((UINT64_C(1) << t) - 1)) {
+            c->sym_done[s >> 6] |= bit;
+            c->nb_sym_done++;
+        }
+    }
+}
+
+/* Copy a packet's payload to its place in the chain's buffer, and reference
+ * it from there, letting go of the buffer it arrived in */
+static void chain_place(AVTReorderBuffer *rb, AVTReorderChain *c, uint32_t i)
+{
+    AVTReorderPkt *p = &rb->pkt[i];
+    size_t off = rb->link[i].offset;
+    size_t len = rb->link[i].len;
+    if (!len)
+        return;
+
+    size_t tmp;
+    uint8_t *data = avt_buffer_get_data(c->data, &tmp);
+    memcpy(&data[off], p->pl.data, len);
+    avt_buffer_quick_unref(&p->pl);
+    avt_buffer_quick_ref(&p->pl, c->data, off, len);
+
+    chain_cover(c, off, len);
+}
+
+/* Start assembling a stream data chain's payload, once its size is known */
+static int chain_alloc(AVTContext *ctx, AVTReorderBuffer *rb,
+                       AVTReorderChain *c)
+{
+    size_t len = c->tot_payload_size;
+    size_t size = (len + AVT_FEC_SYMBOL_SIZE - 1) & ~((size_t)AVT_FEC_SYMBOL_SIZE - 1);
+
+    AVTBuffer *buf = avt_buffer_pool_get(ctx->buffer_pool, size);
+    if (!buf)
+        return AVT_ERROR(ENOMEM);
+
+    /* Blocks may hold tens of thousands of symbols */
+    size_t nb_words = (size + 63) >> 6;
+    uint64_t *bitmaps = calloc(nb_words + ((chain_nb_sym(c) + 63) >> 6) + 1,
+                               sizeof(*bitmaps));
+    if (!bitmaps) {
+        avt_buffer_unref(&buf);
+        return AVT_ERROR(ENOMEM);
+    }
+
+    /* Missing symbols are recovered whole, only the padding must be zero */
+    size_t tmp;
+    uint8_t *data = avt_buffer_get_data(buf, &tmp);
+    memset(&data[len], 0, size - len);
+
+    for (uint32_t i = c->start; i != NIL; i = rb->link[i].next) {
+        rb->chain[GLOBAL].payload_size -= rb->link[i].len;
+        rb->global_size -= rb->link[i].len;
+    }
+    rb->chain[GLOBAL].payload_size += size;
+    rb->global_size += size;
+
+    c->data = buf;
+    c->sym_bytes = bitmaps;
+    c->sym_done = &bitmaps[nb_words];
+    c->nb_sym_done = 0;
+
+    /* The padding counts as received */
+    chain_cover(c, len, size - len);
+
+    for (uint32_t i = c->start, next; i != NIL; i = next) {
+        next = rb->link[i].next;
+        if (((size_t)rb->link[i].offset + rb->link[i].len) > len)
+            chain_unlink(rb, c, i);
+        else
+            chain_place(rb, c, i);
+    }
+
+    return 0;
+}
+
+/* Insert a packet, keeping the chain sorted by offset.
+ * Returns AVT_ERROR(EEXIST) for duplicates. */
+static int chain_insert(AVTReorderBuffer *rb, AVTReorderChain *c,
+                        union AVTPacketData pkt, AVTBuffer *pl,
+                        size_t offset)
+{
+    size_t len = avt_buffer_get_data_len(pl);
+    if (c->data && (offset + len) > c->tot_payload_size)
+        return AVT_ERROR(EINVAL);
+
+    /* Packets mostly arrive in order, so search from the end */
+    uint32_t next = NIL, prev = c->top;
+    while (prev != NIL && rb->link[prev].offset > offset) {
+        next = prev;
+        prev = rb->link[prev].prev;
+    }
+
+    if (prev != NIL && rb->link[prev].offset == offset &&
+        rb->link[prev].desc == pkt.desc)
+        return AVT_ERROR(EEXIST);
+
+    uint32_t i = pkt_new(rb, c, pkt, pl, 0, len);
+    chain_link_before(rb, c, next, i);
+    if (c->data)
+        chain_place(rb, c, i);
+
+    return 0;
+}
+
+static void chain_add_header_7(AVTReorderChain *c, uint64_t global_seq,
+                               const uint8_t header_7[4])
+{
+    int part = global_seq % 7;
+    memcpy(&c->header_7[part*4], header_7, 4);
+    c->header_7_mask |= 1 << part;
+}
+
+/* Returns the number of ranges in [0, total) not covered by the chain,
+ * and marks the symbols of size sym they overlap in mask, if given */
+static int chain_gaps(AVTReorderBuffer *rb, const AVTReorderChain *c,
+                      size_t total, size_t sym, uint64_t *mask)
+{
+    int nb = 0;
+    size_t end = 0;
+
+    for (uint32_t i = c->start; end < total; i = rb->link[i].next) {
+        const AVTReorderLink *l = i != NIL ? &rb->link[i] : NULL;
+        size_t off = l ? AVT_MIN(l->offset, total) : total;
+        if (off > end) {
+            nb++;
+            for (size_t s = end / sym; mask && s <= (off - 1) / sym; s++)
+                mask[s >> 6] |= 1ULL << (s & 63);
+        }
+        if (!l)
+            break;
+        end = AVT_MAX(end, (size_t)l->offset + l->len);
+    }
+
+    return nb;
+}
+
+/* Rebuild the first packet's header from the parts segments and parity carry */
+static int chain_rebuild_header(AVTReorderChain *c, union AVTPacketData *pkt)
+{
+    uint8_t data[36];
+    memcpy(data, c->header_7, sizeof(c->header_7));
+    avt_ldpc_encode_288_224(&data[28], data);
+
+    AVTBuffer tmp = { .data = data, .len = sizeof(data) };
+    int64_t ret = avt_decode_packet_size(&tmp, pkt);
+    if (ret < 0)
+        return ret;
+    else if (pkt->desc != AVT_PKT_STREAM_DATA || pkt->seq != c->seq ||
+             pkt->stream_data.data_length > c->tot_payload_size)
+        return AVT_ERROR(EINVAL);
+
+    return 0;
+}
+
+/* Copy the payloads of a chain into data, of size len */
+static void chain_copy(AVTReorderBuffer *rb, const AVTReorderChain *c,
+                       uint8_t *data, size_t len)
+{
+    for (uint32_t i = c->start; i != NIL; i = rb->link[i].next) {
+        const AVTReorderLink *l = &rb->link[i];
+        if (l->offset < len)
+            memcpy(&data[l->offset], rb->pkt[i].pl.data,
+                   AVT_MIN(l->len, len - l->offset));
+    }
+}
+
+/* Rebuild whatever is missing of a stream data chain using its parity chain.
+ * Returns 1 if the chain is now complete. */
+static int chain_recover(AVTContext *ctx, AVTReorderBuffer *rb,
+                         AVTReorderChain *c)
+{
+    int err;
+    union AVTPacketData hdr;
+    size_t len = c->tot_payload_size;
+    if (c->parity == NIL || !c->data)
+        return 0;
+    AVTReorderChain *pc = &rb->chain[c->parity];
+
+    bool has_header = chain_has_header(rb, c);
+    if (!has_header) {
+        for (int i = 0; i < 7; i++)
+            if ((pc->header_7_mask & ~c->header_7_mask) & (1 << i))
+                chain_add_header_7(c, i, &pc->header_7[i*4]);
+        if (c->header_7_mask != 0x7F)
+            return 0;
+    }
+
+    size_t par_total = pc->tot_payload_size;
+    if (!par_total || (par_total % AVT_FEC_SYMBOL_SIZE) || len > AVT_FEC_MAX_LEN)
+        return 0;
+
+    /* The header is added as a packet of its own */
+    if (!has_header && rb->free_pkt == NIL)
+        return 0;
+
+    /* Not worth trying with fewer repair symbols than missing ones */
+    const size_t nb_source = chain_nb_sym(c);
+    const size_t nb_par = par_total / AVT_FEC_SYMBOL_SIZE;
+    const size_t nb_lost = nb_source - c->nb_sym_done;
+    if ((pc->payload_size / AVT_FEC_SYMBOL_SIZE) < nb_lost)
+        return 0;
+
+    uint64_t *lost = calloc(((nb_source + 63) >> 6) + ((nb_par + 63) >> 6),
+                            sizeof(*lost));
+    if (!lost)
+        return 0;
+    uint64_t *par_lost = &lost[(nb_source + 63) >> 6];
+
+    for (size_t i = 0; i < ((nb_source + 63) >> 6); i++)
+        lost[i] = ~c->sym_done[i];
+    if (nb_source & 63)
+        lost[nb_source >> 6] &= (UINT64_C(1) << (nb_source & 63)) - 1;
+    chain_gaps(rb, pc, par_total, AVT_FEC_SYMBOL_SIZE, par_lost);
+
+    size_t nb_repair = nb_par;
+    for (size_t i = 0; i < ((nb_par + 63) >> 6); i++)
+        nb_repair -= __builtin_popcountll(par_lost[i]);
+
+    AVTBuffer *par = NULL;
+    err = 0;
+    if (nb_repair < nb_lost)
+        goto end;
+
+    if (!has_header) {
+        err = chain_rebuild_header(c, &hdr);
+        if (err < 0)
+            goto end;
+    }
+
+    par = avt_buffer_pool_get(ctx->buffer_pool, par_total);
+    if (!par)
+        goto end;
+
+    size_t tmp;
+    uint8_t *data = avt_buffer_get_data(c->data, &tmp);
+    uint8_t *par_data = avt_buffer_get_data(par, &tmp);
+    chain_copy(rb, pc, par_data, par_total);
+
+    err = avt_fec_decode(data, len, lost, par_data, nb_par, par_lost);
+    if (err < 0)
+        goto end;
+
+    for (size_t i = 0; i < ((nb_source + 63) >> 6); i++)
+        c->sym_done[i] |= lost[i];
+    c->nb_sym_done = nb_source;
+
+    if (!has_header) {
+        uint32_t i = pkt_new(rb, c, hdr, c->data, 0, hdr.stream_data.data_length);
+        chain_link_before(rb, c, c->start, i);
+    }
+
+    err = 1;
+
+end:
+    avt_buffer_unref(&par);
+    free(lost);
+    return err < 0 ? 0 : err;
+}
+
+static void chain_finish(AVTReorderBuffer *rb, AVTReorderChain *c)
+{
+    uint32_t idx = chain_idx(rb, c);
+
+    chain_deactivate(rb, c);
+
+    /* Parity is of no further use */
+    if (c->parity != NIL) {
+        AVTReorderChain *pc = &rb->chain[c->parity];
+        pc->parity = NIL;
+        c->parity = NIL;
+        chain_free(rb, pc);
+    }
+
+    /* Parity still to arrive for it is dropped on sight */
+    if (c->type == AVT_REORDER_CHAIN_STREAM_DATA ||
+        (c->type == AVT_REORDER_CHAIN_SINGLE &&
+         rb->link[c->start].desc == AVT_PKT_STREAM_DATA))
+        rb->done_seq[c->seq & rb->done_mask] = c->seq;
+
+    c->finished = true;
+    c->next = NIL;
+    if (rb->finished_last != NIL)
+        rb->chain[rb->finished_last].next = idx;
+    else
+        rb->finished_first = idx;
+    rb->finished_last = idx;
+}
+
+static void chain_update(AVTContext *ctx, AVTReorderBuffer *rb,
+                         AVTReorderChain *c)
+{
+    if (c->type == AVT_REORDER_CHAIN_PARITY) {
+        if (c->parity == NIL)
+            return;
+        c = &rb->chain[c->parity];
+    }
+
+    /* Complete as received, otherwise try to avoid waiting for a resend */
+    if ((chain_has_header(rb, c) && c->data &&
+         c->nb_sym_done == chain_nb_sym(c)) ||
+        chain_recover(ctx, rb, c))
+        chain_finish(rb, c);
+}
+
+/* Drop the oldest unfinished chain */
+static int reorder_evict(AVTReorderBuffer *rb)
+{
+    for (uint32_t i = rb->chain[GLOBAL].start; i != NIL; i = rb->link[i].global_next) {
+        AVTReorderChain *c = &rb->chain[rb->link[i].chain];
+        if (!c->finished) {
+            chain_free(rb, c);
+            return 0;
+        }
+    }
+
+    return AVT_ERROR(ENOMEM);
+}
+
+static inline bool nack_has(AVTReorderNack *n, uint64_t seq)
+{
+    uint32_t idx = seq % NACK_WINDOW;
+    return (n->received[idx >> 6] >> (idx & 63)) & 1;
+}
+
+static void nack_received(AVTReorderNack *n, uint32_t wire_seq)
+{
+    if (!n->init) {
+        n->init = true;
+        n->base = n->top = AVT_SEQ_INIT(wire_seq);
+        n->rtt = NACK_INITIAL_RTT;
+        n->rtt_var = NACK_INITIAL_RTT / 2;
+    }
+
+    /* Compared extended, as they wrap around */
+    uint64_t seq = avt_seq_unwrap(n->top, wire_seq);
+    uint32_t idx = seq % NACK_WINDOW;
+
+    /* Too late, already given up on */
+    if (seq < n->base)
+        return;
+
+    if (seq >= n->top) {
+        /* Anything falling out of the window is lost */
+        if ((seq - n->base) >= NACK_WINDOW) {
+            uint64_t base = seq + 1 - NACK_WINDOW;
+            for (uint64_t s = n->base; s < AVT_MIN(base, n->top); s++)
+                n->lost += !nack_has(n, s) && n->due[s % NACK_WINDOW] != UINT64_MAX;
+            n->base = base;
+        }
+
+        /* Wait a little for reordered packets before asking for gaps */
+        uint64_t due = seq > n->top ? avt_get_time_ns() + n->rtt / 4 : 0;
+        for (uint64_t s = AVT_MAX(n->top, n->base); s < seq; s++) {
+            uint32_t i = s % NACK_WINDOW;
+            n->received[i >> 6] &= ~(UINT64_C(1) << (i & 63));
+            n->due[i] = due;
+            n->tries[i] = 0;
+        }
+
+        n->top = seq + 1;
+    } else if (nack_has(n, seq)) {
+        return;
+    } else if (n->tries[idx] == 1) {
+        /* Only unambiguous answers are sampled */
+        int64_t sample = avt_get_time_ns() - n->asked[idx];
+        int64_t diff = sample - (int64_t)n->rtt;
+        n->rtt_var += ((diff < 0 ? -diff : diff) - (int64_t)n->rtt_var) / 4;
+        n->rtt += diff / 8;
+    }
+
+    n->received[idx >> 6] |= UINT64_C(1) << (idx & 63);
+
+    while (n->base < n->top && nack_has(n, n->base))
+        n->base++;
+}
+
+int avt_reorder_nack(AVTContext *ctx, AVTReorderBuffer *rb, uint64_t now,
+                     AVTReorderNackRange *ranges, int max_ranges)
+{
+    int nb = 0;
+    AVTReorderNack *n = &rb->nack;
+    uint64_t rto = AVT_MAX(n->rtt + 4*n->rtt_var, NACK_MIN_RTO);
+
+    for (uint64_t s = n->base; s < n->top; s++) {
+        uint32_t idx = s % NACK_WINDOW;
+        if (nack_has(n, s) || n->due[idx] > now)
+            continue;
+
+        if (n->tries[idx] == NACK_MAX_TRIES) {
+            n->due[idx] = UINT64_MAX;
+            n->lost++;
+            continue;
+        }
+
+        /* Consecutive packets go in one range */
+        if (nb && (ranges[nb - 1].seq + ranges[nb - 1].nb) == s) {
+            ranges[nb - 1].nb++;
+        } else if (nb < max_ranges) {
+            ranges[nb++] = (AVTReorderNackRange){ .seq = s, .nb = 1 };
+        } else {
+            break;
+        }
+
+        /* Back off exponentially */
+        n->asked[idx] = now;
+        n->due[idx] = now + (rto << n->tries[idx]);
+        n->tries[idx]++;
+    }
+
+    for (int i = 0; i < nb; i++)
+        ranges[i].seq &= UINT32_MAX;
+
+    return nb;
+}
+
+/* Allocated on the first packet received, as most connections
+ * only ever send */
+static int reorder_alloc(AVTReorderBuffer *rb)
+{
+    uint32_t nb = AVT_MAX(rb->max_global_size / REORDER_AVG_PKT_SIZE, 64);
+
+    /* Every chain has at least one packet, plus the global chain.
+     * The lookup table is kept at most half full. */
+    uint32_t nb_lookup = 1;
+    while (nb_lookup < 2*nb)
+        nb_lookup <<= 1;
+
+    size_t pkt_size = REORDER_ALIGN(nb*sizeof(*rb->pkt));
+    size_t link_size = REORDER_ALIGN(nb*sizeof(*rb->link));
+    size_t chain_size = REORDER_ALIGN((nb + 1)*sizeof(*rb->chain));
+    size_t lookup_size = REORDER_ALIGN(nb_lookup*sizeof(*rb->lookup));
+    size_t done_size = REORDER_ALIGN(nb_lookup*sizeof(*rb->done_seq));
+    size_t age_size = REORDER_ALIGN((nb + 1)*sizeof(*rb->parity_age));
+
+    uint8_t *arena = aligned_alloc(64, pkt_size + link_size + chain_size +
+                                       lookup_size + done_size + age_size);
+    if (!arena)
+        return AVT_ERROR(ENOMEM);
+
+    rb->arena = arena;
+    rb->pkt = (AVTReorderPkt *)arena;
+    rb->link = (AVTReorderLink *)(arena + pkt_size);
+    rb->chain = (AVTReorderChain *)(arena + pkt_size + link_size);
+    rb->lookup = (uint32_t *)(arena + pkt_size + link_size + chain_size);
+    rb->done_seq = (uint64_t *)((uint8_t *)rb->lookup + lookup_size);
+    rb->parity_age = (uint32_t *)((uint8_t *)rb->done_seq + done_size);
+
+    rb->nb_pkt_allocated = nb;
+    rb->nb_chains_allocated = nb + 1;
+    rb->lookup_mask = nb_lookup - 1;
+    rb->done_mask = nb_lookup - 1;
+    memset(rb->chain, 0, chain_size);
+    memset(rb->lookup, 0xFF, lookup_size);
+    memset(rb->done_seq, 0xFF, done_size);
+
+    rb->free_pkt = NIL;
+    for (int i = nb - 1; i >= 0; i--) {
+        memset(&rb->pkt[i].pl, 0, sizeof(rb->pkt[i].pl));
+        rb->link[i].global_next = rb->free_pkt;
+        rb->free_pkt = i;
+    }
+
+    rb->chain[GLOBAL] = (AVTReorderChain) {
+        .type = AVT_REORDER_CHAIN_GLOBAL,
+        .start = NIL,
+        .top = NIL,
+        .next = NIL,
+        .parity = NIL,
+        .fec_group = NIL,
+    };
+    rb->nb_chains = 1;
+
+    rb->free_chain = NIL;
+    for (int i = nb; i > 0; i--) {
+        rb->chain[i].next = rb->free_chain;
+        rb->free_chain = i;
+    }
+
+    return 0;
+}
 
 int avt_reorder_init(AVTContext *ctx, AVTReorderBuffer *rb,
                      size_t max_size)
 {
+    memset(rb, 0, sizeof(*rb));
+
+    rb->max_global_size = max_size ? max_size : REORDER_DEFAULT_SIZE;
+    rb->finished_first = rb->finished_last = NIL;
+    rb->top_stream_data = NIL;
+
     return 0;
 }
 
 int avt_reorder_push(AVTContext *ctx, AVTReorderBuffer *rb,
                      union AVTPacketData pkt, AVTBuffer *pl)
 {
+    int err;
+    size_t total;
+    AVTReorderChain *c;
+    size_t size = avt_pkt_hdr_size(pkt) + avt_buffer_get_data_len(pl);
+
+    if (!rb->arena) {
+        err = reorder_alloc(rb);
+        if (err < 0)
+            return err;
+    }
+
+    nack_received(&rb->nack, pkt.seq);
+
+    while (rb->parity_age_nb && parity_age_pop(rb, false))
+        ;
+
+    while (rb->free_pkt == NIL || (rb->global_size + size) > rb->max_global_size) {
+        err = reorder_evict(rb);
+        if (err < 0) {
+            if (rb->free_pkt != NIL)
+                break;
+            return err;
+        }
+    }
+
+    switch (pkt.desc) {
+    case AVT_PKT_STREAM_DATA:
+        /* Complete in one packet, no need to wait for parity */
+        if (!pkt.stream_data.pkt_segmented)
+            break;
+
+        /* Recovered already, or a duplicate */
+        if (rb->done_seq[pkt.seq & rb->done_mask] == pkt.seq)
+            return 0;
+
+        c = chain_find(rb, AVT_REORDER_CHAIN_STREAM_DATA, pkt.seq);
+        if (!c)
+            c = chain_new(rb, AVT_REORDER_CHAIN_STREAM_DATA, pkt.seq, pkt.stream_id);
+        rb->top_stream_data = chain_idx(rb, c);
+
+        if (chain_insert(rb, c, pkt, pl, 0) == 0)
+            chain_update(ctx, rb, c);
+        return 0;
+    case AVT_PKT_STREAM_DATA_SEGMENT:
+        total = pkt.generic_segment.pkt_total_data;
+        c = chain_find(rb, AVT_REORDER_CHAIN_STREAM_DATA, pkt.generic_segment.target_seq);
+
+        /* Segments of finished packets, and ones which disagree
+         * with the ones before are dropped */
+        if (rb->done_seq[pkt.generic_segment.target_seq & rb->done_mask] ==
+            pkt.generic_segment.target_seq ||
+            !total || total > rb->max_global_size ||
+            (pkt.generic_segment.seg_offset + avt_buffer_get_data_len(pl)) > total ||
+            (c && c->data && c->tot_payload_size != total))
+            return 0;
+
+        if (!c)
+            c = chain_new(rb, AVT_REORDER_CHAIN_STREAM_DATA,
+                          pkt.generic_segment.target_seq, pkt.stream_id);
+        rb->top_stream_data = chain_idx(rb, c);
+
+        /* The payload is assembled in place from here on */
+        if (!c->data) {
+            c->tot_payload_size = total;
+            err = chain_alloc(ctx, rb, c);
+            if (err < 0) {
+                if (c->start == NIL)
+                    chain_free(rb, c);
+                return err;
+            }
+        }
+
+        chain_add_header_7(c, pkt.generic_segment.global_seq,
+                           pkt.generic_segment.header_7);
+
+        if (chain_insert(rb, c, pkt, pl, pkt.generic_segment.seg_offset) == 0)
+            chain_update(ctx, rb, c);
+        return 0;
+    case AVT_PKT_STREAM_DATA_PARITY:
+        /* The data may well be done already, which is the usual case */
+        if (rb->done_seq[pkt.generic_parity.target_seq & rb->done_mask] ==
+            pkt.generic_parity.target_seq)
+            return 0;
+
+        c = chain_find(rb, AVT_REORDER_CHAIN_PARITY, pkt.generic_parity.target_seq);
+        if (!c)
+            c = chain_new(rb, AVT_REORDER_CHAIN_PARITY,
+                          pkt.generic_parity.target_seq, pkt.stream_id);
+
+        c->tot_payload_size = pkt.generic_parity.parity_total;
+        chain_add_header_7(c, pkt.generic_parity.global_seq,
+                           pkt.generic_parity.header_7);
+
+        if (chain_insert(rb, c, pkt, pl, pkt.generic_parity.parity_data_offset) == 0)
+            chain_update(ctx, rb, c);
+        return 0;
+    default:
+        break;
+    }
+
+    /* Everything else is passed through */
+    c = chain_new(rb, AVT_REORDER_CHAIN_SINGLE, pkt.seq, pkt.stream_id);
+    if (pkt.desc == AVT_PKT_STREAM_DATA)
+        rb->top_stream_data = chain_idx(rb, c);
+    chain_insert(rb, c, pkt, pl, 0);
+    chain_finish(rb, c);
+
+    return 0;
+}
+
+int avt_reorder_push_fifo(AVTContext *ctx, AVTReorderBuffer *rb,
+                          AVTPacketFifo *fifo)
+{
+    int err = 0;
+
+    for (unsigned int i = 0; i < fifo->nb; i++) {
+        AVTOutputPacket *e = avt_pkt_fifo_get(fifo, i);
+        err = avt_reorder_push(ctx, rb, e->pkt, &e->pl);
+        if (err < 0)
+            break;
+    }
+
+    avt_pkt_fifo_clear(fifo);
+
+    return err;
+}
+
+int avt_reorder_peek_stream_data(AVTContext *ctx, AVTReorderBuffer *rb,
+                                 AVTReorderChain **chain)
+{
+    if (rb->top_stream_data == NIL)
+        return AVT_ERROR(EAGAIN);
+
+    *chain = &rb->chain[rb->top_stream_data];
     return 0;
 }
 
-int avt_reorder_pop(AVTContext *ctx, AVTReorderChain **chain)
+int avt_reorder_pop(AVTContext *ctx, AVTReorderBuffer *rb,
+                    AVTReorderChain **chain)
 {
+    if (rb->finished_first == NIL)
+        return AVT_ERROR(EAGAIN);
+
+    AVTReorderChain *c = &rb->chain[rb->finished_first];
+    rb->finished_first = c->next;
+    if (rb->finished_first == NIL)
+        rb->finished_last = NIL;
+    c->next = NIL;
+
+    *chain = c;
+    return 0;
+}
+
+int avt_reorder_done(AVTContext *ctx, AVTReorderBuffer *rb,
+                     AVTReorderChain *chain)
+{
+    chain_free(rb, chain);
     return 0;
 }
 
 void avt_reorder_free(AVTContext *ctx, AVTReorderBuffer *rb)
 {
+    if (rb->arena)
+        for (uint32_t i = rb->chain[GLOBAL].start; i != NIL; i = rb->link[i].global_next)
+            avt_buffer_quick_unref(&rb->pkt[i].pl);
+
+    for (uint32_t i = 1; i < rb->nb_chains_allocated; i++) {
+        avt_buffer_unref(&rb->chain[i].data);
+        free(rb->chain[i].sym_bytes);
+    }
 
+    free(rb->arena);
+    memset(rb, 0, sizeof(*rb));
 }
@@ -29,29 +29,43 @@
 
 #include "common.h"
 #include "buffer.h"
+#include "fec.h"
+#include "utils_internal.h"
 
+/* Index of no packet or chain */
+#define AVT_REORDER_NIL UINT32_MAX
+
+/* Packets and chains live in a single arena, and refer to each other
+ * by index. The packets of a chain are iterated with:
+ *     for (uint32_t i = c->start; i != AVT_REORDER_NIL; i = rb->link[i].next)
+ *         ... rb->pkt[i] ... */
 typedef struct AVTReorderPkt {
     union AVTPacketData pkt;
-    AVTBuffer *pl;
+    AVTBuffer pl;
 
     uint64_t recv_order;
+} AVTReorderPkt;
 
-    /* Segment */
-    struct AVTReorderPkt *prev;
-    struct AVTReorderPkt *next;
+/* Links and layout of a packet, kept apart from its data, so that
+ * walking chains stays within a few cachelines */
+typedef struct AVTReorderLink {
+    /* Chain the packet belongs to */
+    uint32_t chain;
 
-    /* Parity */
-    struct AVTReorderPkt *parity_prev;
-    struct AVTReorderPkt *parity_next;
+    /* Segment, sorted by offset */
+    uint32_t prev;
+    uint32_t next;
 
-    /* FEC group */
-    struct AVTReorderPkt *fecg_prev;
-    struct AVTReorderPkt *fecg_next;
+    /* Global, in arrival order. global_next links the free list. */
+    uint32_t global_prev;
+    uint32_t global_next;
 
-    /* Global */
-    struct AVTReorderPkt *global_prev;
-    struct AVTReorderPkt *global_next;
-} AVTReorderPkt;
+    /* Position of the payload within the chain, and its length */
+    uint32_t offset;
+    uint32_t len;
+
+    enum AVTPktDescriptors desc;
+} AVTReorderLink;
 
 enum AVTReorderChainType {
     /* Stream chain contains segments of a single stream data packet */
@@ -68,12 +82,34 @@ enum AVTReorderChainType {
 
     /* Stream chain contains the list of all currently buffered packets */
     AVT_REORDER_CHAIN_GLOBAL,
+
+    /* Stream chain contains a single packet, which is never segmented */
+    AVT_REORDER_CHAIN_SINGLE,
 };
 
 typedef struct AVTReorderChain {
     enum AVTReorderChainType type;
-    AVTReorderPkt *start;
-    AVTReorderPkt *top;
+    uint32_t start;
+    uint32_t top;
+
+    /* Sequence number of the packet being reassembled */
+    uint64_t seq;
+
+    /* Arrival order of the packet which started the chain */
+    uint64_t created;
+
+    /* Complete, and waiting to be popped or already popped */
+    bool finished;
+
+    /* Being reassembled, and listed in the lookup table */
+    bool active;
+
+    /* Next chain in the free list, or the list of finished chains */
+    uint32_t next;
+
+    /* Parts of the first packet's header, carried by segments and parity */
+    uint8_t header_7[28];
+    uint8_t header_7_mask;
 
     uint32_t nb_packets; /* Received */
     uint32_t tot_nb_packets; /* Signalled */
@@ -81,6 +117,23 @@ typedef struct AVTReorderChain {
     size_t payload_size; /* Received */
     size_t tot_payload_size; /* Signalled */
 
+    /*
+     * type == AVT_REORDER_CHAIN_STREAM_DATA:
+     * The payload, assembled in place as it arrives, once its size is known.
+     * Padded to whole FEC source symbols, so it can be recovered in place.
+     * Packets of the chain reference their part of it.
+     */
+    AVTBuffer *data;
+
+    /*
+     * type == AVT_REORDER_CHAIN_STREAM_DATA, once data is allocated:
+     * The bytes of data received, the FEC source symbols fully received,
+     * and their number. Segments need not end on symbol boundaries.
+     */
+    uint64_t *sym_bytes;
+    uint64_t *sym_done;
+    size_t nb_sym_done;
+
     uint16_t stream_id;
     uint16_t fec_group_id;
 
@@ -89,81 +142,145 @@ typedef struct AVTReorderChain {
 
     /*
      * type == AVT_REORDER_CHAIN_STREAM_DATA:
-     * Pointer to a AVT_REORDER_CHAIN_PARITY chain that has
-     * not been popped off yet, containing parity data not yet
-     * fully finished.
+     * The AVT_REORDER_CHAIN_PARITY chain that has not been popped off
+     * yet, containing parity data not yet fully finished.
      *
      * type == AVT_REORDER_CHAIN_PARITY:
-     * Pointer to a poppped-off AVTReorderChain for the packet
-     * being given redundancy by this parity data chain
+     * The AVTReorderChain for the packet being given redundancy by this
+     * parity data chain
      */
-    struct AVTReorderChain *parity;
+    uint32_t parity;
 
     /*
      * type == AVT_REORDER_CHAIN_FEC_GROUP:
-     * Pointer to a AVT_REORDER_CHAIN_FEC_GROUP_PARITY chain that has
-     * not been popped off yet, containing FEC data not yet
-     * fully finished.
+     * The AVT_REORDER_CHAIN_FEC_GROUP_PARITY chain that has not been
+     * popped off yet, containing FEC data not yet fully finished.
      *
-     * type == AVT_REORDER_CHAIN_FEC_GROUP:
-     * Pointer to a poppped-off AVTReorderChain for the packet
-     * being given redundancy by this FEC data chain
+     * type == AVT_REORDER_CHAIN_FEC_GROUP_PARITY:
+     * The AVTReorderChain for the packet being given redundancy by this
+     * FEC data chain
      */
-    struct AVTReorderChain *fec_group;
-
-    /*
-     * type == any
-     * The global chain itself.
-     * the start field may be NULL
-     */
-    struct AVTReorderChain *global;
+    uint32_t fec_group;
 } AVTReorderChain;
 
+/* Number of sequence numbers tracked for loss detection */
+#define AVT_REORDER_NACK_WINDOW 4096
+
+/* Loss detection, over the global sequence numbers received */
+typedef struct AVTReorderNack {
+    uint64_t received[AVT_REORDER_NACK_WINDOW / 64];
+
+    /* Per sequence number: when to ask for it next (UINT64_MAX once
+     * given up on), when it was last asked for, and how many times */
+    uint64_t due[AVT_REORDER_NACK_WINDOW];
+    uint64_t asked[AVT_REORDER_NACK_WINDOW];
+    uint8_t tries[AVT_REORDER_NACK_WINDOW];
+
+    /* Sequence numbers in [base, top) are tracked, extended to 64 bits */
+    bool init;
+    uint64_t base;
+    uint64_t top;
+
+    /* Round-trip time of resend requests, in nanoseconds */
+    uint64_t rtt;
+    uint64_t rtt_var;
+
+    /* Packets given up on */
+    uint64_t lost;
+} AVTReorderNack;
+
+/* nb packets from seq on, which may wrap around past 0xFFFFFFFF */
+typedef struct AVTReorderNackRange {
+    uint64_t seq;
+    uint32_t nb;
+} AVTReorderNackRange;
+
 /* Main context */
 typedef struct AVTReorderBuffer {
-    /* Buffer for all packet structs */
+    /* Single allocation, holding all arrays below */
+    void *arena;
+
+    /* All packets, their links, and unused ones */
     AVTReorderPkt *pkt;
+    AVTReorderLink *link;
     uint32_t nb_pkt;
     uint32_t nb_pkt_allocated;
+    uint32_t free_pkt;
 
-    /* Buffer for all chains */
+    /* All chains, and unused ones. The first one is the global chain. */
     AVTReorderChain *chain;
     uint32_t nb_chains;
     uint32_t nb_chains_allocated;
+    uint32_t free_chain;
+
+    size_t global_size;
+
+    /* Active chains, hashed by type and sequence number.
+     * Open addressing, with linear probing. */
+    uint32_t *lookup;
+    uint32_t lookup_mask;
+
+    /* Finished chains, in the order they were finished */
+    uint32_t finished_first;
+    uint32_t finished_last;
 
-    AVTReorderChain *global_chain;
+    /* Most recent stream data chain */
+    uint32_t top_stream_data;
 
-    AVTReorderChain **segment_chains;
-    uint32_t nb_segment_chains;
-    uint32_t nb_segment_chains_allocated;
+    /* Sequence numbers of recently finished stream data, indexed by
+     * their lower bits, so late parity for them can be dropped */
+    uint64_t *done_seq;
+    uint32_t done_mask;
 
-    AVTReorderChain **fecg_chains;
-    uint32_t nb_fecg_chains;
-    uint32_t nb_fecg_chains_allocated;
+    /* Parity chains, in the order they were created, to drop those
+     * whose data never arrived. Entries of freed chains are skipped. */
+    uint32_t *parity_age;
+    uint32_t parity_age_first;
+    uint32_t parity_age_nb;
+
+    uint64_t recv_order;
 
     size_t max_global_size;
+
+    AVTReorderNack nack;
 } AVTReorderBuffer;
 
 /* Initialize a reorder buffer with a given max_size which
  * is the approximate bound of all packets and their payloads
- * contained within. */
+ * contained within. Memory is only allocated once packets arrive. */
 int avt_reorder_init(AVTContext *ctx, AVTReorderBuffer *rb,
                      size_t max_size);
 
-/* Push data to reorder buffer and let it figure everything out */
+/* Push data to reorder buffer and let it figure everything out.
+ * The payload is ref'd. */
 int avt_reorder_push(AVTContext *ctx, AVTReorderBuffer *rb,
                      union AVTPacketData pkt, AVTBuffer *pl);
 
+/* Push all packets from a FIFO in one pass. The FIFO is left empty. */
+int avt_reorder_push_fifo(AVTContext *ctx, AVTReorderBuffer *rb,
+                          AVTPacketFifo *fifo);
+
 /* Peek at the topmost, most recent stream data chain.
  * Call after push to understand if the packet ended up
  * somewhere useful yet */
 int avt_reorder_peek_stream_data(AVTContext *ctx, AVTReorderBuffer *rb,
                                  AVTReorderChain **chain);
 
-/* Pop a finished chain off the reorder buffer */
-int avt_reorder_pop(AVTContext *ctx, AVTReorderChain **chain);
+/* Pop a finished chain off the reorder buffer.
+ * Stream data chains list the first packet, then the segments received,
+ * in order, and hold the whole payload in data.
+ * Returns AVT_ERROR(EAGAIN) if no chain is finished. */
+int avt_reorder_pop(AVTContext *ctx, AVTReorderBuffer *rb,
+                    AVTReorderChain **chain);
 /* Mark chain as being done, letting its memory be reused */
-int avt_reorder_done(AVTContext *ctx, AVTReorderChain *chain);
+int avt_reorder_done(AVTContext *ctx, AVTReorderBuffer *rb,
+                     AVTReorderChain *chain);
+
+/* Get the ranges of missing packets due to be asked for again,
+ * up to max_ranges. Their retry timers are restarted.
+ * Returns the number of ranges. */
+int avt_reorder_nack(AVTContext *ctx, AVTReorderBuffer *rb, uint64_t now,
+                     AVTReorderNackRange *ranges, int max_ranges);
 
 /* Free everything in all chains */
 void avt_reorder_free(AVTContext *ctx, AVTReorderBuffer *rb);
@@ -42,12 +42,78 @@ uint64_t avt_get_time_ns(void)
     return (ts.tv_sec * 1000000000) + ts.tv_nsec;
 }
 
-void avt_pkt_fifo_clear(AVTPacketFifo *fifo)
+
+int avt_id_map_set(AVTIdMap *map, uint16_t id, void *ptr)
+{
+    void ***page = &map->pages[id >> AVT_ID_MAP_BITS];
+    if (!*page) {
+        if (!ptr)
+            return 0;
+        *page = calloc(1 << AVT_ID_MAP_BITS, sizeof(**page));
+        if (!*page)
+            return AVT_ERROR(ENOMEM);
+    }
+
+    (*page)[id & ((1 << AVT_ID_MAP_BITS) - 1)] = ptr;
+
+    return 0;
+}
+
+void avt_id_map_free(AVTIdMap *map)
+{
+    for (int i = 0; i < AVT_ARRAY_ELEMS(map->pages); i++) {
+        free(map->pages[i]);
+        map->pages[i] = NULL;
+    }
+}
+
+/* Ring buffer. The allocation is always a power of two, so wrapping
+ * is a mask, and popping from the head never moves any data. */
+#define FIFO_MIN_ALLOC 16
+
+static inline AVTOutputPacket *fifo_entry(AVTPacketFifo *fifo, unsigned int i)
+{
+    return &fifo->data[(fifo->head + i) & (fifo->alloc - 1)];
+}
+
+static int fifo_reserve(AVTPacketFifo *fifo, unsigned int nb)
 {
-    for (int i = 0; i < fifo->nb; i++) {
-        AVTOutputPacket *data = &fifo->data[i];
-        avt_buffer_quick_unref(&data->pl);
+    unsigned int req;
+    if (ckd_add(&req, fifo->nb, nb))
+        return AVT_ERROR(ENOMEM);
+    if (req <= fifo->alloc)
+        return 0;
+
+    unsigned int new_alloc = fifo->alloc ? fifo->alloc : FIFO_MIN_ALLOC;
+    while (new_alloc < req) {
+        if (ckd_mul(&new_alloc, new_alloc, 2))
+            return AVT_ERROR(ENOMEM);
     }
+
+    AVTOutputPacket *alloc = reallocarray(fifo->data, new_alloc,
+                                          sizeof(*fifo->data));
+    if (!alloc)
+        return AVT_ERROR(ENOMEM);
+
+    /* Unwrap: the part that wrapped around to the start now goes
+     * right after the old end of the array */
+    unsigned int old_alloc = fifo->alloc;
+    if (fifo->head + fifo->nb > old_alloc) {
+        unsigned int wrapped = fifo->head + fifo->nb - old_alloc;
+        memcpy(&alloc[old_alloc], alloc, wrapped*sizeof(*alloc));
+    }
+
+    fifo->data = alloc;
+    fifo->alloc = new_alloc;
+
+    return 0;
+}
+
+void avt_pkt_fifo_clear(AVTPacketFifo *fifo)
+{
+    for (unsigned int i = 0; i < fifo->nb; i++)
+        avt_buffer_quick_unref(&fifo_entry(fifo, i)->pl);
+    fifo->head = 0;
     fifo->nb = 0;
 }
 
@@ -61,81 +127,70 @@ void avt_pkt_fifo_free(AVTPacketFifo *fifo)
 int avt_pkt_fifo_push(AVTPacketFifo *fifo,
                       union AVTPacketData pkt, AVTBuffer *pl)
 {
-    if ((fifo->nb + 1) >= fifo->alloc) {
-        if (!fifo->alloc)
-            fifo->alloc = 1;
-
-        /* Ptwo allocations */
-        AVTOutputPacket *alloc = reallocarray(fifo->data,
-                                              fifo->alloc << 1,
-                                              sizeof(*fifo->data));
-        if (!alloc)
-            return AVT_ERROR(ENOMEM);
+    int err = fifo_reserve(fifo, 1);
+    if (err < 0)
+        return err;
 
-        fifo->data = alloc;
-        fifo->alloc <<= 1;
-    }
+    AVTOutputPacket *data = fifo_entry(fifo, fifo->nb);
+    err = avt_buffer_quick_ref(&data->pl, pl, 0, 0);
+    if (err < 0)
+        return err;
 
-    AVTOutputPacket *data = &fifo->data[fifo->nb];
-    int err = avt_buffer_quick_ref(&data->pl, pl, 0, 0);
     data->pkt = pkt;
-    if (err < 0)
-        fifo->nb++;
+    fifo->nb++;
 
-    return err;
+    return 0;
 }
 
-int avt_pkt_fifo_copy(AVTPacketFifo *dst, AVTPacketFifo *src)
+int avt_pkt_fifo_push_move(AVTPacketFifo *fifo,
+                           union AVTPacketData pkt, AVTBuffer *pl)
 {
-    if ((dst->nb + src->nb) >= dst->alloc) {
-        if (!dst->alloc)
-            dst->alloc = src->nb;
+    int err = fifo_reserve(fifo, 1);
+    if (err < 0)
+        return err;
 
-        AVTOutputPacket *alloc = reallocarray(dst->data,
-                                              dst->alloc + src->nb,
-                                              sizeof(*dst->data));
-        if (!alloc)
-            return AVT_ERROR(ENOMEM);
+    AVTOutputPacket *data = fifo_entry(fifo, fifo->nb);
+    data->pl = *pl;
+    data->pkt = pkt;
+    fifo->nb++;
 
-        dst->data = alloc;
-        dst->alloc += src->nb;
-    }
+    memset(pl, 0, sizeof(*pl));
 
-    for (int i = 0; i < src->nb; i++) {
-        AVTOutputPacket *pdst = &dst->data[dst->nb + i];
-        AVTOutputPacket *psrc = &src->data[i];
-        *psrc = *pdst;
-        int err = avt_buffer_quick_ref(&pdst->pl, &psrc->pl, 0, 0);
-        if (err < 0) {
-            dst->nb += 1;
+    return 0;
+}
+
+int avt_pkt_fifo_copy(AVTPacketFifo *dst, AVTPacketFifo *src)
+{
+    int err = fifo_reserve(dst, src->nb);
+    if (err < 0)
+        return err;
+
+    for (unsigned int i = 0; i < src->nb; i++) {
+        AVTOutputPacket *pdst = fifo_entry(dst, dst->nb);
+        AVTOutputPacket *psrc = fifo_entry(src, i);
+        err = avt_buffer_quick_ref(&pdst->pl, &psrc->pl, 0, 0);
+        if (err < 0)
             return err;
-        }
+        pdst->pkt = psrc->pkt;
+        dst->nb++;
     }
 
-    dst->nb += src->nb;
-
     return 0;
 }
 
 int avt_pkt_fifo_move(AVTPacketFifo *dst, AVTPacketFifo *src)
 {
-    if ((dst->nb + src->nb) >= dst->alloc) {
-        if (!dst->alloc)
-            dst->alloc = src->nb;
+    int err = fifo_reserve(dst, src->nb);
+    if (err < 0)
+        return err;
 
-        AVTOutputPacket *alloc = reallocarray(dst->data,
-                                              dst->alloc + src->nb,
-                                              sizeof(*dst->data));
-        if (!alloc)
-            return AVT_ERROR(ENOMEM);
+    /* References are transferred, no need to ref/unref */
+    for (unsigned int i = 0; i < src->nb; i++)
+        *fifo_entry(dst, dst->nb + i) = *fifo_entry(src, i);
 
-        dst->data = alloc;
-        dst->alloc += src->nb;
-    }
-
-    memcpy(&dst->data[dst->nb], src->data, src->nb*sizeof(*dst->data));
     dst->nb += src->nb;
-    avt_pkt_fifo_clear(src);
+    src->head = 0;
+    src->nb = 0;
 
     return 0;
 }
@@ -146,7 +201,7 @@ int avt_pkt_fifo_peek(AVTPacketFifo *fifo,
     if (!fifo->nb)
         return AVT_ERROR(ENOENT);
 
-    AVTOutputPacket *data = &fifo->data[0];
+    AVTOutputPacket *data = fifo_entry(fifo, 0);
 
     *pkt = data->pkt;
     return avt_buffer_quick_ref(pl, &data->pl, 0, 0);
@@ -158,31 +213,50 @@ int avt_pkt_fifo_pop(AVTPacketFifo *fifo,
     if (!fifo->nb)
         return AVT_ERROR(ENOENT);
 
-    AVTOutputPacket *data = &fifo->data[0];
+    AVTOutputPacket *data = fifo_entry(fifo, 0);
 
-    int err = avt_buffer_quick_ref(pl, &data->pl, 0, 0);
-    avt_buffer_quick_unref(&data->pl);
+    /* Hand over the reference */
     *pkt = data->pkt;
+    *pl = data->pl;
 
+    fifo->head = (fifo->head + 1) & (fifo->alloc - 1);
     fifo->nb--;
-    memmove(fifo->data, fifo->data + 1, fifo->nb*sizeof(*fifo->data));
+    if (!fifo->nb)
+        fifo->head = 0;
+
+    return 0;
+}
+
+AVTOutputPacket *avt_pkt_fifo_get(AVTPacketFifo *fifo, unsigned int idx)
+{
+    if (idx >= fifo->nb)
+        return NULL;
 
-    return err;
+    return fifo_entry(fifo, idx);
+}
+
+size_t avt_pkt_fifo_front_size(AVTPacketFifo *fifo)
+{
+    if (!fifo->nb)
+        return 0;
+
+    AVTOutputPacket *data = fifo_entry(fifo, 0);
+    return avt_pkt_hdr_size(data->pkt) + avt_buffer_get_data_len(&data->pl);
 }
 
 static inline size_t avt_pkt_fifo_get_entry_size(AVTOutputPacket *e)
 {
-    return sizeof(e) + avt_buffer_get_data_len(&e->pl);
+    return sizeof(*e) + avt_buffer_get_data_len(&e->pl);
 }
 
 int avt_pkt_fifo_drop(AVTPacketFifo *fifo, unsigned int nb_pkts, size_t ceiling)
 {
-    unsigned int idx = 0;
+    unsigned int idx = fifo->nb;
 
     if (!nb_pkts) {
         size_t acc = 0;
-        for (int i = 0; i < fifo->nb; i++) {
-            acc += avt_pkt_fifo_get_entry_size(&fifo->data[i]);
+        for (unsigned int i = 0; i < fifo->nb; i++) {
+            acc += avt_pkt_fifo_get_entry_size(fifo_entry(fifo, i));
             if (acc > ceiling) {
                 idx = i;
                 break;
@@ -193,12 +267,12 @@ int avt_pkt_fifo_drop(AVTPacketFifo *fifo, unsigned int nb_pkts, size_t ceiling)
             return AVT_ERROR(EINVAL);
     }
 
-    for (; idx < fifo->nb; idx++) {
-        AVTOutputPacket *data = &fifo->data[idx];
-        avt_buffer_quick_unref(&data->pl);
-    }
+    for (unsigned int i = idx; i < fifo->nb; i++)
+        avt_buffer_quick_unref(&fifo_entry(fifo, i)->pl);
 
     fifo->nb = idx;
+    if (!fifo->nb)
+        fifo->head = 0;
 
     return 0;
 }
@@ -208,8 +282,115 @@ size_t avt_pkt_fifo_size(AVTPacketFifo *fifo)
     // TODO: not sure if I want to use fifo->alloc instead of fifo->nb here
     size_t acc = fifo->alloc * sizeof(*fifo->data);
 
-    for (int i = 0; i < fifo->nb; i++)
-        acc += avt_buffer_get_data_len(&fifo->data[i].pl);
+    for (unsigned int i = 0; i < fifo->nb; i++)
+        acc += avt_buffer_get_data_len(&fifo_entry(fifo, i)->pl);
 
     return acc;
 }
+
+int avt_pkt_queue_init(AVTPacketQueue *q, size_t nb)
+{
+    size_t alloc = 1;
+    while (alloc < nb) {
+        if (ckd_mul(&alloc, alloc, 2))
+            return AVT_ERROR(EINVAL);
+    }
+
+    /* Each cell's sequence number tells whether it's free to be written
+     * at a given position (seq == pos), or ready to be read (seq == pos + 1).
+     * It is stored minus the cell's index, so all start at zero, and cells
+     * are only paged in once used. */
+    q->cells = calloc(alloc, sizeof(*q->cells));
+    if (!q->cells)
+        return AVT_ERROR(ENOMEM);
+
+    q->mask = alloc - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+
+    return 0;
+}
+
+int avt_pkt_queue_push(AVTPacketQueue *q,
+                       union AVTPacketData pkt, AVTBuffer *pl)
+{
+    AVTPacketQueueCell *cell;
+    AVTBuffer ref;
+
+    /* Reference the payload first, so a claimed cell is always published */
+    int err = avt_buffer_quick_ref(&ref, pl, 0, 0);
+    if (err < 0)
+        return err;
+
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        cell = &q->cells[pos & q->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire) +
+                     (pos & q->mask);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (!diff) {
+            /* seq_cst, so that a consumer which checks the queue after
+             * releasing a lock we failed to take sees this push */
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_seq_cst,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            avt_buffer_quick_unref(&ref);
+            return AVT_ERROR(EAGAIN);
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    cell->p.pkt = pkt;
+    cell->p.pl = ref;
+    atomic_store_explicit(&cell->seq, pos + 1 - (pos & q->mask),
+                          memory_order_release);
+
+    return 0;
+}
+
+int avt_pkt_queue_pop(AVTPacketQueue *q,
+                      union AVTPacketData *pkt, AVTBuffer *pl)
+{
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    AVTPacketQueueCell *cell = &q->cells[pos & q->mask];
+
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire) +
+                 (pos & q->mask);
+    if (seq != (pos + 1))
+        return AVT_ERROR(ENOENT);
+
+    *pkt = cell->p.pkt;
+    *pl = cell->p.pl;
+
+    /* Hand the cell back to producers for the next lap */
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1 - (pos & q->mask),
+                          memory_order_release);
+    atomic_store_explicit(&q->tail, pos + 1, memory_order_release);
+
+    return 0;
+}
+
+size_t avt_pkt_queue_pending(AVTPacketQueue *q)
+{
+    size_t tail = atomic_load(&q->tail);
+    size_t head = atomic_load(&q->head);
+    return head - tail;
+}
+
+void avt_pkt_queue_free(AVTPacketQueue *q)
+{
+    union AVTPacketData pkt;
+    AVTBuffer pl;
+
+    if (!q->cells)
+        return;
+
+    while (!avt_pkt_queue_pop(q, &pkt, &pl))
+        avt_buffer_quick_unref(&pl);
+
+    free(q->cells);
+    memset(q, 0, sizeof(*q));
+}
@@ -31,6 +31,8 @@
 #include <time.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 
 #include <avtransport/utils.h>
 #include <avtransport/packet_data.h>
@@ -80,7 +82,39 @@ static inline type * prefix## _ ## create_ ## shortname(ctx *dctx)             \
     return sctx;                                                               \
 }
 
-/* Zero (usually) alloc FIFO. Payload is ref'd, and leaves with a ref. */
+/* Sparse map of 16-bit IDs (stream IDs) to pointers.
+ * Two levels, second level pages are allocated on first use. */
+#define AVT_ID_MAP_BITS 8
+
+typedef struct AVTIdMap {
+    void **pages[1 << (16 - AVT_ID_MAP_BITS)];
+} AVTIdMap;
+
+static inline void *avt_id_map_get(const AVTIdMap *map, uint16_t id)
+{
+    void **page = map->pages[id >> AVT_ID_MAP_BITS];
+    return page ? page[id & ((1 << AVT_ID_MAP_BITS) - 1)] : NULL;
+}
+
+/* Set the pointer for an ID. Only fails if a page can't be allocated. */
+int avt_id_map_set(AVTIdMap *map, uint16_t id, void *ptr);
+
+/* Free all pages. Does not touch the pointers themselves. */
+void avt_id_map_free(AVTIdMap *map);
+
+/* Sequence numbers are 32 bits on the wire, and wrap around. They are tracked
+ * extended to 64 bits, starting from AVT_SEQ_INIT() of the first one, so that
+ * extended values never go below zero. */
+#define AVT_SEQ_INIT(seq) ((UINT64_C(1) << 32) | (uint32_t)(seq))
+
+/* Extend seq to the 64-bit value nearest to ref, a previously extended one */
+static inline uint64_t avt_seq_unwrap(uint64_t ref, uint32_t seq)
+{
+    return ref + (int32_t)(seq - (uint32_t)ref);
+}
+
+/* Zero (usually) alloc FIFO. Payload is ref'd, and leaves with a ref.
+ * Power-of-two ring buffer, all operations on the head are O(1). */
 typedef struct AVTOutputPacket {
     union AVTPacketData pkt;
     AVTBuffer pl;
@@ -88,6 +122,7 @@ typedef struct AVTOutputPacket {
 
 typedef struct AVTPacketFifo {
     AVTOutputPacket *data;
+    unsigned int head;
     unsigned int nb;
     unsigned int alloc;
 } AVTPacketFifo;
@@ -96,6 +131,11 @@ typedef struct AVTPacketFifo {
 int avt_pkt_fifo_push(AVTPacketFifo *fifo,
                       union AVTPacketData pkt, AVTBuffer *pl);
 
+/* Push a packet to the FIFO, taking over the reference of pl.
+ * On success, pl is zeroed. */
+int avt_pkt_fifo_push_move(AVTPacketFifo *fifo,
+                           union AVTPacketData pkt, AVTBuffer *pl);
+
 /* Pop a packet from the FIFO. quick_ref'd into pl */
 int avt_pkt_fifo_pop(AVTPacketFifo *fifo,
                      union AVTPacketData *pkt, AVTBuffer *pl);
@@ -115,6 +155,14 @@ int avt_pkt_fifo_move(AVTPacketFifo *dst, AVTPacketFifo *src);
 int avt_pkt_fifo_drop(AVTPacketFifo *fifo,
                       unsigned nb_pkts, size_t ceiling);
 
+/* Get the packet at a position from the head, NULL if out of range.
+ * The packet remains in the FIFO. */
+AVTOutputPacket *avt_pkt_fifo_get(AVTPacketFifo *fifo, unsigned int idx);
+
+/* Get the on-wire size (header and payload) of the packet at the head.
+ * Returns 0 if empty. */
+size_t avt_pkt_fifo_front_size(AVTPacketFifo *fifo);
+
 /* Get the current size of the FIFO */
 size_t avt_pkt_fifo_size(AVTPacketFifo *fifo);
 
@@ -124,4 +172,38 @@ void avt_pkt_fifo_clear(AVTPacketFifo *fifo);
 /* Free all resources */
 void avt_pkt_fifo_free(AVTPacketFifo *fifo);
 
+/* Bounded lock-free multi-producer, single-consumer packet queue.
+ * Any number of threads may push concurrently, only one thread may pop. */
+typedef struct AVTPacketQueueCell {
+    atomic_size_t seq;
+    AVTOutputPacket p;
+} AVTPacketQueueCell;
+
+typedef struct AVTPacketQueue {
+    AVTPacketQueueCell *cells;
+    size_t mask;
+
+    /* Producers and the consumer each get their own cacheline */
+    alignas(64) atomic_size_t head;
+    alignas(64) atomic_size_t tail;
+} AVTPacketQueue;
+
+/* Initialize a queue of at least nb entries (rounded up to a power of two) */
+int avt_pkt_queue_init(AVTPacketQueue *q, size_t nb);
+
+/* Push a packet. Thread-safe. Returns AVT_ERROR(EAGAIN) if full. */
+int avt_pkt_queue_push(AVTPacketQueue *q,
+                       union AVTPacketData pkt, AVTBuffer *pl);
+
+/* Pop a packet. Consumer thread only. The reference is moved to pl.
+ * Returns AVT_ERROR(ENOENT) if there are no (completely pushed) packets. */
+int avt_pkt_queue_pop(AVTPacketQueue *q,
+                      union AVTPacketData *pkt, AVTBuffer *pl);
+
+/* Approximate number of queued packets. Thread-safe. */
+size_t avt_pkt_queue_pending(AVTPacketQueue *q);
+
+/* Free all resources, unreferencing any queued packets */
+void avt_pkt_queue_free(AVTPacketQueue *q);
+
 #endif /* AVTRANSPORT_UTILS_H */
@@ -0,0 +1,138 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avtransport/avtransport.h>
+
+#include "fec.h"
+#include "utils_internal.h"
+
+/* Repair symbols generated and payloads recovered per second, for frames
+ * of a 50 Mbps, 30 fps video stream. The first encode of each size also
+ * builds the cached plan, and is timed separately. */
+
+#define NB_FRAMES 64
+#define OVERHEAD 10 /* Percent */
+
+static const size_t sizes[] = {
+    1200,
+    50000000 / 8 / 30, /* An average frame */
+    50000000 / 8 / 2,  /* A keyframe */
+};
+
+static double mbps(size_t bytes, uint64_t time)
+{
+    return bytes*8 / (time / 1000000000.0) / 1000000.0;
+}
+
+static int run(size_t len)
+{
+    AVTFECBlocks b;
+    int err = avt_fec_blocks(&b, len);
+    if (err < 0)
+        return err;
+
+    int nb_source = (len + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+    int nb_repair = (nb_source*OVERHEAD + 99) / 100;
+    size_t padded = (size_t)nb_source*AVT_FEC_SYMBOL_SIZE;
+
+    uint8_t *src = calloc(padded, 1);
+    uint8_t *data = malloc(padded);
+    uint8_t *repair = malloc((size_t)nb_repair*AVT_FEC_SYMBOL_SIZE);
+    uint64_t *lost = calloc((nb_source + 63) / 64, sizeof(*lost));
+    uint64_t *repair_lost = calloc((nb_repair + 63) / 64, sizeof(*repair_lost));
+    if (!src || !data || !repair || !lost || !repair_lost) {
+        err = AVT_ERROR(ENOMEM);
+        goto end;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        src[i] = rand();
+
+    uint64_t start = avt_get_time_ns();
+    err = avt_fec_encode(repair, src, len, 0, nb_repair);
+    uint64_t first = avt_get_time_ns() - start;
+    if (err < 0)
+        goto end;
+
+    start = avt_get_time_ns();
+    for (int i = 0; i < NB_FRAMES; i++)
+        avt_fec_encode(repair, src, len, 0, nb_repair);
+    uint64_t enc = avt_get_time_ns() - start;
+
+    /* Blocks are contiguous, so a burst of lost source symbols mostly
+     * falls within a single one. Lose almost as much as a block's repair
+     * symbols can make up for, and a repair symbol. */
+    int burst = AVT_MAX(nb_repair / b.nb - 3, 1);
+    int burst_start = (nb_source - burst) / 2;
+    for (int i = burst_start; i < burst_start + burst; i++)
+        lost[i >> 6] |= 1ULL << (i & 63);
+    repair_lost[0] |= 1;
+
+    uint64_t dec = 0;
+    for (int i = 0; i < NB_FRAMES; i++) {
+        memcpy(data, src, padded);
+        memset(&data[(size_t)burst_start*AVT_FEC_SYMBOL_SIZE], 0,
+               (size_t)burst*AVT_FEC_SYMBOL_SIZE);
+
+        start = avt_get_time_ns();
+        err = avt_fec_decode(data, len, lost, repair, nb_repair, repair_lost);
+        dec += avt_get_time_ns() - start;
+        if (err < 0)
+            goto end;
+
+        if (memcmp(data, src, len)) {
+            printf("%zu bytes: payload not recovered\n", len);
+            err = AVT_ERROR(EINVAL);
+            goto end;
+        }
+    }
+
+    printf("%zu bytes, %i blocks, %i%% overhead: first encode %.2f ms, "
+           "encode %.2f Mbps, recover %i symbols %.2f Mbps\n",
+           len, b.nb, OVERHEAD, first / 1000000.0,
+           mbps(len*NB_FRAMES, enc), burst, mbps(len*NB_FRAMES, dec));
+
+end:
+    free(src);
+    free(data);
+    free(repair);
+    free(lost);
+    free(repair_lost);
+    return err;
+}
+
+int main(void)
+{
+    for (int i = 0; i < AVT_ARRAY_ELEMS(sizes); i++)
+        if (run(sizes[i]) < 0)
+            return 1;
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+
+#include <avtransport/avtransport.h>
+
+#include "utils_internal.h"
+
+/* Throughput of the packet FIFO, kept at a steady depth so that it wraps
+ * around its ring, and filled then drained in bursts */
+
+#define NB_PKTS (1 << 24)
+#define DEPTH 64
+#define BURST 4096
+
+static int steady(AVTPacketFifo *f, AVTBuffer *pl)
+{
+    union AVTPacketData pkt = AVT_STREAM_DATA_HDR(.data_length = 1024);
+    AVTBuffer tmp;
+
+    for (int i = 0; i < NB_PKTS; i++) {
+        pkt.stream_data.global_seq = i;
+        if (avt_pkt_fifo_push(f, pkt, pl) < 0)
+            return 1;
+        if (i < DEPTH)
+            continue;
+
+        if (avt_pkt_fifo_pop(f, &pkt, &tmp) < 0 ||
+            pkt.stream_data.global_seq != (uint32_t)(i - DEPTH)) {
+            printf("Out of order at packet %i\n", i);
+            return 1;
+        }
+        avt_buffer_quick_unref(&tmp);
+    }
+
+    avt_pkt_fifo_clear(f);
+
+    return 0;
+}
+
+static int bursts(AVTPacketFifo *f, AVTBuffer *pl)
+{
+    union AVTPacketData pkt = AVT_STREAM_DATA_HDR(.data_length = 1024);
+    AVTBuffer tmp;
+
+    for (int i = 0; i < NB_PKTS; i += BURST) {
+        for (int j = 0; j < BURST; j++) {
+            pkt.stream_data.global_seq = i + j;
+            if (avt_pkt_fifo_push(f, pkt, pl) < 0)
+                return 1;
+        }
+        for (int j = 0; j < BURST; j++) {
+            if (avt_pkt_fifo_pop(f, &pkt, &tmp) < 0 ||
+                pkt.stream_data.global_seq != (uint32_t)(i + j)) {
+                printf("Out of order at packet %i\n", i + j);
+                return 1;
+            }
+            avt_buffer_quick_unref(&tmp);
+        }
+    }
+
+    return 0;
+}
+
+static int run(const char *name, int (*fn)(AVTPacketFifo *f, AVTBuffer *pl),
+               AVTBuffer *pl)
+{
+    AVTPacketFifo f = { };
+
+    uint64_t start = avt_get_time_ns();
+    int ret = fn(&f, pl);
+    uint64_t time = avt_get_time_ns() - start;
+
+    avt_pkt_fifo_free(&f);
+    if (ret)
+        return ret;
+
+    printf("%s: %.2f Mpkts/s\n", name,
+           NB_PKTS / (time / 1000000000.0) / 1000000.0);
+
+    return 0;
+}
+
+int main(void)
+{
+    AVTBuffer *pl = avt_buffer_alloc(1024);
+    if (!pl)
+        return 1;
+
+    int ret = run("steady", steady, pl);
+    if (!ret)
+        ret = run("bursts", bursts, pl);
+
+    avt_buffer_unref(&pl);
+
+    return ret;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avtransport/avtransport.h>
+
+#include "ldpc_encode.h"
+#include "ldpc_decode.h"
+#include "utils_internal.h"
+
+/* Headers per second encoded, checked and corrected, for both codes.
+ * There is only the portable implementation to measure. */
+
+#define NB_ENCODE (1 << 22)
+#define NB_DECODE (1 << 18)
+#define BATCH 64
+
+typedef struct Code {
+    const char *name;
+    int msg_len;
+    int parity_len;
+    void (*encode)(uint8_t *parity, const uint8_t *msg);
+    void (*decode)(uint8_t *blocks[], int ret[], int nb, int iterations);
+} Code;
+
+static const Code codes[] = {
+    { "LDPC(288, 224)", 28, 8, avt_ldpc_encode_288_224, avt_ldpc_decode_288_224 },
+    { "LDPC(2784, 2016)", 252, 96, avt_ldpc_encode_2784_2016, avt_ldpc_decode_2784_2016 },
+};
+
+static double rate(int nb, uint64_t time)
+{
+    return nb / (time / 1000000000.0) / 1000000.0;
+}
+
+static int run(const Code *c)
+{
+    int len = c->msg_len + c->parity_len;
+    uint8_t *data = malloc(BATCH*len);
+    uint8_t *blocks[BATCH];
+    int ret[BATCH];
+    if (!data)
+        return AVT_ERROR(ENOMEM);
+
+    for (int i = 0; i < BATCH*len; i++)
+        data[i] = rand();
+    for (int i = 0; i < BATCH; i++)
+        blocks[i] = &data[i*len];
+
+    uint64_t start = avt_get_time_ns();
+    for (int i = 0; i < NB_ENCODE; i++) {
+        uint8_t *b = blocks[i % BATCH];
+        b[0] = i;
+        c->encode(&b[c->msg_len], b);
+    }
+    uint64_t enc = avt_get_time_ns() - start;
+
+    start = avt_get_time_ns();
+    for (int i = 0; i < NB_DECODE; i += BATCH)
+        c->decode(blocks, ret, BATCH, AVT_LDPC_DEFAULT_ITERATIONS);
+    uint64_t check = avt_get_time_ns() - start;
+
+    /* One bit flipped per block */
+    start = avt_get_time_ns();
+    for (int i = 0; i < NB_DECODE; i += BATCH) {
+        for (int j = 0; j < BATCH; j++)
+            blocks[j][(i + j) % len] ^= 1 << (j & 7);
+        c->decode(blocks, ret, BATCH, AVT_LDPC_DEFAULT_ITERATIONS);
+        for (int j = 0; j < BATCH; j++) {
+            if (ret[j] != 1) {
+                printf("%s: block %i not corrected (%i)\n", c->name, j, ret[j]);
+                free(data);
+                return AVT_ERROR(EINVAL);
+            }
+        }
+    }
+    uint64_t correct = avt_get_time_ns() - start;
+
+    printf("%s: encode %.2f M/s, check %.2f M/s, correct %.2f M/s\n", c->name,
+           rate(NB_ENCODE, enc), rate(NB_DECODE, check), rate(NB_DECODE, correct));
+
+    free(data);
+    return 0;
+}
+
+int main(void)
+{
+    for (int i = 0; i < AVT_ARRAY_ELEMS(codes); i++)
+        if (run(&codes[i]) < 0)
+            return 1;
+
+    return 0;
+}
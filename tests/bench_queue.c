@@ -0,0 +1,115 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <avtransport/avtransport.h>
+
+#include "utils_internal.h"
+
+/* Throughput of the queue between producer threads and the sender thread,
+ * with as many producers as given on the command line */
+
+#define QUEUE_SIZE 1024
+#define NB_PKTS (1 << 22)
+
+typedef struct Producer {
+    pthread_t thread;
+    AVTPacketQueue *q;
+    AVTBuffer *pl;
+    int nb_pkts;
+} Producer;
+
+static void *producer(void *arg)
+{
+    Producer *p = arg;
+    union AVTPacketData pkt = AVT_STREAM_DATA_HDR(.data_length = 1024);
+
+    for (int i = 0; i < p->nb_pkts; i++) {
+        pkt.stream_data.global_seq = i;
+        while (avt_pkt_queue_push(p->q, pkt, p->pl) == AVT_ERROR(EAGAIN))
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_producers = argc > 1 ? atoi(argv[1]) : 1;
+    if (nb_producers < 1)
+        return 1;
+
+    AVTPacketQueue q;
+    if (avt_pkt_queue_init(&q, QUEUE_SIZE) < 0)
+        return 1;
+
+    AVTBuffer *pl = avt_buffer_alloc(1024);
+    if (!pl)
+        return 1;
+
+    Producer *p = calloc(nb_producers, sizeof(*p));
+    if (!p)
+        return 1;
+
+    int total = 0;
+    uint64_t start = avt_get_time_ns();
+    for (int i = 0; i < nb_producers; i++) {
+        p[i].q = &q;
+        p[i].pl = pl;
+        p[i].nb_pkts = NB_PKTS / nb_producers;
+        total += p[i].nb_pkts;
+        if (pthread_create(&p[i].thread, NULL, producer, &p[i]))
+            return 1;
+    }
+
+    union AVTPacketData pkt;
+    AVTBuffer tmp;
+    for (int i = 0; i < total;) {
+        if (avt_pkt_queue_pop(&q, &pkt, &tmp) < 0) {
+            sched_yield();
+            continue;
+        }
+        avt_buffer_quick_unref(&tmp);
+        i++;
+    }
+    uint64_t time = avt_get_time_ns() - start;
+
+    for (int i = 0; i < nb_producers; i++)
+        pthread_join(p[i].thread, NULL);
+
+    printf("%i producers: %.2f Mpkts/s\n", nb_producers,
+           total / (time / 1000000000.0) / 1000000.0);
+
+    free(p);
+    avt_buffer_unref(&pl);
+    avt_pkt_queue_free(&q);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <avtransport/avtransport.h>
+
+#include "connection_internal.h"
+#include "reorder.h"
+#include "utils_internal.h"
+
+/* Rate and CPU time per packet of the batched receive path, from the
+ * socket into the reorder buffer and out of it, over loopback */
+
+#define URL_RX "avt://udp:passive@[::1]:18222"
+#define URL_TX "avt://udp:active@[::1]:18222"
+
+#define NB_PKTS 500000
+#define BATCH 64
+#define PKT_SIZE 1200
+
+/* Stream of the packets marking the end */
+#define END_STREAM 2
+
+typedef struct Sender {
+    AVTConnection *conn;
+    atomic_bool done;
+    int err;
+} Sender;
+
+static void *sender(void *arg)
+{
+    Sender *s = arg;
+    AVTBuffer *pl = avt_buffer_alloc(PKT_SIZE);
+    if (!pl) {
+        s->err = AVT_ERROR(ENOMEM);
+        return NULL;
+    }
+
+    uint32_t seq = 0;
+    for (int i = 0; i < NB_PKTS && s->err >= 0; i++) {
+        s->err = avt_connection_send(s->conn, AVT_STREAM_DATA_HDR(
+            .global_seq = seq++,
+            .stream_id = 1,
+            .pts = i,
+            .data_length = PKT_SIZE,
+        ), pl);
+        if (s->err >= 0 && !((i + 1) % BATCH))
+            s->err = avt_connection_flush(s->conn);
+    }
+
+    /* Keep marking the end until the receiver has caught up,
+     * in case the markers get dropped */
+    while (s->err >= 0 && !atomic_load(&s->done)) {
+        s->err = avt_connection_send(s->conn, AVT_STREAM_DATA_HDR(
+            .global_seq = seq++,
+            .stream_id = END_STREAM,
+        ), NULL);
+        if (s->err >= 0)
+            s->err = avt_connection_flush(s->conn);
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+
+    avt_buffer_unref(&pl);
+    return NULL;
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+int main(void)
+{
+    int err;
+    AVTContext *ctx;
+    AVTConnection *rx;
+    Sender s = { 0 };
+
+    err = avt_init(&ctx, NULL);
+    if (err < 0)
+        return 1;
+
+    err = avt_connection_create(ctx, &rx, &(AVTConnectionInfo) {
+        .type = AVT_CONNECTION_URL,
+        .path = URL_RX,
+    });
+    if (err < 0)
+        return 1;
+
+    err = avt_connection_create(ctx, &s.conn, &(AVTConnectionInfo) {
+        .type = AVT_CONNECTION_URL,
+        .path = URL_TX,
+    });
+    if (err < 0)
+        return 1;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sender, &s))
+        return 1;
+
+    uint64_t nb_pkts = 0;
+    uint64_t start = avt_get_time_ns();
+    uint64_t cpu_start = thread_cpu_ns();
+
+    while (!atomic_load(&s.done)) {
+        err = avt_connection_receive(rx, BATCH);
+        if (err < 0)
+            break;
+
+        AVTReorderChain *c;
+        while (avt_connection_pop(rx, &c) >= 0) {
+            if (c->stream_id == END_STREAM)
+                atomic_store(&s.done, true);
+            else
+                nb_pkts++;
+            avt_connection_done(rx, c);
+        }
+    }
+
+    uint64_t cpu = thread_cpu_ns() - cpu_start;
+    uint64_t time = avt_get_time_ns() - start;
+
+    atomic_store(&s.done, true);
+    pthread_join(thread, NULL);
+
+    if (err >= 0 && s.err >= 0)
+        printf("Received %.2f Mpkts/s, %.0f ns of CPU per packet, %.2f%% lost\n",
+               nb_pkts / (time / 1000.0), (double)cpu / nb_pkts,
+               100.0 - (100.0 * nb_pkts) / NB_PKTS);
+
+    avt_connection_destroy(&s.conn);
+    avt_connection_destroy(&rx);
+    avt_close(&ctx);
+
+    return err < 0 || s.err < 0;
+}
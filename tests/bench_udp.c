@@ -0,0 +1,193 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <avtransport/avtransport.h>
+
+#include "io_common.h"
+#include "address.h"
+#include "utils_internal.h"
+
+/* Loopback UDP throughput of each socket IO, sending and receiving
+ * in batches, the way connections do */
+
+extern const AVTIO avt_io_udp;
+extern const AVTIO avt_io_udp_uring;
+
+#define NB_PKTS 200000
+#define BATCH 64
+#define PKT_SIZE 1400
+#define HDR_SIZE 36
+
+/* First header byte of the packets marking the end */
+#define END_MARKER 0xFF
+
+typedef struct Receiver {
+    AVTContext *ctx;
+    const AVTIO *io;
+    AVTIOCtx *io_ctx;
+
+    uint64_t nb_pkts;
+    int err;
+    atomic_bool done;
+} Receiver;
+
+static void *receiver(void *arg)
+{
+    Receiver *r = arg;
+    AVTBuffer *bufs[BATCH];
+    size_t seg_len[BATCH];
+
+    while (!atomic_load(&r->done)) {
+        int nb = r->io->read_vec_input(r->ctx, r->io_ctx, bufs, seg_len, BATCH);
+        if (nb < 0) {
+            r->err = nb;
+            break;
+        }
+
+        for (int i = 0; i < nb; i++) {
+            size_t len;
+            uint8_t *data = avt_buffer_get_data(bufs[i], &len);
+            size_t seg = seg_len[i] ? seg_len[i] : len;
+
+            /* Coalesced datagrams are all full sized, save for the last */
+            for (size_t off = 0; off < len; off += seg) {
+                if (data[off] == END_MARKER)
+                    atomic_store(&r->done, true);
+                else
+                    r->nb_pkts++;
+            }
+            avt_buffer_unref(&bufs[i]);
+        }
+    }
+
+    return NULL;
+}
+
+static int run(AVTContext *ctx, const AVTIO *io, uint16_t port)
+{
+    int err;
+    AVTAddress rx_addr = {
+        .proto = AVT_PROTOCOL_UDP,
+        .mode = AVT_MODE_PASSIVE,
+        .port = port,
+        .ip[15] = 1,
+    };
+    AVTAddress tx_addr = rx_addr;
+    tx_addr.mode = AVT_MODE_ACTIVE;
+
+    Receiver r = { .ctx = ctx, .io = io };
+    AVTIOCtx *tx;
+
+    err = io->init(ctx, &r.io_ctx, &rx_addr);
+    if (err < 0) {
+        printf("%s: unavailable\n", io->name);
+        return 0;
+    }
+
+    err = io->init(ctx, &tx, &tx_addr);
+    if (err < 0) {
+        io->close(ctx, &r.io_ctx);
+        return err;
+    }
+
+    AVTBuffer *pl = avt_buffer_alloc(PKT_SIZE - HDR_SIZE);
+    if (!pl)
+        return AVT_ERROR(ENOMEM);
+
+    AVTIOVector vecs[BATCH] = { 0 };
+    for (int i = 0; i < BATCH; i++) {
+        vecs[i].hdr_len = HDR_SIZE;
+        vecs[i].payload = pl;
+    }
+    AVTIOVectors vec = { .nb_vecs = BATCH, .vecs = vecs };
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, receiver, &r))
+        return AVT_ERROR(ENOMEM);
+
+    uint64_t start = avt_get_time_ns();
+    for (int i = 0; i < NB_PKTS; i += BATCH) {
+        int64_t ret = io->write_vec_output(ctx, tx, &vec);
+        if (ret < 0) {
+            err = ret;
+            break;
+        }
+    }
+    io->flush(ctx, tx);
+    uint64_t sent = avt_get_time_ns() - start;
+
+    /* Keep marking the end until the receiver has caught up,
+     * in case the markers get dropped */
+    vecs[0].hdr[0] = END_MARKER;
+    vec.nb_vecs = 1;
+    while (!atomic_load(&r.done)) {
+        io->write_vec_output(ctx, tx, &vec);
+        io->flush(ctx, tx);
+        nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+    }
+    uint64_t received = avt_get_time_ns() - start;
+    pthread_join(thread, NULL);
+
+    if (err >= 0)
+        err = r.err;
+    if (err >= 0) {
+        printf("%s: sent %.1f Mbps, received %.1f Mbps, %.2f Mpkts/s, %.2f%% lost\n",
+               io->name,
+               (NB_PKTS * PKT_SIZE * 8.0) / (sent / 1000.0),
+               (r.nb_pkts * PKT_SIZE * 8.0) / (received / 1000.0),
+               r.nb_pkts / (received / 1000.0),
+               100.0 - (100.0 * r.nb_pkts) / NB_PKTS);
+    }
+
+    avt_buffer_unref(&pl);
+    io->close(ctx, &tx);
+    io->close(ctx, &r.io_ctx);
+
+    return err;
+}
+
+int main(void)
+{
+    AVTContext *ctx;
+    if (avt_init(&ctx, NULL) < 0)
+        return 1;
+
+    int err = run(ctx, &avt_io_udp, 18220);
+#ifdef CONFIG_HAVE_LIBURING
+    if (err >= 0)
+        err = run(ctx, &avt_io_udp_uring, 18221);
+#endif
+
+    avt_close(&ctx);
+
+    return err < 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avtransport/avtransport.h>
+
+#include "fec.h"
+#include "raptorq_tables.h"
+
+#define MAX_VECTOR 32
+
+/* Repair symbols of payloads, as computed by the reference encoder,
+ * tools/rfc6330_vectors.py, from the same tables */
+static const struct {
+    size_t len;
+    int first;
+    int nb;
+    uint8_t repair[MAX_VECTOR*AVT_FEC_SYMBOL_SIZE];
+} vectors[] = {
+    /* K' = 10 */
+    { 40, 0, 8, {
+        0x4c, 0x49, 0x21, 0x99, 0x47, 0x4e, 0xb5, 0xcc, 0xd3, 0x95, 0xa3, 0x9b,
+        0x43, 0xb7, 0x34, 0x81, 0x31, 0x8a, 0xa5, 0xef, 0xeb, 0x90, 0x2a, 0xc4,
+        0x58, 0xcc, 0xf1, 0x2b, 0x67, 0x0f, 0x52, 0xc6,
+    } },
+    /* K' = 10 */
+    { 37, 3, 5, {
+        0x43, 0x90, 0x47, 0x4d, 0x31, 0x24, 0xca, 0xdf, 0xeb, 0x42, 0x1d, 0x56,
+        0x58, 0x8f, 0xe3, 0xa9, 0x67, 0xca, 0x64, 0x5d,
+    } },
+    /* K' = 46 */
+    { 180, 0, 6, {
+        0x17, 0x62, 0x34, 0x43, 0x0f, 0x0d, 0x1e, 0x75, 0x8f, 0x3f, 0x86, 0xfa,
+        0x27, 0x96, 0xe2, 0xa8, 0x02, 0xa1, 0x74, 0x0d, 0x5f, 0x24, 0x04, 0x19,
+    } },
+    /* K' = 138 */
+    { 550, 10, 4, {
+        0x48, 0xa3, 0x4b, 0xc8, 0x67, 0x0f, 0x67, 0x74, 0x69, 0x9f, 0xa0, 0x15,
+        0xd1, 0x48, 0x04, 0x04,
+    } },
+    /* K' = 302 */
+    { 1201, 1, 6, {
+        0xe9, 0x1d, 0x44, 0x03, 0x56, 0x26, 0x9c, 0x90, 0x7b, 0x8a, 0x59, 0x0c,
+        0xd9, 0xad, 0xde, 0x7f, 0x70, 0xf3, 0x99, 0x6b, 0x34, 0xb2, 0x8a, 0x96,
+    } },
+};
+
+/* Payload sizes for the round trip: a single symbol, padding within the
+ * last symbol and up to K', a block of the largest K', and several blocks */
+static const size_t sizes[] = {
+    1,
+    37,
+    4*1000 + 1,
+    4*AVT_FEC_MAX_SOURCE,
+    4*AVT_FEC_MAX_SOURCE*2 + 3,
+};
+
+static uint32_t lcg(uint32_t *state)
+{
+    *state = *state*1664525 + 1013904223;
+    return *state >> 8;
+}
+
+static void fill(uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        data[i] = (i*31 + 7) & 0xFF;
+}
+
+static int check_vectors(void)
+{
+    for (int i = 0; i < AVT_ARRAY_ELEMS(vectors); i++) {
+        uint8_t src[4096], repair[MAX_VECTOR*AVT_FEC_SYMBOL_SIZE];
+        fill(src, vectors[i].len);
+
+        int err = avt_fec_encode(repair, src, vectors[i].len,
+                                 vectors[i].first, vectors[i].nb);
+        if (err < 0 || memcmp(repair, vectors[i].repair,
+                              vectors[i].nb*AVT_FEC_SYMBOL_SIZE)) {
+            printf("Vector %i (%zu bytes): repair symbols differ (%i)\n",
+                   i, vectors[i].len, err);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Every K' must be decodable from its source symbols alone */
+static int check_tables(void)
+{
+    uint8_t *src = calloc(AVT_FEC_MAX_SOURCE, AVT_FEC_SYMBOL_SIZE);
+    if (!src)
+        return 1;
+
+    for (int i = 0; i < AVT_ARRAY_ELEMS(rq_sys); i++) {
+        uint8_t repair[AVT_FEC_SYMBOL_SIZE];
+        int err = avt_fec_encode(repair, src, rq_sys[i][0]*AVT_FEC_SYMBOL_SIZE,
+                                 0, 1);
+        if (err < 0) {
+            printf("K' = %i: cannot encode (%i)\n", rq_sys[i][0], err);
+            free(src);
+            return 1;
+        }
+    }
+
+    free(src);
+    return 0;
+}
+
+/* Lose about as many source symbols as there is repair data for,
+ * with a few repair symbols gone too, and recover them */
+static int round_trip(size_t len, uint32_t seed)
+{
+    int ret = 1;
+    AVTFECBlocks b;
+    int z = avt_fec_blocks(&b, len);
+    if (z < 0)
+        return 1;
+
+    size_t nb_source = (len + AVT_FEC_SYMBOL_SIZE - 1) / AVT_FEC_SYMBOL_SIZE;
+    size_t padded = nb_source*AVT_FEC_SYMBOL_SIZE;
+    int nb_repair = 8*z + nb_source / 20;
+
+    uint8_t *src = calloc(padded, 1);
+    uint8_t *data = malloc(padded);
+    uint8_t *repair = malloc((size_t)nb_repair*AVT_FEC_SYMBOL_SIZE);
+    uint64_t *lost = calloc((nb_source + 63) / 64, sizeof(*lost));
+    uint64_t *repair_lost = calloc((nb_repair + 63) / 64, sizeof(*repair_lost));
+    if (!src || !data || !repair || !lost || !repair_lost)
+        goto end;
+
+    for (size_t i = 0; i < len; i++)
+        src[i] = lcg(&seed);
+
+    int err = avt_fec_encode(repair, src, len, 0, nb_repair);
+    if (err < 0) {
+        printf("%zu bytes: encoding failed (%i)\n", len, err);
+        goto end;
+    }
+
+    /* Two repair symbols of each block are lost, and all but two of the
+     * others make up for lost source symbols of their block */
+    memcpy(data, src, padded);
+    for (int n = 0; n < 2*z; n++)
+        repair_lost[n >> 6] |= 1ULL << (n & 63);
+    for (int bz = 0; bz < z; bz++) {
+        size_t k = bz < b.nb_long ? b.k_long : b.k_short;
+        size_t start = bz < b.nb_long ? (size_t)bz*b.k_long :
+                       (size_t)b.nb_long*b.k_long + (size_t)(bz - b.nb_long)*b.k_short;
+        size_t nb_lost = AVT_MIN((size_t)(nb_repair - bz + z - 1) / z - 4, k);
+        for (size_t n = 0; n < nb_lost; n++) {
+            size_t i;
+            do {
+                i = start + lcg(&seed) % k;
+            } while ((lost[i >> 6] >> (i & 63)) & 1);
+            lost[i >> 6] |= 1ULL << (i & 63);
+            memset(&data[i*AVT_FEC_SYMBOL_SIZE], 0, AVT_FEC_SYMBOL_SIZE);
+        }
+    }
+
+    err = avt_fec_decode(data, len, lost, repair, nb_repair, repair_lost);
+    if (err < 0) {
+        printf("%zu bytes: decoding failed (%i)\n", len, err);
+        goto end;
+    }
+    if (memcmp(data, src, len)) {
+        printf("%zu bytes: payload not recovered\n", len);
+        goto end;
+    }
+
+    ret = 0;
+
+end:
+    free(src);
+    free(data);
+    free(repair);
+    free(lost);
+    free(repair_lost);
+    return ret;
+}
+
+int main(void)
+{
+    if (check_vectors() || check_tables())
+        return 1;
+
+    for (int i = 0; i < AVT_ARRAY_ELEMS(sizes); i++)
+        if (round_trip(sizes[i], i + 1))
+            return 1;
+
+    return 0;
+}
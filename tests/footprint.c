@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include <avtransport/avtransport.h>
+
+#include "output_internal.h"
+#include "connection_scheduler.h"
+
+/* Connections created, to measure what each one adds */
+#define NB_CONN 8
+
+/* Upper bound for an output connection with two active streams, allocated,
+ * and actually resident. Most of what is allocated goes to the queue in
+ * front of the scheduler, which is only paged in as it fills up. Tables
+ * sized for every possible stream ID would take megabytes. */
+#define MAX_HEAP_PER_CONN (640*1024)
+#define MAX_RSS_PER_CONN (256*1024)
+
+/* Internal structures must not scale with the stream ID range */
+#define MAX_STRUCT_SIZE (16*1024)
+
+static size_t heap_used(void)
+{
+    struct mallinfo2 mi = mallinfo2();
+    /* Large allocations are mapped separately */
+    return mi.uordblks + mi.hblkhd;
+}
+
+static size_t rss(void)
+{
+    size_t size, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%zu %zu", &size, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident*sysconf(_SC_PAGESIZE);
+}
+
+static int open_output(AVTContext *ctx, AVTConnection **conn, AVTOutput **out)
+{
+    AVTConnectionInfo info = {
+        .type = AVT_CONNECTION_URL,
+        .path = "file:///dev/null",
+    };
+    int err = avt_connection_create(ctx, conn, &info);
+    if (err < 0)
+        return err;
+
+    err = avt_output_open(ctx, out, *conn, &(AVTOutputOptions) { 0 });
+    if (err < 0)
+        return err;
+
+    AVTStream *st[2];
+    for (int i = 0; i < 2; i++) {
+        st[i] = avt_output_stream_add(*out, i*1000);
+        if (!st[i])
+            return AVT_ERROR(ENOMEM);
+    }
+
+    for (int i = 0; i < 64; i++) {
+        AVTPacket pkt = {
+            .data = avt_buffer_alloc(1024),
+            .pts = i,
+        };
+        err = avt_output_stream_data(st[i & 1], &pkt);
+        avt_buffer_unref(&pkt.data);
+        if (err < 0)
+            return err;
+    }
+
+    return avt_connection_flush(*conn);
+}
+
+int main(void)
+{
+    int err;
+    AVTContext *ctx;
+    AVTConnection *conn[NB_CONN];
+    AVTOutput *out[NB_CONN];
+
+    if (sizeof(AVTOutput) > MAX_STRUCT_SIZE ||
+        sizeof(AVTScheduler) > MAX_STRUCT_SIZE) {
+        printf("AVTOutput: %zu bytes, AVTScheduler: %zu bytes\n",
+               sizeof(AVTOutput), sizeof(AVTScheduler));
+        return 1;
+    }
+
+    err = avt_init(&ctx, NULL);
+    if (err < 0)
+        return 1;
+
+    /* The first one also sets up what is shared, like the buffer pool */
+    err = open_output(ctx, &conn[0], &out[0]);
+    if (err < 0)
+        return 1;
+
+    size_t heap_before = heap_used();
+    size_t rss_before = rss();
+
+    for (int i = 1; i < NB_CONN; i++) {
+        err = open_output(ctx, &conn[i], &out[i]);
+        if (err < 0)
+            return 1;
+    }
+
+    size_t heap = (heap_used() - heap_before) / (NB_CONN - 1);
+    size_t resident = (rss() - rss_before) / (NB_CONN - 1);
+    printf("Footprint per connection with 2 streams: %zu bytes, "
+           "%zu bytes resident\n", heap, resident);
+
+    for (int i = 0; i < NB_CONN; i++) {
+        avt_output_close(&out[i]);
+        avt_connection_destroy(&conn[i]);
+    }
+    avt_close(&ctx);
+
+    return heap > MAX_HEAP_PER_CONN || resident > MAX_RSS_PER_CONN;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <avtransport/avtransport.h>
+
+#include "connection_mirror.h"
+
+/* Writes packets to a mirror with sequence numbers wrapping around
+ * 0xFFFFFFFF, and reads all of them back */
+
+#define FIRST_SEQ (UINT32_MAX - 5000)
+#define NB_PKTS 10000
+#define BATCH 32
+
+static size_t payload_len(uint32_t i)
+{
+    return i % 67;
+}
+
+static uint8_t payload_byte(uint32_t i, size_t j)
+{
+    return (i*7 + j) & 0xFF;
+}
+
+static int check(AVTMirror *m, uint32_t i)
+{
+    union AVTPacketData pkt;
+    AVTBuffer *pl;
+    uint32_t seq = FIRST_SEQ + i;
+
+    int err = avt_mirror_read(m, seq, &pkt, &pl);
+    if (err < 0) {
+        printf("Packet %u: read error %i\n", seq, err);
+        return err;
+    }
+
+    size_t len = pl ? avt_buffer_get_data_len(pl) : 0;
+    uint8_t *data = pl ? avt_buffer_get_data(pl, &len) : NULL;
+    if ((uint32_t)pkt.seq != seq || pkt.stream_data.pts != i ||
+        len != payload_len(i)) {
+        printf("Packet %u: got packet %u, pts %" PRIi64 ", %zu bytes\n",
+               seq, (uint32_t)pkt.seq, pkt.stream_data.pts, len);
+        err = AVT_ERROR(EINVAL);
+    }
+
+    for (size_t j = 0; err >= 0 && j < len; j++) {
+        if (data[j] != payload_byte(i, j)) {
+            printf("Packet %u: payload mismatch at %zu\n", seq, j);
+            err = AVT_ERROR(EINVAL);
+        }
+    }
+
+    avt_buffer_unref(&pl);
+    return err;
+}
+
+int main(void)
+{
+    int err;
+    AVTContext *ctx;
+    AVTMirror *m;
+    AVTPacketFifo fifo = { 0 };
+
+    char path[] = "/tmp/avt_mirror_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    err = avt_init(&ctx, NULL);
+    if (err < 0)
+        return 1;
+
+    err = avt_mirror_open(ctx, &m, path);
+    if (err < 0)
+        return 1;
+
+    for (uint32_t i = 0; i < NB_PKTS && err >= 0; i++) {
+        AVTBuffer *pl = NULL;
+        size_t len = payload_len(i);
+        if (len) {
+            pl = avt_buffer_alloc(len);
+            if (!pl)
+                return 1;
+            uint8_t *data = avt_buffer_get_data(pl, &len);
+            for (size_t j = 0; j < len; j++)
+                data[j] = payload_byte(i, j);
+        }
+
+        err = avt_pkt_fifo_push(&fifo, AVT_STREAM_DATA_HDR(
+            .global_seq = (uint32_t)(FIRST_SEQ + i),
+            .stream_id = 1,
+            .pts = i,
+            .data_length = len,
+        ), pl);
+        avt_buffer_unref(&pl);
+
+        if (err >= 0 && (fifo.nb == BATCH || i == (NB_PKTS - 1))) {
+            err = avt_mirror_write(m, &fifo);
+            avt_pkt_fifo_clear(&fifo);
+
+            /* Packets from before the wrap stay readable while writing */
+            if (err >= 0)
+                err = check(m, i / 2);
+        }
+    }
+    if (err < 0)
+        return 1;
+
+    for (uint32_t i = 0; i < NB_PKTS; i++)
+        if (check(m, i) < 0)
+            return 1;
+
+    /* Never written, on either side of the range */
+    union AVTPacketData pkt;
+    AVTBuffer *pl = NULL;
+    if (avt_mirror_read(m, FIRST_SEQ - 1, &pkt, &pl) != AVT_ERROR(ENOENT) ||
+        avt_mirror_read(m, FIRST_SEQ + NB_PKTS, &pkt, &pl) != AVT_ERROR(ENOENT)) {
+        printf("Read a packet never written\n");
+        return 1;
+    }
+
+    avt_pkt_fifo_free(&fifo);
+    avt_mirror_close(&m);
+    avt_close(&ctx);
+    unlink(path);
+
+    return 0;
+}
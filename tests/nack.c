@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <avtransport/avtransport.h>
+
+#include "reorder.h"
+#include "utils_internal.h"
+
+/* Receives packets with gaps, around sequence numbers wrapping past
+ * 0xFFFFFFFF, and checks which ranges are asked for, and when */
+
+#define FIRST_SEQ (UINT32_MAX - 10)
+#define NB_PKTS 40
+
+static bool missing(uint32_t seq)
+{
+    return (seq >= UINT32_MAX - 7 && seq <= UINT32_MAX - 5) ||
+           seq == UINT32_MAX || seq == 1 || seq == 20;
+}
+
+/* Late, but arrives before being asked for */
+#define LATE_SEQ 0
+
+static const AVTReorderNackRange expected[] = {
+    { UINT32_MAX - 7, 3 },
+    { UINT32_MAX, 1 },
+    { 1, 1 },
+    { 20, 1 },
+};
+#define NB_MISSING 6
+
+static int push(AVTContext *ctx, AVTReorderBuffer *rb, uint32_t seq)
+{
+    AVTBuffer *pl = avt_buffer_alloc(16);
+    if (!pl)
+        return AVT_ERROR(ENOMEM);
+
+    int err = avt_reorder_push(ctx, rb, AVT_STREAM_DATA_HDR(
+        .global_seq = seq,
+        .stream_id = 1,
+        .pts = seq,
+        .data_length = 16,
+    ), pl);
+    avt_buffer_unref(&pl);
+
+    AVTReorderChain *c;
+    while (avt_reorder_pop(ctx, rb, &c) >= 0)
+        avt_reorder_done(ctx, rb, c);
+
+    return err;
+}
+
+/* Returns 1 if the expected ranges were asked for, 0 if none were */
+static int nack(AVTContext *ctx, AVTReorderBuffer *rb, uint64_t now)
+{
+    AVTReorderNackRange ranges[16];
+    int nb = avt_reorder_nack(ctx, rb, now, ranges, 16);
+    if (!nb)
+        return 0;
+
+    bool match = nb == AVT_ARRAY_ELEMS(expected);
+    for (int i = 0; match && i < nb; i++)
+        match = ranges[i].seq == expected[i].seq && ranges[i].nb == expected[i].nb;
+    if (!match) {
+        printf("Asked for:");
+        for (int i = 0; i < nb; i++)
+            printf(" %" PRIu64 "+%" PRIu32, ranges[i].seq, ranges[i].nb);
+        printf("\n");
+        return AVT_ERROR(EINVAL);
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    int err;
+    AVTContext *ctx;
+    AVTReorderBuffer rb;
+
+    err = avt_init(&ctx, NULL);
+    if (err < 0)
+        return 1;
+
+    err = avt_reorder_init(ctx, &rb, 1024*1024);
+    if (err < 0)
+        return 1;
+
+    uint64_t now = avt_get_time_ns();
+    for (uint32_t i = 0; i < NB_PKTS; i++) {
+        uint32_t seq = FIRST_SEQ + i;
+        if (missing(seq) || seq == LATE_SEQ)
+            continue;
+        if (push(ctx, &rb, seq) < 0)
+            return 1;
+    }
+    if (push(ctx, &rb, LATE_SEQ) < 0)
+        return 1;
+
+    /* Gaps are given a little time to fill in */
+    if (nack(ctx, &rb, now) != 0)
+        return 1;
+
+    now += 1000000000;
+    if (nack(ctx, &rb, now) != 1 || nack(ctx, &rb, now) != 0)
+        return 1;
+
+    /* Asked for again after exponentially longer waits, until given up */
+    uint64_t rto = rb.nack.rtt + 4*rb.nack.rtt_var;
+    int tries = 1;
+    for (uint64_t wait = rto;; wait *= 2) {
+        if (nack(ctx, &rb, now + wait - 1) != 0)
+            return 1;
+        now += wait;
+        err = nack(ctx, &rb, now);
+        if (err < 0)
+            return 1;
+        if (!err)
+            break;
+        tries++;
+    }
+
+    printf("Asked %i times, %" PRIu64 " packets lost\n", tries, rb.nack.lost);
+    if (tries < 2 || rb.nack.lost != NB_MISSING)
+        return 1;
+
+    /* Given up on */
+    if (nack(ctx, &rb, now + 100*rto) != 0)
+        return 1;
+
+    avt_reorder_free(ctx, &rb);
+    avt_close(&ctx);
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <avtransport/avtransport.h>
+
+#include "connection_internal.h"
+#include "reorder.h"
+#include "utils_internal.h"
+
+/* Loses packets on their way over loopback, and checks the receiver
+ * gets them back by asking the output to resend them */
+
+#define PORT_RX 18240
+#define PORT_RELAY 18241
+#define URL_RX "avt://udp:passive@[::1]:18240"
+#define URL_TX "avt://udp:active@[::1]:18241"
+
+#define NB_PKTS 256
+#define PKT_SIZE 256
+#define BATCH 64
+#define MAX_SEQ 4096
+
+/* Datagrams the relay drops the first time through */
+static const int dropped[] = { 3, 4, 5, 40, 100, 101, 200 };
+
+typedef struct Resend {
+    AVTOutput *out;
+    int nb_requests;
+    uint32_t nb_requested;
+    uint32_t lost;
+} Resend;
+
+static int resend_cb(AVTContext *ctx, void *opaque, uint64_t seq, uint32_t nb)
+{
+    Resend *r = opaque;
+    r->nb_requests++;
+    r->nb_requested += nb;
+    return avt_output_resend(ctx, r->out, seq, nb);
+}
+
+static int feedback_cb(AVTContext *ctx, void *opaque, AVTStream *st,
+                       uint64_t epoch_offset, uint64_t bandwidth,
+                       uint32_t fec_corrections, uint32_t corrupt_packets,
+                       uint32_t missing_packets)
+{
+    Resend *r = opaque;
+    r->lost = missing_packets;
+    return 0;
+}
+
+static int relay_open(void)
+{
+    int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in6 addr = {
+        .sin6_family = AF_INET6,
+        .sin6_port = htons(PORT_RELAY),
+        .sin6_addr = IN6ADDR_LOOPBACK_INIT,
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Forward up to a batch of what arrived on the relay to the receiver,
+ * minus the drops. Returns the number of datagrams forwarded. */
+static int relay_pump(int fd, int *nb_seen, int timeout_ms)
+{
+    static uint8_t buf[65536];
+    struct sockaddr_in6 dst = {
+        .sin6_family = AF_INET6,
+        .sin6_port = htons(PORT_RX),
+        .sin6_addr = IN6ADDR_LOOPBACK_INIT,
+    };
+    int nb = 0;
+
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return 0;
+
+    ssize_t len;
+    for (int i = 0; i < BATCH &&
+         (len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) >= 0; i++) {
+        bool drop = false;
+        for (size_t i = 0; i < AVT_ARRAY_ELEMS(dropped); i++)
+            drop |= *nb_seen == dropped[i];
+        (*nb_seen)++;
+        if (drop)
+            continue;
+
+        if (sendto(fd, buf, len, 0, (struct sockaddr *)&dst, sizeof(dst)) < 0)
+            return -1;
+        nb++;
+    }
+
+    return nb;
+}
+
+int main(void)
+{
+    int err;
+    AVTContext *tx_ctx, *rx_ctx;
+    AVTConnection *rx, *tx;
+    Resend r = { 0 };
+
+    int relay = relay_open();
+    if (relay < 0)
+        return 1;
+
+    err = avt_init(&tx_ctx, NULL);
+    if (err < 0)
+        return 1;
+    err = avt_init(&rx_ctx, NULL);
+    if (err < 0)
+        return 1;
+
+    err = avt_connection_create(rx_ctx, &rx, &(AVTConnectionInfo) {
+        .type = AVT_CONNECTION_URL,
+        .path = URL_RX,
+    });
+    if (err < 0)
+        return 1;
+
+    err = avt_connection_create(tx_ctx, &tx, &(AVTConnectionInfo) {
+        .type = AVT_CONNECTION_URL,
+        .path = URL_TX,
+        .output_opts.resend_buffer = 1024*1024,
+    });
+    if (err < 0)
+        return 1;
+
+    err = avt_output_open(tx_ctx, &r.out, tx, &(AVTOutputOptions) { 0 });
+    if (err < 0)
+        return 1;
+
+    avt_connection_set_input_cb(rx, &(AVTInputCallbacks) {
+        .resend_cb = resend_cb,
+        .feedback_cb = feedback_cb,
+    }, &r);
+
+    AVTStream *st = avt_output_stream_add(r.out, 1);
+    if (!st)
+        return 1;
+
+    /* Send in batches, so that no socket buffer overflows. Then, receive
+     * until every sequence number up to the highest one seen has arrived,
+     * with an empty packet sent each round, so that losses at the end are
+     * noticed too. */
+    static bool received[MAX_SEQ];
+    uint64_t top = 0, nb_received = 0;
+    int nb_sent = 0, nb_seen = 0, pending = 0;
+    uint64_t deadline = avt_get_time_ns() + 5000000000ULL;
+
+    while (avt_get_time_ns() < deadline) {
+        int nb = relay_pump(relay, &nb_seen, 1);
+        if (nb < 0)
+            return 1;
+        pending += nb;
+
+        while (pending > 0) {
+            err = avt_connection_receive(rx, BATCH);
+            if (err < 0)
+                return 1;
+            pending -= err;
+        }
+
+        AVTReorderChain *c;
+        while (avt_connection_pop(rx, &c) >= 0) {
+            if (c->seq < MAX_SEQ && !received[c->seq]) {
+                received[c->seq] = true;
+                nb_received++;
+                top = AVT_MAX(top, c->seq + 1);
+            }
+            avt_connection_done(rx, c);
+        }
+
+        if (top > NB_PKTS && nb_received == top)
+            break;
+        if (nb)
+            continue;
+
+        if (nb_sent >= NB_PKTS)
+            nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+
+        for (int i = 0; i < (nb_sent < NB_PKTS ? BATCH : 1); i++) {
+            AVTPacket pkt = {
+                .data = nb_sent < NB_PKTS ? avt_buffer_alloc(PKT_SIZE) : NULL,
+                .pts = nb_sent++,
+            };
+            err = avt_output_stream_data(st, &pkt);
+            avt_buffer_unref(&pkt.data);
+            if (err < 0)
+                return 1;
+        }
+        err = avt_connection_flush(tx);
+        if (err < 0)
+            return 1;
+    }
+
+    printf("Received %" PRIu64 " of %" PRIu64 " packets, after %i resend "
+           "requests for %u packets, %u lost\n",
+           nb_received, top, r.nb_requests, r.nb_requested, r.lost);
+
+    avt_output_close(&r.out);
+    avt_connection_destroy(&tx);
+    avt_connection_destroy(&rx);
+    avt_close(&tx_ctx);
+    avt_close(&rx_ctx);
+    close(relay);
+
+    return !(top > NB_PKTS && nb_received == top) ||
+           r.nb_requested < AVT_ARRAY_ELEMS(dropped) || r.lost;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2024, Lynne
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <avtransport/avtransport.h>
+
+#include "connection_resend.h"
+
+/* Adds packets to resend rings with sequence numbers wrapping around
+ * 0xFFFFFFFF, and gets them back, or not, once evicted by size or age */
+
+#define FIRST_SEQ (UINT32_MAX - 100)
+#define BATCH 16
+
+static int add(AVTResendRing *r, uint32_t first, int nb, size_t len,
+               uint64_t time)
+{
+    int err = 0;
+    AVTPacketFifo fifo = { 0 };
+
+    for (int i = 0; i < nb && err >= 0; i++) {
+        uint32_t seq = first + i;
+        AVTBuffer *pl = avt_buffer_alloc(len);
+        if (!pl)
+            return AVT_ERROR(ENOMEM);
+        memset(avt_buffer_get_data(pl, &len), seq & 0xFF, len);
+
+        err = avt_pkt_fifo_push(&fifo, AVT_STREAM_DATA_HDR(
+            .global_seq = seq,
+            .stream_id = 1,
+            .pts = seq,
+            .data_length = len,
+        ), pl);
+        avt_buffer_unref(&pl);
+
+        if (err >= 0 && (fifo.nb == BATCH || i == (nb - 1))) {
+            avt_resend_ring_add(r, &fifo, time);
+            avt_pkt_fifo_clear(&fifo);
+        }
+    }
+
+    avt_pkt_fifo_free(&fifo);
+    return err;
+}
+
+/* Check packets [first, first + nb) are held, or not */
+static int check(AVTResendRing *r, uint32_t first, int nb, bool held)
+{
+    for (int i = 0; i < nb; i++) {
+        uint32_t seq = first + i;
+        union AVTPacketData pkt;
+        AVTBuffer pl;
+
+        int err = avt_resend_ring_get(r, seq, &pkt, &pl);
+        if (!held) {
+            if (err != AVT_ERROR(ENOENT)) {
+                printf("Packet %" PRIu32 ": still held\n", seq);
+                if (err >= 0)
+                    avt_buffer_quick_unref(&pl);
+                return AVT_ERROR(EINVAL);
+            }
+            continue;
+        }
+
+        if (err < 0) {
+            printf("Packet %" PRIu32 ": get error %i\n", seq, err);
+            return err;
+        }
+
+        size_t len;
+        uint8_t *data = avt_buffer_get_data(&pl, &len);
+        if ((uint32_t)pkt.seq != seq || (uint32_t)pkt.stream_data.pts != seq ||
+            !len || data[0] != (seq & 0xFF) || data[len - 1] != (seq & 0xFF)) {
+            printf("Packet %" PRIu32 ": got packet %" PRIu32 "\n",
+                   seq, (uint32_t)pkt.seq);
+            err = AVT_ERROR(EINVAL);
+        }
+
+        avt_buffer_quick_unref(&pl);
+        if (err < 0)
+            return err;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    int err;
+    AVTResendRing r;
+    uint64_t now = avt_get_time_ns();
+
+    /* Across the wrap */
+    err = avt_resend_ring_init(&r, 1024*1024, 0);
+    if (err < 0)
+        return 1;
+    if (add(&r, FIRST_SEQ, 300, 64, now) < 0 ||
+        check(&r, FIRST_SEQ, 300, true) < 0 ||
+        check(&r, FIRST_SEQ - 10, 10, false) < 0 ||
+        check(&r, FIRST_SEQ + 300, 10, false) < 0)
+        return 1;
+    avt_resend_ring_free(&r);
+
+    /* By size: room for 32 payloads of 1000 bytes, in 128 entries */
+    err = avt_resend_ring_init(&r, 32*1000, 0);
+    if (err < 0)
+        return 1;
+    if (add(&r, FIRST_SEQ, 200, 1000, now) < 0 ||
+        check(&r, FIRST_SEQ + 200 - 32, 32, true) < 0 ||
+        check(&r, FIRST_SEQ, 200 - 32, false) < 0)
+        return 1;
+    if (r.size > r.max_size) {
+        printf("Holding %" PRIu64 " bytes, over %" PRIu64 "\n", r.size, r.max_size);
+        return 1;
+    }
+    avt_resend_ring_free(&r);
+
+    /* By age: packets sent 5 seconds ago are evicted once newer ones are
+     * added, and never returned in the meantime */
+    err = avt_resend_ring_init(&r, 1024*1024, 1000000000);
+    if (err < 0)
+        return 1;
+    if (add(&r, FIRST_SEQ, 90, 64, now - 5000000000ULL) < 0 ||
+        check(&r, FIRST_SEQ, 90, false) < 0)
+        return 1;
+    if (add(&r, FIRST_SEQ + 90, 20, 64, now) < 0 ||
+        check(&r, FIRST_SEQ, 90, false) < 0 ||
+        check(&r, FIRST_SEQ + 90, 20, true) < 0)
+        return 1;
+    if (r.size != 20*64) {
+        printf("Holding %" PRIu64 " bytes after eviction by age\n", r.size);
+        return 1;
+    }
+    avt_resend_ring_free(&r);
+
+    return 0;
+}
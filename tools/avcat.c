@@ -237,6 +237,36 @@ static int open_io(IOContext *io, const char *path, int is_out)
     return 0;
 }
 
+static int index_files(char **paths)
+{
+    int err;
+    AVTContext *avt;
+    AVTContextOptions ctx_opts = {
+        .log_cb = NULL,
+        .producer_name = "avcat",
+        .producer_ver = { PROJECT_VERSION_MAJOR,
+                          PROJECT_VERSION_MICRO,
+                          PROJECT_VERSION_MINOR },
+    };
+
+    err = avt_init(&avt, &ctx_opts);
+    if (err < 0)
+        return err;
+
+    for (int i = 0; i < MAX_INPUTS && paths[i]; i++) {
+        err = avt_index_file(avt, paths[i], NULL);
+        if (err < 0) {
+            avt_log(NULL, AVT_LOG_ERROR, "Couldn't index %s: %i!\n", paths[i], err);
+            break;
+        }
+        avt_log(NULL, AVT_LOG_INFO, "Indexed %s\n", paths[i]);
+    }
+
+    avt_close(&avt);
+
+    return err;
+}
+
 int main(int argc, char **argv)
 {
     int err;
@@ -246,6 +276,7 @@ int main(int argc, char **argv)
     GEN_OPT_ONE(opts_list, char *, output,  "o", 1, 1, 0, 0, "Destination (file or URL)");
     GEN_OPT_ONE(opts_list, bool  , unround, "u", 0, 0, 0, 0, "Unround timestamps (for remuxing from Matroska)");
     GEN_OPT_ONE(opts_list, char *, mirror,  "m", 1, 1, 0, 0, "Mirror input and output to a file for monitoring and caching");
+    GEN_OPT_ONE(opts_list, bool  , build_index, "x", 0, 0, 0, 0, "Write a seek index for each input file (<input>.idx), then exit");
 
     if ((err = GEN_OPT_PARSE(opts_list, argc, argv)))
         return err;
@@ -255,6 +286,9 @@ int main(int argc, char **argv)
         return EINVAL;
     }
 
+    if (build_index)
+        return index_files(input) < 0;
+
     /* Create inputs */
     IOContext in[MAX_INPUTS] = { 0 };
     for (int i = 0; input[i]; i++) {
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2024 Lynne
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the “Software”), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+# OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+# HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+
+# Extracts the tables RaptorQ needs from the plain text of RFC 6330:
+#  - V0 to V3, the random number generator's tables (section 5.5)
+#  - f, the degree distribution (section 5.3.5.2)
+#  - the systematic indices and other parameters (section 5.6)
+# and writes them as a C header, replacing libavtransport/raptorq_tables.h:
+#   tools/rfc6330_tables.py rfc6330.txt libavtransport/raptorq_tables.h
+
+import re
+import sys
+
+if len(sys.argv) != 3:
+    print("Invalid arguments: need <rfc6330.txt> <output header>", file=sys.stderr)
+    exit(22)
+
+with open(sys.argv[1]) as text:
+    lines = text.read().splitlines()
+
+# Split into sections by their headings, which start on the first column.
+# The table of contents is indented, and so is skipped.
+sections = { }
+cur = None
+heading = re.compile(r'^(\d+(?:\.\d+)*)\.\s+\S')
+for l in lines:
+    m = heading.match(l)
+    if m:
+        cur = m.group(1)
+        sections[cur] = [ ]
+        continue
+    # Page headers and footers
+    if "RFC 6330" in l or "[Page" in l or l.startswith("\f"):
+        continue
+    if cur is not None:
+        sections[cur].append(l)
+
+def fail(msg):
+    print(f"{sys.argv[1]}: {msg}, is this RFC 6330?", file=sys.stderr)
+    exit(22)
+
+def section(nb):
+    if nb not in sections:
+        fail(f"no section {nb}")
+    return sections[nb]
+
+# Cells of the table rows in a section that are all integers
+def table_rows(nb):
+    rows = [ ]
+    for l in section(nb):
+        if '|' not in l:
+            continue
+        cells = [ c.strip() for c in l.strip().strip('|').split('|') ]
+        if cells and all(c.isdigit() for c in cells):
+            rows.append([ int(c) for c in cells ])
+    return rows
+
+# The V tables
+v = [ ]
+for i in range(4):
+    vals = [ int(n) for l in section(f"5.5.{i + 1}") for n in re.findall(r'\d+', l) ]
+    if len(vals) != 256 or any(n > 0xFFFFFFFF for n in vals):
+        fail(f"table V{i} has {len(vals)} entries instead of 256")
+    v.append(vals)
+
+# The degree distribution, as (index, value) pairs, possibly several per row
+deg = { }
+for r in table_rows("5.3.5.2"):
+    if len(r) % 2:
+        fail("malformed degree distribution table")
+    for i in range(0, len(r), 2):
+        deg[r[i]] = r[i + 1]
+if sorted(deg.keys()) != list(range(31)) or deg[30] != 1 << 20 or \
+   any(deg[i] >= deg[i + 1] for i in range(30)):
+    fail("malformed degree distribution table")
+
+# The systematic indices: K', J(K'), S(K'), H(K'), W(K')
+sys_idx = [ ]
+for r in table_rows("5.6"):
+    if len(r) % 5:
+        fail("malformed systematic index table")
+    sys_idx += [ r[i:i + 5] for i in range(0, len(r), 5) ]
+sys_idx.sort()
+if not sys_idx or sys_idx[0][0] != 10 or sys_idx[-1][0] != 56403 or \
+   any(sys_idx[i][0] >= sys_idx[i + 1][0] for i in range(len(sys_idx) - 1)) or \
+   any(n > 0xFFFF for r in sys_idx for n in r[1:]):
+    fail("malformed systematic index table")
+
+# The license of the header being replaced
+with open(sys.argv[2]) as old:
+    license = old.read().split("*/\n", 1)[0] + "*/\n"
+
+with open(sys.argv[2], "w") as out:
+    out.write(license)
+    out.write("\n/* RaptorQ tables, from RFC 6330.\n")
+    out.write(" * Generated by tools/rfc6330_tables.py, do not edit. */\n\n")
+    out.write("#ifndef LIBAVTRANSPORT_RAPTORQ_TABLES\n")
+    out.write("#define LIBAVTRANSPORT_RAPTORQ_TABLES\n\n")
+    out.write("#include <stdint.h>\n\n")
+
+    out.write("static const uint32_t rq_v[4][256] = {\n")
+    for t in v:
+        out.write("    {\n")
+        for i in range(0, 256, 6):
+            out.write("        " + ", ".join(str(n) + "U" for n in t[i:i + 6]) + ",\n")
+        out.write("    },\n")
+    out.write("};\n\n")
+
+    out.write("static const uint32_t rq_deg[31] = {\n")
+    for i in range(0, 31, 8):
+        out.write("    " + ", ".join(str(deg[j]) for j in range(i, min(i + 8, 31))) + ",\n")
+    out.write("};\n\n")
+
+    out.write("/* K', J(K'), S(K'), H(K'), W(K') */\n")
+    out.write(f"static const uint16_t rq_sys[{len(sys_idx)}][5] = {{\n")
+    for r in sys_idx:
+        out.write("    { " + ", ".join(str(n) for n in r) + " },\n")
+    out.write("};\n\n")
+    out.write("#endif /* LIBAVTRANSPORT_RAPTORQ_TABLES */\n")
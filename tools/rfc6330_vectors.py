@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2024 Lynne
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the “Software”), to deal in the Software without
+# restriction, including without limitation the rights to use,
+# copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following
+# conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+# OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+# HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+# WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+# OTHER DEALINGS IN THE SOFTWARE.
+
+# Reference RaptorQ encoder, written directly from RFC 6330 section 5.3:
+# the constraint matrix A is built in full and solved by plain Gaussian
+# elimination. Shares nothing with libavtransport/fec.c but the tables.
+# Prints the repair symbols of the vectors in tests/fec.c:
+#   tools/rfc6330_vectors.py libavtransport/raptorq_tables.h
+
+import re
+import sys
+
+if len(sys.argv) != 2:
+    print("Invalid arguments: need <raptorq_tables.h>", file=sys.stderr)
+    exit(22)
+
+with open(sys.argv[1]) as f:
+    text = f.read()
+
+def c_array(name):
+    body = re.search(name + r'\[[^=]*=\s*\{(.*?)\n\};', text, re.S).group(1)
+    return [ int(n) for n in re.findall(r'\d+', body) ]
+
+vals = c_array('rq_v')
+V = [ vals[i*256:(i + 1)*256] for i in range(4) ]
+f = c_array('rq_deg')
+vals = c_array('rq_sys')
+sys_idx = [ vals[i:i + 5] for i in range(0, len(vals), 5) ]
+
+# GF(256), with the polynomial of section 5.7.3
+OCT_EXP = [ 0 ]*510
+OCT_LOG = [ 0 ]*256
+x = 1
+for i in range(255):
+    OCT_EXP[i] = OCT_EXP[i + 255] = x
+    OCT_LOG[x] = i
+    x <<= 1
+    if x & 0x100:
+        x ^= 0x11D
+
+def mul(a, b):
+    if not a or not b:
+        return 0
+    return OCT_EXP[OCT_LOG[a] + OCT_LOG[b]]
+
+def inv(a):
+    return OCT_EXP[255 - OCT_LOG[a]]
+
+def alpha(n):
+    return OCT_EXP[n % 255]
+
+def is_prime(n):
+    return n > 1 and all(n % d for d in range(2, int(n**0.5) + 1))
+
+# Section 5.3.5.1
+def rand(y, i, m):
+    return (V[0][(y + i) % 256] ^ V[1][((y >> 8) + i) % 256] ^
+            V[2][((y >> 16) + i) % 256] ^ V[3][((y >> 24) + i) % 256]) % m
+
+class Params:
+    def __init__(self, k):
+        self.k, self.j, self.s, self.h, self.w = next(r for r in sys_idx if r[0] >= k)
+        self.l = self.k + self.s + self.h
+        self.p = self.l - self.w
+        self.b = self.w - self.s
+        self.p1 = self.p
+        while not is_prime(self.p1):
+            self.p1 += 1
+
+# Sections 5.3.5.2 and 5.3.5.4
+def deg(p, v):
+    d = next(d for d in range(1, 31) if f[d - 1] <= v < f[d])
+    return min(d, p.w - 2)
+
+def tuple_of(p, x):
+    a = 53591 + p.j*997
+    if a % 2 == 0:
+        a += 1
+    b = 10267*(p.j + 1)
+    y = (b + x*a) % 2**32
+    d = deg(p, rand(y, 0, 2**20))
+    a = 1 + rand(y, 1, p.w - 1)
+    b = rand(y, 2, p.w)
+    d1 = 2 + rand(x, 3, 2) if d < 4 else 2
+    a1 = 1 + rand(x, 4, p.p1 - 1)
+    b1 = rand(x, 5, p.p1)
+    return d, a, b, d1, a1, b1
+
+# Intermediate symbols an encoding symbol is the sum of, section 5.3.5.3
+def enc_cols(p, x):
+    d, a, b, d1, a1, b1 = tuple_of(p, x)
+    cols = [ b ]
+    for _ in range(1, d):
+        b = (b + a) % p.w
+        cols.append(b)
+    while b1 >= p.p:
+        b1 = (b1 + a1) % p.p1
+    cols.append(p.w + b1)
+    for _ in range(1, d1):
+        b1 = (b1 + a1) % p.p1
+        while b1 >= p.p:
+            b1 = (b1 + a1) % p.p1
+        cols.append(p.w + b1)
+    return cols
+
+# The constraint matrix A, section 5.3.3.4.2
+def matrix(p):
+    a = [ [ 0 ]*p.l for _ in range(p.l) ]
+
+    # G_LDPC,1, I_S, G_LDPC,2
+    for i in range(p.b):
+        inc = 1 + i // p.s
+        r = i % p.s
+        for _ in range(3):
+            a[r][i] ^= 1
+            r = (r + inc) % p.s
+    for i in range(p.s):
+        a[i][p.b + i] = 1
+        a[i][p.w + i % p.p] ^= 1
+        a[i][p.w + (i + 1) % p.p] ^= 1
+
+    # G_HDPC = MT*GAMMA, I_H
+    ks = p.k + p.s
+    mt = [ [ 0 ]*ks for _ in range(p.h) ]
+    for j in range(ks - 1):
+        i1 = rand(j + 1, 6, p.h)
+        i2 = (i1 + rand(j + 1, 7, p.h - 1) + 1) % p.h
+        mt[i1][j] = 1
+        mt[i2][j] = 1
+    for i in range(p.h):
+        mt[i][ks - 1] = alpha(i)
+    for i in range(p.h):
+        for j in range(ks):
+            v = 0
+            for k in range(j, ks):
+                v ^= mul(mt[i][k], alpha(k - j))
+            a[p.s + i][j] = v
+        a[p.s + i][ks + i] = 1
+
+    # G_ENC
+    for i in range(p.k):
+        for c in enc_cols(p, i):
+            a[p.s + p.h + i][c] ^= 1
+
+    return a
+
+def solve(a, d):
+    n = len(a)
+    for col in range(n):
+        piv = next(r for r in range(col, n) if a[r][col])
+        a[col], a[piv] = a[piv], a[col]
+        d[col], d[piv] = d[piv], d[col]
+        iv = inv(a[col][col])
+        a[col] = [ mul(v, iv) for v in a[col] ]
+        d[col] = [ mul(v, iv) for v in d[col] ]
+        for r in range(n):
+            c = a[r][col]
+            if r == col or not c:
+                continue
+            a[r] = [ v ^ mul(c, w) for v, w in zip(a[r], a[col]) ]
+            d[r] = [ v ^ mul(c, w) for v, w in zip(d[r], d[col]) ]
+    return d
+
+def repair(src, first, nb):
+    k = (len(src) + 3) // 4
+    p = Params(k)
+    src = src + bytes(4*p.k - len(src))
+    d = [ [ 0 ]*4 for _ in range(p.s + p.h) ]
+    d += [ list(src[i*4:(i + 1)*4]) for i in range(p.k) ]
+    c = solve(matrix(p), d)
+
+    out = [ ]
+    for x in range(p.k + first, p.k + first + nb):
+        sym = [ 0 ]*4
+        for col in enc_cols(p, x):
+            sym = [ v ^ w for v, w in zip(sym, c[col]) ]
+        out += sym
+    return p.k, out
+
+# Length, first repair symbol, number of repair symbols.
+# Must match the vectors in tests/fec.c.
+vectors = [
+    (40, 0, 8),
+    (37, 3, 5),
+    (180, 0, 6),
+    (550, 10, 4),
+    (1201, 1, 6),
+]
+
+for length, first, nb in vectors:
+    src = bytes((i*31 + 7) & 0xFF for i in range(length))
+    kp, out = repair(src, first, nb)
+    print(f"    /* K' = {kp} */")
+    print(f"    {{ {length}, {first}, {nb}, {{")
+    for i in range(0, len(out), 12):
+        print("        " + ", ".join(f"0x{v:02x}" for v in out[i:i + 12]) + ",")
+    print("    } },")
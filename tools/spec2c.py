@@ -551,6 +551,40 @@ if f_packet_data != None:
     file_structs.write("    return 0;\n")
     file_structs.write("}\n")
 
+    # Size of what follows the header, for skipping packets without parsing them
+    def pl_size_expr(member, fields):
+        for fname, field in fields.items():
+            if field["payload"]:
+                return "pkt." + member + "." + field["array_len"]
+            elif field["struct"] != None and type(field["array_len"]) == str:
+                return "(size_t)pkt." + member + "." + field["array_len"] + "*" + str(field["bytestream"])
+        return None
+
+    file_structs.write("\nstatic inline size_t avt_pkt_pl_size(union AVTPacketData pkt)\n")
+    file_structs.write("{\n")
+    file_structs.write("    switch (pkt.desc) {\n")
+
+    for name, fields in packet_structs.items():
+        if name in substructs or orig_desc_names[name].startswith("generic"):
+            continue
+        expr = pl_size_expr(orig_desc_names[name], fields)
+        if expr == None:
+            continue
+        file_structs.write("    case " + (data_prefix + "_PKT_" + orig_desc_names[name]).upper() + ":\n")
+        file_structs.write("        return " + expr + ";\n")
+    for name, tstruct in templated_structs.items():
+        expr = pl_size_expr(orig_desc_names[tstruct["template"]], packet_structs[tstruct["template"]])
+        if expr == None:
+            continue
+        file_structs.write("    case " + (data_prefix + "_PKT_" + tstruct["descriptor_name"]).upper() + ":\n")
+        file_structs.write("        return " + expr + ";\n")
+
+    file_structs.write("    default:\n")
+    file_structs.write("        break;\n")
+    file_structs.write("    }\n")
+    file_structs.write("    return 0;\n")
+    file_structs.write("}\n")
+
     file_structs.write("\n#endif /* AVTRANSPORT_PACKET_DATA_H */\n")
     file_structs.close()
 
@@ -611,9 +645,10 @@ if f_packet_encode != None:
             if name == "global_seq" or name == "target_seq":
                 file_encode.write(" & UINT32_MAX")
             elif name.endswith("descriptor"):
-                file_encode.write(" & UINT16_MAX")
                 if field["size_bits"] < 16:
-                    file_encode.write(" >> 8")
+                    file_encode.write(" >> 8 & UINT8_MAX")
+                else:
+                    file_encode.write(" & UINT16_MAX")
 
             # Array index
             if ((type(field["array_len"]) == int and field["array_len"] > 1) or \
@@ -660,20 +695,28 @@ if f_packet_encode != None:
                     file_encode.write(indent + "bitfield  = ")
                 else:
                     file_encode.write(indent + "bitfield |= ")
-                file_encode.write("p." + name + " << (" + str(bitfield_bit + 1) + " - " + str(field["size_bits"]) + ");\n")
+                file_encode.write("(uint" + str(MAX_BITFIELD_LEN) + "_t)p." + name + " << (" + str(bitfield_bit + 1) + " - " + str(field["size_bits"]) + ");\n")
                 bitfield_bit -= field["size_bits"]
             else:
                 if write_sym != bsw["fstr"] and (type(field["array_len"]) == int and field["array_len"] > 1):
                     file_encode.write(indent + "for (int i = 0; i < " + str(field["array_len"]) + "; i++)\n")
                     indent = indent + "    "
                 if write_sym != bsw["fstr"] and (type(field["array_len"]) == str and field["bytestream"] > 1):
+                    # Lists of structs are left for the caller unless given
+                    if field["struct"] != None:
+                        file_encode.write(indent + "if (!p." + name + ")\n")
+                        file_encode.write(indent + "    return;\n")
                     file_encode.write(indent + "for (int i = 0; i < p." + field["array_len"] + "; i++)\n")
                     indent = indent + "    "
                 wsym(indent, write_sym, name, field)
 
             if bitfield and (MAX_BITFIELD_LEN - bitfield_bit - 1) >= 8 and \
                math.log2(MAX_BITFIELD_LEN - bitfield_bit - 1).is_integer(): # Terminate bitfield
-                file_encode.write(indent + bsw["int"] + "u" + str(MAX_BITFIELD_LEN - bitfield_bit - 1) + "b (bs, bitfield);\n")
+                bitfield_len = MAX_BITFIELD_LEN - bitfield_bit - 1
+                file_encode.write(indent + bsw["int"] + "u" + str(bitfield_len) + "b (bs, bitfield")
+                if bitfield_len < MAX_BITFIELD_LEN:
+                    file_encode.write(" >> " + str(MAX_BITFIELD_LEN - bitfield_len))
+                file_encode.write(");\n")
                 bitfield = False
         file_encode.write("}\n")
     file_encode.write("\n#endif /* AVTRANSPORT_ENCODE_H */\n")
@@ -745,7 +788,9 @@ if f_packet_decode != None:
                 file_decode.write(sym)
 
             file_decode.write("(bs")
-            if field["struct"] != None:
+            if field["struct"] != None and type(field["array_len"]) == str:
+                file_decode.write(", &p->" + name + "[i]")
+            elif field["struct"] != None:
                 file_decode.write(", p->" + name)
 
             # Length
@@ -774,7 +819,8 @@ if f_packet_decode != None:
                 file_decode.write(" ^ " + "0x" + format(field["fixed"], "04X") + ")\n")
                 file_decode.write(indent + indent + "return AVT_ERROR(EINVAL);\n")
 
-        for name, field in fields.items():
+        field_list = list(fields.items())
+        for field_idx, (name, field) in enumerate(field_list):
             indent = "    "
             read_sym = bsr["int"]
             if field["datatype"] == data_prefix + "Rational":
@@ -794,9 +840,21 @@ if f_packet_decode != None:
 
             if field["bytestream"] == 0 and bitfield == False: # Setup bitfield writing
                 file_decode.write("\n")
+                # Bitfields are read whole, and kept aligned to the top
+                bitfield_len = 0
+                for _, bf in field_list[field_idx:]:
+                    if bf["bytestream"] != 0:
+                        break
+                    bitfield_len += bf["size_bits"]
+                    if bitfield_len >= 8 and math.log2(bitfield_len).is_integer():
+                        break
+                file_decode.write(indent)
                 if had_bitfield == False:
-                    file_decode.write(indent + "uint32_t ");
-                file_decode.write("bitfield = " + bsr["int"] + "u8b(bs);\n")
+                    file_decode.write("uint" + str(MAX_BITFIELD_LEN) + "_t ");
+                file_decode.write("bitfield = (uint" + str(MAX_BITFIELD_LEN) + "_t)" + bsr["int"] + "u" + str(bitfield_len) + "b(bs)")
+                if bitfield_len < MAX_BITFIELD_LEN:
+                    file_decode.write(" << " + str(MAX_BITFIELD_LEN - bitfield_len))
+                file_decode.write(";\n")
                 bitfield = True
                 had_bitfield = True
                 bitfield_bit = (MAX_BITFIELD_LEN - 1)
@@ -808,6 +866,12 @@ if f_packet_decode != None:
                 if ((type(field["array_len"]) == int and field["array_len"] > 1) or \
                     (type(field["array_len"]) == str and field["bytestream"] > 1)) and \
                    read_sym != bsr["fstr"]:
+                    # Lists of structs are left for the caller unless given storage
+                    if field["struct"] != None and type(field["array_len"]) == str:
+                        file_decode.write(indent + "if (!p->" + name + ") {\n")
+                        file_decode.write(indent + "    " + bsr["skip"] + "(bs, (size_t)p->" + field["array_len"] + "*" + str(field["bytestream"]) + ");\n")
+                        file_decode.write(indent + "    return avt_bs_offs(bs);\n")
+                        file_decode.write(indent + "}\n")
                     file_decode.write(indent + "for (int i = 0; i < ")
                     if type(field["array_len"]) == str:
                         file_decode.write("p->")